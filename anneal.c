@@ -0,0 +1,620 @@
+/*
+ * anneal.c --
+ *
+ *	This file implements a simulated annealing search on top of the
+ *	native hill climber's key and scoring routines.  Each step makes a
+ *	random move from the key's neighbors and keeps it with the
+ *	Metropolis rule: better keys are always kept, and a key that is
+ *	worse by d is kept with probability exp(-d/T).  The temperature T
+ *	follows one of three schedules:
+ *
+ *	linear		T falls in a straight line from the starting to the
+ *			final temperature.
+ *	geometric	T is multiplied by the same factor on every step,
+ *			reaching the final temperature on the last step.
+ *	adaptive	T is adjusted after every window of steps to move
+ *			the fraction of accepted moves towards a target.
+ *			The target falls linearly from the starting
+ *			acceptance rate to zero.
+ *
+ *	If no starting temperature is given then one is estimated from a
+ *	sample of random moves so that about 80% of the worse keys would
+ *	be accepted at the start.
+ *
+ * Copyright (c) 2008 Michael Thomas <wart@kobold.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <tcl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include "hillclimb.h"
+
+#define ANNEAL_LINEAR		0
+#define ANNEAL_GEOMETRIC	1
+#define ANNEAL_ADAPTIVE		2
+
+static const char *annealSchedules[] = {"linear", "geometric", "adaptive",
+    NULL};
+
+/*
+ * The number of moves between temperature changes in the adaptive
+ * schedule, and the number of moves sampled to pick a starting
+ * temperature.
+ */
+
+#define ANNEAL_WINDOW		100
+#define ANNEAL_SAMPLE		100
+
+/*
+ * The fraction of worse keys that are accepted at an estimated starting
+ * temperature.
+ */
+
+#define ANNEAL_START_ACCEPTANCE	0.8
+
+/*
+ * The number of moves between looking at the clock to see if a
+ * checkpoint is due.
+ */
+
+#define ANNEAL_CHECKPOINT_CHECK	256
+
+typedef struct AnnealState {
+    HillclimbState climb;
+    int schedule;
+    long iterations;
+    double startTemperature;
+    double temperature;
+    double finalTemperature;
+    double acceptance;
+
+    long evaluations;
+    long accepted;
+    HillclimbTrace trace;
+
+    HillclimbCheckpoint checkpoint;
+} AnnealState;
+
+/*
+ * Estimate the temperature at which the given fraction of the random
+ * moves away from key that make it worse would be accepted, from the
+ * average loss of a sample of moves.  key is left unchanged, and the
+ * number of keys that were scored is added to *evaluationsPtr.
+ */
+
+int
+HillclimbEstimateTemperature(HillclimbState *statePtr, char *key, const char *pt, double value, double acceptance, long *evaluationsPtr, double *temperaturePtr)
+{
+    HillclimbMove move;
+    double newValue;
+    double loss = 0.0;
+    int worse = 0;
+    int i;
+
+    for (i=0; i < ANNEAL_SAMPLE; i++) {
+	HillclimbRandomMove(statePtr, &move);
+	HillclimbApplyMove(&statePtr->moves, key, &move);
+	if (HillclimbDecipher(statePtr, key) != TCL_OK
+		|| HillclimbScore(statePtr, pt, value, &newValue) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	HillclimbUndoMove(&statePtr->moves, key, &move);
+	(*evaluationsPtr)++;
+
+	if (newValue < value) {
+	    loss += value - newValue;
+	    worse++;
+	}
+    }
+
+    if (worse == 0) {
+	*temperaturePtr = 1.0;
+    } else {
+	*temperaturePtr = (loss / worse) / -log(acceptance);
+    }
+
+    return TCL_OK;
+}
+
+/*
+ * Save the search after the given iteration.  Along with the best key,
+ * this holds everything that the rest of the schedule depends on:  the
+ * current key and its score, the temperatures, and the random number
+ * generator.
+ */
+
+static int
+AnnealWriteCheckpoint(AnnealState *statePtr, long iteration, char *key, double curValue, long windowAccepted, char *maxKey, double maxValue)
+{
+    HillclimbState *climbPtr = &statePtr->climb;
+    Checkpoint checkpoint;
+    int result;
+
+    HillclimbCheckpointStart(climbPtr, &checkpoint, CHECKPOINT_ANNEAL);
+    CheckpointPutInt(&checkpoint, statePtr->schedule);
+    CheckpointPutInt(&checkpoint, statePtr->iterations);
+    CheckpointPutInt(&checkpoint, iteration);
+    CheckpointPutBytes(&checkpoint, key, climbPtr->keySize);
+    CheckpointPutDouble(&checkpoint, curValue);
+    CheckpointPutBytes(&checkpoint, maxKey, climbPtr->keySize);
+    CheckpointPutDouble(&checkpoint, maxValue);
+    CheckpointPutDouble(&checkpoint, statePtr->startTemperature);
+    CheckpointPutDouble(&checkpoint, statePtr->temperature);
+    CheckpointPutDouble(&checkpoint, statePtr->finalTemperature);
+    CheckpointPutInt(&checkpoint, windowAccepted);
+    CheckpointPutInt(&checkpoint, statePtr->accepted);
+    CheckpointPutInt(&checkpoint, statePtr->evaluations);
+    HillclimbCheckpointPutTrace(&checkpoint, &statePtr->trace);
+
+    result = CheckpointWrite(climbPtr->interp, &checkpoint,
+	    statePtr->checkpoint.fileName);
+    CheckpointFree(&checkpoint);
+
+    return result;
+}
+
+static int
+AnnealReadCheckpoint(AnnealState *statePtr, long *iterationPtr, char *key, double *curValuePtr, long *windowAcceptedPtr, char *maxKey, double *maxValuePtr)
+{
+    HillclimbState *climbPtr = &statePtr->climb;
+    Tcl_Interp *interp = climbPtr->interp;
+    Checkpoint checkpoint;
+    Tcl_WideInt schedule, iterations, iteration;
+    Tcl_WideInt windowAccepted, accepted, evaluations;
+    int result;
+
+    if (HillclimbCheckpointResume(climbPtr, &statePtr->checkpoint,
+		&checkpoint, CHECKPOINT_ANNEAL) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    result = CheckpointGetInt(interp, &checkpoint, &schedule);
+    if (result == TCL_OK) {
+	result = CheckpointGetInt(interp, &checkpoint, &iterations);
+    }
+    if (result == TCL_OK && (schedule != statePtr->schedule
+		|| iterations != statePtr->iterations)) {
+	result = CheckpointMismatch(interp, &checkpoint);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetInt(interp, &checkpoint, &iteration);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetBytes(interp, &checkpoint, key,
+		climbPtr->keySize);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetDouble(interp, &checkpoint, curValuePtr);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetBytes(interp, &checkpoint, maxKey,
+		climbPtr->keySize);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetDouble(interp, &checkpoint, maxValuePtr);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetDouble(interp, &checkpoint,
+		&statePtr->startTemperature);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetDouble(interp, &checkpoint,
+		&statePtr->temperature);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetDouble(interp, &checkpoint,
+		&statePtr->finalTemperature);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetInt(interp, &checkpoint, &windowAccepted);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetInt(interp, &checkpoint, &accepted);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetInt(interp, &checkpoint, &evaluations);
+    }
+    if (result == TCL_OK) {
+	result = HillclimbCheckpointGetTrace(climbPtr, &checkpoint,
+		&statePtr->trace);
+    }
+    CheckpointFree(&checkpoint);
+
+    *iterationPtr = (long)iteration;
+    *windowAcceptedPtr = (long)windowAccepted;
+    statePtr->accepted = (long)accepted;
+    statePtr->evaluations = (long)evaluations;
+
+    return result;
+}
+
+/*
+ * Run the annealing schedule from key, or carry on from a checkpoint if
+ * the search is being resumed.  On return maxKey holds the best key
+ * seen.
+ */
+
+static int
+AnnealRun(HillclimbState *climbPtr, char *key, char *maxKey, double *maxValuePtr)
+{
+    AnnealState *statePtr = (AnnealState *)climbPtr;
+    HillclimbCheckpoint *cpPtr = &statePtr->checkpoint;
+    HillclimbMove move;
+    char *curPt = (char *)NULL;
+    int curPtSpace = 0;
+    double curValue, value, maxValue;
+    double startTemperature, factor = 1.0;
+    long windowAccepted = 0;
+    long iteration = 0;
+    int result;
+
+    if (cpPtr->resumeName) {
+	/*
+	 * The plaintext of the current key isn't saved, so it is
+	 * deciphered again.
+	 */
+
+	result = AnnealReadCheckpoint(statePtr, &iteration, key, &curValue,
+		&windowAccepted, maxKey, &maxValue);
+	if (result == TCL_OK) {
+	    result = HillclimbDecipher(climbPtr, key);
+	}
+	if (result != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	HillclimbCopyPt(&curPt, &curPtSpace, climbPtr->pt);
+	startTemperature = statePtr->startTemperature;
+    } else {
+	result = HillclimbDecipher(climbPtr, key);
+	if (result == TCL_OK) {
+	    result = HillclimbScore(climbPtr, (char *)NULL, 0.0, &curValue);
+	}
+	if (result != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	statePtr->evaluations++;
+	HillclimbCopyPt(&curPt, &curPtSpace, climbPtr->pt);
+
+	if (statePtr->temperature <= 0.0) {
+	    result = HillclimbEstimateTemperature(climbPtr, key, curPt,
+		    curValue, ANNEAL_START_ACCEPTANCE, &statePtr->evaluations,
+		    &statePtr->temperature);
+	}
+	if (result == TCL_OK && statePtr->finalTemperature <= 0.0) {
+	    statePtr->finalTemperature = statePtr->temperature / 1000.0;
+	}
+	startTemperature = statePtr->startTemperature = statePtr->temperature;
+
+	maxValue = curValue;
+	memcpy(maxKey, key, climbPtr->keySize);
+	if (result == TCL_OK) {
+	    result = HillclimbBestFit(climbPtr, key, 0, maxValue);
+	}
+    }
+    if (statePtr->schedule == ANNEAL_GEOMETRIC && statePtr->iterations > 1) {
+	factor = pow(statePtr->finalTemperature / startTemperature,
+		1.0 / (statePtr->iterations - 1));
+    }
+
+    for (iteration++; iteration <= statePtr->iterations && result == TCL_OK;
+	    iteration++) {
+	HillclimbRandomMove(climbPtr, &move);
+	HillclimbApplyMove(&climbPtr->moves, key, &move);
+	result = HillclimbDecipher(climbPtr, key);
+	if (result == TCL_OK) {
+	    result = HillclimbScore(climbPtr, curPt, curValue, &value);
+	}
+	if (result != TCL_OK) {
+	    break;
+	}
+	statePtr->evaluations++;
+
+	if (value >= curValue || HillclimbRandom(climbPtr)
+		< exp((value - curValue) / statePtr->temperature)) {
+	    curValue = value;
+	    HillclimbCopyPt(&curPt, &curPtSpace, climbPtr->pt);
+	    statePtr->accepted++;
+	    windowAccepted++;
+
+	    if (value > maxValue) {
+		maxValue = value;
+		memcpy(maxKey, key, climbPtr->keySize);
+		HillclimbTraceAdd(&statePtr->trace, iteration, value);
+
+		result = HillclimbBestFit(climbPtr, key, iteration, value);
+	    }
+	} else {
+	    HillclimbUndoMove(&climbPtr->moves, key, &move);
+	}
+
+	if (result == TCL_OK) {
+	    result = HillclimbStep(climbPtr, key, iteration);
+	}
+
+	switch (statePtr->schedule) {
+	    case ANNEAL_LINEAR:
+		statePtr->temperature = startTemperature
+		    - (startTemperature - statePtr->finalTemperature)
+		    * iteration / statePtr->iterations;
+		break;
+	    case ANNEAL_GEOMETRIC:
+		statePtr->temperature *= factor;
+		break;
+	    case ANNEAL_ADAPTIVE:
+		if (iteration % ANNEAL_WINDOW == 0) {
+		    double target = statePtr->acceptance
+			* (1.0 - (double)iteration / statePtr->iterations);
+
+		    if ((double)windowAccepted / ANNEAL_WINDOW > target) {
+			statePtr->temperature *= 0.9;
+		    } else {
+			statePtr->temperature /= 0.9;
+		    }
+		    windowAccepted = 0;
+		}
+		break;
+	}
+
+	/*
+	 * Keep the temperature from reaching zero, which would turn the
+	 * acceptance test into a division by zero.
+	 */
+
+	if (statePtr->temperature < 1e-12) {
+	    statePtr->temperature = 1e-12;
+	}
+
+	if (result == TCL_OK && cpPtr->fileName
+		&& iteration % ANNEAL_CHECKPOINT_CHECK == 0
+		&& CheckpointDue(&cpPtr->last, cpPtr->interval)) {
+	    result = AnnealWriteCheckpoint(statePtr, iteration, key, curValue,
+		    windowAccepted, maxKey, maxValue);
+	}
+    }
+
+    if (result == TCL_OK && cpPtr->fileName) {
+	result = AnnealWriteCheckpoint(statePtr, statePtr->iterations, key,
+		curValue, windowAccepted, maxKey, maxValue);
+    }
+    if (result == TCL_OK) {
+	result = HillclimbDecipher(climbPtr, maxKey);
+    }
+
+    if (curPt) {
+	ckfree(curPt);
+    }
+
+    *maxValuePtr = maxValue;
+    return result;
+}
+
+/*
+ * Hillclimb::anneal cipher key ?options?
+ *
+ *	Search for the best key with simulated annealing.  Returns a list
+ *	of the best key found, its score, and a list of statistics about
+ *	the run.  The cipher is left with the best key restored.  See
+ *	doc/Hillclimb/package.tml for the options.
+ */
+
+int
+HillclimbAnnealObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
+{
+    AnnealState state;
+    AnnealState *bestPtr = &state;
+    Tcl_Obj *resultObjs[3];
+    Tcl_Obj *statObjs[24];
+    Tcl_Obj *traceObj;
+    Tcl_Time start, end;
+    char *restarts = (char *)NULL;
+    char *key = (char *)NULL;
+    char *maxKey;
+    double maxValue = 0.0;
+    double seconds;
+    long evaluations, accepted;
+    int result = TCL_OK;
+    int best = 0;
+    int i;
+
+    if (objc < 3 || objc % 2 == 0) {
+	Tcl_AppendResult(interp, "Usage:  ", Tcl_GetString(objv[0]),
+		" cipher key ?option value ...?", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    memset(&state, 0, sizeof(AnnealState));
+    if (HillclimbInitState(interp, objv[1], &state.climb) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    state.schedule = ANNEAL_GEOMETRIC;
+    state.iterations = 100000;
+    state.acceptance = 0.5;
+    HillclimbCheckpointInit(&state.checkpoint);
+
+    for (i=3; i < objc; i += 2) {
+	const char *option = Tcl_GetString(objv[i]);
+
+	result = HillclimbStateOption(&state.climb, option, objv[i+1]);
+	if (result == TCL_ERROR) {
+	    return TCL_ERROR;
+	} else if (result == TCL_OK) {
+	    continue;
+	}
+	result = HillclimbCheckpointOption(&state.climb, &state.checkpoint,
+		option, objv[i+1]);
+	if (result == TCL_ERROR) {
+	    return TCL_ERROR;
+	} else if (result == TCL_OK) {
+	    continue;
+	}
+	result = TCL_OK;
+
+	if (strcmp(option, "-schedule") == 0) {
+	    if (Tcl_GetIndexFromObj(interp, objv[i+1], annealSchedules,
+			"schedule", 0, &state.schedule) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-iterations") == 0) {
+	    if (Tcl_GetLongFromObj(interp, objv[i+1], &state.iterations)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.iterations < 1) {
+		Tcl_SetResult(interp, "Iterations must be at least 1",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-temperature") == 0) {
+	    if (Tcl_GetDoubleFromObj(interp, objv[i+1], &state.temperature)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.temperature <= 0.0) {
+		Tcl_SetResult(interp, "Temperatures must be greater than 0",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-final") == 0) {
+	    if (Tcl_GetDoubleFromObj(interp, objv[i+1],
+			&state.finalTemperature) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.finalTemperature <= 0.0) {
+		Tcl_SetResult(interp, "Temperatures must be greater than 0",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-acceptance") == 0) {
+	    if (Tcl_GetDoubleFromObj(interp, objv[i+1], &state.acceptance)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.acceptance <= 0.0 || state.acceptance > 1.0) {
+		Tcl_SetResult(interp,
+			"Acceptance rate must be greater than 0 and at most 1",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else {
+	    Tcl_AppendResult(interp, "Unknown option ", option, (char *)NULL);
+	    return TCL_ERROR;
+	}
+    }
+
+    if ((state.checkpoint.fileName || state.checkpoint.resumeName)
+	    && (state.climb.restarts > 1 || state.climb.threads > 1)) {
+	Tcl_SetResult(interp,
+		"Checkpoints can't be used with -restarts or -threads",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    if (HillclimbPrepare(&state.climb, objv[2], &key) != TCL_OK) {
+	HillclimbFreeState(&state.climb);
+	return TCL_ERROR;
+    }
+    if (state.climb.moves.count == 0) {
+	Tcl_SetResult(interp, "The key has no positions that can be swapped",
+		TCL_STATIC);
+	ckfree(key);
+	HillclimbFreeState(&state.climb);
+	return TCL_ERROR;
+    }
+    maxKey = (char *)ckalloc(state.climb.keySize);
+
+    Tcl_GetTime(&start);
+    if (state.climb.restarts > 1 || state.climb.threads > 1) {
+	result = HillclimbRunRestarts(&state.climb, sizeof(AnnealState),
+		AnnealRun, key, maxKey, &maxValue, &restarts, &best);
+    } else {
+	result = AnnealRun(&state.climb, key, maxKey, &maxValue);
+    }
+    Tcl_GetTime(&end);
+
+    /*
+     * The counts are totals over all of the restarts.  The temperatures
+     * and the trace come from the restart that found the best key.
+     */
+
+    evaluations = state.evaluations;
+    accepted = state.accepted;
+    if (restarts) {
+	for (i=0; i < state.climb.restarts; i++) {
+	    AnnealState *runPtr = (AnnealState *)(restarts
+		    + i * sizeof(AnnealState));
+
+	    evaluations += runPtr->evaluations;
+	    accepted += runPtr->accepted;
+	}
+	bestPtr = (AnnealState *)(restarts + best * sizeof(AnnealState));
+    }
+
+    if (result == TCL_OK) {
+	seconds = (end.sec - start.sec) + (end.usec - start.usec) / 1e6;
+
+	traceObj = HillclimbTraceObj(&bestPtr->trace);
+
+	statObjs[0] = Tcl_NewStringObj("evaluations", -1);
+	statObjs[1] = Tcl_NewLongObj(evaluations);
+	statObjs[2] = Tcl_NewStringObj("seconds", -1);
+	statObjs[3] = Tcl_NewDoubleObj(seconds);
+	statObjs[4] = Tcl_NewStringObj("rate", -1);
+	statObjs[5] = Tcl_NewDoubleObj(seconds > 0.0
+		? evaluations / seconds : 0.0);
+	statObjs[6] = Tcl_NewStringObj("accepted", -1);
+	statObjs[7] = Tcl_NewLongObj(accepted);
+	statObjs[8] = Tcl_NewStringObj("acceptance", -1);
+	statObjs[9] = Tcl_NewDoubleObj((double)accepted
+		/ (state.iterations * state.climb.restarts));
+	statObjs[10] = Tcl_NewStringObj("starttemperature", -1);
+	statObjs[11] = Tcl_NewDoubleObj(bestPtr->startTemperature);
+	statObjs[12] = Tcl_NewStringObj("temperature", -1);
+	statObjs[13] = Tcl_NewDoubleObj(bestPtr->temperature);
+	statObjs[14] = Tcl_NewStringObj("seed", -1);
+	statObjs[15] = Tcl_NewLongObj(state.climb.seed);
+	statObjs[16] = Tcl_NewStringObj("iterations", -1);
+	statObjs[17] = Tcl_NewLongObj(state.iterations);
+	statObjs[18] = Tcl_NewStringObj("restarts", -1);
+	statObjs[19] = Tcl_NewLongObj(state.climb.restarts);
+	statObjs[20] = Tcl_NewStringObj("threads", -1);
+	statObjs[21] = Tcl_NewIntObj(state.climb.threads);
+	statObjs[22] = Tcl_NewStringObj("trace", -1);
+	statObjs[23] = traceObj;
+
+	resultObjs[0] = HillclimbKeyObj(&state.climb, maxKey);
+	resultObjs[1] = Tcl_NewDoubleObj(maxValue);
+	resultObjs[2] = Tcl_NewListObj(24, statObjs);
+	Tcl_SetObjResult(interp, Tcl_NewListObj(3, resultObjs));
+    }
+
+    if (restarts) {
+	for (i=0; i < state.climb.restarts; i++) {
+	    HillclimbTraceFree(&((AnnealState *)(restarts
+		    + i * sizeof(AnnealState)))->trace);
+	}
+	HillclimbFreeRestarts(&state.climb, sizeof(AnnealState), restarts);
+    }
+    HillclimbTraceFree(&state.trace);
+    ckfree(key);
+    ckfree(maxKey);
+    HillclimbFreeState(&state.climb);
+
+    return result;
+}
@@ -994,25 +994,72 @@ AristocratRecSwap(Tcl_Interp *interp, CipherItem *itemPtr)
     int pos1, pos2;
     int maximaFound=0;
     char *pt;
+    char *newPt;
     double maxValue = 0.0;
+    double curValue;
+    int *ctPositions;
+    int *changed;
+    int ctStart[27];
+    int length;
+    int result = TCL_OK;
+
+    /*
+     * pt holds the plaintext for the current key.  Swaps are tried in
+     * newPt, which only differs from pt at the positions of the two
+     * swapped ciphertext letters, so only those positions need to be
+     * rescored.
+     */
 
     pt = GetAristocrat(interp, itemPtr);
     if (DefaultScoreValue(interp, (const char *)pt, &aristPtr->maxValue)
             != TCL_OK) {
+	ckfree(pt);
 	return TCL_ERROR;
     }
+    curValue = aristPtr->maxValue;
     for(i=0; i < 26; i++) {
 	aristPtr->maxKey[i] = aristPtr->ptkey[i];
     }
-    ckfree(pt);
+    length = strlen(pt);
+    newPt = ckalloc(sizeof(char)*(length+1));
+    strcpy(newPt, pt);
 
-    while (! maximaFound) {
+    /*
+     * Index the positions of each ciphertext letter.  The positions of
+     * letter i are ctPositions[ctStart[i]] to ctPositions[ctStart[i+1]-1].
+     */
+
+    ctPositions = (int *)ckalloc(sizeof(int)*(length+1));
+    changed = (int *)ckalloc(sizeof(int)*(length+1));
+    for(i=0; i < 27; i++) {
+	ctStart[i] = 0;
+    }
+    for(i=0; itemPtr->ciphertext[i]; i++) {
+	if (itemPtr->ciphertext[i] >= 'a' && itemPtr->ciphertext[i] <= 'z') {
+	    ctStart[itemPtr->ciphertext[i] - 'a' + 1]++;
+	}
+    }
+    for(i=1; i < 27; i++) {
+	ctStart[i] += ctStart[i-1];
+    }
+    for(i=0; itemPtr->ciphertext[i]; i++) {
+	if (itemPtr->ciphertext[i] >= 'a' && itemPtr->ciphertext[i] <= 'z') {
+	    ctPositions[ctStart[itemPtr->ciphertext[i] - 'a']++] = i;
+	}
+    }
+    for(i=26; i > 0; i--) {
+	ctStart[i] = ctStart[i-1];
+    }
+    ctStart[0] = 0;
+
+    while (! maximaFound && result == TCL_OK) {
 	maximaFound = 1;
 
-	for(pos1=0; pos1 < 25; pos1++) {
-	    for(pos2=pos1+1; pos2 < 26; pos2++) {
+	for(pos1=0; pos1 < 25 && result == TCL_OK; pos1++) {
+	    for(pos2=pos1+1; pos2 < 26 && result == TCL_OK; pos2++) {
 		char temp;
 		double value;
+		int numChanged = 0;
 		Tcl_DString dsPtr;
 
 		/*
@@ -1027,13 +1074,23 @@ AristocratRecSwap(Tcl_Interp *interp, CipherItem *itemPtr)
 		aristPtr->ctkey[aristPtr->ptkey[pos1]-'a'] = pos1+'a';
 		aristPtr->ctkey[aristPtr->ptkey[pos2]-'a'] = pos2+'a';
 
-		pt = GetAristocrat(interp, itemPtr);
-		if (DefaultScoreValue(interp, (const char *)pt, &value)
-                        != TCL_OK) {
-		    return TCL_ERROR;
+		for(i=ctStart[pos1]; i < ctStart[pos1+1]; i++) {
+		    changed[numChanged++] = ctPositions[i];
+		    newPt[ctPositions[i]] = aristPtr->ptkey[pos1]?aristPtr->ptkey[pos1]:' ';
+		}
+		for(i=ctStart[pos2]; i < ctStart[pos2+1]; i++) {
+		    changed[numChanged++] = ctPositions[i];
+		    newPt[ctPositions[i]] = aristPtr->ptkey[pos2]?aristPtr->ptkey[pos2]:' ';
+		}
+
+		if (DefaultScoreDeltaValue(interp, (const char *)pt,
+			(const char *)newPt, curValue, changed, numChanged,
+			&value) != TCL_OK) {
+		    result = TCL_ERROR;
+		    break;
 		}
 
-		if (itemPtr->stepInterval && itemPtr->curIteration % itemPtr->stepInterval == 0 && itemPtr->stepCommand && pt) {
+		if (itemPtr->stepInterval && itemPtr->curIteration % itemPtr->stepInterval == 0 && itemPtr->stepCommand) {
 		    char temp_str[128];
 
 		    Tcl_DStringInit(&dsPtr);
@@ -1052,11 +1109,12 @@ AristocratRecSwap(Tcl_Interp *interp, CipherItem *itemPtr)
 		    temp_str[i] = '\0';
 		    Tcl_DStringAppendElement(&dsPtr, temp_str);
 
-		    Tcl_DStringAppendElement(&dsPtr, pt);
+		    Tcl_DStringAppendElement(&dsPtr, newPt);
 
 		    if (Tcl_Eval(interp, Tcl_DStringValue(&dsPtr)) != TCL_OK) {
 			Tcl_DStringFree(&dsPtr);
-			return TCL_ERROR;
+			result = TCL_ERROR;
+			break;
 		    }
 		    Tcl_DStringFree(&dsPtr);
 		}
@@ -1094,16 +1152,25 @@ AristocratRecSwap(Tcl_Interp *interp, CipherItem *itemPtr)
 		    sprintf(temp_str, "%g", value);
 		    Tcl_DStringAppendElement(&dsPtr, temp_str);
 
-		    Tcl_DStringAppendElement(&dsPtr, pt);
+		    Tcl_DStringAppendElement(&dsPtr, newPt);
 
 		    if (itemPtr->bestFitCommand) {
 			if (Tcl_Eval(interp, Tcl_DStringValue(&dsPtr)) != TCL_OK) {
 			    Tcl_DStringFree(&dsPtr);
-			    return TCL_ERROR;
+			    result = TCL_ERROR;
+			    break;
 			}
 		    }
 
 		    Tcl_DStringFree(&dsPtr);
+
+		    /*
+		     * Keep the swap.
+		     */
+		    for(i=0; i < numChanged; i++) {
+			pt[changed[i]] = newPt[changed[i]];
+		    }
+		    curValue = value;
 		} else {
 		    /*
 		     * This swap produced bad results.  Undo it.
@@ -1114,18 +1181,25 @@ AristocratRecSwap(Tcl_Interp *interp, CipherItem *itemPtr)
 
 		    aristPtr->ctkey[aristPtr->ptkey[pos1]-'a'] = pos1+'a';
 		    aristPtr->ctkey[aristPtr->ptkey[pos2]-'a'] = pos2+'a';
+
+		    for(i=0; i < numChanged; i++) {
+			newPt[changed[i]] = pt[changed[i]];
+		    }
 		}
 
 		itemPtr->curIteration++;
-
-		ckfree(pt);
 	    }
 	}
     }
 
-    return TCL_OK;
+    ckfree(pt);
+    ckfree(newPt);
+    ckfree((char *)ctPositions);
+    ckfree((char *)changed);
+
+    return result;
 }
-
+
 static int
 AristocratRecKeygen(Tcl_Interp *interp, CipherItem *itemPtr, int period, int depth)
 {
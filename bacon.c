@@ -28,7 +28,7 @@
 #include <dictionaryCmds.h>
 #include <ctype.h>
 #include <stdlib.h>
-#include <time.h>
+#include <cipherRandom.h>
 
 #include <cipherDebug.h>
 
@@ -1185,9 +1185,6 @@ EncodeBaconian(Tcl_Interp *interp, CipherItem *itemPtr, const char *pt, const ch
 	}
     }
 
-    /* This should be in another file. */
-    srand48((long int) time(NULL));
-
     if (!incomplete) {
 	
 	/* Encode. */
@@ -1199,7 +1196,8 @@ EncodeBaconian(Tcl_Interp *interp, CipherItem *itemPtr, const char *pt, const ch
 	    if (islower(c)) {
 		Tcl_ListObjIndex(interp,
 			wordListByLetter[c-'a'],
-			rand() % lengthOfWordListByLetter[c-'a'],
+			RandomIndex(RandomThreadState(),
+			    lengthOfWordListByLetter[c-'a']),
 			&wordObj);
 		strcpy(ct + 5*count, Tcl_GetString(wordObj));
 		count++;
@@ -146,6 +146,14 @@ DeleteCadenus(ClientData clientData)
 	ckfree((char *)(cadPtr->order));
     }
 
+    if (cadPtr->maxKey) {
+	ckfree(cadPtr->maxKey);
+    }
+
+    if (cadPtr->maxOrder) {
+	ckfree((char *)(cadPtr->maxOrder));
+    }
+
     DeleteCipher(clientData);
 }
 
@@ -318,6 +326,35 @@ RestoreCadenus(Tcl_Interp *interp, CipherItem *itemPtr, const char *key, const c
     return TCL_OK;
 }
 
+/*
+ * Get a cadenus cipher ready to search for a key.  Every key letter is
+ * fitted to its column as each order is tried, so nothing needs to be
+ * copied from fromData.
+ */
+
+static int
+CadenusStartSolve(Tcl_Interp *interp, ClientData fromData, ClientData toData, PermBest *bestPtr)
+{
+    CadenusItem *cadPtr = (CadenusItem *)toData;
+    CipherItem *itemPtr = (CipherItem *)toData;
+
+    if (cadPtr->maxKey) {
+	ckfree(cadPtr->maxKey);
+    }
+    if (cadPtr->maxOrder) {
+	ckfree((char *)(cadPtr->maxOrder));
+    }
+    cadPtr->maxKey = (char *)ckalloc(sizeof(char)*itemPtr->period);
+    cadPtr->maxOrder = (int *)ckalloc(sizeof(int)*itemPtr->period);
+    cadPtr->maxVal = 0;
+
+    PermBestInit(bestPtr, &cadPtr->maxVal, &itemPtr->curIteration);
+    PermBestAdd(bestPtr, cadPtr->maxKey, sizeof(char)*itemPtr->period);
+    PermBestAdd(bestPtr, cadPtr->maxOrder, sizeof(int)*itemPtr->period);
+
+    return TCL_OK;
+}
+
 /*
  * Fix this
  */
@@ -326,25 +363,54 @@ static int
 SolveCadenus(Tcl_Interp *interp, CipherItem *itemPtr, char *maxkey)
 {
     CadenusItem *cadPtr = (CadenusItem *)itemPtr;
-    int i;
+    PermCheckpoint checkpoint;
+    PermBest best;
+    int i, result;
     char *curKey;
 
+    if (CipherCheckRange(interp, itemPtr) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
     curKey = (char *)ckalloc(sizeof(char) * itemPtr->period);
     for(i=0; i < itemPtr->period; i++) {
 	curKey[i] = '\0';
     }
 
-    if (cadPtr->maxKey) {
-	ckfree(cadPtr->maxKey);
+    CadenusStartSolve(interp, (ClientData)itemPtr, (ClientData)itemPtr,
+	    &best);
+
+    if (itemPtr->rangeCount) {
+	result = _internalDoPermRangeCmd((ClientData)itemPtr, interp,
+		itemPtr->period, CadenusCheckValue, itemPtr->rangeStart,
+		itemPtr->rangeCount);
+    } else if (itemPtr->threads > 1) {
+	result = _internalDoPermThreadCmd((ClientData)itemPtr, interp,
+		itemPtr->period, CadenusCheckValue, itemPtr->threads,
+		CadenusStartSolve, &best);
+    } else {
+	PermCheckpointInit(&checkpoint, itemPtr->checkpointFile,
+		itemPtr->resumeFile, itemPtr->checkpointInterval,
+		itemPtr->ciphertext, &itemPtr->curIteration);
+	PermCheckpointAdd(&checkpoint, cadPtr->maxKey,
+		sizeof(char)*itemPtr->period);
+	PermCheckpointAdd(&checkpoint, cadPtr->maxOrder,
+		sizeof(int)*itemPtr->period);
+	PermCheckpointAdd(&checkpoint, &cadPtr->maxVal,
+		sizeof(cadPtr->maxVal));
+
+	result = _internalDoPermCheckpointCmd((ClientData)itemPtr, interp,
+		itemPtr->period, CadenusCheckValue, &checkpoint);
     }
-    if (cadPtr->maxOrder) {
+    ckfree(curKey);
+
+    if (result != TCL_OK) {
+	ckfree(cadPtr->maxKey);
 	ckfree((char *)(cadPtr->maxOrder));
+	cadPtr->maxKey = (char *)NULL;
+	cadPtr->maxOrder = (int *)NULL;
+	return result;
     }
-    cadPtr->maxKey = (char *)ckalloc(sizeof(char)*itemPtr->period);
-    cadPtr->maxOrder = (int *)ckalloc(sizeof(int)*itemPtr->period);
-    cadPtr->maxVal = 0;
-
-    _internalDoPermCmd((ClientData)itemPtr, interp, itemPtr->period, CadenusCheckValue);
 
     /*
     RecSolveCadenus(interp, itemPtr, 0, curKey);
@@ -710,6 +776,15 @@ CadenusCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **arg
 	} else if (strncmp(argv[1], "-type", 5) == 0) {
 	    Tcl_SetResult(interp, itemPtr->typePtr->type, TCL_STATIC);
 	    return TCL_OK;
+	} else if (strncmp(argv[1], "-checkpoint", 11) == 0 ||
+		   strncmp(argv[1], "-resume", 7) == 0) {
+	    return CipherGetCheckpoint(interp, itemPtr, argv[1]);
+	} else if (strcmp(argv[1], "-threads") == 0) {
+	    sprintf(temp_str, "%d", itemPtr->threads);
+	    Tcl_SetResult(interp, temp_str, TCL_VOLATILE);
+	    return TCL_OK;
+	} else if (strcmp(argv[1], "-range") == 0) {
+	    return CipherGetRange(interp, itemPtr);
 	} else if (strncmp(argv[1], "-language", 8) == 0) {
 	    Tcl_SetResult(interp, cipherGetLanguage(itemPtr->language),
 		    TCL_VOLATILE);
@@ -739,6 +814,23 @@ CadenusCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **arg
 
 		Tcl_SetResult(interp, "", TCL_STATIC);
 		return TCL_OK;
+	    } else if (strncmp(*argv, "-checkpoint", 11) == 0 ||
+		strncmp(*argv, "-resume", 7) == 0) {
+		if (CipherSetCheckpoint(interp, itemPtr, argv[0], argv[1])
+			!= TCL_OK) {
+		    return TCL_ERROR;
+		}
+	    } else if (strcmp(*argv, "-threads") == 0) {
+		if (sscanf(argv[1], "%d", &i) != 1 || i < 1) {
+		    Tcl_SetResult(interp, "Threads must be at least 1",
+			    TCL_STATIC);
+		    return TCL_ERROR;
+		}
+		itemPtr->threads = i;
+	    } else if (strcmp(*argv, "-range") == 0) {
+		if (CipherSetRange(interp, itemPtr, argv[1]) != TCL_OK) {
+		    return TCL_ERROR;
+		}
 	    } else if (strncmp(*argv, "-language", 8) == 0) {
 		itemPtr->language = cipherSelectLanguage(argv[1]);
 		Tcl_SetResult(interp, cipherGetLanguage(itemPtr->language),
@@ -0,0 +1,291 @@
+/*
+ * checkpoint.c --
+ *
+ *	This file reads and writes the checkpoint files of the long running
+ *	searches, so that a search that is stopped can be picked up again
+ *	from where it left off.  A checkpoint is a short header followed by
+ *	whatever the search needs to save.  It is written to a temporary
+ *	file that then replaces the old checkpoint, so a crash while
+ *	writing never leaves a broken checkpoint behind.
+ *
+ * Copyright (c) 2008 Michael Thomas <wart@kobold.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <tcl.h>
+#include <string.h>
+#include "checkpoint.h"
+
+#define CHECKPOINT_MAGIC	"CTKP"
+#define CHECKPOINT_VERSION	1
+#define CHECKPOINT_ORDER	0x01020304
+
+/*
+ * Start a new checkpoint of the given kind.
+ */
+
+void
+CheckpointInit(Checkpoint *cpPtr, int kind)
+{
+    Tcl_DStringInit(&cpPtr->data);
+    cpPtr->offset = 0;
+    cpPtr->fileName = (const char *)NULL;
+
+    Tcl_DStringAppend(&cpPtr->data, CHECKPOINT_MAGIC, 4);
+    CheckpointPutInt(cpPtr, CHECKPOINT_VERSION);
+    CheckpointPutInt(cpPtr, CHECKPOINT_ORDER);
+    CheckpointPutInt(cpPtr, kind);
+}
+
+void
+CheckpointFree(Checkpoint *cpPtr)
+{
+    Tcl_DStringFree(&cpPtr->data);
+}
+
+void
+CheckpointPutBytes(Checkpoint *cpPtr, const void *bytes, int length)
+{
+    Tcl_DStringAppend(&cpPtr->data, (const char *)bytes, length);
+}
+
+void
+CheckpointPutInt(Checkpoint *cpPtr, Tcl_WideInt value)
+{
+    CheckpointPutBytes(cpPtr, &value, sizeof(value));
+}
+
+void
+CheckpointPutDouble(Checkpoint *cpPtr, double value)
+{
+    CheckpointPutBytes(cpPtr, &value, sizeof(value));
+}
+
+/*
+ * The 64 bit FNV-1a hash of a text.  Checkpoints hold the hash of the
+ * ciphertext rather than the ciphertext itself.
+ */
+
+static Tcl_WideUInt
+CheckpointHash(const char *text)
+{
+    Tcl_WideUInt hash = ((Tcl_WideUInt)0xcbf29ce4 << 32) | 0x84222325;
+
+    for (; text && *text; text++) {
+	hash ^= (unsigned char)*text;
+	hash *= ((Tcl_WideUInt)0x100 << 32) | 0x1b3;
+    }
+
+    return hash;
+}
+
+void
+CheckpointPutText(Checkpoint *cpPtr, const char *text)
+{
+    CheckpointPutInt(cpPtr, (Tcl_WideInt)CheckpointHash(text));
+}
+
+/*
+ * Write a checkpoint to fileName, replacing any checkpoint that was
+ * already there.
+ */
+
+int
+CheckpointWrite(Tcl_Interp *interp, Checkpoint *cpPtr, const char *fileName)
+{
+    Tcl_DString tempName;
+    Tcl_Channel chan;
+    Tcl_Obj *tempObj, *fileObj;
+    int length = Tcl_DStringLength(&cpPtr->data);
+    int result = TCL_OK;
+
+    Tcl_DStringInit(&tempName);
+    Tcl_DStringAppend(&tempName, fileName, -1);
+    Tcl_DStringAppend(&tempName, ".tmp", -1);
+
+    chan = Tcl_OpenFileChannel(interp, Tcl_DStringValue(&tempName), "w",
+	    0644);
+    if (chan == NULL) {
+	Tcl_DStringFree(&tempName);
+	return TCL_ERROR;
+    }
+    Tcl_SetChannelOption(interp, chan, "-translation", "binary");
+    if (Tcl_Write(chan, Tcl_DStringValue(&cpPtr->data), length) != length) {
+	Tcl_AppendResult(interp, "Could not write the checkpoint ", fileName,
+		":  ", Tcl_PosixError(interp), (char *)NULL);
+	result = TCL_ERROR;
+    }
+    if (Tcl_Close(interp, chan) != TCL_OK) {
+	result = TCL_ERROR;
+    }
+
+    tempObj = Tcl_NewStringObj(Tcl_DStringValue(&tempName), -1);
+    fileObj = Tcl_NewStringObj(fileName, -1);
+    Tcl_IncrRefCount(tempObj);
+    Tcl_IncrRefCount(fileObj);
+    if (result == TCL_OK && Tcl_FSRenameFile(tempObj, fileObj) != TCL_OK) {
+	Tcl_AppendResult(interp, "Could not write the checkpoint ", fileName,
+		":  ", Tcl_PosixError(interp), (char *)NULL);
+	result = TCL_ERROR;
+    }
+    Tcl_DecrRefCount(tempObj);
+    Tcl_DecrRefCount(fileObj);
+    Tcl_DStringFree(&tempName);
+
+    return result;
+}
+
+/*
+ * Read the checkpoint in fileName and check that it was written by the
+ * given kind of search.  On success the checkpoint is ready for its
+ * values to be read and must be freed by the caller.
+ */
+
+int
+CheckpointRead(Tcl_Interp *interp, Checkpoint *cpPtr, const char *fileName, int kind)
+{
+    Tcl_Channel chan;
+    Tcl_WideInt version, order, fileKind;
+    char buffer[4096];
+    char magic[4];
+    int count;
+
+    Tcl_DStringInit(&cpPtr->data);
+    cpPtr->offset = 0;
+    cpPtr->fileName = fileName;
+
+    chan = Tcl_OpenFileChannel(interp, fileName, "r", 0);
+    if (chan == NULL) {
+	return TCL_ERROR;
+    }
+    Tcl_SetChannelOption(interp, chan, "-translation", "binary");
+    while ((count = Tcl_Read(chan, buffer, sizeof(buffer))) > 0) {
+	Tcl_DStringAppend(&cpPtr->data, buffer, count);
+    }
+    Tcl_Close(interp, chan);
+
+    if (Tcl_DStringLength(&cpPtr->data) < 4
+	    || memcmp(Tcl_DStringValue(&cpPtr->data), CHECKPOINT_MAGIC, 4)) {
+	Tcl_AppendResult(interp, fileName, " is not a checkpoint file",
+		(char *)NULL);
+	Tcl_DStringFree(&cpPtr->data);
+	return TCL_ERROR;
+    }
+    CheckpointGetBytes(interp, cpPtr, magic, 4);
+
+    if (CheckpointGetInt(interp, cpPtr, &version) != TCL_OK
+	    || CheckpointGetInt(interp, cpPtr, &order) != TCL_OK
+	    || CheckpointGetInt(interp, cpPtr, &fileKind) != TCL_OK) {
+	Tcl_DStringFree(&cpPtr->data);
+	return TCL_ERROR;
+    }
+    if (version != CHECKPOINT_VERSION || order != CHECKPOINT_ORDER) {
+	Tcl_AppendResult(interp, "The checkpoint ", fileName,
+		" was written by a different version or kind of machine",
+		(char *)NULL);
+	Tcl_DStringFree(&cpPtr->data);
+	return TCL_ERROR;
+    }
+    if (fileKind != kind) {
+	Tcl_AppendResult(interp, "The checkpoint ", fileName,
+		" is for a different kind of search", (char *)NULL);
+	Tcl_DStringFree(&cpPtr->data);
+	return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+
+int
+CheckpointGetBytes(Tcl_Interp *interp, Checkpoint *cpPtr, void *bytes, int length)
+{
+    if (cpPtr->offset + length > Tcl_DStringLength(&cpPtr->data)) {
+	Tcl_AppendResult(interp, "The checkpoint ", cpPtr->fileName,
+		" is truncated", (char *)NULL);
+	return TCL_ERROR;
+    }
+    memcpy(bytes, Tcl_DStringValue(&cpPtr->data) + cpPtr->offset, length);
+    cpPtr->offset += length;
+
+    return TCL_OK;
+}
+
+int
+CheckpointGetInt(Tcl_Interp *interp, Checkpoint *cpPtr, Tcl_WideInt *valuePtr)
+{
+    return CheckpointGetBytes(interp, cpPtr, valuePtr, sizeof(*valuePtr));
+}
+
+int
+CheckpointGetDouble(Tcl_Interp *interp, Checkpoint *cpPtr, double *valuePtr)
+{
+    return CheckpointGetBytes(interp, cpPtr, valuePtr, sizeof(*valuePtr));
+}
+
+/*
+ * Check that the checkpoint was written for the same text.
+ */
+
+int
+CheckpointCheckText(Tcl_Interp *interp, Checkpoint *cpPtr, const char *text)
+{
+    Tcl_WideInt hash;
+
+    if (CheckpointGetInt(interp, cpPtr, &hash) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if ((Tcl_WideUInt)hash != CheckpointHash(text)) {
+	Tcl_AppendResult(interp, "The checkpoint ", cpPtr->fileName,
+		" is for a different ciphertext", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+
+/*
+ * Report that the checkpoint's settings don't match the search that is
+ * trying to resume it.
+ */
+
+int
+CheckpointMismatch(Tcl_Interp *interp, Checkpoint *cpPtr)
+{
+    Tcl_AppendResult(interp, "The checkpoint ", cpPtr->fileName,
+	    " doesn't match the settings of this search", (char *)NULL);
+    return TCL_ERROR;
+}
+
+/*
+ * Return 1 if at least interval seconds have passed since *lastPtr, and
+ * if so set *lastPtr to now.
+ */
+
+int
+CheckpointDue(Tcl_Time *lastPtr, double interval)
+{
+    Tcl_Time now;
+
+    Tcl_GetTime(&now);
+    if ((now.sec - lastPtr->sec) + (now.usec - lastPtr->usec) / 1e6
+	    < interval) {
+	return 0;
+    }
+    *lastPtr = now;
+
+    return 1;
+}
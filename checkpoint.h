@@ -0,0 +1,78 @@
+/*
+ * checkpoint.h --
+ *
+ *	This is the header file for the checkpoint files written by the
+ *	long running searches.
+ *
+ * Copyright (c) 2008 Michael Thomas <wart@kobold.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef _CHECKPOINT_H_INCLUDED
+#define _CHECKPOINT_H_INCLUDED
+
+#include <tcl.h>
+
+/*
+ * The kinds of search that write checkpoints.  A checkpoint can only be
+ * resumed by the same kind of search.
+ */
+
+#define CHECKPOINT_PERM		1
+#define CHECKPOINT_ANNEAL	2
+#define CHECKPOINT_GENETIC	3
+
+/*
+ * The default number of seconds between checkpoints.
+ */
+
+#define CHECKPOINT_INTERVAL	60
+
+/*
+ * A checkpoint being built or read.  Values are stored in the byte order
+ * of the machine that wrote them, so a checkpoint can only be resumed on
+ * the same kind of machine.
+ */
+
+typedef struct Checkpoint {
+    Tcl_DString data;
+    int offset;			/* The next byte to read. */
+    const char *fileName;
+} Checkpoint;
+
+void	CheckpointInit _ANSI_ARGS_((Checkpoint *, int));
+void	CheckpointFree _ANSI_ARGS_((Checkpoint *));
+void	CheckpointPutInt _ANSI_ARGS_((Checkpoint *, Tcl_WideInt));
+void	CheckpointPutDouble _ANSI_ARGS_((Checkpoint *, double));
+void	CheckpointPutBytes _ANSI_ARGS_((Checkpoint *, const void *, int));
+void	CheckpointPutText _ANSI_ARGS_((Checkpoint *, const char *));
+int	CheckpointWrite _ANSI_ARGS_((Tcl_Interp *, Checkpoint *,
+		const char *));
+int	CheckpointRead _ANSI_ARGS_((Tcl_Interp *, Checkpoint *, const char *,
+		int));
+int	CheckpointGetInt _ANSI_ARGS_((Tcl_Interp *, Checkpoint *,
+		Tcl_WideInt *));
+int	CheckpointGetDouble _ANSI_ARGS_((Tcl_Interp *, Checkpoint *,
+		double *));
+int	CheckpointGetBytes _ANSI_ARGS_((Tcl_Interp *, Checkpoint *, void *,
+		int));
+int	CheckpointCheckText _ANSI_ARGS_((Tcl_Interp *, Checkpoint *,
+		const char *));
+int	CheckpointMismatch _ANSI_ARGS_((Tcl_Interp *, Checkpoint *));
+int	CheckpointDue _ANSI_ARGS_((Tcl_Time *, double));
+
+#endif /* _CHECKPOINT_H_INCLUDED */
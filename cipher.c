@@ -24,6 +24,8 @@
 #include <tcl.h>
 #include <string.h>
 #include "cipher.h"
+#include "checkpoint.h"
+#include "perm.h"
 
 #include <cipherDebug.h>
 
@@ -172,6 +174,295 @@ CipherSetStepCmd(CipherItem *itemPtr, const char *cmd)
     return TCL_OK;
 }
 
+/*
+ * Handle the -checkpoint, -checkpointinterval, and -resume options for
+ * the ciphers whose solves can be checkpointed.  An empty file name
+ * turns the option off.
+ */
+
+int
+CipherSetCheckpoint(Tcl_Interp *interp, CipherItem *itemPtr, const char *option, const char *value)
+{
+    char **filePtr;
+
+    if (strcmp(option, "-checkpointinterval") == 0) {
+	long interval;
+
+	if (sscanf(value, "%ld", &interval) != 1 || interval < 0) {
+	    Tcl_SetResult(interp, "Invalid checkpoint interval.", TCL_STATIC);
+	    return TCL_ERROR;
+	}
+	itemPtr->checkpointInterval = interval;
+	return TCL_OK;
+    } else if (strcmp(option, "-checkpoint") == 0) {
+	filePtr = &itemPtr->checkpointFile;
+    } else if (strcmp(option, "-resume") == 0) {
+	filePtr = &itemPtr->resumeFile;
+    } else {
+	Tcl_AppendResult(interp, "Unknown option ", option, (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    if (*filePtr) {
+	ckfree(*filePtr);
+    }
+    *filePtr = (char *)NULL;
+
+    if (strlen(value) > 0) {
+	*filePtr = (char *)ckalloc(sizeof(char) * strlen(value)+1);
+	strcpy(*filePtr, value);
+    }
+
+    return TCL_OK;
+}
+
+int
+CipherGetCheckpoint(Tcl_Interp *interp, CipherItem *itemPtr, const char *option)
+{
+    const char *file;
+
+    if (strcmp(option, "-checkpointinterval") == 0) {
+	Tcl_SetObjResult(interp, Tcl_NewLongObj(itemPtr->checkpointInterval));
+	return TCL_OK;
+    } else if (strcmp(option, "-checkpoint") == 0) {
+	file = itemPtr->checkpointFile;
+    } else if (strcmp(option, "-resume") == 0) {
+	file = itemPtr->resumeFile;
+    } else {
+	Tcl_AppendResult(interp, "Unknown option ", option, (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    Tcl_SetResult(interp, (char *)(file ? file : ""), TCL_VOLATILE);
+    return TCL_OK;
+}
+
+/*
+ * Handle the -range option for the ciphers whose solves search every
+ * permutation of the key.  The value is a list of the rank of the first
+ * permutation to try and the number to try, or an empty string to try
+ * them all.
+ */
+
+int
+CipherSetRange(Tcl_Interp *interp, CipherItem *itemPtr, const char *value)
+{
+    Tcl_WideUInt start, count;
+    const char **listv;
+    int listc;
+
+    if (Tcl_SplitList(interp, value, &listc, &listv) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    if (listc == 0) {
+	ckfree((char *)listv);
+	itemPtr->rangeStart = 0;
+	itemPtr->rangeCount = 0;
+	return TCL_OK;
+    }
+
+    if (listc != 2) {
+	ckfree((char *)listv);
+	Tcl_SetResult(interp, "The range must be a start and a count",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    if (PermGetRank(interp, listv[0], &start) != TCL_OK
+	    || PermGetRank(interp, listv[1], &count) != TCL_OK) {
+	ckfree((char *)listv);
+	return TCL_ERROR;
+    }
+    ckfree((char *)listv);
+
+    /*
+     * Only an empty value means every permutation.
+     */
+
+    if (count == 0) {
+	Tcl_SetResult(interp, "The range must hold at least one permutation",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    itemPtr->rangeStart = start;
+    itemPtr->rangeCount = count;
+    return TCL_OK;
+}
+
+int
+CipherGetRange(Tcl_Interp *interp, CipherItem *itemPtr)
+{
+    Tcl_Obj *resultObj = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+
+    if (itemPtr->rangeCount) {
+	Tcl_ListObjAppendElement(interp, resultObj,
+		Tcl_NewWideIntObj((Tcl_WideInt)itemPtr->rangeStart));
+	Tcl_ListObjAppendElement(interp, resultObj,
+		Tcl_NewWideIntObj((Tcl_WideInt)itemPtr->rangeCount));
+    }
+
+    Tcl_SetObjResult(interp, resultObj);
+    return TCL_OK;
+}
+
+/*
+ * Check that a solve that is limited to a range of permutations doesn't
+ * also ask for something that needs the whole search.
+ */
+
+int
+CipherCheckRange(Tcl_Interp *interp, CipherItem *itemPtr)
+{
+    if (itemPtr->rangeCount == 0) {
+	return TCL_OK;
+    }
+
+    if (itemPtr->threads > 1) {
+	Tcl_SetResult(interp, "Ranges can't be used with -threads",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (itemPtr->checkpointFile || itemPtr->resumeFile) {
+	Tcl_SetResult(interp, "Checkpoints can't be used with -range",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+
+/*
+ * The cipher settings that are copied to a clone of a cipher, if the
+ * cipher has them.
+ */
+
+static const char *cipherCloneOptions[] = {"-period", "-language",
+    "-primer", "-strict", "-blocks", "-encoding", NULL};
+
+/*
+ * Cipher names come from a global counter, so clones are created one
+ * at a time.
+ */
+
+static Tcl_Mutex cipherCloneMutex;
+
+/*
+ * Collect the arguments for "cipher create" that make a copy of a
+ * cipher, from its ciphertext and settings.  The copy can then be made
+ * in another interpreter, even one in another thread, with
+ * CipherCloneCreate().  cmdName is only used in error messages.
+ */
+
+int
+CipherCloneInit(Tcl_Interp *interp, CipherItem *itemPtr, const char *cmdName, CipherClone *clonePtr)
+{
+    const char *argv[4];
+    Tcl_Obj **elemObjs;
+    int elemCount;
+    int i;
+
+    clonePtr->argc = 0;
+    clonePtr->argv = (const char **)NULL;
+    clonePtr->argsObj = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+    Tcl_IncrRefCount(clonePtr->argsObj);
+    Tcl_ListObjAppendElement(interp, clonePtr->argsObj,
+	    Tcl_NewStringObj("cipher", -1));
+    Tcl_ListObjAppendElement(interp, clonePtr->argsObj,
+	    Tcl_NewStringObj("create", -1));
+    Tcl_ListObjAppendElement(interp, clonePtr->argsObj,
+	    Tcl_NewStringObj(itemPtr->typePtr->type, -1));
+
+    argv[0] = cmdName;
+    argv[1] = "cget";
+    argv[3] = (char *)NULL;
+
+    argv[2] = "-ct";
+    Tcl_ResetResult(interp);
+    if ((itemPtr->typePtr->cmdProc)((ClientData)itemPtr, interp, 3,
+		argv) != TCL_OK) {
+	Tcl_DecrRefCount(clonePtr->argsObj);
+	clonePtr->argsObj = (Tcl_Obj *)NULL;
+	return TCL_ERROR;
+    }
+    Tcl_ListObjAppendElement(interp, clonePtr->argsObj,
+	    Tcl_NewStringObj("-ct", -1));
+    Tcl_ListObjAppendElement(interp, clonePtr->argsObj,
+	    Tcl_DuplicateObj(Tcl_GetObjResult(interp)));
+
+    for (i=0; cipherCloneOptions[i]; i++) {
+	Tcl_Obj *valueObj;
+
+	argv[2] = cipherCloneOptions[i];
+	Tcl_ResetResult(interp);
+	if ((itemPtr->typePtr->cmdProc)((ClientData)itemPtr, interp, 3,
+		    argv) != TCL_OK) {
+	    continue;
+	}
+	valueObj = Tcl_GetObjResult(interp);
+	if (Tcl_GetCharLength(valueObj) == 0
+		|| strcmp(Tcl_GetString(valueObj), "0") == 0) {
+	    continue;
+	}
+	Tcl_ListObjAppendElement(interp, clonePtr->argsObj,
+		Tcl_NewStringObj(cipherCloneOptions[i], -1));
+	Tcl_ListObjAppendElement(interp, clonePtr->argsObj,
+		Tcl_DuplicateObj(valueObj));
+    }
+    Tcl_ResetResult(interp);
+
+    /*
+     * The strings are only read by the clones, and the list isn't
+     * touched again until it's freed.
+     */
+
+    Tcl_ListObjGetElements(interp, clonePtr->argsObj, &elemCount,
+	    &elemObjs);
+    clonePtr->argc = elemCount;
+    clonePtr->argv = (const char **)ckalloc(sizeof(char *)
+	    * (elemCount + 1));
+    for (i=0; i < elemCount; i++) {
+	clonePtr->argv[i] = Tcl_GetString(elemObjs[i]);
+    }
+    clonePtr->argv[elemCount] = (char *)NULL;
+
+    return TCL_OK;
+}
+
+/*
+ * Make a copy of a cipher in interp.  The name of the new cipher's
+ * command is left in cmdName.  Returns NULL, with the error in interp's
+ * result, if the copy can't be made.
+ */
+
+CipherItem *
+CipherCloneCreate(Tcl_Interp *interp, CipherClone *clonePtr, char *cmdName, int size)
+{
+    CipherItem *itemPtr = (CipherItem *)NULL;
+
+    Tcl_MutexLock(&cipherCloneMutex);
+    if (CipherCmd((ClientData)NULL, interp, clonePtr->argc,
+		clonePtr->argv) == TCL_OK) {
+	strncpy(cmdName, Tcl_GetStringResult(interp), size - 1);
+	cmdName[size - 1] = '\0';
+	itemPtr = GetCipherItem(interp, cmdName);
+    }
+    Tcl_MutexUnlock(&cipherCloneMutex);
+
+    return itemPtr;
+}
+
+void
+CipherCloneFree(CipherClone *clonePtr)
+{
+    if (clonePtr->argsObj) {
+	Tcl_DecrRefCount(clonePtr->argsObj);
+	ckfree((char *)clonePtr->argv);
+	clonePtr->argsObj = (Tcl_Obj *)NULL;
+    }
+}
+
 void
 DeleteCipher(ClientData clientData)
 {
@@ -189,6 +480,14 @@ DeleteCipher(ClientData clientData)
 	ckfree((char *)(itemPtr->bestFitCommand));
     }
 
+    if (itemPtr->checkpointFile) {
+	ckfree(itemPtr->checkpointFile);
+    }
+
+    if (itemPtr->resumeFile) {
+	ckfree(itemPtr->resumeFile);
+    }
+
     ckfree((char *) clientData);
 }
 
@@ -240,6 +539,12 @@ CipherCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **argv
 	itemPtr->bestFitCommand = (char *)NULL;
 	itemPtr->stepInterval = 0;
 	itemPtr->curIteration = 0;
+	itemPtr->checkpointFile = (char *)NULL;
+	itemPtr->resumeFile = (char *)NULL;
+	itemPtr->checkpointInterval = CHECKPOINT_INTERVAL;
+	itemPtr->threads = 1;
+	itemPtr->rangeStart = 0;
+	itemPtr->rangeCount = 0;
 	if ((*typePtr->createProc)(interp, itemPtr, argc-3, argv+3) != TCL_OK) {
 	    /*
 	     * If the create procedure failed then we should assume that it
@@ -271,3 +576,33 @@ CipherCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **argv
 
     return TCL_ERROR;
 }
+
+/*
+ * Return the cipher object for a command that was created by "cipher
+ * create".  If there is no such command, or it isn't a cipher, an error
+ * is left in the interpreter and NULL is returned.
+ */
+
+CipherItem *
+GetCipherItem(Tcl_Interp *interp, const char *cmdName)
+{
+    Tcl_CmdInfo cmdInfo;
+    CipherType *typePtr;
+
+    if (Tcl_GetCommandInfo(interp, cmdName, &cmdInfo) != 1) {
+	Tcl_AppendResult(interp, "Command '", cmdName, "' not found.",
+		(char *)NULL);
+	return (CipherItem *)NULL;
+    }
+
+    for(typePtr = typeList; typePtr != NULL; typePtr = typePtr->nextPtr) {
+	if (cmdInfo.proc == typePtr->cmdProc
+		&& ((CipherItem *)cmdInfo.clientData)->typePtr == typePtr) {
+	    return (CipherItem *)cmdInfo.clientData;
+	}
+    }
+
+    Tcl_AppendResult(interp, "Command '", cmdName, "' is not a cipher.",
+	    (char *)NULL);
+    return (CipherItem *)NULL;
+}
@@ -145,9 +145,44 @@ typedef struct {
     long stepInterval;
     unsigned long curIteration;
 
+    /*
+     * These let long solves be stopped and picked up again later.
+     */
+
+    char *checkpointFile;
+    char *resumeFile;
+    long checkpointInterval;
+
+    /*
+     * The number of threads that a solve can spread its work over.
+     */
+
+    int threads;
+
+    /*
+     * Limit a solve to rangeCount permutations of the key, starting with
+     * the one of rank rangeStart (see PermRank()), so that one solve can
+     * be split over several processes.  A rangeCount of 0 searches every
+     * permutation.
+     */
+
+    Tcl_WideUInt rangeStart;
+    Tcl_WideUInt rangeCount;
+
     struct CipherType *typePtr;
 } CipherItem;
 
+/*
+ * The arguments to "cipher create" that make a copy of a cipher, for
+ * solves that run in several interpreters.
+ */
+
+typedef struct CipherClone {
+    Tcl_Obj *argsObj;
+    int argc;
+    const char **argv;
+} CipherClone;
+
 int	CountValidChars _ANSI_ARGS_((CipherItem *, const char *, int *));
 char *	ExtractValidChars _ANSI_ARGS_((CipherItem *, const char *));
 char *	ExtractValidCharsJtoI _ANSI_ARGS_((CipherItem *, const char *));
@@ -159,7 +194,21 @@ int	cipherSelectLanguage _ANSI_ARGS_((const char *));
 char *	cipherGetLanguage _ANSI_ARGS_((int));
 int	CipherSetStepCmd _ANSI_ARGS_((CipherItem *, const char *));
 int	CipherSetBestFitCmd _ANSI_ARGS_((CipherItem *, const char *));
+int	CipherSetCheckpoint _ANSI_ARGS_((Tcl_Interp *, CipherItem *,
+	const char *, const char *));
+int	CipherGetCheckpoint _ANSI_ARGS_((Tcl_Interp *, CipherItem *,
+	const char *));
+int	CipherSetRange _ANSI_ARGS_((Tcl_Interp *, CipherItem *,
+	const char *));
+int	CipherGetRange _ANSI_ARGS_((Tcl_Interp *, CipherItem *));
+int	CipherCheckRange _ANSI_ARGS_((Tcl_Interp *, CipherItem *));
+int	CipherCloneInit _ANSI_ARGS_((Tcl_Interp *, CipherItem *,
+	const char *, CipherClone *));
+CipherItem *CipherCloneCreate _ANSI_ARGS_((Tcl_Interp *, CipherClone *,
+	char *, int));
+void	CipherCloneFree _ANSI_ARGS_((CipherClone *));
 void	DeleteCipher _ANSI_ARGS_((ClientData));
+CipherItem *GetCipherItem _ANSI_ARGS_((Tcl_Interp *, const char *));
 int 	CipherNullEncoder _ANSI_ARGS_((Tcl_Interp *, CipherItem *,
 	char *, char *));
 
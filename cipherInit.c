@@ -29,6 +29,7 @@
 #include <wordtree.h>
 #include <score.h>
 #include <hillclimb.h>
+#include <cipherRandom.h>
 #include <keygen.h>
 #include <crithmCmd.h>
 #include <wordtreeCmd.h>
@@ -71,6 +72,7 @@ Cipher_Init(Tcl_Interp *interp)
     Tcl_CreateCommand(interp, "permute", PermCmd, (ClientData)NULL, NULL);
     Tcl_CreateCommand(interp, "key", KeygenCmd, (ClientData)NULL, NULL);
     Tcl_CreateCommand(interp, "morse", MorseCmd, (ClientData)NULL, NULL);
+    Tcl_CreateObjCommand(interp, "random", RandomObjCmd, (ClientData)NULL, NULL);
     Tcl_CreateCommand(interp, "crithm", CrithmCmd, (ClientData)cInfo,
 	    CrithmDelete);
     Tcl_CreateCommand(interp, "wordtree", WordtreeCmd, (ClientData) tInfo,
@@ -80,11 +82,19 @@ Cipher_Init(Tcl_Interp *interp)
     if (InitScoreTypes(interp) != TCL_OK) {
 	return TCL_ERROR;
     }
-    Tcl_CreateCommand(interp, "score", ScoreCmd, (ClientData)NULL, DeleteScoreCommand);
+    Tcl_CreateObjCommand(interp, "score", ScoreObjCmd, (ClientData)NULL, DeleteScoreCommand);
     Tcl_CreateObjCommand(interp, "Hillclimb::generateSwapNeighborKeys", HillclimbGenerateSwapNeighborKeysObjCmd, (ClientData)NULL, NULL);
     Tcl_CreateObjCommand(interp, "Hillclimb::swapKeysquareKey", HillclimbKeysquareSwapNeighborKeysObjCmd, (ClientData)NULL, NULL);
     Tcl_CreateObjCommand(interp, "Hillclimb::swapAristocratKey", HillclimbAristocratSwapNeighborKeysObjCmd, (ClientData)NULL, NULL);
     Tcl_CreateObjCommand(interp, "Hillclimb::randomizeList", HillclimbRandomizeListObjCmd, (ClientData)NULL, NULL);
+    Tcl_CreateObjCommand(interp, "Hillclimb::climb", HillclimbClimbObjCmd, (ClientData)NULL, NULL);
+    Tcl_CreateObjCommand(interp, "Hillclimb::anneal", HillclimbAnnealObjCmd, (ClientData)NULL, NULL);
+    Tcl_CreateObjCommand(interp, "Hillclimb::genetic", HillclimbGeneticObjCmd, (ClientData)NULL, NULL);
+    Tcl_CreateObjCommand(interp, "Hillclimb::tempering", HillclimbTemperingObjCmd, (ClientData)NULL, NULL);
+    Tcl_CreateObjCommand(interp, "Hillclimb::tabu", HillclimbTabuObjCmd, (ClientData)NULL, NULL);
+    Tcl_CreateObjCommand(interp, "Hillclimb::keywordclimb", HillclimbKeywordClimbObjCmd, (ClientData)NULL, NULL);
+    Tcl_CreateObjCommand(interp, "Hillclimb::neighbors", HillclimbNeighborsObjCmd, (ClientData)NULL, NULL);
+    Tcl_CreateObjCommand(interp, "Hillclimb::keywords", HillclimbKeywordsObjCmd, (ClientData)NULL, NULL);
 
     Tcl_PkgProvide(interp, PACKAGE_NAME, PACKAGE_VERSION);
 
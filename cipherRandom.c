@@ -0,0 +1,177 @@
+/*
+ * cipherRandom.c --
+ *
+ *	This file implements the random number generator used by the
+ *	searches and by the ciphers that encode with random choices.  It is
+ *	xoshiro256** by Blackman and Vigna, seeded through splitmix64 so
+ *	that nearby seeds give unrelated sequences.  All of its state is
+ *	passed in explicitly.
+ *
+ * Copyright (c) 2008 Michael Thomas <wart@kobold.org>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <tcl.h>
+#include <string.h>
+#include "cipherRandom.h"
+
+#define RandomRotate(x, k)	(((x) << (k)) | ((x) >> (64 - (k))))
+
+typedef struct RandomThreadData {
+    int seeded;
+    long seed;
+    RandomState state;
+} RandomThreadData;
+
+static Tcl_ThreadDataKey randomDataKey;
+
+void
+RandomSeed(RandomState *statePtr, Tcl_WideUInt seed)
+{
+    Tcl_WideUInt z;
+    int i;
+
+    for (i=0; i < 4; i++) {
+	seed += 0x9e3779b97f4a7c15ULL;
+	z = seed;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	statePtr->s[i] = z ^ (z >> 31);
+    }
+}
+
+Tcl_WideUInt
+RandomNext(RandomState *statePtr)
+{
+    Tcl_WideUInt *s = statePtr->s;
+    Tcl_WideUInt result = RandomRotate(s[1] * 5, 7) * 9;
+    Tcl_WideUInt t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = RandomRotate(s[3], 45);
+
+    return result;
+}
+
+/*
+ * Return a random number in [0, 1).
+ */
+
+double
+RandomDouble(RandomState *statePtr)
+{
+    return (RandomNext(statePtr) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * Return a random integer in [0, n).
+ */
+
+int
+RandomIndex(RandomState *statePtr, int n)
+{
+    return (int)(((RandomNext(statePtr) >> 32) * (Tcl_WideUInt) n) >> 32);
+}
+
+/*
+ * Shuffle an array of objects in place with a Fisher-Yates shuffle.
+ */
+
+void
+RandomShuffle(RandomState *statePtr, Tcl_Obj **objv, int objc)
+{
+    Tcl_Obj *temp;
+    int i, j;
+
+    for (i=objc-1; i > 0; i--) {
+	j = RandomIndex(statePtr, i+1);
+	temp = objv[i];
+	objv[i] = objv[j];
+	objv[j] = temp;
+    }
+}
+
+static RandomThreadData *
+RandomGetThreadData(void)
+{
+    RandomThreadData *dataPtr = (RandomThreadData *)
+	    Tcl_GetThreadData(&randomDataKey, sizeof(RandomThreadData));
+
+    if (! dataPtr->seeded) {
+	Tcl_Time now;
+
+	Tcl_GetTime(&now);
+	dataPtr->seed = (long)((now.sec * 1000003L) ^ now.usec
+		^ (long)(size_t)dataPtr) & 0x7fffffffL;
+	RandomSeed(&dataPtr->state, (Tcl_WideUInt) dataPtr->seed);
+	dataPtr->seeded = 1;
+    }
+
+    return dataPtr;
+}
+
+RandomState *
+RandomThreadState(void)
+{
+    return &RandomGetThreadData()->state;
+}
+
+/*
+ * Return a new seed for a search that wasn't given one.
+ */
+
+long
+RandomNewSeed(void)
+{
+    return (long)(RandomNext(RandomThreadState()) & 0x7fffffffL);
+}
+
+/*
+ * random seed ?value?
+ *
+ *	Reseed this thread's generator, or return the seed it was last
+ *	seeded with.
+ */
+
+int
+RandomObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
+{
+    RandomThreadData *dataPtr;
+    long seed;
+
+    if (objc < 2 || objc > 3 || strcmp(Tcl_GetString(objv[1]), "seed") != 0) {
+	Tcl_AppendResult(interp, "Usage:  ", Tcl_GetString(objv[0]),
+		" seed ?value?", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    dataPtr = RandomGetThreadData();
+    if (objc == 3) {
+	if (Tcl_GetLongFromObj(interp, objv[2], &seed) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	dataPtr->seed = seed;
+	RandomSeed(&dataPtr->state, (Tcl_WideUInt) seed);
+    }
+    Tcl_SetObjResult(interp, Tcl_NewLongObj(dataPtr->seed));
+
+    return TCL_OK;
+}
@@ -0,0 +1,56 @@
+/*
+ * cipherRandom.h --
+ *
+ *	This is the header file for the random number generator used by
+ *	the searches and by the ciphers that encode with random choices.
+ *
+ * Copyright (c) 2008 Michael Thomas <wart@kobold.org>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef _CIPHERRANDOM_H_INCLUDED
+#define _CIPHERRANDOM_H_INCLUDED
+
+#include <tcl.h>
+
+/*
+ * The state of one xoshiro256** generator.  Every search keeps its own
+ * state, so searches in different threads never share one and a seeded
+ * search always makes the same choices.
+ */
+
+typedef struct RandomState {
+    Tcl_WideUInt s[4];
+} RandomState;
+
+void	RandomSeed _ANSI_ARGS_((RandomState *, Tcl_WideUInt));
+Tcl_WideUInt RandomNext _ANSI_ARGS_((RandomState *));
+double	RandomDouble _ANSI_ARGS_((RandomState *));
+int	RandomIndex _ANSI_ARGS_((RandomState *, int));
+void	RandomShuffle _ANSI_ARGS_((RandomState *, Tcl_Obj **, int));
+
+/*
+ * Each thread also has a generator for the commands that don't take a
+ * seed of their own.  It is seeded from the clock unless "random seed"
+ * has been used.
+ */
+
+RandomState *RandomThreadState _ANSI_ARGS_((void));
+long	RandomNewSeed _ANSI_ARGS_((void));
+int	RandomObjCmd _ANSI_ARGS_((ClientData, Tcl_Interp *, int, Tcl_Obj *CONST[]));
+
+#endif /* _CIPHERRANDOM_H_INCLUDED */
@@ -26,6 +26,7 @@
 #include <cipher.h>
 #include <score.h>
 #include <perm.h>
+#include <digram.h>
 
 #include <cipherDebug.h>
 
@@ -57,6 +58,9 @@ static int ColumnarShiftColumn	_ANSI_ARGS_((Tcl_Interp *, CipherItem *, int,
 static int EncodeColumnar	_ANSI_ARGS_((Tcl_Interp *, CipherItem *,
 				const char *, const char *));
 static char *ColumnarTransform	_ANSI_ARGS_((CipherItem *, const char *, int));
+static int ColumnarBoundValue	_ANSI_ARGS_((Tcl_Interp *, ClientData, int *,
+				int, int, double *));
+static int ColumnarSolveAdjacency _ANSI_ARGS_((Tcl_Interp *, CipherItem *));
 
 typedef struct ColumnarItem {
     CipherItem header;
@@ -68,6 +72,14 @@ typedef struct ColumnarItem {
     char *pt;
     char *maxKey;	/* For solving */
     double maxValue;
+    double scoreBound;	/* See DefaultScoreBound() */
+
+    int prune;		/* Solve with a branch and bound search. */
+    int windowCount;	/* Scoring windows in the plaintext, or 0 if
+			 * the score can't be bounded. */
+    PermBoundStats pruneStats;
+    int adjacency;	/* Solve from a column adjacency matrix, and
+			 * score this many of the best orders in full. */
 } ColumnarItem;
 
 CipherType ColumnarType = {
@@ -103,6 +115,10 @@ CreateColumnar(Tcl_Interp *interp, CipherItem *itemPtr, int argc, const char **a
     colPtr->maxKey = (char *)NULL;
     colPtr->maxValue = 0.0;
     colPtr->pt = (char *)NULL;
+    colPtr->prune = 0;
+    colPtr->windowCount = 0;
+    memset(&colPtr->pruneStats, 0, sizeof(PermBoundStats));
+    colPtr->adjacency = 0;
 
     sprintf(temp_ptr, "cipher%d", cipherid);
     Tcl_DStringInit(&dsPtr);
@@ -368,7 +384,16 @@ ColumnarCheckSolutionValue(Tcl_Interp *interp, ClientData clientData, int *key,
 
     pt = GetColumnar(interp, (CipherItem *)colPtr);
 
-    if (DefaultScoreValue(interp, pt, &value) != TCL_OK) {
+    /*
+     * Only a score that beats the best so far matters.
+     */
+
+    if (DefaultScoreBoundedValue(interp, pt, colPtr->maxValue,
+		colPtr->scoreBound, &value) != TCL_OK) {
+	for(i=0; i < keylen; i++) {
+	    colPtr->key[i] = tKey[i];
+	}
+	ckfree((char *)tKey);
 	return TCL_ERROR;
     }
 
@@ -392,10 +417,13 @@ ColumnarCheckSolutionValue(Tcl_Interp *interp, ClientData clientData, int *key,
 	Tcl_DStringAppendElement(&dsPtr, pt);
 
 	if (Tcl_Eval(interp, Tcl_DStringValue(&dsPtr)) != TCL_OK) {
-	    ckfree(pt);
 	    Tcl_ResetResult(interp);
 	    Tcl_AppendResult(interp, "Bad command usage:  ", Tcl_DStringValue(&dsPtr), (char *)NULL);
 	    Tcl_DStringFree(&dsPtr);
+	    for(i=0; i < keylen; i++) {
+		colPtr->key[i] = tKey[i];
+	    }
+	    ckfree((char *)tKey);
 	    return TCL_ERROR;
 	}
 	Tcl_DStringFree(&dsPtr);
@@ -428,11 +456,14 @@ ColumnarCheckSolutionValue(Tcl_Interp *interp, ClientData clientData, int *key,
 
 	if (itemPtr->bestFitCommand) {
 	    if (Tcl_Eval(interp, Tcl_DStringValue(&dsPtr)) != TCL_OK) {
-		ckfree(pt);
 		Tcl_ResetResult(interp);
 		Tcl_AppendResult(interp, "Bad command usage:  ", Tcl_DStringValue(&dsPtr), (char *)NULL);
 
 		Tcl_DStringFree(&dsPtr);
+		for(i=0; i < keylen; i++) {
+		    colPtr->key[i] = tKey[i];
+		}
+		ckfree((char *)tKey);
 		return TCL_ERROR;
 	    }
 	}
@@ -448,11 +479,49 @@ ColumnarCheckSolutionValue(Tcl_Interp *interp, ClientData clientData, int *key,
     return TCL_OK;
 }
 
+/*
+ * Get a columnar cipher ready to search for the key of fromData.  The
+ * search permutes the columns of the current key.
+ */
+
+static int
+ColumnarStartSolve(Tcl_Interp *interp, ClientData fromData, ClientData toData, PermBest *bestPtr)
+{
+    ColumnarItem *fromPtr = (ColumnarItem *)fromData;
+    ColumnarItem *colPtr = (ColumnarItem *)toData;
+    CipherItem *itemPtr = (CipherItem *)toData;
+    double value;
+
+    if (colPtr != fromPtr) {
+	memcpy(colPtr->key, fromPtr->key, sizeof(char)*itemPtr->period);
+    }
+
+    itemPtr->curIteration = 0;
+    colPtr->maxValue = 0;
+    if (!DefaultScoreBound(&colPtr->scoreBound)
+	    || !DefaultScoreWindowSum(itemPtr->ciphertext, itemPtr->length,
+		&value, &colPtr->windowCount)) {
+	colPtr->windowCount = 0;
+    }
+    if (colPtr->maxKey) {
+	ckfree((char *)colPtr->maxKey);
+    }
+
+    colPtr->maxKey = (char *)ckalloc(sizeof(char)*itemPtr->period);
+
+    PermBestInit(bestPtr, &colPtr->maxValue, &itemPtr->curIteration);
+    PermBestAdd(bestPtr, colPtr->maxKey, sizeof(char)*itemPtr->period);
+
+    return TCL_OK;
+}
+
 static int
 SolveColumnar(Tcl_Interp *interp, CipherItem *itemPtr, char *maxkey)
 {
     ColumnarItem *colPtr = (ColumnarItem *)itemPtr;
     int i, result;
+    PermCheckpoint checkpoint;
+    PermBest best;
 
     if (itemPtr->ciphertext == (char *)NULL) {
 	Tcl_SetResult(interp,
@@ -468,15 +537,66 @@ SolveColumnar(Tcl_Interp *interp, CipherItem *itemPtr, char *maxkey)
 	return TCL_ERROR;
     }
 
-    itemPtr->curIteration = 0;
-    colPtr->maxValue = 0;
-    if (colPtr->maxKey) {
-	ckfree((char *)colPtr->maxKey);
+    if (colPtr->adjacency && itemPtr->threads > 1) {
+	Tcl_SetResult(interp, "The adjacency solve can't be used with -threads",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (colPtr->adjacency
+	    && (itemPtr->checkpointFile || itemPtr->resumeFile)) {
+	Tcl_SetResult(interp, "Checkpoints can't be used with -adjacency",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (colPtr->prune && itemPtr->threads > 1) {
+	Tcl_SetResult(interp, "Pruning can't be used with -threads",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (colPtr->prune && (itemPtr->checkpointFile || itemPtr->resumeFile)) {
+	Tcl_SetResult(interp, "Checkpoints can't be used with -prune",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (itemPtr->rangeCount && (colPtr->prune || colPtr->adjacency)) {
+	Tcl_SetResult(interp, "Ranges can't be used with -prune or -adjacency",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (CipherCheckRange(interp, itemPtr) != TCL_OK) {
+	return TCL_ERROR;
     }
 
-    colPtr->maxKey = (char *)ckalloc(sizeof(char)*itemPtr->period);
-
-    result = _internalDoPermCmd((ClientData)itemPtr, interp, itemPtr->period, ColumnarCheckSolutionValue);
+    ColumnarStartSolve(interp, (ClientData)itemPtr, (ClientData)itemPtr,
+	    &best);
+    memset(&colPtr->pruneStats, 0, sizeof(PermBoundStats));
+
+    if (colPtr->adjacency) {
+	result = ColumnarSolveAdjacency(interp, itemPtr);
+    } else if (colPtr->prune) {
+	result = _internalDoPermBoundCmd((ClientData)itemPtr, interp,
+		itemPtr->period, ColumnarCheckSolutionValue,
+		ColumnarBoundValue, &colPtr->maxValue, &colPtr->pruneStats);
+    } else if (itemPtr->rangeCount) {
+	result = _internalDoPermRangeCmd((ClientData)itemPtr, interp,
+		itemPtr->period, ColumnarCheckSolutionValue,
+		itemPtr->rangeStart, itemPtr->rangeCount);
+    } else if (itemPtr->threads > 1) {
+	result = _internalDoPermThreadCmd((ClientData)itemPtr, interp,
+		itemPtr->period, ColumnarCheckSolutionValue,
+		itemPtr->threads, ColumnarStartSolve, &best);
+    } else {
+	PermCheckpointInit(&checkpoint, itemPtr->checkpointFile,
+		itemPtr->resumeFile, itemPtr->checkpointInterval,
+		itemPtr->ciphertext, &itemPtr->curIteration);
+	PermCheckpointAdd(&checkpoint, colPtr->maxKey,
+		sizeof(char)*itemPtr->period);
+	PermCheckpointAdd(&checkpoint, &colPtr->maxValue,
+		sizeof(colPtr->maxValue));
+
+	result = _internalDoPermCheckpointCmd((ClientData)itemPtr, interp,
+		itemPtr->period, ColumnarCheckSolutionValue, &checkpoint);
+    }
 
     /*
      * Now apply the best key
@@ -487,9 +607,160 @@ SolveColumnar(Tcl_Interp *interp, CipherItem *itemPtr, char *maxkey)
 	    colPtr->key[i] = colPtr->maxKey[i];
 	    maxkey[i] = colPtr->key[i] + 'a';
 	}
+	maxkey[i] = '\0';
+
+	Tcl_SetResult(interp, maxkey, TCL_VOLATILE);
+    }
+
+    return result;
+}
+
+/*
+ * Bound the score of every key that places the columns in perm at the
+ * first length positions of the plaintext.  Only the windows whose
+ * letters all come from those columns are scored, and every other window
+ * is assumed to score as well as any window can.  The columns can't be
+ * located in the ciphertext until the columns that are left all have the
+ * same length.
+ */
+
+static int
+ColumnarBoundValue(Tcl_Interp *interp, ClientData clientData, int *perm, int length, int n, double *boundPtr)
+{
+    ColumnarItem *colPtr = (ColumnarItem *)clientData;
+    CipherItem *itemPtr = (CipherItem *)clientData;
+    int period = itemPtr->period;
+    int tailLength = colPtr->colLength[length];
+    int i, j, row, start, below, known;
+    int count, windows = 0;
+    double value, total = 0.0;
+
+    if (colPtr->windowCount <= 0
+	    || colPtr->colLength[period-1] != tailLength) {
+	return TCL_CONTINUE;
     }
 
-    Tcl_SetResult(interp, maxkey, TCL_VOLATILE);
+    for (i=0; i < length; i++) {
+	int rank = colPtr->key[perm[i]];
+
+	start = 0;
+	below = 0;
+	for (j=0; j < length; j++) {
+	    if (colPtr->key[perm[j]] < rank) {
+		start += colPtr->colLength[j];
+		below++;
+	    }
+	}
+	start += (rank - below) * tailLength;
+
+	for (row=0; row < colPtr->colLength[i]; row++) {
+	    colPtr->pt[row*period + i] = itemPtr->ciphertext[start + row];
+	}
+    }
+
+    for (row=0; row < colPtr->maxColLen; row++) {
+	known = length;
+	if (row*period + known > itemPtr->length) {
+	    known = itemPtr->length - row*period;
+	}
+
+	DefaultScoreWindowSum(colPtr->pt + row*period, known, &value, &count);
+	total += value;
+	windows += count;
+    }
+
+    *boundPtr = total + (colPtr->windowCount - windows) * colPtr->scoreBound;
+
+    return TCL_OK;
+}
+
+/*
+ * Solve a complete columnar by scoring the digrams of every pair of
+ * columns side by side once.  The orders of the columns whose adjacent
+ * pairs score best are found from those scores, and only those orders
+ * have their plaintext scored in full.
+ */
+
+static int
+ColumnarSolveAdjacency(Tcl_Interp *interp, CipherItem *itemPtr)
+{
+    ColumnarItem *colPtr = (ColumnarItem *)itemPtr;
+    int period = itemPtr->period;
+    int rows = itemPtr->length / period;
+    int size = colPtr->adjacency;
+    Tcl_WideUInt orderCount = 1;
+    char *columns;
+    double *matrix, *values;
+    int *orders, *rankIndex, *perm;
+    int a, b, i, found;
+    int result = TCL_OK;
+
+    if (itemPtr->length % period != 0) {
+	Tcl_SetResult(interp,
+		"The adjacency solve needs columns of the same length",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    for (i=2; i <= period && orderCount < (Tcl_WideUInt)size; i++) {
+	orderCount *= i;
+    }
+    if (orderCount < (Tcl_WideUInt)size) {
+	size = (int)orderCount;
+    }
+
+    if (PermAdjacencyAlloc(interp, size, period, &orders, &values)
+	    != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    /*
+     * The columns are in the ciphertext in the order of their key
+     * letters.
+     */
+
+    columns = (char *)ckalloc(sizeof(char) * period * (rows + 1));
+    matrix = (double *)ckalloc(sizeof(double) * period * period);
+    for (a=0; a < period; a++) {
+	memcpy(columns + a*(rows+1), itemPtr->ciphertext + a*rows, rows);
+	columns[a*(rows+1) + rows] = '\0';
+    }
+    for (a=0; a < period; a++) {
+	for (b=0; b < period; b++) {
+	    matrix[a*period + b] = (a == b) ? 0.0
+		: get_digram_values(columns + a*(rows+1),
+			columns + b*(rows+1), itemPtr->language);
+	}
+    }
+
+    found = PermAdjacencyOrders(matrix, period, size, orders, values,
+	    &colPtr->pruneStats);
+
+    /*
+     * The test function permutes the current key, so turn each order of
+     * key letters into a permutation of the current key.
+     */
+
+    rankIndex = (int *)ckalloc(sizeof(int) * period);
+    perm = (int *)ckalloc(sizeof(int) * period);
+    for (i=0; i < period; i++) {
+	rankIndex[(int)colPtr->key[i]] = i;
+    }
+
+    for (a=0; a < found && result == TCL_OK; a++) {
+	for (i=0; i < period; i++) {
+	    perm[i] = rankIndex[orders[a*period + i]];
+	}
+	result = ColumnarCheckSolutionValue(interp, (ClientData)itemPtr,
+		perm, period);
+    }
+
+    ckfree(columns);
+    ckfree((char *)matrix);
+    ckfree((char *)orders);
+    ckfree((char *)values);
+    ckfree((char *)rankIndex);
+    ckfree((char *)perm);
 
     return result;
 }
@@ -778,6 +1049,26 @@ ColumnarCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **ar
 		Tcl_SetResult(interp, "", TCL_STATIC);
 	    }
 	    return TCL_OK;
+	} else if (strncmp(argv[1], "-checkpoint", 11) == 0 ||
+		   strncmp(argv[1], "-resume", 7) == 0) {
+	    return CipherGetCheckpoint(interp, itemPtr, argv[1]);
+	} else if (strcmp(argv[1], "-threads") == 0) {
+	    sprintf(temp_str, "%d", itemPtr->threads);
+	    Tcl_SetResult(interp, temp_str, TCL_VOLATILE);
+	    return TCL_OK;
+	} else if (strcmp(argv[1], "-range") == 0) {
+	    return CipherGetRange(interp, itemPtr);
+	} else if (strcmp(argv[1], "-prune") == 0) {
+	    sprintf(temp_str, "%d", colPtr->prune);
+	    Tcl_SetResult(interp, temp_str, TCL_VOLATILE);
+	    return TCL_OK;
+	} else if (strcmp(argv[1], "-prunestats") == 0) {
+	    PermBoundStatsResult(interp, &colPtr->pruneStats);
+	    return TCL_OK;
+	} else if (strcmp(argv[1], "-adjacency") == 0) {
+	    sprintf(temp_str, "%d", colPtr->adjacency);
+	    Tcl_SetResult(interp, temp_str, TCL_VOLATILE);
+	    return TCL_OK;
 	} else if (strncmp(argv[1], "-language", 8) == 0) {
 	    Tcl_SetResult(interp, cipherGetLanguage(itemPtr->language),
 		    TCL_VOLATILE);
@@ -839,6 +1130,33 @@ ColumnarCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **ar
 		if (CipherSetStepCmd(itemPtr, argv[1]) != TCL_OK) {
 		    return TCL_ERROR;
 		}
+	    } else if (strncmp(*argv, "-checkpoint", 11) == 0 ||
+		strncmp(*argv, "-resume", 7) == 0) {
+		if (CipherSetCheckpoint(interp, itemPtr, argv[0], argv[1])
+			!= TCL_OK) {
+		    return TCL_ERROR;
+		}
+	    } else if (strcmp(*argv, "-threads") == 0) {
+		if (sscanf(argv[1], "%d", &i) != 1 || i < 1) {
+		    Tcl_SetResult(interp, "Threads must be at least 1",
+			    TCL_STATIC);
+		    return TCL_ERROR;
+		}
+		itemPtr->threads = i;
+	    } else if (strcmp(*argv, "-range") == 0) {
+		if (CipherSetRange(interp, itemPtr, argv[1]) != TCL_OK) {
+		    return TCL_ERROR;
+		}
+	    } else if (strcmp(*argv, "-prune") == 0) {
+		if (Tcl_GetBoolean(interp, argv[1], &colPtr->prune)
+			!= TCL_OK) {
+		    return TCL_ERROR;
+		}
+	    } else if (strcmp(*argv, "-adjacency") == 0) {
+		if (PermGetAdjacency(interp, argv[1], &colPtr->adjacency)
+			!= TCL_OK) {
+		    return TCL_ERROR;
+		}
 	    } else if (strncmp(*argv, "-language", 8) == 0) {
 		itemPtr->language = cipherSelectLanguage(argv[1]);
 		Tcl_SetResult(interp, cipherGetLanguage(itemPtr->language),
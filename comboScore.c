@@ -0,0 +1,419 @@
+/*
+ * comboScore.c --
+ *
+ *	This file implements the combo scoring method, which scores a
+ *	plaintext with the weighted sum of several other scoring
+ *	objects.  Components that can score individual windows are
+ *	evaluated together in a single pass over the plaintext that
+ *	keeps one rolling base-26 index for all n-gram orders up to
+ *	SCORE_TABLE_MAX_NGRAM.  Any other component is scored on its own.
+ *
+ * Copyright (c) 2018 Michael Thomas <wart@kobold.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <tcl.h>
+#include <score.h>
+#include <string.h>
+
+static int CreateCombo _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, int, const char **));
+static int AddComboComponent _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *, double));
+void DeleteComboScore _ANSI_ARGS_((ClientData));
+static double ComboValue _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static double ComboElementValue _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static int DumpComboScore _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static double ComboDelta _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *, const char *, double, const int *, int));
+static double ComboWindowValue _ANSI_ARGS_((ScoreItem *, const char *, int));
+static void ComboTraceProc _ANSI_ARGS_((ClientData, Tcl_Interp *, const char *, const char *, int));
+
+/*
+ * A component holds a reference to another scoring object.  The
+ * component's command is traced so that the component can be dropped
+ * when the scoring object is deleted.
+ */
+
+typedef struct ComboComponent {
+    struct ComboItem *comboPtr;
+    ScoreItem *itemPtr;
+    Tcl_Command token;
+    double weight;
+} ComboComponent;
+
+typedef struct ComboItem {
+    ScoreItem header;
+
+    Tcl_Interp *interp;
+    ComboComponent **components;
+    int count;
+    int space;
+} ComboItem;
+
+/*
+ * Components that can be scored in the shared pass over the plaintext.
+ */
+
+#define ComboFused(itemPtr) \
+	((itemPtr)->typePtr->gramProc != NULL && (itemPtr)->elemSize > 0)
+
+ScoreType ComboType = {
+    "combo",
+    sizeof(ComboItem),
+    CreateCombo,
+    AddComboComponent,
+    ComboValue,
+    ComboElementValue,
+    NullScoreNormalizer,
+    DeleteComboScore,
+    DumpComboScore,
+    ScoreMethodCmd,
+    (ScoreSaveProc *)NULL,
+    (ScoreLoadProc *)NULL,
+    ComboDelta,
+    (ScoreGramProc *)NULL,
+    (ScoreMaxProc *)NULL,
+    (ScoreBlockProc *)NULL,
+    (ScoreType *)NULL
+};
+
+static int
+CreateCombo(Tcl_Interp *interp, ScoreItem *itemPtr, int argc, const char **argv) {
+    ComboItem *coPtr = (ComboItem *)itemPtr;
+    char temp_ptr[TCL_DOUBLE_SPACE];
+    Tcl_DString dsPtr;
+    int i;
+
+    coPtr->header.elemSize = 0;
+    coPtr->interp = interp;
+    coPtr->components = (ComboComponent **)NULL;
+    coPtr->count = 0;
+    coPtr->space = 0;
+    sprintf(temp_ptr, "score%d", scoreid);
+    Tcl_DStringInit(&dsPtr);
+    Tcl_DStringAppendElement(&dsPtr, temp_ptr);
+    Tcl_DStringAppendElement(&dsPtr, "configure");
+    for (i=0; i < argc; i++) {
+	Tcl_DStringAppendElement(&dsPtr, argv[i]);
+    }
+
+    Tcl_CreateCommand(interp, temp_ptr, ScoreMethodCmd, itemPtr,
+	    itemPtr->typePtr->deleteProc);
+    if (argc) {
+	if (Tcl_Eval(interp, Tcl_DStringValue(&dsPtr)) != TCL_OK) {
+	    Tcl_DeleteCommand(interp, temp_ptr);
+	    Tcl_DStringFree(&dsPtr);
+	    return TCL_ERROR;
+	}
+    }
+
+    Tcl_SetResult(interp, temp_ptr, TCL_VOLATILE);
+    Tcl_DStringFree(&dsPtr);
+
+    return TCL_OK;
+}
+
+void
+DeleteComboScore(ClientData clientData) {
+    ComboItem *coPtr = (ComboItem *)clientData;
+    Tcl_Obj *nameObj = Tcl_NewObj();
+    int i;
+
+    Tcl_IncrRefCount(nameObj);
+    for (i=0; i < coPtr->count; i++) {
+	ComboComponent *compPtr = coPtr->components[i];
+
+	Tcl_GetCommandFullName(coPtr->interp, compPtr->token, nameObj);
+	Tcl_UntraceCommand(coPtr->interp, Tcl_GetString(nameObj),
+		TCL_TRACE_DELETE, ComboTraceProc, (ClientData)compPtr);
+	Tcl_SetObjLength(nameObj, 0);
+	ckfree((char *)compPtr);
+    }
+    Tcl_DecrRefCount(nameObj);
+
+    if (coPtr->components) {
+	ckfree((char *)(coPtr->components));
+    }
+    coPtr->components = (ComboComponent **)NULL;
+    coPtr->count = 0;
+
+    DeleteScore(clientData);
+}
+
+/*
+ * Drop a component when the command for its scoring object is deleted.
+ */
+
+static void
+ComboTraceProc(ClientData clientData, Tcl_Interp *interp, const char *oldName, const char *newName, int flags) {
+    ComboComponent *compPtr = (ComboComponent *)clientData;
+    ComboItem *coPtr = compPtr->comboPtr;
+    int i;
+
+    if (! (flags & TCL_TRACE_DELETE)) {
+	return;
+    }
+
+    for (i=0; i < coPtr->count; i++) {
+	if (coPtr->components[i] == compPtr) {
+	    memmove(coPtr->components+i, coPtr->components+i+1,
+		    sizeof(ComboComponent *) * (coPtr->count - i - 1));
+	    coPtr->count--;
+	    break;
+	}
+    }
+
+    ckfree((char *)compPtr);
+}
+
+/*
+ * The element for a combo is the name of a scoring object created with
+ * "score create", and the value is its weight.  Adding the same object
+ * again adds to its weight.
+ */
+
+static int
+AddComboComponent(Tcl_Interp *interp, ScoreItem *itemPtr, const char *element, double value)  {
+    ComboItem *coPtr = (ComboItem *)itemPtr;
+    ComboComponent *compPtr;
+    ScoreItem *componentPtr;
+    Tcl_Obj *nameObj;
+    int i;
+
+    componentPtr = GetInternalScore(interp, element);
+    if (componentPtr == NULL) {
+	return TCL_ERROR;
+    }
+
+    if (componentPtr->typePtr == &ComboType) {
+	Tcl_SetResult(interp,
+		"Can't add a combo scoring object to another combo.",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    for (i=0; i < coPtr->count; i++) {
+	if (coPtr->components[i]->itemPtr == componentPtr) {
+	    coPtr->components[i]->weight += value;
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(element, -1));
+	    return TCL_OK;
+	}
+    }
+
+    if (coPtr->count == coPtr->space) {
+	coPtr->space = (coPtr->space ? coPtr->space * 2 : 4);
+	coPtr->components = (ComboComponent **)ckrealloc(
+		(char *)coPtr->components,
+		sizeof(ComboComponent *) * coPtr->space);
+    }
+
+    nameObj = Tcl_NewStringObj(element, -1);
+    Tcl_IncrRefCount(nameObj);
+    compPtr = (ComboComponent *)ckalloc(sizeof(ComboComponent));
+    compPtr->comboPtr = coPtr;
+    compPtr->itemPtr = componentPtr;
+    compPtr->token = Tcl_GetCommandFromObj(interp, nameObj);
+    compPtr->weight = value;
+    Tcl_DecrRefCount(nameObj);
+
+    if (Tcl_TraceCommand(interp, element, TCL_TRACE_DELETE, ComboTraceProc,
+		(ClientData)compPtr) != TCL_OK) {
+	ckfree((char *)compPtr);
+	return TCL_ERROR;
+    }
+    coPtr->components[coPtr->count++] = compPtr;
+
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(element, -1));
+    return TCL_OK;
+}
+
+static double
+ComboValue(Tcl_Interp *interp, ScoreItem *itemPtr, const char *string) {
+    ComboItem *coPtr = (ComboItem *)itemPtr;
+    ComboComponent **components = coPtr->components;
+    const int count = coPtr->count;
+    int roll[SCORE_TABLE_MAX_NGRAM+1];
+    double totalVal = 0.0;
+    int fused = 0;
+    int run = 0;
+    int i, j, n;
+
+    for (j=0; j < count; j++) {
+	ScoreItem *componentPtr = components[j]->itemPtr;
+
+	if (ComboFused(componentPtr)) {
+	    fused++;
+	} else {
+	    totalVal += components[j]->weight
+		* (componentPtr->typePtr->valueProc)(interp, componentPtr,
+			string);
+	}
+    }
+
+    if (fused == 0) {
+	return totalVal;
+    }
+
+    /*
+     * roll[n] is the base-26 index of the last n letters.  It's only
+     * valid when the last run letters were all a-z and n <= run.
+     */
+
+    memset(roll, 0, sizeof(roll));
+    for (i=0; string[i]; i++) {
+	if (string[i] >= 'a' && string[i] <= 'z') {
+	    for (n=SCORE_TABLE_MAX_NGRAM; n > 0; n--) {
+		roll[n] = roll[n-1]*26 + (string[i] - 'a');
+	    }
+	    if (run < SCORE_TABLE_MAX_NGRAM) {
+		run++;
+	    }
+	} else {
+	    run = 0;
+	}
+
+	for (j=0; j < count; j++) {
+	    ScoreItem *componentPtr = components[j]->itemPtr;
+
+	    n = componentPtr->elemSize;
+	    if (n > i+1 || ! ComboFused(componentPtr)) {
+		continue;
+	    }
+
+	    totalVal += components[j]->weight
+		* (componentPtr->typePtr->gramProc)(componentPtr, string,
+			i-n+1, (n <= run ? roll[n] : -1));
+	}
+    }
+
+    return totalVal;
+}
+
+/*
+ * The weighted sum of the element values of the components whose
+ * elements are the same length as this one.
+ */
+
+static double
+ComboElementValue(Tcl_Interp *interp, ScoreItem *itemPtr, const char *string) {
+    ComboItem *coPtr = (ComboItem *)itemPtr;
+    int length = strlen(string);
+    double totalVal = 0.0;
+    int j;
+
+    for (j=0; j < coPtr->count; j++) {
+	ScoreItem *componentPtr = coPtr->components[j]->itemPtr;
+
+	if (componentPtr->elemSize == 0 || componentPtr->elemSize == length) {
+	    totalVal += coPtr->components[j]->weight
+		* (componentPtr->typePtr->elemValueProc)(interp, componentPtr,
+			string);
+	}
+    }
+
+    return totalVal;
+}
+
+static int
+DumpComboScore(Tcl_Interp *interp, ScoreItem *itemPtr, const char *script) {
+    ComboItem *coPtr = (ComboItem *)itemPtr;
+    Tcl_DString dsPtr;
+    Tcl_Obj *nameObj = Tcl_NewObj();
+    Tcl_Obj *valueObj = Tcl_NewDoubleObj(0.0);
+    int result = TCL_OK;
+    int length;
+    int i;
+
+    Tcl_IncrRefCount(nameObj);
+    Tcl_IncrRefCount(valueObj);
+    Tcl_DStringInit(&dsPtr);
+    Tcl_DStringAppend(&dsPtr, script, strlen(script));
+    length = Tcl_DStringLength(&dsPtr);
+
+    for (i=0; i < coPtr->count && result == TCL_OK; i++) {
+	Tcl_SetObjLength(nameObj, 0);
+	Tcl_GetCommandFullName(interp, coPtr->components[i]->token, nameObj);
+	Tcl_SetDoubleObj(valueObj, coPtr->components[i]->weight);
+
+	Tcl_DStringSetLength(&dsPtr, length);
+	Tcl_DStringStartSublist(&dsPtr);
+	Tcl_DStringAppendElement(&dsPtr, Tcl_GetString(nameObj));
+	Tcl_DStringAppendElement(&dsPtr, Tcl_GetString(valueObj));
+	Tcl_DStringEndSublist(&dsPtr);
+
+	result = Tcl_EvalEx(interp, Tcl_DStringValue(&dsPtr),
+		Tcl_DStringLength(&dsPtr), 0);
+    }
+
+    Tcl_DStringFree(&dsPtr);
+    Tcl_DecrRefCount(nameObj);
+    Tcl_DecrRefCount(valueObj);
+
+    return result;
+}
+
+/*
+ * Score the window of a component that starts at an offset in the
+ * string.  The index is computed the same way as the rolling index in
+ * ComboValue().
+ */
+
+static double
+ComboWindowValue(ScoreItem *itemPtr, const char *string, int start) {
+    int length = itemPtr->elemSize;
+    int index = 0;
+    int i;
+
+    for (i=0; i < length && index >= 0; i++) {
+	if (i >= SCORE_TABLE_MAX_NGRAM
+		|| string[start+i] < 'a' || string[start+i] > 'z') {
+	    index = -1;
+	} else {
+	    index = index*26 + (string[start+i] - 'a');
+	}
+    }
+
+    return (itemPtr->typePtr->gramProc)(itemPtr, string, start, index);
+}
+
+/*
+ * If every component can score windows then only the windows around
+ * the changed positions are rescored.  Otherwise the new string is
+ * scored in full.
+ */
+
+static double
+ComboDelta(Tcl_Interp *interp, ScoreItem *itemPtr, const char *oldString, const char *newString, double oldValue, const int *positions, int count) {
+    ComboItem *coPtr = (ComboItem *)itemPtr;
+    double value = oldValue;
+    int j;
+
+    for (j=0; j < coPtr->count; j++) {
+	if (! ComboFused(coPtr->components[j]->itemPtr)) {
+	    return ComboValue(interp, itemPtr, newString);
+	}
+    }
+
+    for (j=0; j < coPtr->count; j++) {
+	ScoreItem *componentPtr = coPtr->components[j]->itemPtr;
+
+	value += coPtr->components[j]->weight
+	    * ScoreWindowDelta(componentPtr, ComboWindowValue,
+		    componentPtr->elemSize, oldString, newString, 0.0,
+		    positions, count);
+    }
+
+    return value;
+}
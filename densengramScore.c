@@ -0,0 +1,506 @@
+/*
+ * densengramScore.c --
+ *
+ *	This file implements n-gram scoring methods backed by a flat
+ *	table.  Each n-gram over a-z is stored at the index formed by
+ *	treating its letters as a base-26 number, so scoring a string
+ *	costs one table lookup per offset rather than a walk through a
+ *	word tree.  The table holds 26^n entries, which limits the
+ *	element size to SCORE_TABLE_MAX_NGRAM.  Tables loaded from the
+ *	binary format are used in place and can't be modified.
+ *
+ * Copyright (c) 2018 Michael Thomas <wart@kobold.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <tcl.h>
+#include <score.h>
+#include <math.h>
+#include <string.h>
+
+static int CreateDenseNgram _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, int, const char **));
+static int AddDenseNgram _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *, double));
+void DeleteDenseNgramScore _ANSI_ARGS_((ClientData));
+static int NormalizeDenseNgramLog _ANSI_ARGS_((Tcl_Interp *, ScoreItem *));
+static double DenseNgramValue _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static double DenseNgramElementValue _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static int DumpDenseNgramScore _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static int SaveDenseNgramScore _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static int LoadDenseNgramScore _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static double DenseNgramDelta _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *, const char *, double, const int *, int));
+static double DenseNgramWindowValue _ANSI_ARGS_((ScoreItem *, const char *, int));
+static double DenseNgramGramValue _ANSI_ARGS_((ScoreItem *, const char *, int, int));
+static double DenseNgramMaxValue _ANSI_ARGS_((ScoreItem *));
+static double DenseNgramBlockValue _ANSI_ARGS_((ScoreItem *, const char *, int, int));
+static int DenseNgramIndex _ANSI_ARGS_((const char *, int));
+
+typedef struct DenseNgramItem {
+    ScoreItem header;
+
+    /*
+     * 26^elemSize entries, allocated when the first element is added.
+     * The entry for an n-gram is at the base-26 value of its letters,
+     * most significant letter first.
+     */
+    unsigned short int *value;
+    int tableSize;
+    /*
+     * 26^(elemSize-1).  Used to drop the leading letter from the
+     * rolling index while scoring.
+     */
+    int leadPlace;
+    /*
+     * The binary table that value points into, if the table was loaded
+     * with "score load".
+     */
+    ScoreTableMap map;
+} DenseNgramItem;
+
+static int DenseNgramMapped _ANSI_ARGS_((Tcl_Interp *, DenseNgramItem *));
+
+ScoreType DenseNgramLogType = {
+    "densengramlog",
+    sizeof(DenseNgramItem),
+    CreateDenseNgram,
+    AddDenseNgram,
+    DenseNgramValue,
+    DenseNgramElementValue,
+    NormalizeDenseNgramLog,
+    DeleteDenseNgramScore,
+    DumpDenseNgramScore,
+    ScoreMethodCmd,
+    SaveDenseNgramScore,
+    LoadDenseNgramScore,
+    DenseNgramDelta,
+    DenseNgramGramValue,
+    DenseNgramMaxValue,
+    DenseNgramBlockValue,
+    (ScoreType *)NULL
+};
+
+ScoreType DenseNgramCountType = {
+    "densengramcount",
+    sizeof(DenseNgramItem),
+    CreateDenseNgram,
+    AddDenseNgram,
+    DenseNgramValue,
+    DenseNgramElementValue,
+    NullScoreNormalizer,
+    DeleteDenseNgramScore,
+    DumpDenseNgramScore,
+    ScoreMethodCmd,
+    SaveDenseNgramScore,
+    LoadDenseNgramScore,
+    DenseNgramDelta,
+    DenseNgramGramValue,
+    DenseNgramMaxValue,
+    DenseNgramBlockValue,
+    (ScoreType *)NULL
+};
+
+static int
+CreateDenseNgram(Tcl_Interp *interp, ScoreItem *itemPtr, int argc, const char **argv) {
+    DenseNgramItem *dnPtr = (DenseNgramItem *)itemPtr;
+    char temp_ptr[TCL_DOUBLE_SPACE];
+    Tcl_DString dsPtr;
+    int i;
+
+    dnPtr->header.elemSize = -1;
+    dnPtr->value = (unsigned short int *)NULL;
+    dnPtr->tableSize = 0;
+    dnPtr->leadPlace = 0;
+    dnPtr->map.base = NULL;
+    dnPtr->map.length = 0;
+    dnPtr->map.mapped = 0;
+    sprintf(temp_ptr, "score%d", scoreid);
+    Tcl_DStringInit(&dsPtr);
+    Tcl_DStringAppendElement(&dsPtr, temp_ptr);
+    Tcl_DStringAppendElement(&dsPtr, "configure");
+    for (i=0; i < argc; i++) {
+	Tcl_DStringAppendElement(&dsPtr, argv[i]);
+    }
+
+    Tcl_CreateCommand(interp, temp_ptr, ScoreMethodCmd, itemPtr,
+	    itemPtr->typePtr->deleteProc);
+    if (argc) {
+	if (Tcl_Eval(interp, Tcl_DStringValue(&dsPtr)) != TCL_OK) {
+	    Tcl_DeleteCommand(interp, temp_ptr);
+	    Tcl_DStringFree(&dsPtr);
+	    return TCL_ERROR;
+	}
+    }
+
+    Tcl_SetResult(interp, temp_ptr, TCL_VOLATILE);
+    Tcl_DStringFree(&dsPtr);
+
+    return TCL_OK;
+}
+
+void
+DeleteDenseNgramScore(ClientData clientData) {
+    DenseNgramItem *dnPtr = (DenseNgramItem *)clientData;
+
+    if (dnPtr->map.base) {
+	ScoreTableClose(&dnPtr->map);
+    } else if (dnPtr->value) {
+	ckfree((char *)(dnPtr->value));
+    }
+    dnPtr->value = (unsigned short int *)NULL;
+
+    DeleteScore(clientData);
+}
+
+/*
+ * Tables loaded from a binary file are shared with other processes and
+ * can't be changed.  Returns 1 and leaves an error in the interpreter if
+ * this is one of them.
+ */
+
+static int
+DenseNgramMapped(Tcl_Interp *interp, DenseNgramItem *dnPtr) {
+    if (dnPtr->map.base == NULL) {
+	return 0;
+    }
+
+    Tcl_SetResult(interp,
+	    "Can't modify a scoring table that was loaded from a binary file.",
+	    TCL_STATIC);
+    return 1;
+}
+
+/*
+ * Return the table index for the first length characters of element, or
+ * -1 if any of them fall outside of a-z.
+ */
+
+static int
+DenseNgramIndex(const char *element, int length) {
+    int index = 0;
+    int i;
+
+    for (i=0; i < length; i++) {
+	if (element[i] < 'a' || element[i] > 'z') {
+	    return -1;
+	}
+	index = index*26 + (element[i] - 'a');
+    }
+
+    return index;
+}
+
+static int
+AddDenseNgram(Tcl_Interp *interp, ScoreItem *itemPtr, const char *element, double value)  {
+    DenseNgramItem *dnPtr = (DenseNgramItem *)itemPtr;
+    int index;
+    int i;
+
+    if (DenseNgramMapped(interp, dnPtr)) {
+	return TCL_ERROR;
+    }
+
+    if (dnPtr->value == NULL) {
+	if (itemPtr->elemSize < 1 || itemPtr->elemSize > SCORE_TABLE_MAX_NGRAM) {
+	    char temp_str[TCL_INTEGER_SPACE];
+
+	    sprintf(temp_str, "%d", SCORE_TABLE_MAX_NGRAM);
+	    Tcl_AppendResult(interp, "Element size must be between 1 and ",
+		    temp_str, " for a dense n-gram table.", (char *)NULL);
+	    return TCL_ERROR;
+	}
+
+	dnPtr->leadPlace = 1;
+	for (i=1; i < itemPtr->elemSize; i++) {
+	    dnPtr->leadPlace *= 26;
+	}
+	dnPtr->tableSize = dnPtr->leadPlace * 26;
+	dnPtr->value = (unsigned short int *)ckalloc(sizeof(unsigned short int)
+		* dnPtr->tableSize);
+	memset(dnPtr->value, 0, sizeof(unsigned short int) * dnPtr->tableSize);
+    }
+
+    index = DenseNgramIndex(element, itemPtr->elemSize);
+    if (index < 0) {
+	Tcl_AppendResult(interp, "Invalid n-gram ", element, (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    /*
+     * Accumulate the value the same way that the word tree does for the
+     * ngram types so that both produce identical tables.
+     */
+
+    dnPtr->value[index] += (unsigned short int) value;
+
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(element, -1));
+    return TCL_OK;
+}
+
+static double
+DenseNgramValue(Tcl_Interp *interp, ScoreItem *itemPtr, const char *string) {
+    DenseNgramItem *dnPtr = (DenseNgramItem *)itemPtr;
+    const unsigned short int *table = dnPtr->value;
+    const int elemSize = itemPtr->elemSize;
+    const int leadPlace = dnPtr->leadPlace;
+    int totalVal = 0;
+    int index = 0;
+    int run = 0;
+    int i;
+
+    if (table == NULL) {
+	return 0.0;
+    }
+
+    /*
+     * Maintain a rolling base-26 index of the last elemSize letters.
+     * A character outside of a-z can't be part of any n-gram in the
+     * table, so it restarts the window.
+     */
+
+    for (i=0; string[i]; i++) {
+	if (string[i] < 'a' || string[i] > 'z') {
+	    index = 0;
+	    run = 0;
+	    continue;
+	}
+
+	if (run == elemSize) {
+	    index -= (string[i-elemSize] - 'a') * leadPlace;
+	} else {
+	    run++;
+	}
+	index = index*26 + (string[i] - 'a');
+
+	if (run == elemSize) {
+	    totalVal += table[index];
+	}
+    }
+
+    return (double) totalVal;
+}
+
+static double
+DenseNgramElementValue(Tcl_Interp *interp, ScoreItem *itemPtr, const char *string) {
+    DenseNgramItem *dnPtr = (DenseNgramItem *)itemPtr;
+    int index;
+
+    if (dnPtr->value == NULL || strlen(string) != itemPtr->elemSize) {
+	return 0.0;
+    }
+
+    index = DenseNgramIndex(string, itemPtr->elemSize);
+    if (index < 0) {
+	return 0.0;
+    }
+
+    return (double) dnPtr->value[index];
+}
+
+static int
+NormalizeDenseNgramLog(Tcl_Interp *interp, ScoreItem *itemPtr) {
+    DenseNgramItem *dnPtr = (DenseNgramItem *)itemPtr;
+    int i;
+
+    if (DenseNgramMapped(interp, dnPtr)) {
+	return TCL_ERROR;
+    }
+
+    /*
+     * Use the same fixed point scale as the ngramlog type so that the
+     * existing n-gram data files can be loaded into either type.
+     */
+
+    for (i=0; dnPtr->value && i < dnPtr->tableSize; i++) {
+	if (dnPtr->value[i] > 0) {
+	    dnPtr->value[i] = (unsigned short int) (log((double) (dnPtr->value[i])) * 1000.0);
+	}
+    }
+
+    Tcl_ResetResult(interp);
+    return TCL_OK;
+}
+
+static int
+DumpDenseNgramScore(Tcl_Interp *interp, ScoreItem *itemPtr, const char *script) {
+    DenseNgramItem *dnPtr = (DenseNgramItem *)itemPtr;
+    char element[SCORE_TABLE_MAX_NGRAM+1];
+    Tcl_DString command;
+    int result = TCL_OK;
+    int i, j, index;
+
+    Tcl_ResetResult(interp);
+    if (dnPtr->value == NULL) {
+	return TCL_OK;
+    }
+
+    Tcl_DStringInit(&command);
+    Tcl_DStringAppend(&command, script, strlen(script));
+
+    element[itemPtr->elemSize] = '\0';
+    for (i=0; i < dnPtr->tableSize && result == TCL_OK; i++) {
+	if (dnPtr->value[i] > 0) {
+	    int length = Tcl_DStringLength(&command);
+	    Tcl_Obj *valueObj = Tcl_NewDoubleObj((double)dnPtr->value[i]);
+
+	    for (j=itemPtr->elemSize-1, index=i; j >= 0; j--, index /= 26) {
+		element[j] = 'a' + index%26;
+	    }
+
+	    Tcl_IncrRefCount(valueObj);
+	    Tcl_DStringStartSublist(&command);
+	    Tcl_DStringAppendElement(&command, element);
+	    Tcl_DStringAppendElement(&command, Tcl_GetString(valueObj));
+	    Tcl_DStringEndSublist(&command);
+
+	    result = Tcl_EvalEx(interp, Tcl_DStringValue(&command),
+		    Tcl_DStringLength(&command), 0);
+
+	    Tcl_DecrRefCount(valueObj);
+	    Tcl_DStringSetLength(&command, length);
+	}
+    }
+
+    Tcl_DStringFree(&command);
+
+    return result;
+}
+
+static int
+SaveDenseNgramScore(Tcl_Interp *interp, ScoreItem *itemPtr, const char *filename) {
+    DenseNgramItem *dnPtr = (DenseNgramItem *)itemPtr;
+
+    if (dnPtr->value == NULL) {
+	Tcl_SetResult(interp, "Attempt to use uninitialized scoring object.",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    return ScoreTableWrite(interp, filename, itemPtr, SCORE_TABLE_ALPHA,
+	    dnPtr->value, sizeof(unsigned short int), dnPtr->tableSize);
+}
+
+static int
+LoadDenseNgramScore(Tcl_Interp *interp, ScoreItem *itemPtr, const char *filename) {
+    DenseNgramItem *dnPtr = (DenseNgramItem *)itemPtr;
+    ScoreTableMap map;
+    const void *data;
+    int elemSize;
+    int leadPlace = 1;
+    int entries;
+    int i;
+
+    data = ScoreTableOpen(interp, filename, itemPtr, SCORE_TABLE_ALPHA,
+	    sizeof(unsigned short int), &map, &entries);
+    if (data == NULL) {
+	return TCL_ERROR;
+    }
+
+    elemSize = ((ScoreTableHeader *)map.base)->elemSize;
+    for (i=1; i < elemSize; i++) {
+	leadPlace *= 26;
+    }
+    if (elemSize < 1 || elemSize > SCORE_TABLE_MAX_NGRAM
+	    || entries != leadPlace * 26) {
+	ScoreTableClose(&map);
+	Tcl_AppendResult(interp, "\"", filename,
+		"\" does not hold a valid n-gram table", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    if (dnPtr->map.base) {
+	ScoreTableClose(&dnPtr->map);
+    } else if (dnPtr->value) {
+	ckfree((char *)(dnPtr->value));
+    }
+
+    itemPtr->elemSize = elemSize;
+    dnPtr->map = map;
+    dnPtr->value = (unsigned short int *)data;
+    dnPtr->tableSize = entries;
+    dnPtr->leadPlace = leadPlace;
+
+    Tcl_ResetResult(interp);
+    return TCL_OK;
+}
+
+static double
+DenseNgramWindowValue(ScoreItem *itemPtr, const char *string, int start) {
+    DenseNgramItem *dnPtr = (DenseNgramItem *)itemPtr;
+    int index = DenseNgramIndex(string+start, itemPtr->elemSize);
+
+    if (index < 0) {
+	return 0.0;
+    }
+
+    return (double) dnPtr->value[index];
+}
+
+static double
+DenseNgramGramValue(ScoreItem *itemPtr, const char *string, int start, int index) {
+    DenseNgramItem *dnPtr = (DenseNgramItem *)itemPtr;
+
+    if (dnPtr->value == NULL || index < 0) {
+	return 0.0;
+    }
+
+    return (double) dnPtr->value[index];
+}
+
+static double
+DenseNgramMaxValue(ScoreItem *itemPtr) {
+    DenseNgramItem *dnPtr = (DenseNgramItem *)itemPtr;
+    unsigned short int max = 0;
+    int i;
+
+    for (i=0; dnPtr->value && i < dnPtr->tableSize; i++) {
+	if (dnPtr->value[i] > max) {
+	    max = dnPtr->value[i];
+	}
+    }
+
+    return (double) max;
+}
+
+static double
+DenseNgramBlockValue(ScoreItem *itemPtr, const char *string, int start, int count) {
+    DenseNgramItem *dnPtr = (DenseNgramItem *)itemPtr;
+    int totalVal = 0;
+    int i;
+
+    if (dnPtr->value == NULL) {
+	return 0.0;
+    }
+
+    for (i=start; i < start+count; i++) {
+	int index = DenseNgramIndex(string+i, itemPtr->elemSize);
+
+	if (index >= 0) {
+	    totalVal += dnPtr->value[index];
+	}
+    }
+
+    return (double) totalVal;
+}
+
+static double
+DenseNgramDelta(Tcl_Interp *interp, ScoreItem *itemPtr, const char *oldString, const char *newString, double oldValue, const int *positions, int count) {
+    if (((DenseNgramItem *)itemPtr)->value == NULL) {
+	return oldValue;
+    }
+
+    return ScoreWindowDelta(itemPtr, DenseNgramWindowValue, itemPtr->elemSize,
+	    oldString, newString, oldValue, positions, count);
+}
@@ -33,13 +33,52 @@ static int NormalizeDigramLog _ANSI_ARGS_((Tcl_Interp *, ScoreItem *));
 static double DigramValue _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
 static double DigramElementValue _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
 static int DumpDigram _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static int SaveDigram _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static int LoadDigram _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static double DigramDelta _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *, const char *, double, const int *, int));
+static double DigramWindowValue _ANSI_ARGS_((ScoreItem *, const char *, int));
+static double DigramGramValue _ANSI_ARGS_((ScoreItem *, const char *, int, int));
+static double DigramMaxValue _ANSI_ARGS_((ScoreItem *));
+static double DigramBlockValue _ANSI_ARGS_((ScoreItem *, const char *, int, int));
+
+/*
+ * The digram values are kept in a square table with one row and column
+ * for every character that has been seen.  The letters a-z always have
+ * rows 0-25 and row 26 is shared by every other character.  The shared
+ * row and column are always zero.  A character other than a-z gets its
+ * own row the first time a nonzero value is added for it.  Rows are
+ * 1<<shift entries apart so that the index can be computed with a
+ * shift, so a table with only lowercase letters in it takes 8KB instead
+ * of the 512KB needed for every pair of bytes, and stays in the L1
+ * cache.
+ */
+
+#define DIGRAM_OTHER	26
 
 typedef struct DigramItem {
     ScoreItem header;
 
-    double **value;
+    unsigned char index[256];
+    int size;
+    int shift;
+    /*
+     * Fixed point objects have a nonzero scale and keep their values in
+     * fixedValue instead of value.  See scoreFixedScale in score.h.
+     */
+    int scale;
+    double *value;
+    int *fixedValue;
 } DigramItem;
 
+#define DigramOffset(a, b, c) \
+	( ((c)->index[(unsigned char)(a)] << (c)->shift) \
+	    | (c)->index[(unsigned char)(b)] )
+
+static void ResetDigramTable _ANSI_ARGS_((DigramItem *));
+static int DigramIndex _ANSI_ARGS_((DigramItem *, unsigned char));
+static double DigramEntry _ANSI_ARGS_((DigramItem *, int));
+static void SetDigramEntry _ANSI_ARGS_((DigramItem *, int, double));
+
 ScoreType DigramLogType = {
     "digramlog",
     sizeof(DigramItem),
@@ -51,6 +90,12 @@ ScoreType DigramLogType = {
     DeleteDigram,
     DumpDigram,
     ScoreMethodCmd,
+    SaveDigram,
+    LoadDigram,
+    DigramDelta,
+    DigramGramValue,
+    DigramMaxValue,
+    DigramBlockValue,
     (ScoreType *)NULL
 };
 
@@ -65,6 +110,12 @@ ScoreType DigramCountType = {
     DeleteDigram,
     DumpDigram,
     ScoreMethodCmd,
+    SaveDigram,
+    LoadDigram,
+    DigramDelta,
+    DigramGramValue,
+    DigramMaxValue,
+    DigramBlockValue,
     (ScoreType *)NULL
 };
 
@@ -73,16 +124,13 @@ CreateDigram(Tcl_Interp *interp, ScoreItem *itemPtr, int argc, const char **argv
     DigramItem *dlPtr = (DigramItem *)itemPtr;
     char temp_ptr[TCL_DOUBLE_SPACE];
     Tcl_DString dsPtr;
-    int i, j;
+    int i;
 
     dlPtr->header.elemSize = 2;
-    dlPtr->value = (double **)ckalloc(sizeof(double *) * 256);
-    for (i=0; i < 256; i++) {
-	dlPtr->value[i] = (double *)ckalloc(sizeof(double) * 256);
-	for (j=0; j < 256; j++) {
-	    dlPtr->value[i][j] = 0;
-	}
-    }
+    dlPtr->scale = scoreFixedScale;
+    dlPtr->value = (double *)NULL;
+    dlPtr->fixedValue = (int *)NULL;
+    ResetDigramTable(dlPtr);
     sprintf(temp_ptr, "score%d", scoreid);
     Tcl_DStringInit(&dsPtr);
     Tcl_DStringAppendElement(&dsPtr, temp_ptr);
@@ -110,17 +158,15 @@ CreateDigram(Tcl_Interp *interp, ScoreItem *itemPtr, int argc, const char **argv
 static void
 DeleteDigram(ClientData clientData) {
     DigramItem *dlPtr = (DigramItem *)clientData;
-    int i;
 
     if (dlPtr->value != NULL) {
-	for(i=0; i < 256; i++) {
-	    if (dlPtr->value[i] != NULL) {
-		ckfree((char *)dlPtr->value[i]);
-	    }
-	}
 	ckfree((char *)dlPtr->value);
     }
-    dlPtr->value = (double **)NULL;
+    dlPtr->value = (double *)NULL;
+    if (dlPtr->fixedValue != NULL) {
+	ckfree((char *)dlPtr->fixedValue);
+    }
+    dlPtr->fixedValue = (int *)NULL;
 
     DeleteScore(clientData);
 }
@@ -129,7 +175,19 @@ static int
 AddDigram(Tcl_Interp *interp, ScoreItem *itemPtr, const char *element, double value)  {
     DigramItem *dlPtr = (DigramItem *)itemPtr;
 
-    dlPtr->value[(unsigned char)element[0]][(unsigned char)element[1]] += value;
+    if (value != 0.0) {
+	DigramIndex(dlPtr, (unsigned char)element[0]);
+	DigramIndex(dlPtr, (unsigned char)element[1]);
+    }
+    if (dlPtr->scale) {
+	int offset = DigramOffset(element[0], element[1], dlPtr);
+
+	dlPtr->fixedValue[offset] = ScoreFixedEntry(
+		(double)dlPtr->fixedValue[offset]
+		+ ScoreDoubleToFixed(value, dlPtr->scale));
+    } else {
+	dlPtr->value[DigramOffset(element[0], element[1], dlPtr)] += value;
+    }
 
     Tcl_SetObjResult(interp, Tcl_NewStringObj(element, -1));
     return TCL_OK;
@@ -139,29 +197,31 @@ static double
 DigramValue(Tcl_Interp *interp, ScoreItem *itemPtr, const char *string) {
     DigramItem *dlPtr = (DigramItem *)itemPtr;
 
-    return DigramStringValue(string, (double **)dlPtr->value);
+    if (dlPtr->scale) {
+	return (double)ScoreDigramFixedSum(dlPtr->fixedValue, dlPtr->index,
+		dlPtr->shift, string, strlen(string)) / dlPtr->scale;
+    }
+
+    return ScoreDigramSum(dlPtr->value, dlPtr->index, dlPtr->shift, string,
+	    strlen(string));
 }
 
 static double
 DigramElementValue(Tcl_Interp *interp, ScoreItem *itemPtr, const char *string) {
     DigramItem *dlPtr = (DigramItem *)itemPtr;
 
-    return DigramSingleValue((unsigned char)string[0], (unsigned char)string[1], dlPtr->value);
+    return DigramEntry(dlPtr, DigramOffset(string[0], string[1], dlPtr));
 }
 
 static int
 NormalizeDigramLog(Tcl_Interp *interp, ScoreItem *itemPtr) {
     DigramItem *dlPtr = (DigramItem *)itemPtr;
-    int i, j;
+    int i;
 
-    for(i=0; i < 256; i++) {
-	for (j=0; j < 256; j++) {
-	    if (dlPtr->value[i][j] > 0.0) {
-		dlPtr->value[i][j] = log(dlPtr->value[i][j]);
-	    } else {
-		dlPtr->value[i][j] = 0.0;
-	    }
-	}
+    for(i=0; i < 1 << (2 * dlPtr->shift); i++) {
+	double value = DigramEntry(dlPtr, i);
+
+	SetDigramEntry(dlPtr, i, (value > 0.0) ? log(value) : 0.0);
     }
 
     Tcl_ResetResult(interp);
@@ -185,14 +245,16 @@ DumpDigram(Tcl_Interp *interp, ScoreItem *itemPtr, const char *script) {
 
     for (i=1; i < 256; i++) {
 	for (j=1; j < 256; j++) {
-	    if (DigramSingleValue(i, j, dlPtr->value) > 0.0) {
+	    double value = DigramEntry(dlPtr, DigramOffset(i, j, dlPtr));
+
+	    if (value > 0.0) {
 		element[0] = i;
 		element[1] = j;
 
 		Tcl_DStringSetLength(&dsPtr, length);
 		Tcl_DStringStartSublist(&dsPtr);
 		Tcl_DStringAppendElement(&dsPtr, (const char *)element);
-		Tcl_SetDoubleObj(valueObj, DigramSingleValue(i, j, dlPtr->value));
+		Tcl_SetDoubleObj(valueObj, value);
 		Tcl_DStringAppendElement(&dsPtr, Tcl_GetString(valueObj));
 		Tcl_DStringEndSublist(&dsPtr);
 
@@ -207,3 +269,251 @@ DumpDigram(Tcl_Interp *interp, ScoreItem *itemPtr, const char *script) {
 
     return TCL_OK;
 }
+
+static int
+SaveDigram(Tcl_Interp *interp, ScoreItem *itemPtr, const char *filename) {
+    DigramItem *dlPtr = (DigramItem *)itemPtr;
+    double *table;
+    int i, j;
+    int result;
+
+    /*
+     * The file always holds the full 256x256 table so that it doesn't
+     * depend on which characters have been seen.
+     */
+
+    table = (double *)ckalloc(sizeof(double) * 256 * 256);
+    for (i=0; i < 256; i++) {
+	for (j=0; j < 256; j++) {
+	    table[(i << 8) | j] = DigramEntry(dlPtr, DigramOffset(i, j, dlPtr));
+	}
+    }
+
+    result = ScoreTableWrite(interp, filename, itemPtr, SCORE_TABLE_BYTE,
+	    table, sizeof(double), 256 * 256);
+    ckfree((char *)table);
+
+    return result;
+}
+
+static int
+LoadDigram(Tcl_Interp *interp, ScoreItem *itemPtr, const char *filename) {
+    DigramItem *dlPtr = (DigramItem *)itemPtr;
+    ScoreTableMap map;
+    const double *table;
+    int entries;
+    int i;
+
+    table = (const double *)ScoreTableOpen(interp, filename, itemPtr,
+	    SCORE_TABLE_BYTE, sizeof(double), &map, &entries);
+    if (table == NULL) {
+	return TCL_ERROR;
+    }
+
+    if (entries != 256 * 256) {
+	ScoreTableClose(&map);
+	Tcl_AppendResult(interp, "\"", filename,
+		"\" does not hold a valid digram table", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    ResetDigramTable(dlPtr);
+    for (i=0; i < 256 * 256; i++) {
+	if (table[i] != 0.0) {
+	    DigramIndex(dlPtr, (unsigned char)(i >> 8));
+	    DigramIndex(dlPtr, (unsigned char)(i & 0xff));
+	    SetDigramEntry(dlPtr, DigramOffset(i >> 8, i & 0xff, dlPtr),
+		    table[i]);
+	}
+    }
+
+    ScoreTableClose(&map);
+
+    Tcl_ResetResult(interp);
+    return TCL_OK;
+}
+
+static double
+DigramWindowValue(ScoreItem *itemPtr, const char *string, int start) {
+    DigramItem *dlPtr = (DigramItem *)itemPtr;
+
+    /*
+     * Fixed point windows are returned in table units so that
+     * DigramDelta() only adds up integers.
+     */
+
+    if (dlPtr->scale) {
+	return (double)dlPtr->fixedValue[DigramOffset(string[start],
+		string[start+1], dlPtr)];
+    }
+
+    return dlPtr->value[DigramOffset(string[start], string[start+1], dlPtr)];
+}
+
+static double
+DigramGramValue(ScoreItem *itemPtr, const char *string, int start, int index) {
+    DigramItem *dlPtr = (DigramItem *)itemPtr;
+
+    /*
+     * The letters a-z always have rows 0-25, so the offset of a pair of
+     * letters can be taken straight from its base-26 index.
+     */
+
+    if (index < 0) {
+	return DigramEntry(dlPtr, DigramOffset(string[start], string[start+1],
+		dlPtr));
+    }
+
+    return DigramEntry(dlPtr, ((index / 26) << dlPtr->shift) | (index % 26));
+}
+
+static double
+DigramMaxValue(ScoreItem *itemPtr) {
+    DigramItem *dlPtr = (DigramItem *)itemPtr;
+    double max = 0.0;
+    int i, j;
+
+    for (i=0; i < dlPtr->size; i++) {
+	for (j=0; j < dlPtr->size; j++) {
+	    double value = DigramEntry(dlPtr, (i << dlPtr->shift) | j);
+
+	    if (value > max) {
+		max = value;
+	    }
+	}
+    }
+
+    return max;
+}
+
+static double
+DigramBlockValue(ScoreItem *itemPtr, const char *string, int start, int count) {
+    DigramItem *dlPtr = (DigramItem *)itemPtr;
+
+    if (dlPtr->scale) {
+	return (double)ScoreDigramFixedSum(dlPtr->fixedValue, dlPtr->index,
+		dlPtr->shift, string+start, count+1) / dlPtr->scale;
+    }
+
+    return ScoreDigramSum(dlPtr->value, dlPtr->index, dlPtr->shift,
+	    string+start, count+1);
+}
+
+static double
+DigramDelta(Tcl_Interp *interp, ScoreItem *itemPtr, const char *oldString, const char *newString, double oldValue, const int *positions, int count) {
+    DigramItem *dlPtr = (DigramItem *)itemPtr;
+
+    if (dlPtr->scale) {
+	return ScoreWindowDelta(itemPtr, DigramWindowValue, 2, oldString,
+		newString, ScoreDoubleToFixed(oldValue, dlPtr->scale),
+		positions, count) / dlPtr->scale;
+    }
+
+    return ScoreWindowDelta(itemPtr, DigramWindowValue, 2, oldString,
+	    newString, oldValue, positions, count);
+}
+
+/*
+ * Empty the table and shrink it back to the letters a-z.
+ */
+
+static void
+ResetDigramTable(DigramItem *dlPtr) {
+    int i;
+
+    for (i=0; i < 256; i++) {
+	dlPtr->index[i] = DIGRAM_OTHER;
+    }
+    for (i=0; i < DIGRAM_OTHER; i++) {
+	dlPtr->index['a' + i] = i;
+    }
+    dlPtr->size = DIGRAM_OTHER + 1;
+    dlPtr->shift = 5;
+
+    if (dlPtr->value != NULL) {
+	ckfree((char *)dlPtr->value);
+	dlPtr->value = (double *)NULL;
+    }
+    if (dlPtr->fixedValue != NULL) {
+	ckfree((char *)dlPtr->fixedValue);
+	dlPtr->fixedValue = (int *)NULL;
+    }
+
+    if (dlPtr->scale) {
+	dlPtr->fixedValue = (int *)ckalloc(sizeof(int) << (2 * dlPtr->shift));
+	memset(dlPtr->fixedValue, 0, sizeof(int) << (2 * dlPtr->shift));
+    } else {
+	dlPtr->value = (double *)ckalloc(sizeof(double) << (2 * dlPtr->shift));
+	for (i=0; i < 1 << (2 * dlPtr->shift); i++) {
+	    dlPtr->value[i] = 0.0;
+	}
+    }
+}
+
+/*
+ * Return the table row for a character, giving the character its own
+ * row if it doesn't have one yet.
+ */
+
+static int
+DigramIndex(DigramItem *dlPtr, unsigned char c) {
+    int oldShift = dlPtr->shift;
+    int i, j;
+
+    if (dlPtr->index[c] != DIGRAM_OTHER) {
+	return dlPtr->index[c];
+    }
+
+    dlPtr->index[c] = dlPtr->size++;
+    if (dlPtr->size <= 1 << oldShift) {
+	return dlPtr->index[c];
+    }
+
+    dlPtr->shift++;
+    if (dlPtr->scale) {
+	int *oldValue = dlPtr->fixedValue;
+
+	dlPtr->fixedValue = (int *)ckalloc(sizeof(int) << (2 * dlPtr->shift));
+	memset(dlPtr->fixedValue, 0, sizeof(int) << (2 * dlPtr->shift));
+	for (i=0; i < 1 << oldShift; i++) {
+	    memcpy(dlPtr->fixedValue + (i << dlPtr->shift),
+		    oldValue + (i << oldShift), sizeof(int) << oldShift);
+	}
+	ckfree((char *)oldValue);
+    } else {
+	double *oldValue = dlPtr->value;
+
+	dlPtr->value = (double *)ckalloc(sizeof(double) << (2 * dlPtr->shift));
+	for (i=0; i < 1 << (2 * dlPtr->shift); i++) {
+	    dlPtr->value[i] = 0.0;
+	}
+	for (i=0; i < 1 << oldShift; i++) {
+	    for (j=0; j < 1 << oldShift; j++) {
+		dlPtr->value[(i << dlPtr->shift) | j]
+			= oldValue[(i << oldShift) | j];
+	    }
+	}
+	ckfree((char *)oldValue);
+    }
+
+    return dlPtr->index[c];
+}
+
+static double
+DigramEntry(DigramItem *dlPtr, int offset) {
+    if (dlPtr->scale) {
+	return (double)dlPtr->fixedValue[offset] / dlPtr->scale;
+    }
+
+    return dlPtr->value[offset];
+}
+
+static void
+SetDigramEntry(DigramItem *dlPtr, int offset, double value) {
+    if (dlPtr->scale) {
+	dlPtr->fixedValue[offset] = ScoreFixedEntry(
+		ScoreDoubleToFixed(value, dlPtr->scale));
+    } else {
+	dlPtr->value[offset] = value;
+    }
+}
@@ -125,6 +125,106 @@ proc ConfigureBestfitcommand {{isValid 1}} {
     return $result
 }
 
+proc ConfigureCheckpoint {} {
+    set result "
+    <DT><B><CODE><I>cipherProc</I> configure -checkpoint file</CODE></B></DT>
+	<DD>Save the progress of the <B>solve</B> command to <B>file</B>
+	every <I><B>checkpointinterval</B></I> seconds and when the solve
+	finishes.  The saved progress includes the best key found so far.
+	An empty file name turns checkpoints off.
+	</DD>
+	<P>
+    <DT><B><CODE><I>cipherProc</I> configure -checkpointinterval seconds</CODE></B></DT>
+	<DD>Set the number of seconds between checkpoints.  The default
+	is 60.
+	</DD>
+	<P>
+    <DT><B><CODE><I>cipherProc</I> configure -resume file</CODE></B></DT>
+	<DD>Make the next <B>solve</B> carry on from the checkpoint in
+	<B>file</B> instead of starting from the beginning.  The checkpoint
+	must have been written for the same ciphertext and period.
+	An empty file name turns this off.
+	</DD>
+	<P>
+"
+
+    return $result
+}
+
+proc ConfigureThreads {} {
+    set result "
+    <DT><B><CODE><I>cipherProc</I> configure -threads count</CODE></B></DT>
+	<DD>Spread the <B>solve</B> command over <B>count</B> worker threads.
+	Each thread searches its own share of the permutations with a copy
+	of the cipher, and the <B>-stepcommand</B> and
+	<B>-bestfitcommand</B> procedures are still called in the main
+	interpreter.  The best key found does not depend on the number of
+	threads.  This needs a threaded build of Tcl and a scoring command
+	written in C, and can't be combined with checkpoints.  The default
+	is 1.
+	</DD>
+	<P>
+"
+
+    return $result
+}
+
+proc ConfigureRange {} {
+    set result "
+    <DT><B><CODE><I>cipherProc</I> configure -range {start count}</CODE></B></DT>
+	<DD>Limit the <B>solve</B> command to <B>count</B> of the
+	permutations of the key, starting with the one of rank
+	<B>start</B>.  The permutations are ranked in lexicographic order,
+	as with <B>permute -rank</B>, and are applied to the key that the
+	cipher has when the solve starts.  Splitting the ranks from 0 to
+	<B>period!</B> into ranges lets separate processes share one
+	exhaustive solve, as the <B>permshard</B> program does.  This only
+	works for periods up to 20 and can't be combined with threads or
+	checkpoints.  The count must be at least 1.  An empty list searches
+	every permutation, which is the default.
+	</DD>
+	<P>
+"
+
+    return $result
+}
+
+proc ConfigurePrune {} {
+    set result "
+    <DT><B><CODE><I>cipherProc</I> configure -prune boolean</CODE></B></DT>
+	<DD>Solve with a branch and bound search.  The keys are built one
+	column at a time, and a partial key is dropped as soon as the
+	plaintext that it places couldn't beat the best key found so far,
+	even if every other window of the plaintext got the best possible
+	score.  The search finds the same best key as the full search, but
+	it needs a scoring command written in C, and can't be combined with
+	checkpoints or <B>-threads</B>.  The default is 0.
+	</DD>
+	<P>
+"
+
+    return $result
+}
+
+proc ConfigureAdjacency {} {
+    set result "
+    <DT><B><CODE><I>cipherProc</I> configure -adjacency count</CODE></B></DT>
+	<DD>Make the <B>solve</B> command score the digrams of every pair
+	of columns side by side once, find the <B>count</B> orders of the
+	columns whose neighboring pairs score best, and only score the
+	plaintext of those orders in full.  This is much faster than
+	trying every order, but the best key is only found if its order
+	is among the ones that are scored.  The columns of a columnar
+	cipher must all be the same length, and a nicodemus cipher only
+	pairs up the rows of its complete blocks.  The count can be at most
+	100000.  0, the default, tries every order.
+	</DD>
+	<P>
+"
+
+    return $result
+}
+
 proc ConfigureLanguage {} {
     set result "
     <DT><B><CODE><I>cipherProc</I> configure -language <I>language</I></CODE></B></DT>
@@ -249,6 +349,82 @@ proc CgetBestfitcommand {} {
     return $result
 }
 
+proc CgetCheckpoint {} {
+    set result "
+    <DT><B><CODE><I>cipherProc</I> cget -checkpoint</CODE></B></DT>
+	<DD>Returns the file that checkpoints are written to.
+	</DD>
+	<P>
+    <DT><B><CODE><I>cipherProc</I> cget -checkpointinterval</CODE></B></DT>
+	<DD>Returns the number of seconds between checkpoints.
+	</DD>
+	<P>
+    <DT><B><CODE><I>cipherProc</I> cget -resume</CODE></B></DT>
+	<DD>Returns the checkpoint file that the next solve resumes from.
+	</DD>
+	<P>
+"
+
+    return $result
+}
+
+proc CgetThreads {} {
+    set result "
+    <DT><B><CODE><I>cipherProc</I> cget -threads</CODE></B></DT>
+	<DD>Returns the number of threads that the <B>solve</B> command uses.
+	</DD>
+	<P>
+"
+
+    return $result
+}
+
+proc CgetRange {} {
+    set result "
+    <DT><B><CODE><I>cipherProc</I> cget -range</CODE></B></DT>
+	<DD>Returns the start and count of the permutations that the
+	<B>solve</B> command searches, or an empty list if it searches all of
+	them.
+	</DD>
+	<P>
+"
+
+    return $result
+}
+
+proc CgetPrune {} {
+    set result "
+    <DT><B><CODE><I>cipherProc</I> cget -prune</CODE></B></DT>
+	<DD>Returns 1 if the <B>solve</B> command uses a branch and bound
+	search.
+	</DD>
+	<P>
+    <DT><B><CODE><I>cipherProc</I> cget -prunestats</CODE></B></DT>
+	<DD>Returns a list of names and values describing the last branch
+	and bound or adjacency solve:  the number of partial keys that were
+	<B>bounded</B> and <B>pruned</B>, the number of keys that were
+	<B>tested</B> and <B>skipped</B>, and the <B>ratio</B> of skipped
+	keys to all keys.
+	</DD>
+	<P>
+"
+
+    return $result
+}
+
+proc CgetAdjacency {} {
+    set result "
+    <DT><B><CODE><I>cipherProc</I> cget -adjacency</CODE></B></DT>
+	<DD>Returns the number of column orders that an adjacency solve
+	scores in full, or 0 if the <B>solve</B> command tries every
+	order.
+	</DD>
+	<P>
+"
+
+    return $result
+}
+
 proc CgetLanguage {} {
     set result "
     <DT><B><CODE><I>cipherProc</I> cget -language</CODE></B></DT>
@@ -0,0 +1,820 @@
+/*
+ * genetic.c --
+ *
+ *	This file implements a genetic search on top of the native hill
+ *	climber's key and scoring routines.  The population is kept in one
+ *	flat array of keys.  Every generation the best keys are copied
+ *	unchanged (elitism), and the rest of the new generation is bred
+ *	from parents picked by tournament selection.  A child is a
+ *	crossover of its two parents with probability -crossover, and a
+ *	copy of the first parent otherwise.  Every letter of the child that
+ *	can change then has a chance of -mutate of triggering one random
+ *	move.  The children of a generation are scored as one batch, which
+ *	can be spread over several threads.
+ *
+ *	Crossover works on the letters of each key part that aren't fixed,
+ *	which are always a rearrangement of the same letters.  Repeated
+ *	letters are numbered by their order in the key, so the crossovers
+ *	can treat every part as a permutation:
+ *
+ *	pmx	Partially mapped crossover.  A run of letters is copied from
+ *		the first parent and the rest come from the second, with
+ *		clashes resolved through the mapping between the two
+ *		runs.  Letters tend to keep their positions, which suits
+ *		substitution alphabets.
+ *	ox	Order crossover.  A run of letters is copied from the first
+ *		parent and the gaps are filled with the remaining letters
+ *		in the order in which they appear in the second parent.
+ *		Letters tend to keep their order, which suits
+ *		transposition keys.
+ *
+ * Copyright (c) 2008 Michael Thomas <wart@kobold.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <tcl.h>
+#include <string.h>
+#include <stdlib.h>
+#include "hillclimb.h"
+
+#define GENETIC_PMX	0
+#define GENETIC_OX	1
+
+static const char *geneticMethods[] = {"pmx", "ox", NULL};
+
+typedef struct GeneticState {
+    HillclimbState climb;
+    int method;
+    int population;
+    long generations;
+    double crossover;
+    double mutate;
+    int tournament;
+    int elite;
+
+    /*
+     * The current and next generations, keySize bytes per key.
+     */
+
+    char *keys;
+    double *values;
+    char *nextKeys;
+    double *nextValues;
+
+    /*
+     * The letters of each part that can change, sorted, and the first
+     * number given to each letter.  Letter number i is letters[part][i].
+     */
+
+    char *letters[2];
+    int firstNumber[2][256];
+
+    /*
+     * Room for numbering the parents and building a child.
+     */
+
+    int *first;
+    int *second;
+    int *child;
+    int *where;
+
+    long evaluations;
+    HillclimbTrace trace;
+
+    /*
+     * The last generation that was bred, which is set when the search
+     * is resumed from a checkpoint.
+     */
+
+    HillclimbCheckpoint checkpoint;
+    long generation;
+    int resumed;
+} GeneticState;
+
+static char *
+GeneticKey(GeneticState *statePtr, char *keys, int index)
+{
+    return keys + index * statePtr->climb.keySize;
+}
+
+/*
+ * Number the letters of the free positions of one part of key.
+ */
+
+static void
+GeneticNumber(GeneticState *statePtr, int part, const char *key, int *numbers)
+{
+    HillclimbNeighbors *nbPtr = &statePtr->climb.moves;
+    const char *partKey = key + nbPtr->partOffset[part];
+    const int *freePos = nbPtr->free[part];
+    int next[256];
+    int i;
+
+    memcpy(next, statePtr->firstNumber[part], sizeof(next));
+    for (i=0; i < nbPtr->freeCount[part]; i++) {
+	numbers[i] = next[(unsigned char) partKey[freePos[i]]]++;
+    }
+}
+
+/*
+ * Write numbered letters back into the free positions of one part of
+ * key.
+ */
+
+static void
+GeneticUnnumber(GeneticState *statePtr, int part, const int *numbers, char *key)
+{
+    HillclimbNeighbors *nbPtr = &statePtr->climb.moves;
+    char *partKey = key + nbPtr->partOffset[part];
+    const int *freePos = nbPtr->free[part];
+    int i;
+
+    for (i=0; i < nbPtr->freeCount[part]; i++) {
+	partKey[freePos[i]] = statePtr->letters[part][numbers[i]];
+    }
+}
+
+/*
+ * Set up the letter numbering from the starting key.
+ */
+
+static void
+GeneticInitLetters(GeneticState *statePtr, const char *key)
+{
+    HillclimbNeighbors *nbPtr = &statePtr->climb.moves;
+    int counts[256];
+    int part, i, c, total;
+
+    for (part=0; part < statePtr->climb.partCount; part++) {
+	const char *partKey = key + nbPtr->partOffset[part];
+	int n = nbPtr->freeCount[part];
+
+	memset(counts, 0, sizeof(counts));
+	for (i=0; i < n; i++) {
+	    counts[(unsigned char) partKey[nbPtr->free[part][i]]]++;
+	}
+
+	statePtr->letters[part] = (char *)ckalloc(n + 1);
+	total = 0;
+	for (c=0; c < 256; c++) {
+	    statePtr->firstNumber[part][c] = total;
+	    for (i=0; i < counts[c]; i++) {
+		statePtr->letters[part][total++] = (char) c;
+	    }
+	}
+    }
+}
+
+/*
+ * Partially mapped crossover of first and second, which hold n numbers
+ * each, keeping positions start to end of first.
+ */
+
+static void
+GeneticPmx(GeneticState *statePtr, int n, int start, int end)
+{
+    int *first = statePtr->first;
+    int *second = statePtr->second;
+    int *child = statePtr->child;
+    int *where = statePtr->where;
+    int i, number;
+
+    for (i=0; i < n; i++) {
+	where[i] = -1;
+    }
+    for (i=start; i <= end; i++) {
+	child[i] = first[i];
+	where[first[i]] = i;
+    }
+
+    /*
+     * A letter from the second parent that is already in the copied run
+     * is replaced by the letter that it displaced, until one is found
+     * that isn't in the run.
+     */
+
+    for (i=0; i < n; i++) {
+	if (i >= start && i <= end) {
+	    continue;
+	}
+	number = second[i];
+	while (where[number] >= 0) {
+	    number = second[where[number]];
+	}
+	child[i] = number;
+    }
+}
+
+/*
+ * Order crossover of first and second, which hold n numbers each,
+ * keeping positions start to end of first.
+ */
+
+static void
+GeneticOx(GeneticState *statePtr, int n, int start, int end)
+{
+    int *first = statePtr->first;
+    int *second = statePtr->second;
+    int *child = statePtr->child;
+    int *used = statePtr->where;
+    int i, from, to;
+
+    for (i=0; i < n; i++) {
+	used[i] = 0;
+    }
+    for (i=start; i <= end; i++) {
+	child[i] = first[i];
+	used[first[i]] = 1;
+    }
+
+    to = (end + 1) % n;
+    for (i=0; i < n; i++) {
+	from = (end + 1 + i) % n;
+	if (! used[second[from]]) {
+	    child[to] = second[from];
+	    to = (to + 1) % n;
+	}
+    }
+}
+
+static void
+GeneticCrossover(GeneticState *statePtr, const char *first, const char *second, char *child)
+{
+    HillclimbNeighbors *nbPtr = &statePtr->climb.moves;
+    RandomState *randPtr = &statePtr->climb.rand;
+    int part, n, start, end;
+
+    memcpy(child, first, statePtr->climb.keySize);
+    for (part=0; part < statePtr->climb.partCount; part++) {
+	n = nbPtr->freeCount[part];
+	if (n < 2) {
+	    continue;
+	}
+
+	start = RandomIndex(randPtr, n);
+	end = RandomIndex(randPtr, n);
+	if (start > end) {
+	    int tmp = start;
+	    start = end;
+	    end = tmp;
+	}
+
+	GeneticNumber(statePtr, part, first, statePtr->first);
+	GeneticNumber(statePtr, part, second, statePtr->second);
+	if (statePtr->method == GENETIC_PMX) {
+	    GeneticPmx(statePtr, n, start, end);
+	} else {
+	    GeneticOx(statePtr, n, start, end);
+	}
+	GeneticUnnumber(statePtr, part, statePtr->child, child);
+    }
+}
+
+static void
+GeneticMutate(GeneticState *statePtr, char *key)
+{
+    HillclimbState *climbPtr = &statePtr->climb;
+    HillclimbMove move;
+    int n = climbPtr->moves.freeCount[0] + climbPtr->moves.freeCount[1];
+    int i;
+
+    for (i=0; i < n; i++) {
+	if (HillclimbRandom(climbPtr) < statePtr->mutate) {
+	    HillclimbRandomMove(climbPtr, &move);
+	    HillclimbApplyMove(&climbPtr->moves, key, &move);
+	}
+    }
+}
+
+/*
+ * Pick the best of a few random keys from the current generation.
+ */
+
+static int
+GeneticSelect(GeneticState *statePtr)
+{
+    RandomState *randPtr = &statePtr->climb.rand;
+    int best = RandomIndex(randPtr, statePtr->population);
+    int i, index;
+
+    for (i=1; i < statePtr->tournament; i++) {
+	index = RandomIndex(randPtr, statePtr->population);
+	if (statePtr->values[index] > statePtr->values[best]) {
+	    best = index;
+	}
+    }
+
+    return best;
+}
+
+/*
+ * Copy the best keys of the current generation to the start of the next
+ * one.  The number of elite keys is small, so they are picked one at a
+ * time rather than by sorting the whole generation.
+ */
+
+static void
+GeneticKeepElite(GeneticState *statePtr, char *chosen)
+{
+    int e, i, best;
+
+    memset(chosen, 0, statePtr->population);
+    for (e=0; e < statePtr->elite; e++) {
+	best = -1;
+	for (i=0; i < statePtr->population; i++) {
+	    if (! chosen[i] && (best < 0
+			|| statePtr->values[i] > statePtr->values[best])) {
+		best = i;
+	    }
+	}
+	chosen[best] = 1;
+	memcpy(GeneticKey(statePtr, statePtr->nextKeys, e),
+		GeneticKey(statePtr, statePtr->keys, best),
+		statePtr->climb.keySize);
+	statePtr->nextValues[e] = statePtr->values[best];
+    }
+}
+
+static int
+GeneticBest(GeneticState *statePtr)
+{
+    int best = 0;
+    int i;
+
+    for (i=1; i < statePtr->population; i++) {
+	if (statePtr->values[i] > statePtr->values[best]) {
+	    best = i;
+	}
+    }
+
+    return best;
+}
+
+/*
+ * Save the population and the best key so far.  The random number
+ * generator is saved too, so a resumed search breeds the same
+ * generations as one that was never stopped.
+ */
+
+static int
+GeneticWriteCheckpoint(GeneticState *statePtr, char *maxKey, double maxValue)
+{
+    HillclimbState *climbPtr = &statePtr->climb;
+    int keySize = climbPtr->keySize;
+    Checkpoint checkpoint;
+    int result;
+
+    HillclimbCheckpointStart(climbPtr, &checkpoint, CHECKPOINT_GENETIC);
+    CheckpointPutInt(&checkpoint, statePtr->population);
+    CheckpointPutInt(&checkpoint, statePtr->generation);
+    CheckpointPutInt(&checkpoint, statePtr->evaluations);
+    CheckpointPutDouble(&checkpoint, maxValue);
+    CheckpointPutBytes(&checkpoint, maxKey, keySize);
+    CheckpointPutBytes(&checkpoint, statePtr->keys,
+	    keySize * statePtr->population);
+    CheckpointPutBytes(&checkpoint, statePtr->values,
+	    sizeof(double) * statePtr->population);
+    HillclimbCheckpointPutTrace(&checkpoint, &statePtr->trace);
+
+    result = CheckpointWrite(climbPtr->interp, &checkpoint,
+	    statePtr->checkpoint.fileName);
+    CheckpointFree(&checkpoint);
+
+    return result;
+}
+
+static int
+GeneticReadCheckpoint(GeneticState *statePtr, char *maxKey, double *maxValuePtr)
+{
+    HillclimbState *climbPtr = &statePtr->climb;
+    Tcl_Interp *interp = climbPtr->interp;
+    int keySize = climbPtr->keySize;
+    Checkpoint checkpoint;
+    Tcl_WideInt population, generation, evaluations;
+    int result;
+
+    if (HillclimbCheckpointResume(climbPtr, &statePtr->checkpoint,
+		&checkpoint, CHECKPOINT_GENETIC) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    result = CheckpointGetInt(interp, &checkpoint, &population);
+    if (result == TCL_OK && population != statePtr->population) {
+	result = CheckpointMismatch(interp, &checkpoint);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetInt(interp, &checkpoint, &generation);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetInt(interp, &checkpoint, &evaluations);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetDouble(interp, &checkpoint, maxValuePtr);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetBytes(interp, &checkpoint, maxKey, keySize);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetBytes(interp, &checkpoint, statePtr->keys,
+		keySize * statePtr->population);
+    }
+    if (result == TCL_OK) {
+	result = CheckpointGetBytes(interp, &checkpoint, statePtr->values,
+		sizeof(double) * statePtr->population);
+    }
+    if (result == TCL_OK) {
+	result = HillclimbCheckpointGetTrace(climbPtr, &checkpoint,
+		&statePtr->trace);
+    }
+    CheckpointFree(&checkpoint);
+
+    statePtr->generation = (long)generation;
+    statePtr->evaluations = (long)evaluations;
+    statePtr->resumed = 1;
+
+    return result;
+}
+
+/*
+ * Evolve the population from key, or carry on from the population of a
+ * checkpoint if the search was resumed.  On return maxKey holds the best
+ * key seen.  The trace gets the generation and value of every
+ * improvement of the best key.
+ */
+
+static int
+GeneticRun(GeneticState *statePtr, HillclimbPool *poolPtr, char *key, char *maxKey, double *maxValuePtr)
+{
+    HillclimbState *climbPtr = &statePtr->climb;
+    HillclimbCheckpoint *cpPtr = &statePtr->checkpoint;
+    int population = statePtr->population;
+    int keySize = climbPtr->keySize;
+    HillclimbMove move;
+    char *chosen = (char *)ckalloc(population);
+    double maxValue;
+    long generation, j;
+    int result = TCL_OK;
+    int best, i;
+
+    if (statePtr->resumed) {
+	maxValue = *maxValuePtr;
+    } else {
+	/*
+	 * The first key is the starting key and the rest are random
+	 * shuffles of it.
+	 */
+
+	for (i=0; i < population; i++) {
+	    char *newKey = GeneticKey(statePtr, statePtr->keys, i);
+
+	    memcpy(newKey, key, keySize);
+	    if (i > 0) {
+		for (j=0; j < climbPtr->moves.count; j++) {
+		    HillclimbRandomMove(climbPtr, &move);
+		    HillclimbApplyMove(&climbPtr->moves, newKey, &move);
+		}
+	    }
+	}
+	result = HillclimbPoolScore(poolPtr, statePtr->keys, population,
+		statePtr->values);
+	statePtr->evaluations += population;
+
+	best = GeneticBest(statePtr);
+	maxValue = statePtr->values[best];
+	memcpy(maxKey, GeneticKey(statePtr, statePtr->keys, best), keySize);
+	if (result == TCL_OK) {
+	    result = HillclimbBestFit(climbPtr, maxKey, 0, maxValue);
+	}
+    }
+
+    for (generation=statePtr->generation+1;
+	    generation <= statePtr->generations && result == TCL_OK;
+	    generation++) {
+	char *swapKeys;
+	double *swapValues;
+
+	GeneticKeepElite(statePtr, chosen);
+	for (i=statePtr->elite; i < population; i++) {
+	    char *child = GeneticKey(statePtr, statePtr->nextKeys, i);
+	    int first = GeneticSelect(statePtr);
+
+	    if (HillclimbRandom(climbPtr) < statePtr->crossover) {
+		GeneticCrossover(statePtr,
+			GeneticKey(statePtr, statePtr->keys, first),
+			GeneticKey(statePtr, statePtr->keys,
+			    GeneticSelect(statePtr)), child);
+	    } else {
+		memcpy(child, GeneticKey(statePtr, statePtr->keys, first),
+			keySize);
+	    }
+	    GeneticMutate(statePtr, child);
+	}
+
+	result = HillclimbPoolScore(poolPtr,
+		GeneticKey(statePtr, statePtr->nextKeys, statePtr->elite),
+		population - statePtr->elite,
+		statePtr->nextValues + statePtr->elite);
+	if (result != TCL_OK) {
+	    break;
+	}
+	statePtr->evaluations += population - statePtr->elite;
+
+	swapKeys = statePtr->keys;
+	statePtr->keys = statePtr->nextKeys;
+	statePtr->nextKeys = swapKeys;
+	swapValues = statePtr->values;
+	statePtr->values = statePtr->nextValues;
+	statePtr->nextValues = swapValues;
+
+	best = GeneticBest(statePtr);
+	if (statePtr->values[best] > maxValue) {
+	    maxValue = statePtr->values[best];
+	    memcpy(maxKey, GeneticKey(statePtr, statePtr->keys, best),
+		    keySize);
+	    HillclimbTraceAdd(&statePtr->trace, generation, maxValue);
+
+	    result = HillclimbBestFit(climbPtr, maxKey, generation, maxValue);
+	}
+	if (result == TCL_OK) {
+	    result = HillclimbStep(climbPtr, maxKey, generation);
+	}
+
+	statePtr->generation = generation;
+	if (result == TCL_OK && cpPtr->fileName
+		&& CheckpointDue(&cpPtr->last, cpPtr->interval)) {
+	    result = GeneticWriteCheckpoint(statePtr, maxKey, maxValue);
+	}
+    }
+
+    if (result == TCL_OK && cpPtr->fileName) {
+	result = GeneticWriteCheckpoint(statePtr, maxKey, maxValue);
+    }
+    if (result == TCL_OK) {
+	result = HillclimbDecipher(climbPtr, maxKey);
+    }
+
+    ckfree(chosen);
+    *maxValuePtr = maxValue;
+    return result;
+}
+
+static void
+GeneticFreeState(GeneticState *statePtr)
+{
+    int part;
+
+    if (statePtr->keys) {
+	ckfree(statePtr->keys);
+	ckfree(statePtr->nextKeys);
+	ckfree((char *)statePtr->values);
+	ckfree((char *)statePtr->nextValues);
+	ckfree((char *)statePtr->first);
+	ckfree((char *)statePtr->second);
+	ckfree((char *)statePtr->child);
+	ckfree((char *)statePtr->where);
+    }
+    for (part=0; part < 2; part++) {
+	if (statePtr->letters[part]) {
+	    ckfree(statePtr->letters[part]);
+	}
+    }
+    HillclimbTraceFree(&statePtr->trace);
+    HillclimbFreeState(&statePtr->climb);
+}
+
+static int
+GeneticGetProbability(Tcl_Interp *interp, Tcl_Obj *valueObj, double *probabilityPtr)
+{
+    if (Tcl_GetDoubleFromObj(interp, valueObj, probabilityPtr) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (*probabilityPtr < 0.0 || *probabilityPtr > 1.0) {
+	Tcl_SetResult(interp, "Probabilities must be from 0 to 1",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+
+/*
+ * Hillclimb::genetic cipher key ?options?
+ *
+ *	Search for the best key with a genetic algorithm.  Returns a list
+ *	of the best key found, its score, and a list of statistics about
+ *	the run.  The cipher is left with the best key restored.  See
+ *	doc/Hillclimb/package.tml for the options.
+ */
+
+int
+HillclimbGeneticObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
+{
+    GeneticState state;
+    HillclimbPool *poolPtr;
+    Tcl_Obj *resultObjs[3];
+    Tcl_Obj *statObjs[18];
+    Tcl_Time start, end;
+    char *key = (char *)NULL;
+    char *maxKey;
+    double maxValue = 0.0;
+    double seconds;
+    int result = TCL_OK;
+    int i;
+
+    if (objc < 3 || objc % 2 == 0) {
+	Tcl_AppendResult(interp, "Usage:  ", Tcl_GetString(objv[0]),
+		" cipher key ?option value ...?", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    memset(&state, 0, sizeof(GeneticState));
+    if (HillclimbInitState(interp, objv[1], &state.climb) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    state.method = GENETIC_PMX;
+    state.population = 64;
+    state.generations = 100;
+    state.crossover = 0.7;
+    state.mutate = 0.01;
+    state.tournament = 2;
+    state.elite = 1;
+    HillclimbCheckpointInit(&state.checkpoint);
+
+    for (i=3; i < objc; i += 2) {
+	const char *option = Tcl_GetString(objv[i]);
+
+	result = HillclimbStateOption(&state.climb, option, objv[i+1]);
+	if (result == TCL_ERROR) {
+	    return TCL_ERROR;
+	} else if (result == TCL_OK) {
+	    continue;
+	}
+	result = HillclimbCheckpointOption(&state.climb, &state.checkpoint,
+		option, objv[i+1]);
+	if (result == TCL_ERROR) {
+	    return TCL_ERROR;
+	} else if (result == TCL_OK) {
+	    continue;
+	}
+	result = TCL_OK;
+
+	if (strcmp(option, "-method") == 0) {
+	    if (Tcl_GetIndexFromObj(interp, objv[i+1], geneticMethods,
+			"crossover method", 0, &state.method) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-population") == 0) {
+	    if (Tcl_GetIntFromObj(interp, objv[i+1], &state.population)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.population < 2) {
+		Tcl_SetResult(interp, "Population must be at least 2",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-generations") == 0) {
+	    if (Tcl_GetLongFromObj(interp, objv[i+1], &state.generations)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.generations < 0) {
+		Tcl_SetResult(interp, "Generations can't be negative",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-crossover") == 0) {
+	    if (GeneticGetProbability(interp, objv[i+1], &state.crossover)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-mutate") == 0) {
+	    if (GeneticGetProbability(interp, objv[i+1], &state.mutate)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-tournament") == 0) {
+	    if (Tcl_GetIntFromObj(interp, objv[i+1], &state.tournament)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.tournament < 1) {
+		Tcl_SetResult(interp, "Tournament size must be at least 1",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-elite") == 0) {
+	    if (Tcl_GetIntFromObj(interp, objv[i+1], &state.elite)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.elite < 0) {
+		Tcl_SetResult(interp, "Elite count can't be negative",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else {
+	    Tcl_AppendResult(interp, "Unknown option ", option, (char *)NULL);
+	    return TCL_ERROR;
+	}
+    }
+
+    if (state.elite >= state.population) {
+	Tcl_SetResult(interp, "Elite count must be less than the population",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (state.climb.restarts > 1) {
+	Tcl_SetResult(interp, "Genetic searches can't use -restarts",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    if (HillclimbPrepare(&state.climb, objv[2], &key) != TCL_OK) {
+	GeneticFreeState(&state);
+	return TCL_ERROR;
+    }
+    if (state.climb.moves.count == 0) {
+	Tcl_SetResult(interp, "The key has no positions that can be swapped",
+		TCL_STATIC);
+	ckfree(key);
+	GeneticFreeState(&state);
+	return TCL_ERROR;
+    }
+    if (HillclimbPoolCreate(&state.climb, state.climb.threads, &poolPtr)
+	    != TCL_OK) {
+	ckfree(key);
+	GeneticFreeState(&state);
+	return TCL_ERROR;
+    }
+
+    GeneticInitLetters(&state, key);
+    state.keys = (char *)ckalloc(state.climb.keySize * state.population);
+    state.nextKeys = (char *)ckalloc(state.climb.keySize * state.population);
+    state.values = (double *)ckalloc(sizeof(double) * state.population);
+    state.nextValues = (double *)ckalloc(sizeof(double) * state.population);
+    state.first = (int *)ckalloc(sizeof(int) * state.climb.keySize);
+    state.second = (int *)ckalloc(sizeof(int) * state.climb.keySize);
+    state.child = (int *)ckalloc(sizeof(int) * state.climb.keySize);
+    state.where = (int *)ckalloc(sizeof(int) * state.climb.keySize);
+    maxKey = (char *)ckalloc(state.climb.keySize);
+
+    Tcl_GetTime(&start);
+    if (state.checkpoint.resumeName) {
+	result = GeneticReadCheckpoint(&state, maxKey, &maxValue);
+    }
+    if (result == TCL_OK) {
+	result = GeneticRun(&state, poolPtr, key, maxKey, &maxValue);
+    }
+    Tcl_GetTime(&end);
+    HillclimbPoolDelete(poolPtr);
+
+    if (result == TCL_OK) {
+	seconds = (end.sec - start.sec) + (end.usec - start.usec) / 1e6;
+
+	statObjs[0] = Tcl_NewStringObj("evaluations", -1);
+	statObjs[1] = Tcl_NewLongObj(state.evaluations);
+	statObjs[2] = Tcl_NewStringObj("seconds", -1);
+	statObjs[3] = Tcl_NewDoubleObj(seconds);
+	statObjs[4] = Tcl_NewStringObj("rate", -1);
+	statObjs[5] = Tcl_NewDoubleObj(seconds > 0.0
+		? state.evaluations / seconds : 0.0);
+	statObjs[6] = Tcl_NewStringObj("seed", -1);
+	statObjs[7] = Tcl_NewLongObj(state.climb.seed);
+	statObjs[8] = Tcl_NewStringObj("generations", -1);
+	statObjs[9] = Tcl_NewLongObj(state.generations);
+	statObjs[10] = Tcl_NewStringObj("population", -1);
+	statObjs[11] = Tcl_NewIntObj(state.population);
+	statObjs[12] = Tcl_NewStringObj("threads", -1);
+	statObjs[13] = Tcl_NewIntObj(state.climb.threads);
+	statObjs[14] = Tcl_NewStringObj("method", -1);
+	statObjs[15] = Tcl_NewStringObj(geneticMethods[state.method], -1);
+	statObjs[16] = Tcl_NewStringObj("trace", -1);
+	statObjs[17] = HillclimbTraceObj(&state.trace);
+
+	resultObjs[0] = HillclimbKeyObj(&state.climb, maxKey);
+	resultObjs[1] = Tcl_NewDoubleObj(maxValue);
+	resultObjs[2] = Tcl_NewListObj(18, statObjs);
+	Tcl_SetObjResult(interp, Tcl_NewListObj(3, resultObjs));
+    }
+
+    ckfree(key);
+    ckfree(maxKey);
+    GeneticFreeState(&state);
+
+    return result;
+}
@@ -26,7 +26,7 @@
 #include <cipher.h>
 #include <ctype.h>
 #include <stdlib.h>
-#include <time.h>
+#include <cipherRandom.h>
 
 #include <cipherDebug.h>
 
@@ -643,9 +643,6 @@ EncodeGrandpre(Tcl_Interp *interp, CipherItem *itemPtr, const char *pt, const ch
 	}
     }
 
-    /* Randomize the timer.  Maybe there's a better solution. */
-    srand48((long int) time(NULL));
-
     /* Convert the lowercase letters of the plaintext to ciphertext numbers. */
     ct = (char *) ckalloc(sizeof(char) * 2*n + 1);
     for (i=0; i<n; i++) {
@@ -655,7 +652,8 @@ EncodeGrandpre(Tcl_Interp *interp, CipherItem *itemPtr, const char *pt, const ch
 	    continue;
 	}
 	/* Pick a random translation from the pool. */
-	sprintf(ct+nct, "%d", indexPool[c-'a'][rand()%nPool[c-'a']]);
+	sprintf(ct+nct, "%d", indexPool[c-'a'][RandomIndex(RandomThreadState(),
+		    nPool[c-'a'])]);
 	nct += 2;
     }
 
@@ -24,11 +24,15 @@
 #include <tcl.h>
 #include <string.h>
 #include <stdlib.h>
-#include <time.h>
 #include <math.h>
+#include "cipher.h"
+#include "score.h"
 #include "hillclimb.h"
 #include "keygen.h"
 
+static Tcl_Obj *HillclimbSwapNeighborKeys _ANSI_ARGS_((Tcl_Interp *, Tcl_Obj *,
+	Tcl_Obj *, int));
+
 int
 HillclimbRandomizeListObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
 {
@@ -98,13 +102,8 @@ int
 HillclimbAristocratSwapNeighborKeysObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
 {
     Tcl_Obj *resultObj = (Tcl_Obj *)NULL;
-    Tcl_Obj *alphabetObj = (Tcl_Obj *)NULL;
-    Tcl_Obj *replaceObj = (Tcl_Obj *)NULL;
-    Tcl_Obj *tempObjList[2];
+    Tcl_Obj *keyObjs[2];
     Tcl_Obj *k2KeyObj = (Tcl_Obj *)NULL;
-    char fullKey[27];
-    int i;
-    int resultLength;
 
     if (objc != 2 && objc != 3) {
         Tcl_AppendResult(interp, "Usage:  ", Tcl_GetString(objv[0]), " key ?fixedIndices?", (char *)NULL);
@@ -119,185 +118,1198 @@ HillclimbAristocratSwapNeighborKeysObjCmd(ClientData clientData, Tcl_Interp *int
         Tcl_SetResult(interp, "Could not find k2 component in aristocrat key", TCL_STATIC);
         return TCL_ERROR;
     }
-    if (KeyGenerateK1(interp, Tcl_GetString(k2KeyObj), fullKey) != TCL_OK) {
-        return TCL_ERROR;
-    }
 
-    if (objc == 2 || (objc == 3 && Tcl_GetCharLength(objv[2]) == 0)) {
-        resultObj = HillclimbGenerateSwapNeighborKeys(interp, fullKey, (char *)NULL);
-    } else {
-        resultObj = HillclimbGenerateSwapNeighborKeys(interp, fullKey, Tcl_GetString(objv[2]));
-    }
-    
-    if (resultObj == NULL) {
-        return TCL_ERROR;
-    }
     /*
-     * Prepend the alphabet before each aristocrat key
+     * Each neighbor key is the alphabet followed by the swapped K1 key.
      */
-    alphabetObj = Tcl_NewStringObj("abcdefghijklmnopqrstuvwxyz", 26);
-    Tcl_ListObjLength(interp, resultObj, &resultLength);
-    tempObjList[0] = alphabetObj;
-    for (i=0; i < resultLength; i++) {
-        if (Tcl_ListObjIndex(interp, resultObj, i, &(tempObjList[1])) != TCL_OK) {
-            return TCL_ERROR;
-        }
-        replaceObj = Tcl_NewListObj(2, tempObjList);
-        if (Tcl_ListObjReplace(interp, resultObj, i, 1, 1, &replaceObj) != TCL_OK) {
-            return TCL_ERROR;
-        }
+    keyObjs[0] = Tcl_NewStringObj("abcdefghijklmnopqrstuvwxyz", 26);
+    keyObjs[1] = k2KeyObj;
+
+    resultObj = HillclimbSwapNeighborKeys(interp, Tcl_NewListObj(2, keyObjs),
+	    (objc == 3) ? objv[2] : (Tcl_Obj *)NULL, HILLCLIMB_SWAP_ARISTOCRAT);
+    if (resultObj == NULL) {
+        return TCL_ERROR;
     }
 
     Tcl_SetObjResult(interp, resultObj);
 
     return TCL_OK;
 }
-
+
+/*
+ * Build a list of every key that is one swap away from keyObj.
+ */
+
+static Tcl_Obj *
+HillclimbSwapNeighborKeys(Tcl_Interp *interp, Tcl_Obj *keyObj, Tcl_Obj *fixedObj, int neighbors)
+{
+    HillclimbState state;
+    Tcl_Obj *resultObj = (Tcl_Obj *)NULL;
+    char *key;
+
+    Tcl_IncrRefCount(keyObj);
+    HillclimbInitState(interp, (Tcl_Obj *)NULL, &state);
+    state.neighbors = neighbors;
+    state.fixedObj = fixedObj;
+    if (neighbors == HILLCLIMB_SWAP_ARISTOCRAT) {
+	state.keyForm = HILLCLIMB_KEY_PAIR;
+    }
+
+    if (HillclimbPrepareKey(&state, keyObj, &key) == TCL_OK) {
+	resultObj = HillclimbNeighborList(interp, &state, key);
+	ckfree(key);
+    }
+    HillclimbFreeState(&state);
+    Tcl_DecrRefCount(keyObj);
+
+    return resultObj;
+}
+
 Tcl_Obj *
 HillclimbGenerateSwapNeighborKeys(Tcl_Interp *interp, char *fixedKey, char *fixedIndices) {
-    char *swapKey = (char *)NULL;
-    int i, j;
-    int keyLength = strlen(fixedKey);
-    Tcl_Obj *keyListObj = (Tcl_Obj *)NULL;
+    Tcl_Obj *fixedObj = (Tcl_Obj *)NULL;
+    Tcl_Obj *resultObj;
+
+    if (fixedIndices) {
+	fixedObj = Tcl_NewStringObj(fixedIndices, -1);
+	Tcl_IncrRefCount(fixedObj);
+    }
+    resultObj = HillclimbSwapNeighborKeys(interp, Tcl_NewStringObj(fixedKey, -1),
+	    fixedObj, HILLCLIMB_SWAP_GENERIC);
+    if (fixedObj) {
+	Tcl_DecrRefCount(fixedObj);
+    }
+
+    return resultObj;
+}
+
+Tcl_Obj *
+HillclimbKeysquareSwapNeighborKeys(Tcl_Interp *interp, char *fixedKey, char *fixedIndices) {
+    Tcl_Obj *fixedObj = (Tcl_Obj *)NULL;
+    Tcl_Obj *resultObj;
+
+    if (fixedIndices) {
+	fixedObj = Tcl_NewStringObj(fixedIndices, -1);
+	Tcl_IncrRefCount(fixedObj);
+    }
+    resultObj = HillclimbSwapNeighborKeys(interp, Tcl_NewStringObj(fixedKey, -1),
+	    fixedObj, HILLCLIMB_SWAP_KEYSQUARE);
+    if (fixedObj) {
+	Tcl_DecrRefCount(fixedObj);
+    }
+
+    return resultObj;
+}
 
-    if (fixedIndices && strlen(fixedIndices) != 0 && strlen(fixedIndices) != keyLength) {
-        Tcl_SetResult(interp, "key and fixedIndices are not the same length", TCL_STATIC);
+Tcl_Obj *
+HillclimbRandomizeList(Tcl_Interp *interp, Tcl_Obj *listObj) {
+    Tcl_Obj **elemObjs;
+    Tcl_Obj **shuffleObjs;
+    Tcl_Obj *newList;
+    int listLength;
+
+    if (Tcl_ListObjGetElements(interp, listObj, &listLength, &elemObjs)
+	    != TCL_OK) {
         return (Tcl_Obj *)NULL;
     }
 
-    swapKey = (char *)ckalloc((sizeof(char) * (keyLength+1)));
-    swapKey[keyLength] = '\0';
-    keyListObj = Tcl_NewObj();
+    shuffleObjs = (Tcl_Obj **)ckalloc(sizeof(Tcl_Obj *) * (listLength + 1));
+    memcpy(shuffleObjs, elemObjs, sizeof(Tcl_Obj *) * listLength);
+    RandomShuffle(RandomThreadState(), shuffleObjs, listLength);
+    newList = Tcl_NewListObj(listLength, shuffleObjs);
+    ckfree((char *)shuffleObjs);
+
+    return newList;
+}
+
+static const char *hillclimbKeyForms[] = {"simple", "pair", "gromark", NULL};
+static const char *hillclimbNeighbors[] = {"generic", "keysquare", "aristocrat",
+    "twosquare", NULL};
+
+/*
+ * Seed a search's random number generator.
+ */
+
+void
+HillclimbSeed(HillclimbState *statePtr, long seed)
+{
+    RandomSeed(&statePtr->rand, (Tcl_WideUInt) seed);
+}
+
+/*
+ * Return a random number in [0, 1).
+ */
+
+double
+HillclimbRandom(HillclimbState *statePtr)
+{
+    return RandomDouble(&statePtr->rand);
+}
+
+char *
+HillclimbKeyPart(HillclimbState *statePtr, char *key, int part)
+{
+    return part ? key + statePtr->partLength[0] + 1 : key;
+}
+
+Tcl_Obj *
+HillclimbKeyObj(HillclimbState *statePtr, char *key)
+{
+    Tcl_Obj *partObjs[2];
+
+    if (statePtr->keyForm != HILLCLIMB_KEY_PAIR) {
+	return Tcl_NewStringObj(key, -1);
+    }
+
+    partObjs[0] = Tcl_NewStringObj(HillclimbKeyPart(statePtr, key, 0), -1);
+    partObjs[1] = Tcl_NewStringObj(HillclimbKeyPart(statePtr, key, 1), -1);
+
+    return Tcl_NewListObj(2, partObjs);
+}
+
+/*
+ * Pick a random move.
+ */
+
+void
+HillclimbRandomMove(HillclimbState *statePtr, HillclimbMove *movePtr)
+{
+    long index = (long)(HillclimbRandom(statePtr) * statePtr->moves.count);
+
+    HillclimbNeighborsMove(&statePtr->moves, index, movePtr);
+}
+
+/*
+ * Copy a plaintext into a buffer, growing the buffer if necessary.
+ */
+
+void
+HillclimbCopyPt(char **bufferPtr, int *spacePtr, const char *pt)
+{
+    int length = strlen(pt);
+
+    if (length >= *spacePtr) {
+	if (*bufferPtr) {
+	    ckfree(*bufferPtr);
+	}
+	*spacePtr = length + 1;
+	*bufferPtr = (char *)ckalloc(*spacePtr);
+    }
+    memcpy(*bufferPtr, pt, length + 1);
+}
+
+/*
+ * Restore a key into the cipher and fetch its plaintext into
+ * statePtr->pt.  The cipher's own command procedure is called directly
+ * so that the key is handled just like "$cipher restore" would handle
+ * it from a script.
+ */
+
+int
+HillclimbDecipher(HillclimbState *statePtr, char *key)
+{
+    Tcl_Interp *interp = statePtr->interp;
+    CipherItem *cipherPtr = statePtr->cipherPtr;
+    const char *argv[5];
+    const char *pt;
+    int argc = 0;
+    int length;
+
+    argv[argc++] = statePtr->cipherCmd;
+    argv[argc++] = "restore";
+    argv[argc++] = key;
+    if (statePtr->keyForm == HILLCLIMB_KEY_PAIR) {
+	argv[argc++] = HillclimbKeyPart(statePtr, key, 1);
+    } else if (statePtr->keyForm == HILLCLIMB_KEY_GROMARK) {
+	argv[argc++] = ATOZ;
+    }
+    argv[argc] = (char *)NULL;
+
+    Tcl_ResetResult(interp);
+    if ((cipherPtr->typePtr->cmdProc)((ClientData)cipherPtr, interp, argc,
+		argv) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    argv[1] = "cget";
+    argv[2] = "-pt";
+    argv[3] = (char *)NULL;
+
+    Tcl_ResetResult(interp);
+    if ((cipherPtr->typePtr->cmdProc)((ClientData)cipherPtr, interp, 3,
+		argv) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    pt = Tcl_GetStringFromObj(Tcl_GetObjResult(interp), &length);
+    if (length >= statePtr->ptSpace) {
+	if (statePtr->pt) {
+	    ckfree(statePtr->pt);
+	    ckfree((char *)statePtr->positions);
+	}
+	statePtr->ptSpace = length + 1;
+	statePtr->pt = (char *)ckalloc(statePtr->ptSpace);
+	statePtr->positions = (int *)ckalloc(sizeof(int) * statePtr->ptSpace);
+    }
+    memcpy(statePtr->pt, pt, length + 1);
+    Tcl_ResetResult(interp);
+
+    return TCL_OK;
+}
+
+/*
+ * Score a whole plaintext, or rescore one that differs from oldPt at a
+ * few positions.  The score cache isn't thread safe, so searches running
+ * in worker threads call the scoring object directly.
+ */
+
+static int
+HillclimbValue(HillclimbState *statePtr, const char *pt, double *value)
+{
+    ScoreItem *itemPtr = statePtr->scorePtr;
+
+    if (statePtr->threadPtr) {
+	*value = (itemPtr->typePtr->valueProc)(statePtr->interp, itemPtr, pt);
+	return TCL_OK;
+    }
+
+    return ScoreObjectValue(statePtr->interp, itemPtr, pt, value);
+}
+
+static int
+HillclimbDeltaValue(HillclimbState *statePtr, const char *oldPt, const char *pt, double oldValue, int count, double *value)
+{
+    ScoreItem *itemPtr = statePtr->scorePtr;
+
+    if (statePtr->threadPtr) {
+	if (itemPtr->typePtr->deltaProc) {
+	    *value = (itemPtr->typePtr->deltaProc)(statePtr->interp, itemPtr,
+		    oldPt, pt, oldValue, statePtr->positions, count);
+	} else {
+	    *value = (itemPtr->typePtr->valueProc)(statePtr->interp, itemPtr,
+		    pt);
+	}
+	return TCL_OK;
+    }
+
+    return ScoreObjectDeltaValue(statePtr->interp, itemPtr, oldPt, pt,
+	    oldValue, statePtr->positions, count, value);
+}
+
+/*
+ * Score statePtr->pt.  If refPt is not NULL then it is a plaintext with a
+ * score of refValue, and the score is computed from the difference
+ * between the two when only a few letters have changed.
+ */
+
+int
+HillclimbScore(HillclimbState *statePtr, const char *refPt, double refValue, double *value)
+{
+    Tcl_Interp *interp = statePtr->interp;
+    const char *pt = statePtr->pt;
+    int length, count, i;
+
+    if (statePtr->scoreCmdObj) {
+	Tcl_Obj *objv[3];
+	int result;
+
+	objv[0] = statePtr->scoreCmdObj;
+	objv[1] = Tcl_NewStringObj("value", -1);
+	objv[2] = Tcl_NewStringObj(pt, -1);
+	Tcl_IncrRefCount(objv[1]);
+	Tcl_IncrRefCount(objv[2]);
+	result = Tcl_EvalObjv(interp, 3, objv, 0);
+	Tcl_DecrRefCount(objv[1]);
+	Tcl_DecrRefCount(objv[2]);
+
+	if (result != TCL_OK
+		|| Tcl_GetDoubleFromObj(interp, Tcl_GetObjResult(interp),
+		    value) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	Tcl_ResetResult(interp);
+
+	return TCL_OK;
+    }
+
+    length = strlen(pt);
+    if (refPt == NULL || strlen(refPt) != length) {
+	return HillclimbValue(statePtr, pt, value);
+    }
+
+    count = 0;
+    for (i=0; i < length; i++) {
+	if (pt[i] != refPt[i]) {
+	    statePtr->positions[count++] = i;
+	}
+    }
 
     /*
-     * Initialize 'swapKey' to be a duplicate of 'fixedKey'
+     * Rescoring the changed windows only pays off when most of the
+     * plaintext is the same.
      */
-    for (i=0; i < keyLength; i++) {
-        swapKey[i] = fixedKey[i];
-    }
-
-    for (i=0; i < keyLength; i++) {
-        if (!fixedIndices || fixedIndices[i] == '0') {
-            for (j=i+1; j < keyLength; j++) {
-                if (!fixedIndices || fixedIndices[j] == '0') {
-                    /*
-                     * Swap positions i and j
-                     */
-                    swapKey[i] = fixedKey[j];
-                    swapKey[j] = fixedKey[i];
-                    /*
-                     * Store swapKey in a new Tcl_Obj(string);
-                     */
-                    if (Tcl_ListObjAppendElement(interp, keyListObj, Tcl_NewStringObj(swapKey, keyLength)) != TCL_OK) {
-                        ckfree(swapKey);
-                        return (Tcl_Obj *)NULL;
-                    }
-                    /*
-                     * Undo the swap of positions i and j
-                     */
-                    swapKey[i] = fixedKey[i];
-                    swapKey[j] = fixedKey[j];
-                }
-            }
-        }
-    }
-    ckfree(swapKey);
-
-    return keyListObj;
+
+    if (count * 2 >= length) {
+	return HillclimbValue(statePtr, pt, value);
+    }
+
+    return HillclimbDeltaValue(statePtr, refPt, pt, refValue, count, value);
 }
-
+
+/*
+ * Run a callback with the key and any extra arguments appended to it.
+ */
+
+int
+HillclimbCallback(HillclimbState *statePtr, Tcl_Obj *cmdObj, char *key, int objc, Tcl_Obj **objv)
+{
+    Tcl_Interp *interp = statePtr->interp;
+    Tcl_Obj *scriptObj = Tcl_DuplicateObj(cmdObj);
+    int result;
+    int i;
+
+    Tcl_IncrRefCount(scriptObj);
+    result = Tcl_ListObjAppendElement(interp, scriptObj,
+	    HillclimbKeyObj(statePtr, key));
+    for (i=0; i < objc && result == TCL_OK; i++) {
+	result = Tcl_ListObjAppendElement(interp, scriptObj, objv[i]);
+    }
+    if (result == TCL_OK) {
+	result = Tcl_EvalObjEx(interp, scriptObj, TCL_EVAL_GLOBAL);
+    }
+    Tcl_DecrRefCount(scriptObj);
+
+    return result;
+}
+
+int
+HillclimbBestFit(HillclimbState *statePtr, char *key, long iteration, double value)
+{
+    Tcl_Obj *objv[2];
+
+    if (statePtr->threadPtr) {
+	return HillclimbThreadBestFit(statePtr, key, iteration, value);
+    }
+    if (statePtr->bestFitCmdObj == NULL) {
+	return TCL_OK;
+    }
+
+    objv[0] = Tcl_NewLongObj(iteration);
+    objv[1] = Tcl_NewDoubleObj(value);
+
+    return HillclimbCallback(statePtr, statePtr->bestFitCmdObj, key, 2, objv);
+}
+
+int
+HillclimbStep(HillclimbState *statePtr, char *key, long iteration)
+{
+    Tcl_Obj *objv[1];
+
+    if (statePtr->threadPtr) {
+	return HillclimbThreadStep(statePtr, key, iteration);
+    }
+    if (statePtr->stepCmdObj == NULL || statePtr->stepInterval <= 0
+	    || iteration % statePtr->stepInterval != 0) {
+	return TCL_OK;
+    }
+
+    objv[0] = Tcl_NewLongObj(iteration);
+
+    return HillclimbCallback(statePtr, statePtr->stepCmdObj, key, 1, objv);
+}
+
+/*
+ * Record an improvement of the best key.
+ */
+
+void
+HillclimbTraceAdd(HillclimbTrace *tracePtr, long iteration, double value)
+{
+    if (tracePtr->count == tracePtr->space) {
+	tracePtr->space = tracePtr->space * 2 + 16;
+	tracePtr->iterations = (long *)ckrealloc(
+		(char *)tracePtr->iterations, sizeof(long) * tracePtr->space);
+	tracePtr->values = (double *)ckrealloc((char *)tracePtr->values,
+		sizeof(double) * tracePtr->space);
+    }
+    tracePtr->iterations[tracePtr->count] = iteration;
+    tracePtr->values[tracePtr->count] = value;
+    tracePtr->count++;
+}
+
+/*
+ * Return a trace as a list of iteration and value pairs.
+ */
+
 Tcl_Obj *
-HillclimbKeysquareSwapNeighborKeys(Tcl_Interp *interp, char *fixedKey, char *fixedIndices) {
-    char *swapKey = (char *)NULL;
-    int i, j;
-    int rowLength = 0;
-    int keyLength = strlen(fixedKey);
-    Tcl_Obj *keyListObj = (Tcl_Obj *)NULL;
-
-    if (fixedIndices && strlen(fixedIndices) != 0 && strlen(fixedIndices) != keyLength) {
-        Tcl_SetResult(interp, "key and fixedIndices are not the same length", TCL_STATIC);
-        return (Tcl_Obj *)NULL;
+HillclimbTraceObj(HillclimbTrace *tracePtr)
+{
+    Tcl_Obj *traceObj = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+    int i;
+
+    for (i=0; i < tracePtr->count; i++) {
+	Tcl_Obj *pairObjs[2];
+
+	pairObjs[0] = Tcl_NewLongObj(tracePtr->iterations[i]);
+	pairObjs[1] = Tcl_NewDoubleObj(tracePtr->values[i]);
+	Tcl_ListObjAppendElement((Tcl_Interp *)NULL, traceObj,
+		Tcl_NewListObj(2, pairObjs));
+    }
+
+    return traceObj;
+}
+
+void
+HillclimbTraceFree(HillclimbTrace *tracePtr)
+{
+    if (tracePtr->iterations) {
+	ckfree((char *)tracePtr->iterations);
+	ckfree((char *)tracePtr->values);
+	tracePtr->iterations = (long *)NULL;
+	tracePtr->values = (double *)NULL;
+    }
+    tracePtr->count = tracePtr->space = 0;
+}
+
+void
+HillclimbCheckpointInit(HillclimbCheckpoint *cpPtr)
+{
+    cpPtr->fileName = (const char *)NULL;
+    cpPtr->resumeName = (const char *)NULL;
+    cpPtr->interval = CHECKPOINT_INTERVAL;
+    Tcl_GetTime(&cpPtr->last);
+}
+
+/*
+ * Handle the -checkpoint, -checkpointinterval, and -resume options for
+ * the searches that can be checkpointed.  Returns TCL_CONTINUE if the
+ * option isn't one of these.
+ */
+
+int
+HillclimbCheckpointOption(HillclimbState *statePtr, HillclimbCheckpoint *cpPtr, const char *option, Tcl_Obj *valueObj)
+{
+    Tcl_Interp *interp = statePtr->interp;
+
+    if (strcmp(option, "-checkpoint") == 0) {
+	cpPtr->fileName = Tcl_GetString(valueObj);
+    } else if (strcmp(option, "-resume") == 0) {
+	cpPtr->resumeName = Tcl_GetString(valueObj);
+    } else if (strcmp(option, "-checkpointinterval") == 0) {
+	if (Tcl_GetDoubleFromObj(interp, valueObj, &cpPtr->interval)
+		!= TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (cpPtr->interval < 0.0) {
+	    Tcl_SetResult(interp, "Checkpoint interval can't be negative",
+		    TCL_STATIC);
+	    return TCL_ERROR;
+	}
+    } else {
+	return TCL_CONTINUE;
     }
 
-    rowLength = (int) sqrt(keyLength);
     /*
-     * TODO:  Move this test to the command function
+     * An empty file name turns the option off.
      */
-    if (rowLength * rowLength != keyLength) {
-        char keyLengthString[32];
-        sprintf(keyLengthString, "%d", keyLength);
-        Tcl_AppendResult(interp, "key length is not a perfect square: ", keyLengthString, (char *)NULL);
-        return (Tcl_Obj *)NULL;
+
+    if (cpPtr->fileName && *cpPtr->fileName == '\0') {
+	cpPtr->fileName = (const char *)NULL;
+    }
+    if (cpPtr->resumeName && *cpPtr->resumeName == '\0') {
+	cpPtr->resumeName = (const char *)NULL;
+    }
+
+    return TCL_OK;
+}
+
+/*
+ * Start a checkpoint of a search with the state that every search
+ * shares:  the size of the key, the ciphertext, and the random number
+ * generator.
+ */
+
+void
+HillclimbCheckpointStart(HillclimbState *statePtr, Checkpoint *checkpointPtr, int kind)
+{
+    CheckpointInit(checkpointPtr, kind);
+    CheckpointPutInt(checkpointPtr, statePtr->keySize);
+    CheckpointPutText(checkpointPtr, statePtr->cipherPtr->ciphertext);
+    CheckpointPutInt(checkpointPtr, statePtr->seed);
+    CheckpointPutBytes(checkpointPtr, &statePtr->rand, sizeof(RandomState));
+}
+
+/*
+ * Read the checkpoint that a search resumes from, and restore the state
+ * saved by HillclimbCheckpointStart.  On success the caller reads the
+ * rest of its state and frees the checkpoint.
+ */
+
+int
+HillclimbCheckpointResume(HillclimbState *statePtr, HillclimbCheckpoint *cpPtr, Checkpoint *checkpointPtr, int kind)
+{
+    Tcl_Interp *interp = statePtr->interp;
+    Tcl_WideInt value;
+
+    if (CheckpointRead(interp, checkpointPtr, cpPtr->resumeName, kind)
+	    != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (CheckpointGetInt(interp, checkpointPtr, &value) != TCL_OK) {
+	goto error;
+    }
+    if (value != statePtr->keySize) {
+	CheckpointMismatch(interp, checkpointPtr);
+	goto error;
+    }
+    if (CheckpointCheckText(interp, checkpointPtr,
+		statePtr->cipherPtr->ciphertext) != TCL_OK
+	    || CheckpointGetInt(interp, checkpointPtr, &value) != TCL_OK
+	    || CheckpointGetBytes(interp, checkpointPtr, &statePtr->rand,
+		sizeof(RandomState)) != TCL_OK) {
+	goto error;
+    }
+    statePtr->seed = (long)value;
+    statePtr->haveSeed = 1;
+
+    return TCL_OK;
+
+error:
+    CheckpointFree(checkpointPtr);
+    return TCL_ERROR;
+}
+
+void
+HillclimbCheckpointPutTrace(Checkpoint *checkpointPtr, HillclimbTrace *tracePtr)
+{
+    int i;
+
+    CheckpointPutInt(checkpointPtr, tracePtr->count);
+    for (i=0; i < tracePtr->count; i++) {
+	CheckpointPutInt(checkpointPtr, tracePtr->iterations[i]);
+	CheckpointPutDouble(checkpointPtr, tracePtr->values[i]);
+    }
+}
+
+int
+HillclimbCheckpointGetTrace(HillclimbState *statePtr, Checkpoint *checkpointPtr, HillclimbTrace *tracePtr)
+{
+    Tcl_Interp *interp = statePtr->interp;
+    Tcl_WideInt count, iteration;
+    double value;
+    int i;
+
+    if (CheckpointGetInt(interp, checkpointPtr, &count) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    for (i=0; i < count; i++) {
+	if (CheckpointGetInt(interp, checkpointPtr, &iteration) != TCL_OK
+		|| CheckpointGetDouble(interp, checkpointPtr, &value)
+		    != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	HillclimbTraceAdd(tracePtr, (long)iteration, value);
+    }
+
+    return TCL_OK;
+}
+
+/*
+ * Start a walk over the moves in a random order.
+ */
+
+static void
+HillclimbShuffle(HillclimbState *statePtr, HillclimbCursor *cursorPtr)
+{
+    long count = statePtr->moves.count;
+    long stride = (long)(HillclimbRandom(statePtr) * count);
+    long start = (long)(HillclimbRandom(statePtr) * count);
+
+    HillclimbNeighborsFirst(&statePtr->moves, cursorPtr, stride, start);
+}
+
+/*
+ * Climb a single hill from maxKey, moving to the best neighbor of the
+ * current key until none of them is an improvement.  This is the C
+ * version of Hillclimb::start.  On return maxKey holds the best key, and
+ * the cipher is left with that key restored.
+ */
+
+static int
+HillclimbStart(HillclimbState *statePtr, char *maxKey, double *maxValuePtr, int haveValue)
+{
+    char *curKey = (char *)ckalloc(statePtr->keySize);
+    HillclimbCursor cursor;
+    HillclimbMove move;
+    char *maxPt = (char *)NULL;
+    char *curPt = (char *)NULL;
+    int maxPtSpace = 0;
+    int curPtSpace = 0;
+    double maxValue = *maxValuePtr;
+    double curValue, value;
+    long iteration = 0;
+    int maximaFound = 0;
+    int result = TCL_OK;
+
+    result = HillclimbDecipher(statePtr, maxKey);
+    if (result == TCL_OK && ! haveValue) {
+	result = HillclimbScore(statePtr, (char *)NULL, 0.0, &maxValue);
+    }
+    if (result == TCL_OK) {
+	HillclimbCopyPt(&maxPt, &maxPtSpace, statePtr->pt);
+	result = HillclimbBestFit(statePtr, maxKey, iteration, maxValue);
     }
 
-    swapKey = (char *)ckalloc((sizeof(char) * (keyLength+1)));
-    swapKey[keyLength] = '\0';
-    keyListObj = Tcl_NewObj();
+    while (result == TCL_OK && ! maximaFound) {
+	maximaFound = 1;
+	memcpy(curKey, maxKey, statePtr->keySize);
+	HillclimbCopyPt(&curPt, &curPtSpace, maxPt);
+	curValue = maxValue;
+
+	HillclimbShuffle(statePtr, &cursor);
+	while (result == TCL_OK && HillclimbNeighborsNext(&cursor, &move)) {
+	    iteration++;
+
+	    HillclimbApplyMove(&statePtr->moves, curKey, &move);
+	    result = HillclimbDecipher(statePtr, curKey);
+	    if (result == TCL_OK) {
+		result = HillclimbScore(statePtr, curPt, curValue, &value);
+	    }
+
+	    if (result == TCL_OK && value > maxValue) {
+		maximaFound = 0;
+		maxValue = value;
+		memcpy(maxKey, curKey, statePtr->keySize);
+		HillclimbCopyPt(&maxPt, &maxPtSpace, statePtr->pt);
+
+		result = HillclimbBestFit(statePtr, curKey, iteration, value);
+	    }
+
+	    if (result == TCL_OK) {
+		result = HillclimbStep(statePtr, curKey, iteration);
+	    }
+	    HillclimbUndoMove(&statePtr->moves, curKey, &move);
+	}
+    }
+
+    if (result == TCL_OK) {
+	result = HillclimbDecipher(statePtr, maxKey);
+    }
+
+    ckfree(curKey);
+    if (maxPt) {
+	ckfree(maxPt);
+    }
+    if (curPt) {
+	ckfree(curPt);
+    }
+
+    *maxValuePtr = maxValue;
+    return result;
+}
+
+/*
+ * Recursively climb every neighbor of key that is better than key.  This
+ * is the C version of Hillclimb::recstart.  The best key found is stored
+ * in maxKey.
+ */
+
+static int
+HillclimbRecurse(HillclimbState *statePtr, char *key, double keyValue, int depth, char *maxKey, double *maxValuePtr)
+{
+    Tcl_Interp *interp = statePtr->interp;
+    HillclimbNeighbors *nbPtr = &statePtr->moves;
+    HillclimbMove move;
+    char *neighborKey;
+    char *returnKey;
+    char *refPt = (char *)NULL;
+    int refPtSpace = 0;
+    double *values;
+    double maxValue = keyValue;
+    double value;
+    long iteration = 0;
+    int result = TCL_OK;
+    int i;
+
+    memcpy(maxKey, key, statePtr->keySize);
+    *maxValuePtr = keyValue;
+
+    if (statePtr->abortVarObj) {
+	Tcl_Obj *abortObj = Tcl_ObjGetVar2(interp, statePtr->abortVarObj,
+		(Tcl_Obj *)NULL, TCL_GLOBAL_ONLY);
+	int abort = 0;
+
+	if (abortObj && Tcl_GetBooleanFromObj(interp, abortObj, &abort)
+		!= TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (abort) {
+	    return TCL_OK;
+	}
+    }
+
+    if (HillclimbDecipher(statePtr, key) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    HillclimbCopyPt(&refPt, &refPtSpace, statePtr->pt);
+
+    neighborKey = (char *)ckalloc(statePtr->keySize);
+    returnKey = (char *)ckalloc(statePtr->keySize);
+    values = (double *)ckalloc(sizeof(double) * (nbPtr->count + 1));
+    memcpy(neighborKey, key, statePtr->keySize);
 
     /*
-     * Initialize 'swapKey' to be a duplicate of 'fixedKey'
+     * Score every neighbor before climbing any of them, since climbing
+     * changes the state of the cipher.
      */
-    for (i=0; i < keyLength; i++) {
-        swapKey[i] = fixedKey[i];
-    }
-
-    for (i=0; i < keyLength; i++) {
-        if (!fixedIndices || fixedIndices[i] == '0') {
-            for (j=i+1; j < keyLength; j++) {
-                if (!fixedIndices || fixedIndices[j] == '0') {
-                    if (i%rowLength == j%rowLength || i/rowLength == j/rowLength) {
-                        /*
-                         * Swap positions i and j
-                         */
-                        swapKey[i] = fixedKey[j];
-                        swapKey[j] = fixedKey[i];
-                        /*
-                         * Store swapKey in a new Tcl_Obj(string);
-                         */
-                        if (Tcl_ListObjAppendElement(interp, keyListObj,
-                                    Tcl_NewStringObj(swapKey, keyLength))
-                                != TCL_OK) {
-                            ckfree(swapKey);
-                            return (Tcl_Obj *)NULL;
-                        }
-                        /*
-                         * Undo the swap of positions i and j
-                         */
-                        swapKey[i] = fixedKey[i];
-                        swapKey[j] = fixedKey[j];
-                    }
-                }
-            }
-        }
-    }
-    ckfree(swapKey);
-
-    return keyListObj;
+
+    for (i=0; i < nbPtr->count && result == TCL_OK; i++) {
+	HillclimbNeighborsMove(nbPtr, i, &move);
+	HillclimbApplyMove(nbPtr, neighborKey, &move);
+	result = HillclimbDecipher(statePtr, neighborKey);
+	if (result == TCL_OK) {
+	    result = HillclimbScore(statePtr, refPt, keyValue, values + i);
+	}
+	HillclimbUndoMove(nbPtr, neighborKey, &move);
+    }
+
+    for (i=0; i < nbPtr->count && result == TCL_OK; i++) {
+	iteration++;
+	HillclimbNeighborsMove(nbPtr, i, &move);
+	HillclimbApplyMove(nbPtr, neighborKey, &move);
+
+	if (values[i] > keyValue) {
+	    result = HillclimbRecurse(statePtr, neighborKey, values[i],
+		    depth + 1, returnKey, &value);
+
+	    if (result == TCL_OK && value > maxValue) {
+		if (statePtr->registerCmdObj) {
+		    Tcl_Obj *objv[5];
+
+		    result = HillclimbDecipher(statePtr, returnKey);
+		    if (result == TCL_OK) {
+			objv[0] = Tcl_NewStringObj(statePtr->pt, -1);
+			objv[1] = Tcl_NewDoubleObj(value);
+			objv[2] = Tcl_NewDoubleObj(keyValue);
+			objv[3] = Tcl_NewIntObj(depth);
+			objv[4] = Tcl_NewLongObj(iteration);
+			result = HillclimbCallback(statePtr,
+				statePtr->registerCmdObj, returnKey, 5, objv);
+		    }
+		}
+
+		maxValue = value;
+		memcpy(maxKey, returnKey, statePtr->keySize);
+	    }
+
+	    if (result == TCL_OK) {
+		result = HillclimbBestFit(statePtr, neighborKey, iteration,
+			value);
+	    }
+	}
+
+	if (result == TCL_OK) {
+	    result = HillclimbStep(statePtr, neighborKey, iteration);
+	}
+	HillclimbUndoMove(nbPtr, neighborKey, &move);
+    }
+
+    ckfree(neighborKey);
+    ckfree(returnKey);
+    ckfree((char *)values);
+    ckfree(refPt);
+
+    *maxValuePtr = maxValue;
+    return result;
 }
-
-Tcl_Obj *
-HillclimbRandomizeList(Tcl_Interp *interp, Tcl_Obj *listObj) {
-    int listLength;
+
+/*
+ * Run one restart of Hillclimb::climb.
+ */
+
+static int
+HillclimbClimbRun(HillclimbState *statePtr, char *key, char *maxKey, double *maxValuePtr)
+{
+    memcpy(maxKey, key, statePtr->keySize);
+    *maxValuePtr = 0.0;
+
+    return HillclimbStart(statePtr, maxKey, maxValuePtr, 0);
+}
+
+/*
+ * Set up the state for a native search on the cipher named by cipherObj.
+ * cipherObj may be NULL if the state is only used to generate neighbors.
+ */
+
+int
+HillclimbInitState(Tcl_Interp *interp, Tcl_Obj *cipherObj, HillclimbState *statePtr)
+{
+    memset(statePtr, 0, sizeof(HillclimbState));
+    statePtr->interp = interp;
+    statePtr->keyForm = HILLCLIMB_KEY_SIMPLE;
+    statePtr->neighbors = HILLCLIMB_SWAP_GENERIC;
+    statePtr->scoreName = "score";
+    statePtr->moveKinds = HILLCLIMB_MOVE_SWAP;
+    statePtr->threads = 1;
+    statePtr->restarts = 1;
+
+    if (cipherObj == NULL) {
+	return TCL_OK;
+    }
+    statePtr->cipherCmd = Tcl_GetString(cipherObj);
+    statePtr->cipherPtr = GetCipherItem(interp, statePtr->cipherCmd);
+    if (statePtr->cipherPtr == NULL) {
+	return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+
+/*
+ * Handle one of the options that are shared by all of the native search
+ * commands.  Returns TCL_CONTINUE if the option isn't one of them.
+ */
+
+int
+HillclimbStateOption(HillclimbState *statePtr, const char *option, Tcl_Obj *valueObj)
+{
+    Tcl_Interp *interp = statePtr->interp;
+
+    if (strcmp(option, "-score") == 0) {
+	statePtr->scoreName = Tcl_GetString(valueObj);
+    } else if (strcmp(option, "-keyform") == 0) {
+	if (Tcl_GetIndexFromObj(interp, valueObj, hillclimbKeyForms,
+		    "key form", 0, &statePtr->keyForm) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+    } else if (strcmp(option, "-neighbors") == 0) {
+	if (Tcl_GetIndexFromObj(interp, valueObj, hillclimbNeighbors,
+		    "neighbor type", 0, &statePtr->neighbors) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+    } else if (strcmp(option, "-fixed") == 0) {
+	statePtr->fixedObj = valueObj;
+    } else if (strcmp(option, "-moves") == 0) {
+	if (HillclimbGetMoveKinds(interp, valueObj, &statePtr->moveKinds)
+		!= TCL_OK) {
+	    return TCL_ERROR;
+	}
+    } else if (strcmp(option, "-stepinterval") == 0) {
+	if (Tcl_GetLongFromObj(interp, valueObj, &statePtr->stepInterval)
+		!= TCL_OK) {
+	    return TCL_ERROR;
+	}
+    } else if (strcmp(option, "-stepcommand") == 0) {
+	statePtr->stepCmdObj = valueObj;
+    } else if (strcmp(option, "-bestfitcommand") == 0) {
+	statePtr->bestFitCmdObj = valueObj;
+    } else if (strcmp(option, "-seed") == 0) {
+	if (Tcl_GetLongFromObj(interp, valueObj, &statePtr->seed) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	statePtr->haveSeed = 1;
+    } else if (strcmp(option, "-threads") == 0) {
+	if (Tcl_GetIntFromObj(interp, valueObj, &statePtr->threads)
+		!= TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (statePtr->threads < 1) {
+	    Tcl_SetResult(interp, "Threads must be at least 1", TCL_STATIC);
+	    return TCL_ERROR;
+	}
+    } else if (strcmp(option, "-restarts") == 0) {
+	if (Tcl_GetLongFromObj(interp, valueObj, &statePtr->restarts)
+		!= TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (statePtr->restarts < 1) {
+	    Tcl_SetResult(interp, "Restarts must be at least 1", TCL_STATIC);
+	    return TCL_ERROR;
+	}
+    } else {
+	return TCL_CONTINUE;
+    }
+
+    return TCL_OK;
+}
+
+/*
+ * Finish setting up the state once all of the options have been read:
+ * look up the scoring command, split the starting key into its parts and
+ * set up its neighbors.  The starting key is returned in a newly
+ * allocated buffer that the caller must free.
+ */
+
+int
+HillclimbPrepare(HillclimbState *statePtr, Tcl_Obj *keyObj, char **keyPtr)
+{
+    Tcl_Interp *interp = statePtr->interp;
+    const char *scoreCmd = statePtr->scoreName;
+
+    /*
+     * Empty commands turn the callbacks off, just like the Tcl
+     * variables that they replace.
+     */
+
+    if (statePtr->stepCmdObj && Tcl_GetCharLength(statePtr->stepCmdObj) == 0) {
+	statePtr->stepCmdObj = (Tcl_Obj *)NULL;
+    }
+    if (statePtr->bestFitCmdObj
+	    && Tcl_GetCharLength(statePtr->bestFitCmdObj) == 0) {
+	statePtr->bestFitCmdObj = (Tcl_Obj *)NULL;
+    }
+    if (statePtr->registerCmdObj
+	    && Tcl_GetCharLength(statePtr->registerCmdObj) == 0) {
+	statePtr->registerCmdObj = (Tcl_Obj *)NULL;
+    }
+    if (statePtr->abortVarObj
+	    && Tcl_GetCharLength(statePtr->abortVarObj) == 0) {
+	statePtr->abortVarObj = (Tcl_Obj *)NULL;
+    }
+
+    if (strcmp(scoreCmd, "score") != 0) {
+	Tcl_CmdInfo cmdInfo;
+
+	if (Tcl_GetCommandInfo(interp, scoreCmd, &cmdInfo) != 1) {
+	    Tcl_AppendResult(interp, "Command '", scoreCmd, "' not found.",
+		    (char *)NULL);
+	    return TCL_ERROR;
+	}
+
+	statePtr->scorePtr = GetInternalScore(interp, scoreCmd);
+	if (statePtr->scorePtr == NULL) {
+	    Tcl_ResetResult(interp);
+	    statePtr->scoreCmdObj = Tcl_NewStringObj(scoreCmd, -1);
+	    Tcl_IncrRefCount(statePtr->scoreCmdObj);
+	}
+    }
+
+    if (HillclimbPrepareKey(statePtr, keyObj, keyPtr) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    HillclimbPrepareSeed(statePtr);
+
+    return TCL_OK;
+}
+
+/*
+ * Seed the search's random number generator with the -seed option, or
+ * with a random seed if there wasn't one.
+ */
+
+void
+HillclimbPrepareSeed(HillclimbState *statePtr)
+{
+    if (! statePtr->haveSeed) {
+	statePtr->seed = RandomNewSeed();
+    }
+    HillclimbSeed(statePtr, statePtr->seed);
+}
+
+/*
+ * Split a key into its parts and set up its neighbors.  The key is
+ * returned in a newly allocated buffer that the caller must free.
+ */
+
+int
+HillclimbPrepareKey(HillclimbState *statePtr, Tcl_Obj *keyObj, char **keyPtr)
+{
+    Tcl_Interp *interp = statePtr->interp;
+    const char *parts[2];
+    char fullKey[27];
+    char *key;
+    int part;
+
+    if ((statePtr->neighbors == HILLCLIMB_SWAP_ARISTOCRAT
+		|| statePtr->neighbors == HILLCLIMB_SWAP_TWOSQUARE)
+	    != (statePtr->keyForm == HILLCLIMB_KEY_PAIR)) {
+	Tcl_SetResult(interp,
+		"Only aristocrat and twosquare neighbors can be used with pair keys",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    if (statePtr->keyForm == HILLCLIMB_KEY_PAIR) {
+	Tcl_Obj **elemObjs;
+	int elemCount;
+
+	if (Tcl_ListObjGetElements(interp, keyObj, &elemCount, &elemObjs)
+		!= TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (elemCount != 2) {
+	    Tcl_SetResult(interp, "Pair keys must have two elements",
+		    TCL_STATIC);
+	    return TCL_ERROR;
+	}
+	parts[0] = Tcl_GetString(elemObjs[0]);
+	parts[1] = Tcl_GetString(elemObjs[1]);
+	statePtr->partCount = 2;
+    } else {
+	parts[0] = Tcl_GetString(keyObj);
+	statePtr->partCount = 1;
+    }
+
+    if (statePtr->neighbors == HILLCLIMB_SWAP_ARISTOCRAT) {
+	if (KeyGenerateK1(interp, parts[1], fullKey) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	parts[1] = fullKey;
+    }
+
+    statePtr->keySize = 0;
+    for (part=0; part < statePtr->partCount; part++) {
+	statePtr->partLength[part] = strlen(parts[part]);
+	statePtr->keySize += statePtr->partLength[part] + 1;
+    }
+
+    if (HillclimbNeighborsInit(interp, &statePtr->moves, statePtr->neighbors,
+		statePtr->moveKinds, statePtr->partLength, statePtr->fixedObj)
+	    != TCL_OK) {
+	HillclimbNeighborsFree(&statePtr->moves);
+	return TCL_ERROR;
+    }
+
+    key = (char *)ckalloc(statePtr->keySize);
+    for (part=0; part < statePtr->partCount; part++) {
+	memcpy(HillclimbKeyPart(statePtr, key, part), parts[part],
+		statePtr->partLength[part] + 1);
+    }
+
+    *keyPtr = key;
+    return TCL_OK;
+}
+
+void
+HillclimbFreeState(HillclimbState *statePtr)
+{
+    HillclimbNeighborsFree(&statePtr->moves);
+    if (statePtr->pt) {
+	ckfree(statePtr->pt);
+	ckfree((char *)statePtr->positions);
+	statePtr->pt = (char *)NULL;
+    }
+    if (statePtr->scoreCmdObj) {
+	Tcl_DecrRefCount(statePtr->scoreCmdObj);
+	statePtr->scoreCmdObj = (Tcl_Obj *)NULL;
+    }
+}
+
+/*
+ * Hillclimb::climb cipher key ?options?
+ *
+ *	Climb from a key entirely in C.  Returns a list of the best key
+ *	found and its score, and leaves the cipher with the best key
+ *	restored.  See doc/Hillclimb/package.tml for the options.
+ */
+
+int
+HillclimbClimbObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
+{
+    HillclimbState state;
+    Tcl_Obj *resultObjs[2];
+    char *key = (char *)NULL;
+    char *maxKey;
+    double value = 0.0;
+    double maxValue = 0.0;
+    int haveValue = 0;
+    int recursive = 0;
+    int depth = 0;
+    int result = TCL_OK;
     int i;
-    double randomValue;
-    long int randomIndex;
-    Tcl_Obj *tempObj;
-    Tcl_Obj *newList = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
-
-    srand48((long int) time(NULL));
-
-    Tcl_ListObjLength(interp, listObj, &listLength);
-    for (i=0; i < listLength; i++) {
-        randomValue = drand48();
-        randomIndex = (int) (randomValue * (i+1));
-        /*
-        fprintf(stderr, "%g * %d = %d\n", randomValue, i+1, randomIndex);
-        */
-        if ( Tcl_ListObjIndex(interp, listObj, i, &tempObj) != TCL_OK) {
-            return (Tcl_Obj *)NULL;
-        }
-        Tcl_ListObjReplace(interp, newList, randomIndex, 0, 1, &tempObj);
+
+    if (objc < 3 || objc % 2 == 0) {
+	Tcl_AppendResult(interp, "Usage:  ", Tcl_GetString(objv[0]),
+		" cipher key ?option value ...?", (char *)NULL);
+	return TCL_ERROR;
     }
 
-    return newList;
+    if (HillclimbInitState(interp, objv[1], &state) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    for (i=3; i < objc; i += 2) {
+	const char *option = Tcl_GetString(objv[i]);
+
+	result = HillclimbStateOption(&state, option, objv[i+1]);
+	if (result == TCL_ERROR) {
+	    return TCL_ERROR;
+	} else if (result == TCL_OK) {
+	    continue;
+	}
+	result = TCL_OK;
+
+	if (strcmp(option, "-registercommand") == 0) {
+	    state.registerCmdObj = objv[i+1];
+	} else if (strcmp(option, "-abortvariable") == 0) {
+	    state.abortVarObj = objv[i+1];
+	} else if (strcmp(option, "-recursive") == 0) {
+	    if (Tcl_GetBooleanFromObj(interp, objv[i+1], &recursive)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-value") == 0) {
+	    if (Tcl_GetDoubleFromObj(interp, objv[i+1], &value) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    haveValue = 1;
+	} else if (strcmp(option, "-depth") == 0) {
+	    if (Tcl_GetIntFromObj(interp, objv[i+1], &depth) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else {
+	    Tcl_AppendResult(interp, "Unknown option ", option, (char *)NULL);
+	    return TCL_ERROR;
+	}
+    }
+
+    if (HillclimbPrepare(&state, objv[2], &key) != TCL_OK) {
+	HillclimbFreeState(&state);
+	return TCL_ERROR;
+    }
+    maxKey = (char *)ckalloc(state.keySize);
+
+    if (state.restarts > 1 || state.threads > 1) {
+	char *restarts;
+	int best;
+
+	if (recursive) {
+	    Tcl_SetResult(interp,
+		    "Recursive climbs can't use -threads or -restarts",
+		    TCL_STATIC);
+	    result = TCL_ERROR;
+	} else {
+	    result = HillclimbRunRestarts(&state, sizeof(HillclimbState),
+		    HillclimbClimbRun, key, maxKey, &maxValue, &restarts,
+		    &best);
+	    HillclimbFreeRestarts(&state, sizeof(HillclimbState), restarts);
+	}
+    } else if (recursive) {
+	if (! haveValue) {
+	    result = HillclimbDecipher(&state, key);
+	    if (result == TCL_OK) {
+		result = HillclimbScore(&state, (char *)NULL, 0.0, &value);
+	    }
+	}
+	if (result == TCL_OK) {
+	    result = HillclimbRecurse(&state, key, value, depth, maxKey,
+		    &maxValue);
+	}
+    } else {
+	memcpy(maxKey, key, state.keySize);
+	maxValue = value;
+	result = HillclimbStart(&state, maxKey, &maxValue, haveValue);
+    }
+
+    if (result == TCL_OK) {
+	resultObjs[0] = HillclimbKeyObj(&state, maxKey);
+	resultObjs[1] = Tcl_NewDoubleObj(maxValue);
+	Tcl_SetObjResult(interp, Tcl_NewListObj(2, resultObjs));
+    }
+
+    ckfree(key);
+    ckfree(maxKey);
+    HillclimbFreeState(&state);
+
+    return result;
 }
@@ -24,13 +24,278 @@
 #ifndef _HILLCLIMB_H_INCLUDED
 #define _HILLCLIMB_H_INCLUDED
 
+#include "cipher.h"
+#include "score.h"
+#include "cipherRandom.h"
+#include "checkpoint.h"
+
 int	HillclimbGenerateSwapNeighborKeysObjCmd _ANSI_ARGS_((ClientData, Tcl_Interp *, int, Tcl_Obj *CONST[]));
 int	HillclimbAristocratSwapNeighborKeysObjCmd _ANSI_ARGS_((ClientData, Tcl_Interp *, int, Tcl_Obj *CONST[]));
 int	HillclimbKeysquareSwapNeighborKeysObjCmd _ANSI_ARGS_((ClientData, Tcl_Interp *, int, Tcl_Obj *CONST[]));
 int	HillclimbRandomizeListObjCmd _ANSI_ARGS_((ClientData, Tcl_Interp *, int, Tcl_Obj *CONST[]));
+int	HillclimbClimbObjCmd _ANSI_ARGS_((ClientData, Tcl_Interp *, int, Tcl_Obj *CONST[]));
+int	HillclimbAnnealObjCmd _ANSI_ARGS_((ClientData, Tcl_Interp *, int, Tcl_Obj *CONST[]));
+int	HillclimbGeneticObjCmd _ANSI_ARGS_((ClientData, Tcl_Interp *, int, Tcl_Obj *CONST[]));
+int	HillclimbTemperingObjCmd _ANSI_ARGS_((ClientData, Tcl_Interp *, int, Tcl_Obj *CONST[]));
+int	HillclimbTabuObjCmd _ANSI_ARGS_((ClientData, Tcl_Interp *, int, Tcl_Obj *CONST[]));
+int	HillclimbKeywordClimbObjCmd _ANSI_ARGS_((ClientData, Tcl_Interp *, int, Tcl_Obj *CONST[]));
+int	HillclimbNeighborsObjCmd _ANSI_ARGS_((ClientData, Tcl_Interp *, int, Tcl_Obj *CONST[]));
+int	HillclimbKeywordsObjCmd _ANSI_ARGS_((ClientData, Tcl_Interp *, int, Tcl_Obj *CONST[]));
 
 Tcl_Obj *HillclimbGenerateSwapNeighborKeys _ANSI_ARGS_((Tcl_Interp *, char *, char *));
 Tcl_Obj *HillclimbKeysquareSwapNeighborKeys _ANSI_ARGS_((Tcl_Interp *, char *, char *));
 Tcl_Obj *HillclimbRandomizeList _ANSI_ARGS_((Tcl_Interp *, Tcl_Obj *));
 
+/*
+ * The native hill climber.  A key is made up of one or two parts, and
+ * every neighbor of a key is made by one move within one of its parts.
+ * Moves are generated one at a time by hillclimbNeighbors.c, so no list of
+ * neighbor keys is ever built.  Both parts of a key are kept in one
+ * buffer, with the second part starting right after the terminating null
+ * of the first.
+ */
+
+#define HILLCLIMB_MOVE_SWAP	1	/* Swap two letters. */
+#define HILLCLIMB_MOVE_INSERT	2	/* Move a letter to another position. */
+#define HILLCLIMB_MOVE_REVERSE	4	/* Reverse a run of letters. */
+
+/*
+ * A move.  first and second are indexes into the part's list of positions
+ * that can change, not positions in the key.
+ */
+
+typedef struct HillclimbMove {
+    int kind;			/* One of the HILLCLIMB_MOVE_* values. */
+    int part;
+    int first;
+    int second;
+} HillclimbMove;
+
+/*
+ * The moves that can be made from a key.  Each move has an index from 0
+ * to count-1 that it can be decoded from.  This is only read once it has
+ * been set up, so searches in several threads can share it.
+ */
+
+typedef struct HillclimbNeighbors {
+    int kinds;			/* HILLCLIMB_MOVE_* values or'ed together. */
+    int partOffset[2];
+    int *free[2];		/* The positions of each part that aren't
+				 * fixed. */
+    int freeCount[2];
+    int *pairs[2];		/* If not NULL, the only pairs of free
+				 * positions that can be swapped. */
+    int pairCount[2];
+    long count;
+} HillclimbNeighbors;
+
+/*
+ * A position in a walk over every move.  Index (start + i*stride) mod
+ * count is visited on the i-th step.
+ */
+
+typedef struct HillclimbCursor {
+    HillclimbNeighbors *nbPtr;
+    long stride;
+    long start;
+    long visited;
+} HillclimbCursor;
+
+/*
+ * The iteration and value of every improvement of a search's best key.
+ * These are plain arrays rather than a Tcl list since the search may run
+ * in a worker thread.
+ */
+
+typedef struct HillclimbTrace {
+    long *iterations;
+    double *values;
+    int count;
+    int space;
+} HillclimbTrace;
+
+/*
+ * Where a search writes its checkpoints, and the checkpoint that it
+ * resumes from.
+ */
+
+typedef struct HillclimbCheckpoint {
+    const char *fileName;
+    const char *resumeName;
+    double interval;		/* Seconds between checkpoints. */
+    Tcl_Time last;		/* When the last checkpoint was written. */
+} HillclimbCheckpoint;
+
+struct HillclimbThreadInfo;
+
+typedef struct HillclimbState {
+    Tcl_Interp *interp;
+    CipherItem *cipherPtr;
+    const char *cipherCmd;
+    int keyForm;		/* One of the HILLCLIMB_KEY_* values. */
+    int neighbors;		/* One of the HILLCLIMB_SWAP_* values. */
+    Tcl_Obj *fixedObj;		/* Key positions that can't be swapped. */
+    const char *scoreName;
+    int partCount;
+    int partLength[2];
+    int keySize;
+
+    /*
+     * Plaintexts are scored with scorePtr, or the default scoring table
+     * if scorePtr is NULL, unless scoreCmdObj names a custom scoring
+     * command.
+     */
+
+    ScoreItem *scorePtr;
+    Tcl_Obj *scoreCmdObj;
+
+    int moveKinds;		/* HILLCLIMB_MOVE_* values or'ed together. */
+    HillclimbNeighbors moves;
+
+    long stepInterval;
+    Tcl_Obj *stepCmdObj;
+    Tcl_Obj *bestFitCmdObj;
+    Tcl_Obj *registerCmdObj;
+    Tcl_Obj *abortVarObj;
+
+    /*
+     * The plaintext of the last key that was deciphered, and room for
+     * the positions where it differs from a reference plaintext.
+     */
+
+    char *pt;
+    int *positions;
+    int ptSpace;
+
+    /*
+     * Every search has its own random number generator so that a seeded
+     * search can be repeated exactly.
+     */
+
+    long seed;
+    int haveSeed;
+    RandomState rand;
+
+    /*
+     * Independent restarts from random keys, optionally spread over
+     * several threads.  threadPtr is set while a restart runs in a
+     * worker thread.
+     */
+
+    int threads;
+    long restarts;
+    struct HillclimbThreadInfo *threadPtr;
+} HillclimbState;
+
+/*
+ * Run one search from key, leaving the best key in maxKey.  statePtr
+ * points to the HillclimbState at the start of the search's own state.
+ */
+
+typedef int	HillclimbRunProc _ANSI_ARGS_((HillclimbState *, char *, char *,
+		double *));
+
+#define HILLCLIMB_KEY_SIMPLE	0	/* $cipher restore $key */
+#define HILLCLIMB_KEY_PAIR	1	/* $cipher restore [lindex $key 0] [lindex $key 1] */
+#define HILLCLIMB_KEY_GROMARK	2	/* $cipher restore $key abcd...z */
+
+#define HILLCLIMB_SWAP_GENERIC		0
+#define HILLCLIMB_SWAP_KEYSQUARE	1
+#define HILLCLIMB_SWAP_ARISTOCRAT	2
+#define HILLCLIMB_SWAP_TWOSQUARE	3
+
+int	HillclimbInitState _ANSI_ARGS_((Tcl_Interp *, Tcl_Obj *, HillclimbState *));
+int	HillclimbStateOption _ANSI_ARGS_((HillclimbState *, const char *, Tcl_Obj *));
+int	HillclimbPrepare _ANSI_ARGS_((HillclimbState *, Tcl_Obj *, char **));
+int	HillclimbPrepareKey _ANSI_ARGS_((HillclimbState *, Tcl_Obj *, char **));
+void	HillclimbPrepareSeed _ANSI_ARGS_((HillclimbState *));
+void	HillclimbFreeState _ANSI_ARGS_((HillclimbState *));
+void	HillclimbSeed _ANSI_ARGS_((HillclimbState *, long));
+double	HillclimbRandom _ANSI_ARGS_((HillclimbState *));
+char	*HillclimbKeyPart _ANSI_ARGS_((HillclimbState *, char *, int));
+Tcl_Obj	*HillclimbKeyObj _ANSI_ARGS_((HillclimbState *, char *));
+void	HillclimbRandomMove _ANSI_ARGS_((HillclimbState *, HillclimbMove *));
+void	HillclimbCopyPt _ANSI_ARGS_((char **, int *, const char *));
+int	HillclimbDecipher _ANSI_ARGS_((HillclimbState *, char *));
+int	HillclimbScore _ANSI_ARGS_((HillclimbState *, const char *, double,
+		double *));
+int	HillclimbCallback _ANSI_ARGS_((HillclimbState *, Tcl_Obj *, char *,
+		int, Tcl_Obj **));
+int	HillclimbBestFit _ANSI_ARGS_((HillclimbState *, char *, long, double));
+void	HillclimbTraceAdd _ANSI_ARGS_((HillclimbTrace *, long, double));
+Tcl_Obj	*HillclimbTraceObj _ANSI_ARGS_((HillclimbTrace *));
+void	HillclimbTraceFree _ANSI_ARGS_((HillclimbTrace *));
+int	HillclimbStep _ANSI_ARGS_((HillclimbState *, char *, long));
+void	HillclimbCheckpointInit _ANSI_ARGS_((HillclimbCheckpoint *));
+int	HillclimbCheckpointOption _ANSI_ARGS_((HillclimbState *,
+		HillclimbCheckpoint *, const char *, Tcl_Obj *));
+void	HillclimbCheckpointStart _ANSI_ARGS_((HillclimbState *, Checkpoint *,
+		int));
+int	HillclimbCheckpointResume _ANSI_ARGS_((HillclimbState *,
+		HillclimbCheckpoint *, Checkpoint *, int));
+void	HillclimbCheckpointPutTrace _ANSI_ARGS_((Checkpoint *,
+		HillclimbTrace *));
+int	HillclimbCheckpointGetTrace _ANSI_ARGS_((HillclimbState *,
+		Checkpoint *, HillclimbTrace *));
+
+/*
+ * Temperatures for the annealing searches, in anneal.c.
+ */
+
+int	HillclimbEstimateTemperature _ANSI_ARGS_((HillclimbState *, char *,
+		const char *, double, double, long *, double *));
+
+/*
+ * Neighbors, in hillclimbNeighbors.c.
+ */
+
+int	HillclimbGetMoveKinds _ANSI_ARGS_((Tcl_Interp *, Tcl_Obj *, int *));
+int	HillclimbNeighborsInit _ANSI_ARGS_((Tcl_Interp *, HillclimbNeighbors *,
+		int, int, const int *, Tcl_Obj *));
+void	HillclimbNeighborsFree _ANSI_ARGS_((HillclimbNeighbors *));
+void	HillclimbNeighborsMove _ANSI_ARGS_((HillclimbNeighbors *, long,
+		HillclimbMove *));
+void	HillclimbNeighborsFirst _ANSI_ARGS_((HillclimbNeighbors *,
+		HillclimbCursor *, long, long));
+int	HillclimbNeighborsNext _ANSI_ARGS_((HillclimbCursor *, HillclimbMove *));
+void	HillclimbApplyMove _ANSI_ARGS_((HillclimbNeighbors *, char *,
+		HillclimbMove *));
+void	HillclimbUndoMove _ANSI_ARGS_((HillclimbNeighbors *, char *,
+		HillclimbMove *));
+Tcl_Obj	*HillclimbNeighborList _ANSI_ARGS_((Tcl_Interp *, HillclimbState *,
+		char *));
+
+/*
+ * Restarts, in hillclimbThread.c.  HillclimbRunRestarts() makes a copy
+ * of the stateSize bytes of state for every restart, runs them, and
+ * returns the copies along with the index of the one that found the best
+ * key.  The copies must be released with HillclimbFreeRestarts().
+ */
+
+int	HillclimbRunRestarts _ANSI_ARGS_((HillclimbState *, int,
+		HillclimbRunProc *, char *, char *, double *, char **, int *));
+void	HillclimbFreeRestarts _ANSI_ARGS_((HillclimbState *, int, char *));
+int	HillclimbThreadBestFit _ANSI_ARGS_((HillclimbState *, char *, long,
+		double));
+int	HillclimbThreadStep _ANSI_ARGS_((HillclimbState *, char *, long));
+
+/*
+ * A pool of threads for running batches of tasks, also in
+ * hillclimbThread.c.  A task is given the search state of the thread
+ * that runs it and its index in the batch.
+ */
+
+typedef struct HillclimbPool HillclimbPool;
+
+typedef int	HillclimbTaskProc _ANSI_ARGS_((HillclimbState *, int,
+		ClientData));
+
+int	HillclimbPoolCreate _ANSI_ARGS_((HillclimbState *, int,
+		HillclimbPool **));
+int	HillclimbPoolRun _ANSI_ARGS_((HillclimbPool *, int,
+		HillclimbTaskProc *, ClientData));
+int	HillclimbPoolScore _ANSI_ARGS_((HillclimbPool *, char *, int,
+		double *));
+void	HillclimbPoolDelete _ANSI_ARGS_((HillclimbPool *));
+
 #endif /* _HILLCLIMB_H_INCLUDED */
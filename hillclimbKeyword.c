@@ -0,0 +1,649 @@
+/*
+ * hillclimbKeyword.c --
+ *
+ *	This file searches the space of keywords instead of the space of
+ *	full keys.  A neighbor of a keyword is one edit away from it:  a
+ *	letter inserted, deleted, replaced by another letter, or swapped
+ *	with the letter after it.  Each neighbor is expanded straight into
+ *	a full key with KeyGenerateK1, in one of these forms:
+ *
+ *	k1		{abcdefghijklmnopqrstuvwxyz K1}, as for aristocrats.
+ *	k2		{K1 abcdefghijklmnopqrstuvwxyz}
+ *	k3		{K1 K1}
+ *	alphabet	The K1 alphabet on its own.
+ *	keysquare	The K1 alphabet without j.
+ *
+ *	Many edits give the same key, such as adding a letter to the end
+ *	of a keyword when it already comes next in the alphabet, so every
+ *	full key is kept in a hash table and only scored the first time it
+ *	is seen.
+ *
+ * Copyright (c) 2008 Michael Thomas <wart@kobold.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <tcl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "hillclimb.h"
+#include "keygen.h"
+
+#define KEYWORD_K1		0
+#define KEYWORD_K2		1
+#define KEYWORD_K3		2
+#define KEYWORD_ALPHABET	3
+#define KEYWORD_KEYSQUARE	4
+
+static const char *keywordForms[] = {"k1", "k2", "k3", "alphabet",
+    "keysquare", NULL};
+
+#define KEYWORD_INSERT		1
+#define KEYWORD_DELETE		2
+#define KEYWORD_REPLACE		4
+#define KEYWORD_TRANSPOSE	8
+
+static const char *keywordEdits[] = {"insert", "delete", "replace",
+    "transpose", NULL};
+
+/*
+ * Keywords are reduced to their distinct letters, so they hold at most
+ * 26 letters, and an insert makes one letter more.  An expanded key is
+ * at most two alphabets separated by a space.
+ */
+
+#define KEYWORD_SPACE		28
+#define KEYWORD_MAX_EDITS	(26 * 27 + 26 + 26 * 25 + 25)
+#define KEYWORD_KEY_SPACE	54
+
+static const char *keywordPlain = "abcdefghijklmnopqrstuvwxyz";
+
+typedef struct KeywordState {
+    HillclimbState climb;
+    int form;
+    int edits;
+
+    long evaluations;
+    long duplicates;
+    long steps;
+    HillclimbTrace trace;
+} KeywordState;
+
+static int
+KeywordGetEdits(Tcl_Interp *interp, Tcl_Obj *listObj, int *editsPtr)
+{
+    Tcl_Obj **elemObjs;
+    int elemCount;
+    int edits = 0;
+    int i, index;
+
+    if (Tcl_ListObjGetElements(interp, listObj, &elemCount, &elemObjs)
+	    != TCL_OK) {
+	return TCL_ERROR;
+    }
+    for (i=0; i < elemCount; i++) {
+	if (Tcl_GetIndexFromObj(interp, elemObjs[i], keywordEdits,
+		    "edit", 0, &index) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	edits |= 1 << index;
+    }
+    if (edits == 0) {
+	Tcl_SetResult(interp, "At least one kind of edit is needed",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    *editsPtr = edits;
+    return TCL_OK;
+}
+
+/*
+ * Copy the distinct letters of keyword to result, in the order they
+ * first appear.  Fails if the keyword has anything other than the
+ * letters a-z in it.
+ */
+
+static int
+KeywordReduce(Tcl_Interp *interp, const char *keyword, char *result)
+{
+    int used[26];
+    int count = 0;
+    int i;
+
+    memset(used, 0, sizeof(used));
+    for (i=0; keyword[i]; i++) {
+	int c = keyword[i];
+
+	if (c < 'a' || c > 'z') {
+	    if (interp) {
+		Tcl_AppendResult(interp, "Invalid character found in keyword ",
+			keyword, ".  All letters must be lowercase from a-z",
+			(char *)NULL);
+	    }
+	    return TCL_ERROR;
+	}
+	if (! used[c - 'a']) {
+	    used[c - 'a'] = 1;
+	    result[count++] = c;
+	}
+    }
+    result[count] = '\0';
+
+    return TCL_OK;
+}
+
+/*
+ * Expand a reduced keyword into a full key.  The two parts of a pair key
+ * are separated by a space.
+ */
+
+static void
+KeywordExpand(Tcl_Interp *interp, int form, const char *keyword, char *result)
+{
+    char k1[27];
+    char *src, *dst;
+
+    KeyGenerateK1(interp, keyword, k1);
+    switch (form) {
+	case KEYWORD_K1:
+	    sprintf(result, "%s %s", keywordPlain, k1);
+	    break;
+	case KEYWORD_K2:
+	    sprintf(result, "%s %s", k1, keywordPlain);
+	    break;
+	case KEYWORD_K3:
+	    sprintf(result, "%s %s", k1, k1);
+	    break;
+	case KEYWORD_ALPHABET:
+	    strcpy(result, k1);
+	    break;
+	case KEYWORD_KEYSQUARE:
+	    for (src=k1, dst=result; *src; src++) {
+		if (*src != 'j') {
+		    *dst++ = *src;
+		}
+	    }
+	    *dst = '\0';
+	    break;
+    }
+}
+
+/*
+ * Write every keyword that is one edit away from keyword into result,
+ * KEYWORD_SPACE bytes apart, and return how many there are.  The edits
+ * aren't reduced, so some of them repeat a letter.
+ */
+
+static int
+KeywordEdit(const char *keyword, int edits, char *result)
+{
+    int length = strlen(keyword);
+    int count = 0;
+    int i, c;
+
+    if (edits & KEYWORD_INSERT) {
+	for (i=0; i <= length; i++) {
+	    for (c='a'; c <= 'z'; c++) {
+		char *dst = result + KEYWORD_SPACE * count++;
+
+		memcpy(dst, keyword, i);
+		dst[i] = c;
+		strcpy(dst + i + 1, keyword + i);
+	    }
+	}
+    }
+    if ((edits & KEYWORD_DELETE) && length > 1) {
+	for (i=0; i < length; i++) {
+	    char *dst = result + KEYWORD_SPACE * count++;
+
+	    memcpy(dst, keyword, i);
+	    strcpy(dst + i, keyword + i + 1);
+	}
+    }
+    if (edits & KEYWORD_REPLACE) {
+	for (i=0; i < length; i++) {
+	    for (c='a'; c <= 'z'; c++) {
+		char *dst;
+
+		if (c == keyword[i]) {
+		    continue;
+		}
+		dst = result + KEYWORD_SPACE * count++;
+		strcpy(dst, keyword);
+		dst[i] = c;
+	    }
+	}
+    }
+    if (edits & KEYWORD_TRANSPOSE) {
+	for (i=0; i+1 < length; i++) {
+	    char *dst = result + KEYWORD_SPACE * count++;
+
+	    strcpy(dst, keyword);
+	    dst[i] = keyword[i+1];
+	    dst[i+1] = keyword[i];
+	}
+    }
+
+    return count;
+}
+
+/*
+ * Find the neighbors of keyword whose keys aren't in seenPtr yet, and
+ * add their keys to it.  The reduced keywords and their expanded keys
+ * are written to keywords and keys, KEYWORD_SPACE and KEYWORD_KEY_SPACE
+ * bytes apart, and the number of neighbors is returned.  The number of
+ * neighbors whose keys had already been seen is added to
+ * *duplicatesPtr.
+ */
+
+static int
+KeywordNeighbors(Tcl_Interp *interp, int form, int edits, const char *keyword, Tcl_HashTable *seenPtr, char *keywords, char *keys, long *duplicatesPtr)
+{
+    char *edited = (char *)ckalloc(KEYWORD_SPACE * KEYWORD_MAX_EDITS);
+    int editCount = KeywordEdit(keyword, edits, edited);
+    int count = 0;
+    int i, isNew;
+
+    for (i=0; i < editCount; i++) {
+	char *reduced = keywords + KEYWORD_SPACE * count;
+	char *key = keys + KEYWORD_KEY_SPACE * count;
+
+	KeywordReduce((Tcl_Interp *)NULL, edited + KEYWORD_SPACE * i, reduced);
+	KeywordExpand(interp, form, reduced, key);
+	Tcl_CreateHashEntry(seenPtr, key, &isNew);
+	if (isNew) {
+	    count++;
+	} else {
+	    (*duplicatesPtr)++;
+	}
+    }
+    ckfree(edited);
+
+    return count;
+}
+
+/*
+ * Return an expanded key as a Tcl object, splitting pair keys into a
+ * list.
+ */
+
+static Tcl_Obj *
+KeywordKeyObj(const char *key)
+{
+    const char *space = strchr(key, ' ');
+    Tcl_Obj *partObjs[2];
+
+    if (space == NULL) {
+	return Tcl_NewStringObj(key, -1);
+    }
+    partObjs[0] = Tcl_NewStringObj(key, space - key);
+    partObjs[1] = Tcl_NewStringObj(space + 1, -1);
+
+    return Tcl_NewListObj(2, partObjs);
+}
+
+/*
+ * Copy an expanded key into the native key layout, where the second
+ * part starts after the null that ends the first.
+ */
+
+static void
+KeywordKeyCopy(char *dst, const char *key)
+{
+    for (; *key; key++, dst++) {
+	*dst = (*key == ' ') ? '\0' : *key;
+    }
+    *dst = '\0';
+}
+
+/*
+ * Hillclimb::keywords keyword ?option value ...?
+ *
+ *	Return a list of the keyword and key pairs that are one edit away
+ *	from keyword, with one pair for every distinct key other than the
+ *	key of keyword itself.  The options are -expand and -edits.
+ */
+
+int
+HillclimbKeywordsObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
+{
+    Tcl_HashTable seen;
+    Tcl_Obj *resultObj;
+    char keyword[KEYWORD_SPACE];
+    char key[KEYWORD_KEY_SPACE];
+    char *keywords, *keys;
+    int form = KEYWORD_K1;
+    int edits = KEYWORD_INSERT | KEYWORD_DELETE | KEYWORD_REPLACE
+	| KEYWORD_TRANSPOSE;
+    long duplicates = 0;
+    int count;
+    int i;
+
+    if (objc < 2 || objc % 2 == 1) {
+	Tcl_AppendResult(interp, "Usage:  ", Tcl_GetString(objv[0]),
+		" keyword ?option value ...?", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    for (i=2; i < objc; i += 2) {
+	const char *option = Tcl_GetString(objv[i]);
+
+	if (strcmp(option, "-expand") == 0) {
+	    if (Tcl_GetIndexFromObj(interp, objv[i+1], keywordForms,
+			"key form", 0, &form) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-edits") == 0) {
+	    if (KeywordGetEdits(interp, objv[i+1], &edits) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else {
+	    Tcl_AppendResult(interp, "Unknown option ", option, (char *)NULL);
+	    return TCL_ERROR;
+	}
+    }
+
+    if (KeywordReduce(interp, Tcl_GetString(objv[1]), keyword) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (keyword[0] == '\0') {
+	Tcl_SetResult(interp, "The keyword must have at least one letter",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    Tcl_InitHashTable(&seen, TCL_STRING_KEYS);
+    KeywordExpand(interp, form, keyword, key);
+    Tcl_CreateHashEntry(&seen, key, &i);
+
+    keywords = (char *)ckalloc(KEYWORD_SPACE * KEYWORD_MAX_EDITS);
+    keys = (char *)ckalloc(KEYWORD_KEY_SPACE * KEYWORD_MAX_EDITS);
+    count = KeywordNeighbors(interp, form, edits, keyword, &seen, keywords,
+	    keys, &duplicates);
+
+    resultObj = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+    for (i=0; i < count; i++) {
+	Tcl_Obj *pairObjs[2];
+
+	pairObjs[0] = Tcl_NewStringObj(keywords + KEYWORD_SPACE * i, -1);
+	pairObjs[1] = KeywordKeyObj(keys + KEYWORD_KEY_SPACE * i);
+	Tcl_ListObjAppendElement(interp, resultObj,
+		Tcl_NewListObj(2, pairObjs));
+    }
+    Tcl_SetObjResult(interp, resultObj);
+
+    ckfree(keywords);
+    ckfree(keys);
+    Tcl_DeleteHashTable(&seen);
+
+    return TCL_OK;
+}
+
+/*
+ * Climb from keyword, moving to the best of its neighbors until none of
+ * them is an improvement.  The neighbors of each step are scored as one
+ * batch on the pool.  On return maxKeyword and maxKey hold the best
+ * keyword and its key in the native layout.
+ */
+
+static int
+KeywordRun(KeywordState *statePtr, HillclimbPool *poolPtr, char *maxKeyword, char *maxKey, double *maxValuePtr)
+{
+    HillclimbState *climbPtr = &statePtr->climb;
+    Tcl_Interp *interp = climbPtr->interp;
+    Tcl_HashTable seen;
+    char *keywords, *keys, *batch;
+    double *values;
+    double maxValue;
+    char key[KEYWORD_KEY_SPACE];
+    long step = 0;
+    int result;
+    int isNew;
+
+    Tcl_InitHashTable(&seen, TCL_STRING_KEYS);
+    KeywordExpand(interp, statePtr->form, maxKeyword, key);
+    Tcl_CreateHashEntry(&seen, key, &isNew);
+    KeywordKeyCopy(maxKey, key);
+
+    result = HillclimbPoolScore(poolPtr, maxKey, 1, &maxValue);
+    if (result != TCL_OK) {
+	Tcl_DeleteHashTable(&seen);
+	return TCL_ERROR;
+    }
+    statePtr->evaluations++;
+    result = HillclimbBestFit(climbPtr, maxKey, 0, maxValue);
+
+    keywords = (char *)ckalloc(KEYWORD_SPACE * KEYWORD_MAX_EDITS);
+    keys = (char *)ckalloc(KEYWORD_KEY_SPACE * KEYWORD_MAX_EDITS);
+    batch = (char *)ckalloc(climbPtr->keySize * KEYWORD_MAX_EDITS);
+    values = (double *)ckalloc(sizeof(double) * KEYWORD_MAX_EDITS);
+
+    while (result == TCL_OK) {
+	int count, best = -1;
+	int i;
+
+	step++;
+	count = KeywordNeighbors(interp, statePtr->form, statePtr->edits,
+		maxKeyword, &seen, keywords, keys, &statePtr->duplicates);
+	if (count == 0) {
+	    break;
+	}
+
+	for (i=0; i < count; i++) {
+	    KeywordKeyCopy(batch + climbPtr->keySize * i,
+		    keys + KEYWORD_KEY_SPACE * i);
+	}
+	result = HillclimbPoolScore(poolPtr, batch, count, values);
+	if (result != TCL_OK) {
+	    break;
+	}
+	statePtr->evaluations += count;
+
+	for (i=0; i < count; i++) {
+	    if (values[i] > maxValue && (best < 0 || values[i] > values[best])) {
+		best = i;
+	    }
+	}
+
+	if (best >= 0) {
+	    maxValue = values[best];
+	    strcpy(maxKeyword, keywords + KEYWORD_SPACE * best);
+	    memcpy(maxKey, batch + climbPtr->keySize * best, climbPtr->keySize);
+	    statePtr->steps++;
+	    HillclimbTraceAdd(&statePtr->trace, step, maxValue);
+
+	    result = HillclimbBestFit(climbPtr, maxKey, step, maxValue);
+	}
+	if (result == TCL_OK) {
+	    result = HillclimbStep(climbPtr, maxKey, step);
+	}
+	if (best < 0) {
+	    break;
+	}
+    }
+
+    if (result == TCL_OK) {
+	result = HillclimbDecipher(climbPtr, maxKey);
+    }
+
+    ckfree(keywords);
+    ckfree(keys);
+    ckfree(batch);
+    ckfree((char *)values);
+    Tcl_DeleteHashTable(&seen);
+
+    *maxValuePtr = maxValue;
+    return result;
+}
+
+/*
+ * Hillclimb::keywordclimb cipher keyword ?options?
+ *
+ *	Climb through the keywords that are one edit apart, starting from
+ *	keyword.  Returns a list of the best key found, its score, and a
+ *	list of statistics about the run that includes the best keyword.
+ *	The cipher is left with the best key restored.  See
+ *	doc/Hillclimb/package.tml for the options.
+ */
+
+int
+HillclimbKeywordClimbObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
+{
+    KeywordState state;
+    HillclimbPool *poolPtr;
+    Tcl_Obj *resultObjs[3];
+    Tcl_Obj *statObjs[18];
+    Tcl_Obj *keyObj;
+    Tcl_Time start, end;
+    char maxKeyword[KEYWORD_SPACE];
+    char expanded[KEYWORD_KEY_SPACE];
+    char *key = (char *)NULL;
+    char *maxKey;
+    double maxValue = 0.0;
+    double seconds;
+    int result = TCL_OK;
+    int i;
+
+    if (objc < 3 || objc % 2 == 0) {
+	Tcl_AppendResult(interp, "Usage:  ", Tcl_GetString(objv[0]),
+		" cipher keyword ?option value ...?", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    memset(&state, 0, sizeof(KeywordState));
+    if (HillclimbInitState(interp, objv[1], &state.climb) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    state.form = KEYWORD_K1;
+    state.edits = KEYWORD_INSERT | KEYWORD_DELETE | KEYWORD_REPLACE
+	| KEYWORD_TRANSPOSE;
+
+    for (i=3; i < objc; i += 2) {
+	const char *option = Tcl_GetString(objv[i]);
+
+	if (strcmp(option, "-expand") == 0) {
+	    if (Tcl_GetIndexFromObj(interp, objv[i+1], keywordForms,
+			"key form", 0, &state.form) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-edits") == 0) {
+	    if (KeywordGetEdits(interp, objv[i+1], &state.edits) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-score") == 0
+		|| strcmp(option, "-keyform") == 0
+		|| strcmp(option, "-stepinterval") == 0
+		|| strcmp(option, "-stepcommand") == 0
+		|| strcmp(option, "-bestfitcommand") == 0
+		|| strcmp(option, "-threads") == 0) {
+	    if (HillclimbStateOption(&state.climb, option, objv[i+1])
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else {
+	    Tcl_AppendResult(interp, "Unknown option ", option, (char *)NULL);
+	    return TCL_ERROR;
+	}
+    }
+
+    /*
+     * The k1, k2 and k3 forms are pairs of alphabets that are
+     * deciphered like an aristocrat's key.  The others are single keys,
+     * which may still use the gromark key form.
+     */
+
+    if (state.form == KEYWORD_K1 || state.form == KEYWORD_K2
+	    || state.form == KEYWORD_K3) {
+	state.climb.keyForm = HILLCLIMB_KEY_PAIR;
+	state.climb.neighbors = HILLCLIMB_SWAP_ARISTOCRAT;
+    } else if (state.climb.keyForm == HILLCLIMB_KEY_PAIR) {
+	Tcl_SetResult(interp,
+		"Only k1, k2, and k3 keywords can be used with pair keys",
+		TCL_STATIC);
+	return TCL_ERROR;
+    } else if (state.form == KEYWORD_KEYSQUARE) {
+	state.climb.neighbors = HILLCLIMB_SWAP_KEYSQUARE;
+    }
+
+    if (KeywordReduce(interp, Tcl_GetString(objv[2]), maxKeyword) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (maxKeyword[0] == '\0') {
+	Tcl_SetResult(interp, "The keyword must have at least one letter",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    KeywordExpand(interp, state.form, maxKeyword, expanded);
+    keyObj = KeywordKeyObj(expanded);
+    Tcl_IncrRefCount(keyObj);
+    result = HillclimbPrepare(&state.climb, keyObj, &key);
+    Tcl_DecrRefCount(keyObj);
+    if (result != TCL_OK) {
+	HillclimbFreeState(&state.climb);
+	return TCL_ERROR;
+    }
+    if (HillclimbPoolCreate(&state.climb, state.climb.threads, &poolPtr)
+	    != TCL_OK) {
+	ckfree(key);
+	HillclimbFreeState(&state.climb);
+	return TCL_ERROR;
+    }
+    maxKey = (char *)ckalloc(state.climb.keySize);
+
+    Tcl_GetTime(&start);
+    result = KeywordRun(&state, poolPtr, maxKeyword, maxKey, &maxValue);
+    Tcl_GetTime(&end);
+    HillclimbPoolDelete(poolPtr);
+
+    if (result == TCL_OK) {
+	seconds = (end.sec - start.sec) + (end.usec - start.usec) / 1e6;
+
+	statObjs[0] = Tcl_NewStringObj("evaluations", -1);
+	statObjs[1] = Tcl_NewLongObj(state.evaluations);
+	statObjs[2] = Tcl_NewStringObj("seconds", -1);
+	statObjs[3] = Tcl_NewDoubleObj(seconds);
+	statObjs[4] = Tcl_NewStringObj("rate", -1);
+	statObjs[5] = Tcl_NewDoubleObj(seconds > 0.0
+		? state.evaluations / seconds : 0.0);
+	statObjs[6] = Tcl_NewStringObj("duplicates", -1);
+	statObjs[7] = Tcl_NewLongObj(state.duplicates);
+	statObjs[8] = Tcl_NewStringObj("steps", -1);
+	statObjs[9] = Tcl_NewLongObj(state.steps);
+	statObjs[10] = Tcl_NewStringObj("keyword", -1);
+	statObjs[11] = Tcl_NewStringObj(maxKeyword, -1);
+	statObjs[12] = Tcl_NewStringObj("threads", -1);
+	statObjs[13] = Tcl_NewIntObj(state.climb.threads);
+	statObjs[14] = Tcl_NewStringObj("expand", -1);
+	statObjs[15] = Tcl_NewStringObj(keywordForms[state.form], -1);
+	statObjs[16] = Tcl_NewStringObj("trace", -1);
+	statObjs[17] = HillclimbTraceObj(&state.trace);
+
+	resultObjs[0] = HillclimbKeyObj(&state.climb, maxKey);
+	resultObjs[1] = Tcl_NewDoubleObj(maxValue);
+	resultObjs[2] = Tcl_NewListObj(18, statObjs);
+	Tcl_SetObjResult(interp, Tcl_NewListObj(3, resultObjs));
+    }
+
+    HillclimbTraceFree(&state.trace);
+    ckfree(key);
+    ckfree(maxKey);
+    HillclimbFreeState(&state.climb);
+
+    return result;
+}
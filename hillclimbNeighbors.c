@@ -0,0 +1,636 @@
+/*
+ * hillclimbNeighbors.c --
+ *
+ *	This file generates the neighbors of a key for the native searches
+ *	and for Hillclimb::neighbors.  A neighbor is one move away from the
+ *	key:  two letters swapped, one letter moved to another position with
+ *	the letters in between shifted over, or a run of letters reversed.
+ *	Moves only touch the positions that aren't fixed, so an insert or a
+ *	reverse skips over any fixed positions in its way.
+ *
+ *	Every move has an index from 0 to count-1 and is decoded from that
+ *	index when it is needed.  No list of moves or of neighbor keys is
+ *	built, and visiting the moves doesn't allocate anything.  A cursor
+ *	visits index (start + i*stride) mod count on its i-th step, with a
+ *	stride that has no factor in common with count, so a random start
+ *	and stride visit every move once in a scrambled order.
+ *
+ * Copyright (c) 2008 Michael Thomas <wart@kobold.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <tcl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "hillclimb.h"
+
+static const char *hillclimbMoveKinds[] = {"swap", "insert", "reverse", NULL};
+
+/*
+ * A counter used to generate unique neighbor iterator command names.
+ */
+
+static int neighborsid = 0;
+
+/*
+ * Parse a list of move kinds into a set of HILLCLIMB_MOVE_* bits.
+ */
+
+int
+HillclimbGetMoveKinds(Tcl_Interp *interp, Tcl_Obj *listObj, int *kindsPtr)
+{
+    Tcl_Obj **elemObjs;
+    int elemCount;
+    int kinds = 0;
+    int i, index;
+
+    if (Tcl_ListObjGetElements(interp, listObj, &elemCount, &elemObjs)
+	    != TCL_OK) {
+	return TCL_ERROR;
+    }
+    for (i=0; i < elemCount; i++) {
+	if (Tcl_GetIndexFromObj(interp, elemObjs[i], hillclimbMoveKinds,
+		    "move", 0, &index) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	kinds |= 1 << index;
+    }
+    if (kinds == 0) {
+	Tcl_SetResult(interp, "At least one kind of move is needed",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    *kindsPtr = kinds;
+    return TCL_OK;
+}
+
+/*
+ * The number of moves of one kind within a part with freeCount positions
+ * that can change.
+ */
+
+static long
+HillclimbKindCount(HillclimbNeighbors *nbPtr, int part, int kind)
+{
+    long n = nbPtr->freeCount[part];
+
+    if (n < 2) {
+	return 0;
+    }
+    switch (kind) {
+	case HILLCLIMB_MOVE_SWAP:
+	    if (nbPtr->pairs[part]) {
+		return nbPtr->pairCount[part];
+	    }
+	    return n * (n-1) / 2;
+	case HILLCLIMB_MOVE_INSERT:
+	    return n * (n-1);
+	case HILLCLIMB_MOVE_REVERSE:
+	    return n * (n-1) / 2;
+    }
+
+    return 0;
+}
+
+/*
+ * Set up the neighbors of a key whose parts have the given lengths.
+ * neighbors is one of the HILLCLIMB_SWAP_* values and picks the parts
+ * that can change, and kinds is a set of HILLCLIMB_MOVE_* values.
+ * fixedObj is the optional string of 0s and 1s that marks the key
+ * positions that can't change.  For twosquare keys it is a list with one
+ * such string for each part.
+ */
+
+int
+HillclimbNeighborsInit(Tcl_Interp *interp, HillclimbNeighbors *nbPtr, int neighbors, int kinds, const int *partLength, Tcl_Obj *fixedObj)
+{
+    const char *fixed[2] = {NULL, NULL};
+    int firstPart = 0;
+    int lastPart = 0;
+    int rowLength = 0;
+    int part, i, j, length, kind;
+
+    memset(nbPtr, 0, sizeof(HillclimbNeighbors));
+    nbPtr->kinds = kinds;
+    nbPtr->partOffset[1] = partLength[0] + 1;
+
+    if (neighbors == HILLCLIMB_SWAP_ARISTOCRAT) {
+	firstPart = lastPart = 1;
+    } else if (neighbors == HILLCLIMB_SWAP_TWOSQUARE) {
+	lastPart = 1;
+    }
+
+    if (fixedObj && Tcl_GetCharLength(fixedObj) > 0) {
+	if (neighbors == HILLCLIMB_SWAP_TWOSQUARE) {
+	    Tcl_Obj *partObj;
+
+	    for (part=0; part < 2; part++) {
+		if (Tcl_ListObjIndex(interp, fixedObj, part, &partObj)
+			!= TCL_OK) {
+		    return TCL_ERROR;
+		}
+		if (partObj && Tcl_GetCharLength(partObj) > 0) {
+		    fixed[part] = Tcl_GetString(partObj);
+		}
+	    }
+	} else {
+	    fixed[firstPart] = Tcl_GetString(fixedObj);
+	}
+    }
+
+    for (part=firstPart; part <= lastPart; part++) {
+	if (fixed[part] && strlen(fixed[part]) != partLength[part]) {
+	    Tcl_SetResult(interp,
+		    "key and fixedIndices are not the same length",
+		    TCL_STATIC);
+	    return TCL_ERROR;
+	}
+    }
+
+    if (neighbors == HILLCLIMB_SWAP_KEYSQUARE) {
+	length = partLength[0];
+	rowLength = (int) sqrt(length);
+	if (rowLength * rowLength != length) {
+	    char keyLengthString[32];
+	    sprintf(keyLengthString, "%d", length);
+	    Tcl_AppendResult(interp, "key length is not a perfect square: ",
+		    keyLengthString, (char *)NULL);
+	    return TCL_ERROR;
+	}
+    }
+
+    for (part=firstPart; part <= lastPart; part++) {
+	length = partLength[part];
+	nbPtr->free[part] = (int *)ckalloc(sizeof(int) * (length + 1));
+	for (i=0; i < length; i++) {
+	    if (! fixed[part] || fixed[part][i] == '0') {
+		nbPtr->free[part][nbPtr->freeCount[part]++] = i;
+	    }
+	}
+    }
+
+    /*
+     * Keysquare swaps are limited to letters in the same row or column,
+     * so they can't be decoded with arithmetic alone.  The pairs that
+     * qualify are listed once here instead.
+     */
+
+    if (rowLength) {
+	int n = nbPtr->freeCount[0];
+	int *freePos = nbPtr->free[0];
+
+	nbPtr->pairs[0] = (int *)ckalloc(sizeof(int) * (n * (n-1) + 2));
+	for (i=0; i < n; i++) {
+	    for (j=i+1; j < n; j++) {
+		if (freePos[i]%rowLength == freePos[j]%rowLength
+			|| freePos[i]/rowLength == freePos[j]/rowLength) {
+		    nbPtr->pairs[0][nbPtr->pairCount[0]*2] = i;
+		    nbPtr->pairs[0][nbPtr->pairCount[0]*2 + 1] = j;
+		    nbPtr->pairCount[0]++;
+		}
+	    }
+	}
+    }
+
+    for (part=firstPart; part <= lastPart; part++) {
+	for (kind=HILLCLIMB_MOVE_SWAP; kind <= HILLCLIMB_MOVE_REVERSE;
+		kind <<= 1) {
+	    if (kinds & kind) {
+		nbPtr->count += HillclimbKindCount(nbPtr, part, kind);
+	    }
+	}
+    }
+
+    return TCL_OK;
+}
+
+void
+HillclimbNeighborsFree(HillclimbNeighbors *nbPtr)
+{
+    int part;
+
+    for (part=0; part < 2; part++) {
+	if (nbPtr->free[part]) {
+	    ckfree((char *)nbPtr->free[part]);
+	    nbPtr->free[part] = (int *)NULL;
+	}
+	if (nbPtr->pairs[part]) {
+	    ckfree((char *)nbPtr->pairs[part]);
+	    nbPtr->pairs[part] = (int *)NULL;
+	}
+    }
+    nbPtr->count = 0;
+}
+
+/*
+ * Decode the index of a pair i < j out of n positions.  Pairs are
+ * numbered with i in the outer loop and j in the inner one.
+ */
+
+static void
+HillclimbDecodePair(long index, int n, int *firstPtr, int *secondPtr)
+{
+    int i = 0;
+
+    while (index >= n-1-i) {
+	index -= n-1-i;
+	i++;
+    }
+    *firstPtr = i;
+    *secondPtr = i + 1 + (int) index;
+}
+
+/*
+ * Decode a move from its index.
+ */
+
+void
+HillclimbNeighborsMove(HillclimbNeighbors *nbPtr, long index, HillclimbMove *movePtr)
+{
+    int part, kind;
+    long n;
+
+    for (part=0; part < 2; part++) {
+	for (kind=HILLCLIMB_MOVE_SWAP; kind <= HILLCLIMB_MOVE_REVERSE;
+		kind <<= 1) {
+	    if (! (nbPtr->kinds & kind)) {
+		continue;
+	    }
+	    n = HillclimbKindCount(nbPtr, part, kind);
+	    if (index >= n) {
+		index -= n;
+		continue;
+	    }
+
+	    movePtr->kind = kind;
+	    movePtr->part = part;
+	    if (kind == HILLCLIMB_MOVE_INSERT) {
+		int m = nbPtr->freeCount[part] - 1;
+
+		movePtr->first = (int)(index / m);
+		movePtr->second = (int)(index % m);
+		if (movePtr->second >= movePtr->first) {
+		    movePtr->second++;
+		}
+	    } else if (kind == HILLCLIMB_MOVE_SWAP && nbPtr->pairs[part]) {
+		movePtr->first = nbPtr->pairs[part][index*2];
+		movePtr->second = nbPtr->pairs[part][index*2 + 1];
+	    } else {
+		HillclimbDecodePair(index, nbPtr->freeCount[part],
+			&movePtr->first, &movePtr->second);
+	    }
+	    return;
+	}
+    }
+}
+
+/*
+ * Start visiting the moves.  A stride of 1 and a start of 0 visit them
+ * in index order.
+ */
+
+void
+HillclimbNeighborsFirst(HillclimbNeighbors *nbPtr, HillclimbCursor *cursorPtr, long stride, long start)
+{
+    long a, b, t;
+
+    cursorPtr->nbPtr = nbPtr;
+    cursorPtr->visited = 0;
+    cursorPtr->stride = 1;
+    cursorPtr->start = 0;
+    if (nbPtr->count == 0) {
+	return;
+    }
+
+    /*
+     * Move the stride up until it has no factor in common with the
+     * number of moves.
+     */
+
+    stride = stride % nbPtr->count;
+    if (stride < 1) {
+	stride = 1;
+    }
+    for (;;) {
+	a = stride;
+	b = nbPtr->count;
+	while (b) {
+	    t = a % b;
+	    a = b;
+	    b = t;
+	}
+	if (a == 1) {
+	    break;
+	}
+	stride = stride % nbPtr->count + 1;
+    }
+
+    cursorPtr->stride = stride;
+    cursorPtr->start = start % nbPtr->count;
+    if (cursorPtr->start < 0) {
+	cursorPtr->start += nbPtr->count;
+    }
+}
+
+/*
+ * Fetch the next move.  Returns 0 once every move has been visited.
+ */
+
+int
+HillclimbNeighborsNext(HillclimbCursor *cursorPtr, HillclimbMove *movePtr)
+{
+    HillclimbNeighbors *nbPtr = cursorPtr->nbPtr;
+    long index;
+
+    if (cursorPtr->visited >= nbPtr->count) {
+	return 0;
+    }
+    index = (cursorPtr->start + cursorPtr->visited * cursorPtr->stride)
+	    % nbPtr->count;
+    cursorPtr->visited++;
+    HillclimbNeighborsMove(nbPtr, index, movePtr);
+
+    return 1;
+}
+
+/*
+ * Move the letter at free position from to free position to, shifting
+ * the free positions in between towards from.
+ */
+
+static void
+HillclimbInsert(char *part, const int *freePos, int from, int to)
+{
+    char c = part[freePos[from]];
+    int i;
+
+    if (from < to) {
+	for (i=from; i < to; i++) {
+	    part[freePos[i]] = part[freePos[i+1]];
+	}
+    } else {
+	for (i=from; i > to; i--) {
+	    part[freePos[i]] = part[freePos[i-1]];
+	}
+    }
+    part[freePos[to]] = c;
+}
+
+void
+HillclimbApplyMove(HillclimbNeighbors *nbPtr, char *key, HillclimbMove *movePtr)
+{
+    char *part = key + nbPtr->partOffset[movePtr->part];
+    const int *freePos = nbPtr->free[movePtr->part];
+    int i = movePtr->first;
+    int j = movePtr->second;
+    char temp;
+
+    switch (movePtr->kind) {
+	case HILLCLIMB_MOVE_SWAP:
+	    temp = part[freePos[i]];
+	    part[freePos[i]] = part[freePos[j]];
+	    part[freePos[j]] = temp;
+	    break;
+	case HILLCLIMB_MOVE_INSERT:
+	    HillclimbInsert(part, freePos, i, j);
+	    break;
+	case HILLCLIMB_MOVE_REVERSE:
+	    for (; i < j; i++, j--) {
+		temp = part[freePos[i]];
+		part[freePos[i]] = part[freePos[j]];
+		part[freePos[j]] = temp;
+	    }
+	    break;
+    }
+}
+
+void
+HillclimbUndoMove(HillclimbNeighbors *nbPtr, char *key, HillclimbMove *movePtr)
+{
+    if (movePtr->kind == HILLCLIMB_MOVE_INSERT) {
+	HillclimbInsert(key + nbPtr->partOffset[movePtr->part],
+		nbPtr->free[movePtr->part], movePtr->second, movePtr->first);
+    } else {
+	HillclimbApplyMove(nbPtr, key, movePtr);
+    }
+}
+
+/*
+ * Build a list of all of the neighbors of key in index order.  The part
+ * of a pair key that a move doesn't change is shared by all of the
+ * neighbors.
+ */
+
+Tcl_Obj *
+HillclimbNeighborList(Tcl_Interp *interp, HillclimbState *statePtr, char *key)
+{
+    HillclimbCursor cursor;
+    HillclimbMove move;
+    Tcl_Obj **keyObjs;
+    Tcl_Obj *partObjs[2];
+    Tcl_Obj *listObj;
+    long count = 0;
+    int part;
+
+    for (part=0; part < statePtr->partCount; part++) {
+	partObjs[part] = Tcl_NewStringObj(HillclimbKeyPart(statePtr, key, part),
+		statePtr->partLength[part]);
+	Tcl_IncrRefCount(partObjs[part]);
+    }
+
+    keyObjs = (Tcl_Obj **)ckalloc(sizeof(Tcl_Obj *)
+	    * (statePtr->moves.count + 1));
+    HillclimbNeighborsFirst(&statePtr->moves, &cursor, 1, 0);
+    while (HillclimbNeighborsNext(&cursor, &move)) {
+	Tcl_Obj *pairObjs[2];
+
+	HillclimbApplyMove(&statePtr->moves, key, &move);
+	if (statePtr->keyForm == HILLCLIMB_KEY_PAIR) {
+	    pairObjs[0] = partObjs[0];
+	    pairObjs[1] = partObjs[1];
+	    pairObjs[move.part] = Tcl_NewStringObj(
+		    HillclimbKeyPart(statePtr, key, move.part),
+		    statePtr->partLength[move.part]);
+	    keyObjs[count++] = Tcl_NewListObj(2, pairObjs);
+	} else {
+	    keyObjs[count++] = Tcl_NewStringObj(key, statePtr->partLength[0]);
+	}
+	HillclimbUndoMove(&statePtr->moves, key, &move);
+    }
+    listObj = Tcl_NewListObj(count, keyObjs);
+
+    ckfree((char *)keyObjs);
+    for (part=0; part < statePtr->partCount; part++) {
+	Tcl_DecrRefCount(partObjs[part]);
+    }
+
+    return listObj;
+}
+
+/*
+ * A neighbor iterator created by Hillclimb::neighbors -lazy.
+ */
+
+typedef struct HillclimbIterator {
+    HillclimbState state;
+    char *key;
+    HillclimbCursor cursor;
+    int shuffle;
+} HillclimbIterator;
+
+static void
+HillclimbIteratorReset(HillclimbIterator *iterPtr)
+{
+    HillclimbState *statePtr = &iterPtr->state;
+    long stride = 1;
+    long start = 0;
+
+    if (iterPtr->shuffle) {
+	stride = (long)(HillclimbRandom(statePtr) * statePtr->moves.count);
+	start = (long)(HillclimbRandom(statePtr) * statePtr->moves.count);
+    }
+    HillclimbNeighborsFirst(&statePtr->moves, &iterPtr->cursor, stride,
+	    start);
+}
+
+static void
+HillclimbDeleteIterator(ClientData clientData)
+{
+    HillclimbIterator *iterPtr = (HillclimbIterator *)clientData;
+
+    ckfree(iterPtr->key);
+    HillclimbFreeState(&iterPtr->state);
+    ckfree((char *)iterPtr);
+}
+
+static int
+HillclimbIteratorObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
+{
+    HillclimbIterator *iterPtr = (HillclimbIterator *)clientData;
+    HillclimbMove move;
+    const char *cmd;
+
+    if (objc != 2) {
+	Tcl_AppendResult(interp, "Usage:  ", Tcl_GetString(objv[0]),
+		" next|count|reset", (char *)NULL);
+	return TCL_ERROR;
+    }
+    cmd = Tcl_GetString(objv[1]);
+
+    if (strcmp(cmd, "next") == 0) {
+	if (HillclimbNeighborsNext(&iterPtr->cursor, &move)) {
+	    HillclimbApplyMove(&iterPtr->state.moves, iterPtr->key, &move);
+	    Tcl_SetObjResult(interp, HillclimbKeyObj(&iterPtr->state,
+			iterPtr->key));
+	    HillclimbUndoMove(&iterPtr->state.moves, iterPtr->key, &move);
+	}
+    } else if (strcmp(cmd, "count") == 0) {
+	Tcl_SetObjResult(interp, Tcl_NewLongObj(iterPtr->state.moves.count));
+    } else if (strcmp(cmd, "reset") == 0) {
+	HillclimbIteratorReset(iterPtr);
+    } else {
+	Tcl_AppendResult(interp, "Unknown option ", cmd, (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+
+/*
+ * Hillclimb::neighbors key ?options?
+ *
+ *	Return the neighbors of a key, or with -lazy 1 the name of a new
+ *	command that returns them one at a time.  See
+ *	doc/Hillclimb/package.tml for the options.
+ */
+
+int
+HillclimbNeighborsObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
+{
+    HillclimbIterator *iterPtr;
+    HillclimbState state;
+    char *key = (char *)NULL;
+    char cmdName[32];
+    int lazy = 0;
+    int shuffle = 0;
+    int result;
+    int i;
+
+    if (objc < 2 || objc % 2 == 1) {
+	Tcl_AppendResult(interp, "Usage:  ", Tcl_GetString(objv[0]),
+		" key ?option value ...?", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    HillclimbInitState(interp, (Tcl_Obj *)NULL, &state);
+
+    for (i=2; i < objc; i += 2) {
+	const char *option = Tcl_GetString(objv[i]);
+
+	if (strcmp(option, "-lazy") == 0) {
+	    if (Tcl_GetBooleanFromObj(interp, objv[i+1], &lazy) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-shuffle") == 0) {
+	    if (Tcl_GetBooleanFromObj(interp, objv[i+1], &shuffle)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-keyform") == 0
+		|| strcmp(option, "-neighbors") == 0
+		|| strcmp(option, "-fixed") == 0
+		|| strcmp(option, "-moves") == 0
+		|| strcmp(option, "-seed") == 0) {
+	    result = HillclimbStateOption(&state, option, objv[i+1]);
+	    if (result != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else {
+	    Tcl_AppendResult(interp, "Unknown option ", option, (char *)NULL);
+	    return TCL_ERROR;
+	}
+    }
+
+    if (HillclimbPrepareKey(&state, objv[1], &key) != TCL_OK) {
+	HillclimbFreeState(&state);
+	return TCL_ERROR;
+    }
+    HillclimbPrepareSeed(&state);
+
+    if (! lazy) {
+	Tcl_SetObjResult(interp, HillclimbNeighborList(interp, &state, key));
+	ckfree(key);
+	HillclimbFreeState(&state);
+	return TCL_OK;
+    }
+
+    iterPtr = (HillclimbIterator *)ckalloc(sizeof(HillclimbIterator));
+    iterPtr->state = state;
+    iterPtr->key = key;
+    iterPtr->shuffle = shuffle;
+    HillclimbIteratorReset(iterPtr);
+
+    sprintf(cmdName, "neighbors%d", ++neighborsid);
+    Tcl_CreateObjCommand(interp, cmdName, HillclimbIteratorObjCmd,
+	    (ClientData)iterPtr, HillclimbDeleteIterator);
+    Tcl_SetResult(interp, cmdName, TCL_VOLATILE);
+
+    return TCL_OK;
+}
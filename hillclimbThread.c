@@ -0,0 +1,933 @@
+/*
+ * hillclimbThread.c --
+ *
+ *	This file runs independent restarts of the native searches,
+ *	optionally spread over several threads.  Restart 0 starts from the
+ *	key that was given and every other restart starts from a random
+ *	shuffle of it.  Restart i is seeded with seed+i, so the result of
+ *	every restart, and so the best key, doesn't depend on the number of
+ *	threads or on the order in which the restarts finish.
+ *
+ *	A Tcl interpreter can only be used by the thread that created it.
+ *	Every worker thread creates its own interpreter and its own copy of
+ *	the cipher, made from the ciphertext and settings of the original.
+ *	The scoring tables are only read during a search, so the workers
+ *	share them, but they don't use the score cache.  Scoring with a Tcl
+ *	command isn't possible from a worker thread.
+ *
+ *	The best value found so far by any worker is kept in one slot that
+ *	is updated with a compare-and-swap where the compiler supports it.
+ *	Step and best fit callbacks are sent to the thread that started the
+ *	search as events, and that thread runs the event loop until all of
+ *	the workers are done.  Only improvements on the best value so far
+ *	are sent to the best fit callback.
+ *
+ *	This file also has a pool of long lived worker threads that run
+ *	batches of small tasks, such as scoring the keys of one generation
+ *	of the genetic search.
+ *
+ * Copyright (c) 2008 Michael Thomas <wart@kobold.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <tcl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "hillclimb.h"
+
+extern ScoreItem *defaultScoreItem;
+
+#define HILLCLIMB_EVENT_STEP	0
+#define HILLCLIMB_EVENT_BESTFIT	1
+#define HILLCLIMB_EVENT_DONE	2
+
+/*
+ * State shared by every restart of one search.
+ */
+
+typedef struct HillclimbShared {
+    HillclimbState *templatePtr;
+    int stateSize;
+    HillclimbRunProc *runProc;
+    const char *key;
+
+    /*
+     * The restarts.  states holds a copy of the search state for each
+     * one, keys holds the starting and best keys, and values and results
+     * hold the outcome.
+     */
+
+    char *states;
+    char *keys;
+    double *values;
+    int *results;
+    char **errors;
+
+    long nextRestart;
+    Tcl_Mutex mutex;
+
+    /*
+     * The best value found by any restart, stored as the bits of a
+     * double.
+     */
+
+    volatile Tcl_WideInt bestBits;
+
+    /*
+     * The best value that has been passed to the best fit callback.
+     * Workers can queue their improvements out of order, so the event
+     * handler drops the ones that have been overtaken.
+     */
+
+    double reportedBest;
+
+    /*
+     * How to build a copy of the cipher.
+     */
+
+    CipherClone clone;
+
+    Tcl_ThreadId mainThread;
+    int running;
+    volatile int abort;
+    char *cloneError;		/* Why a copy of the cipher failed. */
+    Tcl_Obj *errorObj;		/* The error from a callback. */
+} HillclimbShared;
+
+typedef struct HillclimbThreadInfo {
+    HillclimbShared *sharedPtr;
+} HillclimbThreadInfo;
+
+typedef struct HillclimbEvent {
+    Tcl_Event header;
+    HillclimbShared *sharedPtr;
+    int kind;
+    char *key;
+    long iteration;
+    double value;
+} HillclimbEvent;
+
+static HillclimbState *
+HillclimbRestartState(HillclimbShared *sharedPtr, long restart)
+{
+    return (HillclimbState *)(sharedPtr->states
+	    + restart * sharedPtr->stateSize);
+}
+
+static char *
+HillclimbRestartKey(HillclimbShared *sharedPtr, long restart, int which)
+{
+    return sharedPtr->keys
+	+ (restart * 2 + which) * sharedPtr->templatePtr->keySize;
+}
+
+static double
+HillclimbBitsToDouble(Tcl_WideInt bits)
+{
+    double value;
+
+    memcpy(&value, &bits, sizeof(double));
+    return value;
+}
+
+static Tcl_WideInt
+HillclimbDoubleToBits(double value)
+{
+    Tcl_WideInt bits;
+
+    memcpy(&bits, &value, sizeof(double));
+    return bits;
+}
+
+/*
+ * Raise the best value so far to value.  Returns 1 if value is an
+ * improvement.
+ */
+
+static int
+HillclimbRaiseBest(HillclimbShared *sharedPtr, double value)
+{
+#if defined(__GNUC__) && defined(__ATOMIC_SEQ_CST)
+    Tcl_WideInt oldBits = __atomic_load_n(&sharedPtr->bestBits,
+	    __ATOMIC_RELAXED);
+    Tcl_WideInt newBits = HillclimbDoubleToBits(value);
+
+    while (HillclimbBitsToDouble(oldBits) < value) {
+	if (__atomic_compare_exchange_n(&sharedPtr->bestBits, &oldBits,
+		    newBits, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	    return 1;
+	}
+    }
+    return 0;
+#else
+    int improved = 0;
+
+    Tcl_MutexLock(&sharedPtr->mutex);
+    if (HillclimbBitsToDouble(sharedPtr->bestBits) < value) {
+	sharedPtr->bestBits = HillclimbDoubleToBits(value);
+	improved = 1;
+    }
+    Tcl_MutexUnlock(&sharedPtr->mutex);
+
+    return improved;
+#endif
+}
+
+/*
+ * Run a callback for a worker thread.  This is called by the event loop
+ * of the thread that started the search.
+ */
+
+static int
+HillclimbEventProc(Tcl_Event *evPtr, int flags)
+{
+    HillclimbEvent *eventPtr = (HillclimbEvent *)evPtr;
+    HillclimbShared *sharedPtr = eventPtr->sharedPtr;
+    HillclimbState *templatePtr = sharedPtr->templatePtr;
+    Tcl_Obj *objv[2];
+    int result = TCL_OK;
+
+    if (eventPtr->kind == HILLCLIMB_EVENT_DONE) {
+	sharedPtr->running--;
+	return 1;
+    }
+
+    if (eventPtr->kind == HILLCLIMB_EVENT_BESTFIT) {
+	if (eventPtr->value <= sharedPtr->reportedBest) {
+	    ckfree(eventPtr->key);
+	    return 1;
+	}
+	sharedPtr->reportedBest = eventPtr->value;
+    }
+
+    if (sharedPtr->errorObj == NULL) {
+	objv[0] = Tcl_NewLongObj(eventPtr->iteration);
+	objv[1] = Tcl_NewDoubleObj(eventPtr->value);
+	if (eventPtr->kind == HILLCLIMB_EVENT_STEP) {
+	    result = HillclimbCallback(templatePtr, templatePtr->stepCmdObj,
+		    eventPtr->key, 1, objv);
+	} else {
+	    result = HillclimbCallback(templatePtr,
+		    templatePtr->bestFitCmdObj, eventPtr->key, 2, objv);
+	}
+
+	if (result != TCL_OK) {
+	    sharedPtr->errorObj = Tcl_GetObjResult(templatePtr->interp);
+	    Tcl_IncrRefCount(sharedPtr->errorObj);
+	    sharedPtr->abort = 1;
+	}
+	Tcl_ResetResult(templatePtr->interp);
+    }
+
+    ckfree(eventPtr->key);
+    return 1;
+}
+
+static void
+HillclimbQueueEvent(HillclimbShared *sharedPtr, int kind, char *key, long iteration, double value)
+{
+    HillclimbEvent *eventPtr = (HillclimbEvent *)ckalloc(sizeof(HillclimbEvent));
+    int keySize = sharedPtr->templatePtr->keySize;
+
+    eventPtr->header.proc = HillclimbEventProc;
+    eventPtr->sharedPtr = sharedPtr;
+    eventPtr->kind = kind;
+    eventPtr->key = (char *)NULL;
+    if (key) {
+	eventPtr->key = (char *)ckalloc(keySize);
+	memcpy(eventPtr->key, key, keySize);
+    }
+    eventPtr->iteration = iteration;
+    eventPtr->value = value;
+
+    Tcl_ThreadQueueEvent(sharedPtr->mainThread, (Tcl_Event *)eventPtr,
+	    TCL_QUEUE_TAIL);
+    Tcl_ThreadAlert(sharedPtr->mainThread);
+}
+
+int
+HillclimbThreadBestFit(HillclimbState *statePtr, char *key, long iteration, double value)
+{
+    HillclimbShared *sharedPtr = statePtr->threadPtr->sharedPtr;
+
+    if (sharedPtr->abort) {
+	return TCL_ERROR;
+    }
+    if (HillclimbRaiseBest(sharedPtr, value) && statePtr->bestFitCmdObj) {
+	HillclimbQueueEvent(sharedPtr, HILLCLIMB_EVENT_BESTFIT, key,
+		iteration, value);
+    }
+
+    return TCL_OK;
+}
+
+int
+HillclimbThreadStep(HillclimbState *statePtr, char *key, long iteration)
+{
+    HillclimbShared *sharedPtr = statePtr->threadPtr->sharedPtr;
+
+    if (sharedPtr->abort) {
+	return TCL_ERROR;
+    }
+    if (statePtr->stepCmdObj && statePtr->stepInterval > 0
+	    && iteration % statePtr->stepInterval == 0) {
+	HillclimbQueueEvent(sharedPtr, HILLCLIMB_EVENT_STEP, key, iteration,
+		0.0);
+    }
+
+    return TCL_OK;
+}
+
+/*
+ * Run one restart with the given interpreter and cipher.
+ */
+
+static void
+HillclimbRunRestart(HillclimbShared *sharedPtr, long restart, Tcl_Interp *interp, CipherItem *cipherPtr, const char *cipherCmd, HillclimbThreadInfo *threadPtr)
+{
+    HillclimbState *templatePtr = sharedPtr->templatePtr;
+    HillclimbState *statePtr = HillclimbRestartState(sharedPtr, restart);
+    char *key = HillclimbRestartKey(sharedPtr, restart, 0);
+    char *maxKey = HillclimbRestartKey(sharedPtr, restart, 1);
+    HillclimbMove move;
+    long i;
+    int result;
+
+    memcpy((char *)statePtr, (char *)templatePtr, sharedPtr->stateSize);
+    statePtr->interp = interp;
+    statePtr->cipherPtr = cipherPtr;
+    statePtr->cipherCmd = cipherCmd;
+    statePtr->threadPtr = threadPtr;
+    statePtr->pt = (char *)NULL;
+    statePtr->positions = (int *)NULL;
+    statePtr->ptSpace = 0;
+    HillclimbSeed(statePtr, templatePtr->seed + restart);
+
+    memcpy(key, sharedPtr->key, templatePtr->keySize);
+    if (restart > 0) {
+	for (i=0; i < statePtr->moves.count; i++) {
+	    HillclimbRandomMove(statePtr, &move);
+	    HillclimbApplyMove(&statePtr->moves, key, &move);
+	}
+    }
+
+    result = (sharedPtr->runProc)(statePtr, key, maxKey,
+	    sharedPtr->values + restart);
+    sharedPtr->results[restart] = result;
+    if (result != TCL_OK) {
+	/*
+	 * Keep the message as a string, since a Tcl_Obj can't be passed
+	 * between threads.
+	 */
+
+	const char *message = Tcl_GetStringResult(interp);
+
+	sharedPtr->errors[restart] = (char *)ckalloc(strlen(message) + 1);
+	strcpy(sharedPtr->errors[restart], message);
+	sharedPtr->abort = 1;
+    }
+    Tcl_ResetResult(interp);
+}
+
+/*
+ * Return the number of the next restart to run, or -1 if there are none
+ * left.
+ */
+
+static long
+HillclimbNextRestart(HillclimbShared *sharedPtr)
+{
+    long restart = -1;
+
+    Tcl_MutexLock(&sharedPtr->mutex);
+    if (! sharedPtr->abort
+	    && sharedPtr->nextRestart < sharedPtr->templatePtr->restarts) {
+	restart = sharedPtr->nextRestart++;
+    }
+    Tcl_MutexUnlock(&sharedPtr->mutex);
+
+    return restart;
+}
+
+/*
+ * Make a copy of the search's cipher in a worker's interpreter.  The
+ * name of the new cipher's command is left in cmdName.
+ */
+
+static CipherItem *
+HillclimbCloneCipher(HillclimbShared *sharedPtr, Tcl_Interp *interp, char *cmdName, int size)
+{
+    CipherItem *cipherPtr;
+
+    cipherPtr = CipherCloneCreate(interp, &sharedPtr->clone, cmdName, size);
+    if (cipherPtr == NULL) {
+	const char *message = Tcl_GetStringResult(interp);
+
+	Tcl_MutexLock(&sharedPtr->mutex);
+	if (sharedPtr->cloneError == NULL) {
+	    sharedPtr->cloneError = (char *)ckalloc(strlen(message) + 1);
+	    strcpy(sharedPtr->cloneError, message);
+	}
+	sharedPtr->abort = 1;
+	Tcl_MutexUnlock(&sharedPtr->mutex);
+    }
+    Tcl_ResetResult(interp);
+
+    return cipherPtr;
+}
+
+static Tcl_ThreadCreateType
+HillclimbWorker(ClientData clientData)
+{
+    HillclimbShared *sharedPtr = (HillclimbShared *)clientData;
+    HillclimbThreadInfo info;
+    Tcl_Interp *interp = Tcl_CreateInterp();
+    CipherItem *cipherPtr;
+    char cmdName[64];
+    long restart;
+
+    info.sharedPtr = sharedPtr;
+
+    cipherPtr = HillclimbCloneCipher(sharedPtr, interp, cmdName,
+	    sizeof(cmdName));
+    while (cipherPtr != NULL
+	    && (restart = HillclimbNextRestart(sharedPtr)) >= 0) {
+	HillclimbRunRestart(sharedPtr, restart, interp, cipherPtr, cmdName,
+		&info);
+    }
+
+    Tcl_DeleteInterp(interp);
+    ScoreThreadFinish();
+    HillclimbQueueEvent(sharedPtr, HILLCLIMB_EVENT_DONE, (char *)NULL, 0,
+	    0.0);
+
+    Tcl_ExitThread(TCL_OK);
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/*
+ * Check that a search can be spread over several threads, and look up
+ * the default scoring object that the workers will share.
+ */
+
+static int
+HillclimbCheckThreads(HillclimbState *templatePtr)
+{
+    Tcl_Interp *interp = templatePtr->interp;
+
+    if (Tcl_GetVar2Ex(interp, "tcl_platform", "threaded",
+		TCL_GLOBAL_ONLY) == NULL) {
+	Tcl_SetResult(interp, "-threads needs a threaded build of Tcl",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (templatePtr->scoreCmdObj) {
+	Tcl_SetResult(interp,
+		"Scoring commands written in Tcl can't be used with -threads",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (templatePtr->scorePtr == NULL) {
+	if (defaultScoreItem == NULL) {
+	    Tcl_SetResult(interp, "No default scoring object is set",
+		    TCL_STATIC);
+	    return TCL_ERROR;
+	}
+	templatePtr->scorePtr = defaultScoreItem;
+    }
+
+    return TCL_OK;
+}
+
+/*
+ * Run all of the restarts of a search.  On return maxKey and
+ * maxValuePtr hold the best key and value over all of the restarts, the
+ * cipher has the best key restored, *restartsPtr holds the state of
+ * every restart, and *bestPtr the number of the restart that found the
+ * best key.
+ */
+
+int
+HillclimbRunRestarts(HillclimbState *templatePtr, int stateSize, HillclimbRunProc *runProc, char *key, char *maxKey, double *maxValuePtr, char **restartsPtr, int *bestPtr)
+{
+    Tcl_Interp *interp = templatePtr->interp;
+    HillclimbShared shared;
+    Tcl_ThreadId *threadIds = (Tcl_ThreadId *)NULL;
+    long restarts = templatePtr->restarts;
+    int threads = templatePtr->threads;
+    int result = TCL_OK;
+    int best = -1;
+    long i;
+
+    *restartsPtr = (char *)NULL;
+    *bestPtr = 0;
+
+    memset(&shared, 0, sizeof(HillclimbShared));
+    shared.templatePtr = templatePtr;
+    shared.stateSize = stateSize;
+    shared.runProc = runProc;
+    shared.key = key;
+    shared.bestBits = HillclimbDoubleToBits(-HUGE_VAL);
+    shared.reportedBest = -HUGE_VAL;
+
+    if (threads > restarts) {
+	threads = (int) restarts;
+    }
+
+    if (threads > 1) {
+	if (HillclimbCheckThreads(templatePtr) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (CipherCloneInit(interp, templatePtr->cipherPtr,
+		    templatePtr->cipherCmd, &shared.clone) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+    }
+
+    shared.states = (char *)ckalloc(stateSize * restarts);
+    memset(shared.states, 0, stateSize * restarts);
+    shared.keys = (char *)ckalloc(templatePtr->keySize * 2 * restarts);
+    shared.values = (double *)ckalloc(sizeof(double) * restarts);
+    shared.results = (int *)ckalloc(sizeof(int) * restarts);
+    shared.errors = (char **)ckalloc(sizeof(char *) * restarts);
+    for (i=0; i < restarts; i++) {
+	shared.values[i] = 0.0;
+	shared.results[i] = TCL_OK;
+	shared.errors[i] = (char *)NULL;
+    }
+
+    if (threads > 1) {
+	shared.mainThread = Tcl_GetCurrentThread();
+	threadIds = (Tcl_ThreadId *)ckalloc(sizeof(Tcl_ThreadId) * threads);
+	for (i=0; i < threads; i++) {
+	    if (Tcl_CreateThread(threadIds + shared.running, HillclimbWorker,
+			(ClientData)&shared, TCL_THREAD_STACK_DEFAULT,
+			TCL_THREAD_JOINABLE) == TCL_OK) {
+		shared.running++;
+	    }
+	}
+	threads = shared.running;
+
+	/*
+	 * Run callbacks until every worker is done.  Each worker sends
+	 * its "done" event last, so all of its callbacks have been run
+	 * by then.
+	 */
+
+	while (shared.running > 0) {
+	    Tcl_DoOneEvent(TCL_ALL_EVENTS);
+	}
+	for (i=0; i < threads; i++) {
+	    int status;
+
+	    Tcl_JoinThread(threadIds[i], &status);
+	}
+	ckfree((char *)threadIds);
+
+	if (threads == 0) {
+	    Tcl_SetResult(interp, "Could not start the worker threads",
+		    TCL_STATIC);
+	    result = TCL_ERROR;
+	}
+    } else {
+	for (i=0; i < restarts && ! shared.abort; i++) {
+	    HillclimbRunRestart(&shared, i, interp, templatePtr->cipherPtr,
+		    templatePtr->cipherCmd, (HillclimbThreadInfo *)NULL);
+	}
+    }
+
+    /*
+     * Report a failed callback first, then the first failed restart in
+     * restart order.
+     */
+
+    if (result == TCL_OK && shared.errorObj) {
+	Tcl_SetObjResult(interp, shared.errorObj);
+	result = TCL_ERROR;
+    }
+    for (i=0; i < restarts && result == TCL_OK; i++) {
+	if (shared.results[i] != TCL_OK) {
+	    Tcl_SetResult(interp, shared.errors[i], TCL_VOLATILE);
+	    result = TCL_ERROR;
+	}
+    }
+    if (result == TCL_OK && shared.cloneError) {
+	Tcl_SetResult(interp, shared.cloneError, TCL_VOLATILE);
+	result = TCL_ERROR;
+    }
+
+    if (result == TCL_OK) {
+	for (i=0; i < restarts; i++) {
+	    if (best < 0 || shared.values[i] > shared.values[best]) {
+		best = (int) i;
+	    }
+	}
+	memcpy(maxKey, HillclimbRestartKey(&shared, best, 1),
+		templatePtr->keySize);
+	*maxValuePtr = shared.values[best];
+	*bestPtr = best;
+
+	result = HillclimbDecipher(templatePtr, maxKey);
+    }
+
+    if (shared.errorObj) {
+	Tcl_DecrRefCount(shared.errorObj);
+    }
+    if (shared.cloneError) {
+	ckfree(shared.cloneError);
+    }
+    for (i=0; i < restarts; i++) {
+	HillclimbState *statePtr = HillclimbRestartState(&shared, i);
+
+	if (shared.errors[i]) {
+	    ckfree(shared.errors[i]);
+	}
+	if (statePtr->pt) {
+	    ckfree(statePtr->pt);
+	    ckfree((char *)statePtr->positions);
+	    statePtr->pt = (char *)NULL;
+	}
+	statePtr->threadPtr = (HillclimbThreadInfo *)NULL;
+	statePtr->interp = interp;
+    }
+    CipherCloneFree(&shared.clone);
+    Tcl_MutexFinalize(&shared.mutex);
+    ckfree(shared.keys);
+    ckfree((char *)shared.values);
+    ckfree((char *)shared.results);
+    ckfree((char *)shared.errors);
+
+    *restartsPtr = shared.states;
+    return result;
+}
+
+/*
+ * Free the restart states returned by HillclimbRunRestarts().
+ */
+
+void
+HillclimbFreeRestarts(HillclimbState *templatePtr, int stateSize, char *restarts)
+{
+    if (restarts != NULL) {
+	ckfree(restarts);
+    }
+}
+
+/*
+ * A pool of threads that run batches of tasks, for searches like the
+ * genetic search that score many unrelated keys at once.  The thread
+ * that owns the pool runs tasks too, so a pool of n threads has n-1
+ * workers.  Each worker has its own interpreter and copy of the cipher,
+ * just like the restart workers, and they all live until the pool is
+ * deleted.  Tasks are handed out one at a time, and a task only works on
+ * its own part of the search, so the results don't depend on which
+ * thread ran it.
+ */
+
+struct HillclimbPool {
+    HillclimbShared shared;
+    HillclimbThreadInfo info;
+    HillclimbState state;	/* The owner's copy of the search state. */
+    Tcl_ThreadId *threadIds;
+    int workers;
+
+    /*
+     * The batch being run.  Everything below is protected by
+     * shared.mutex.
+     */
+
+    Tcl_Condition startCond;
+    Tcl_Condition doneCond;
+    long batch;			/* The number of batches started so far. */
+    int quit;
+    HillclimbTaskProc *taskProc;
+    ClientData clientData;
+    int count;
+    int next;
+    int done;
+    char *error;		/* Why the first task that failed did so. */
+};
+
+/*
+ * The keys and values of a batch run by HillclimbPoolScore().
+ */
+
+typedef struct HillclimbScoreBatch {
+    char *keys;
+    double *values;
+} HillclimbScoreBatch;
+
+/*
+ * Run tasks from the current batch until there are none left.  This
+ * must be called with the pool's mutex held.
+ */
+
+static void
+HillclimbPoolRunBatch(HillclimbPool *poolPtr, HillclimbState *statePtr)
+{
+    HillclimbShared *sharedPtr = &poolPtr->shared;
+
+    while (poolPtr->next < poolPtr->count) {
+	int index = poolPtr->next++;
+	int result;
+
+	Tcl_MutexUnlock(&sharedPtr->mutex);
+	result = (poolPtr->taskProc)(statePtr, index, poolPtr->clientData);
+	Tcl_MutexLock(&sharedPtr->mutex);
+
+	if (result != TCL_OK && poolPtr->error == NULL) {
+	    const char *message = Tcl_GetStringResult(statePtr->interp);
+
+	    poolPtr->error = (char *)ckalloc(strlen(message) + 1);
+	    strcpy(poolPtr->error, message);
+	}
+	Tcl_ResetResult(statePtr->interp);
+
+	if (++poolPtr->done == poolPtr->count) {
+	    Tcl_ConditionNotify(&poolPtr->doneCond);
+	}
+    }
+}
+
+static Tcl_ThreadCreateType
+HillclimbPoolWorker(ClientData clientData)
+{
+    HillclimbPool *poolPtr = (HillclimbPool *)clientData;
+    HillclimbShared *sharedPtr = &poolPtr->shared;
+    HillclimbThreadInfo info;
+    HillclimbState state;
+    Tcl_Interp *interp = Tcl_CreateInterp();
+    char cmdName[64];
+    long batch = 0;
+
+    info.sharedPtr = sharedPtr;
+    memcpy((char *)&state, (char *)sharedPtr->templatePtr,
+	    sizeof(HillclimbState));
+    state.interp = interp;
+    state.cipherPtr = HillclimbCloneCipher(sharedPtr, interp, cmdName,
+	    sizeof(cmdName));
+    state.cipherCmd = cmdName;
+    state.threadPtr = &info;
+    state.pt = (char *)NULL;
+    state.positions = (int *)NULL;
+    state.ptSpace = 0;
+
+    if (state.cipherPtr != NULL) {
+	Tcl_MutexLock(&sharedPtr->mutex);
+	for (;;) {
+	    while (! poolPtr->quit && poolPtr->batch == batch) {
+		Tcl_ConditionWait(&poolPtr->startCond, &sharedPtr->mutex,
+			(Tcl_Time *)NULL);
+	    }
+	    if (poolPtr->quit) {
+		break;
+	    }
+	    batch = poolPtr->batch;
+	    HillclimbPoolRunBatch(poolPtr, &state);
+	}
+	Tcl_MutexUnlock(&sharedPtr->mutex);
+    }
+
+    if (state.pt) {
+	ckfree(state.pt);
+	ckfree((char *)state.positions);
+    }
+    Tcl_DeleteInterp(interp);
+    ScoreThreadFinish();
+
+    Tcl_ExitThread(TCL_OK);
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/*
+ * Create a pool of threads for running tasks with the cipher and
+ * scoring table of a search.  A pool of one thread runs every task in
+ * the calling thread.
+ */
+
+int
+HillclimbPoolCreate(HillclimbState *templatePtr, int threads, HillclimbPool **poolPtrPtr)
+{
+    HillclimbPool *poolPtr;
+    int i;
+
+    *poolPtrPtr = (HillclimbPool *)NULL;
+    if (threads > 1 && HillclimbCheckThreads(templatePtr) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    poolPtr = (HillclimbPool *)ckalloc(sizeof(HillclimbPool));
+    memset(poolPtr, 0, sizeof(HillclimbPool));
+    poolPtr->shared.templatePtr = templatePtr;
+    poolPtr->shared.stateSize = sizeof(HillclimbState);
+    poolPtr->info.sharedPtr = &poolPtr->shared;
+    memcpy((char *)&poolPtr->state, (char *)templatePtr,
+	    sizeof(HillclimbState));
+    poolPtr->state.pt = (char *)NULL;
+    poolPtr->state.positions = (int *)NULL;
+    poolPtr->state.ptSpace = 0;
+
+    if (threads > 1) {
+	if (CipherCloneInit(templatePtr->interp, templatePtr->cipherPtr,
+		    templatePtr->cipherCmd, &poolPtr->shared.clone) != TCL_OK) {
+	    ckfree((char *)poolPtr);
+	    return TCL_ERROR;
+	}
+
+	/*
+	 * The owner skips the score cache too, since the workers use the
+	 * same scoring object.
+	 */
+
+	poolPtr->state.threadPtr = &poolPtr->info;
+	poolPtr->threadIds = (Tcl_ThreadId *)ckalloc(sizeof(Tcl_ThreadId)
+		* (threads - 1));
+	for (i=1; i < threads; i++) {
+	    if (Tcl_CreateThread(poolPtr->threadIds + poolPtr->workers,
+			HillclimbPoolWorker, (ClientData)poolPtr,
+			TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE)
+		    == TCL_OK) {
+		poolPtr->workers++;
+	    }
+	}
+    }
+
+    *poolPtrPtr = poolPtr;
+    return TCL_OK;
+}
+
+/*
+ * Run taskProc for every index from 0 to count-1, spread over the
+ * pool's threads, and wait for all of them to finish.  taskProc is
+ * called with the search state of the thread that runs it.  Tasks must
+ * not run callbacks.
+ */
+
+int
+HillclimbPoolRun(HillclimbPool *poolPtr, int count, HillclimbTaskProc *taskProc, ClientData clientData)
+{
+    HillclimbShared *sharedPtr = &poolPtr->shared;
+    Tcl_Interp *interp = sharedPtr->templatePtr->interp;
+    int result = TCL_OK;
+
+    Tcl_MutexLock(&sharedPtr->mutex);
+    poolPtr->taskProc = taskProc;
+    poolPtr->clientData = clientData;
+    poolPtr->count = count;
+    poolPtr->next = 0;
+    poolPtr->done = 0;
+    poolPtr->batch++;
+    Tcl_ConditionNotify(&poolPtr->startCond);
+
+    HillclimbPoolRunBatch(poolPtr, &poolPtr->state);
+    while (poolPtr->done < count) {
+	Tcl_ConditionWait(&poolPtr->doneCond, &sharedPtr->mutex,
+		(Tcl_Time *)NULL);
+    }
+
+    /*
+     * A worker that couldn't copy the cipher leaves its share of the
+     * tasks to the others, but the search still fails, just like it
+     * would if the restarts had been run in threads.
+     */
+
+    if (poolPtr->error) {
+	Tcl_SetResult(interp, poolPtr->error, TCL_VOLATILE);
+	ckfree(poolPtr->error);
+	poolPtr->error = (char *)NULL;
+	result = TCL_ERROR;
+    } else if (sharedPtr->cloneError) {
+	Tcl_SetResult(interp, sharedPtr->cloneError, TCL_VOLATILE);
+	result = TCL_ERROR;
+    }
+    Tcl_MutexUnlock(&sharedPtr->mutex);
+
+    return result;
+}
+
+static int
+HillclimbScoreTask(HillclimbState *statePtr, int index, ClientData clientData)
+{
+    HillclimbScoreBatch *batchPtr = (HillclimbScoreBatch *)clientData;
+    char *key = batchPtr->keys + index * statePtr->keySize;
+    int result;
+
+    batchPtr->values[index] = 0.0;
+    result = HillclimbDecipher(statePtr, key);
+    if (result == TCL_OK) {
+	result = HillclimbScore(statePtr, (char *)NULL, 0.0,
+		batchPtr->values + index);
+    }
+
+    return result;
+}
+
+/*
+ * Score count keys of the search's key size, stored one after another in
+ * keys, leaving their values in values.
+ */
+
+int
+HillclimbPoolScore(HillclimbPool *poolPtr, char *keys, int count, double *values)
+{
+    HillclimbScoreBatch batch;
+
+    batch.keys = keys;
+    batch.values = values;
+
+    return HillclimbPoolRun(poolPtr, count, HillclimbScoreTask,
+	    (ClientData)&batch);
+}
+
+/*
+ * Stop the pool's workers and free the pool.
+ */
+
+void
+HillclimbPoolDelete(HillclimbPool *poolPtr)
+{
+    HillclimbShared *sharedPtr = &poolPtr->shared;
+    int i;
+
+    Tcl_MutexLock(&sharedPtr->mutex);
+    poolPtr->quit = 1;
+    Tcl_ConditionNotify(&poolPtr->startCond);
+    Tcl_MutexUnlock(&sharedPtr->mutex);
+
+    for (i=0; i < poolPtr->workers; i++) {
+	int status;
+
+	Tcl_JoinThread(poolPtr->threadIds[i], &status);
+    }
+    if (poolPtr->threadIds) {
+	ckfree((char *)poolPtr->threadIds);
+    }
+
+    if (poolPtr->state.pt) {
+	ckfree(poolPtr->state.pt);
+	ckfree((char *)poolPtr->state.positions);
+    }
+    CipherCloneFree(&sharedPtr->clone);
+    if (sharedPtr->cloneError) {
+	ckfree(sharedPtr->cloneError);
+    }
+    Tcl_ConditionFinalize(&poolPtr->startCond);
+    Tcl_ConditionFinalize(&poolPtr->doneCond);
+    Tcl_MutexFinalize(&sharedPtr->mutex);
+    ckfree((char *)poolPtr);
+}
@@ -29,6 +29,7 @@
 #include "digram.h"
 
 #include <cipherDebug.h>
+#include <cipherRandom.h>
 
 #define SOLVE_FAST	0
 #define SOLVE_THOROUGH	1
@@ -769,6 +770,7 @@ SolveHomophonic(Tcl_Interp *interp, CipherItem *itemPtr, char *maxkey)
     int		offset;
     char        *pt;
     double      bestValue = 0.0;
+    double      bound;
 
     if (homoPtr->solveMethod == SOLVE_FAST) {
         for(i=0; i < 4; i++) {
@@ -780,14 +782,15 @@ SolveHomophonic(Tcl_Interp *interp, CipherItem *itemPtr, char *maxkey)
             }
         }
     } else {
+        DefaultScoreBound(&bound);
         for (homoPtr->key[0]='a'; homoPtr->key[0] <= 'z'; homoPtr->key[0]++) {
             for (homoPtr->key[1]='a'; homoPtr->key[1] <= 'z'; homoPtr->key[1]++) {
                 for (homoPtr->key[2]='a'; homoPtr->key[2] <= 'z'; homoPtr->key[2]++) {
                     for (homoPtr->key[3]='a'; homoPtr->key[3] <= 'z'; homoPtr->key[3]++) {
                         double value;
                         pt = GetHomophonic(interp, itemPtr);
-                        if (DefaultScoreValue(interp, pt, &value)
-                                != TCL_OK) {
+                        if (DefaultScoreBoundedValue(interp, pt, bestValue,
+                                    bound, &value) != TCL_OK) {
                             ckfree(pt);
                             return TCL_ERROR;
                         }
@@ -911,13 +914,13 @@ EncodeHomophonic (Tcl_Interp *interp, CipherItem *itemPtr, const char *pt, const
     for (i=0; i<n; i++) {
 	int c;
 	int keychoice;
-	char letter[4]; /* Holds up to "100". */
+	char letter[12]; /* Holds up to "100", but any int fits. */
 	if (!islower(pt[i])) {
 	    continue;
 	}
-	keychoice = rand()%4;
+	keychoice = RandomIndex(RandomThreadState(), 4);
 	c = (offset[keychoice] + Reduce(pt[i]) - 'a') % 25;
-	sprintf(letter, "%03d", c + keychoice*25 + 1);	/* Print a zero-prefixed string. */
+	snprintf(letter, sizeof(letter), "%03d", c + keychoice*25 + 1);	/* Print a zero-prefixed string. */
 	strcpy(ct + count, letter+1);			/* Skip the first digit. */
 	count += 2;
     }
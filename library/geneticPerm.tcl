@@ -1,6 +1,8 @@
 # genetic.tcl --
 #
 #	Library routines for running permutation-based genetic algorithms. 
+#	GeneticPerm::search runs a whole search with the native engine.
+#	The other routines breed gene pools one generation at a time in Tcl.
 #
 # RCS: @(#) $Id: geneticPerm.tcl,v 1.1 2005/04/20 21:14:07 wart Exp $
 #
@@ -254,3 +256,39 @@ proc GeneticPerm::getBestFit {genePool} {
 
     return [list $bestFit $bestVal]
 }
+
+# GeneticPerm::search
+#
+#	Run a genetic search with the native engine, Hillclimb::genetic.
+#	The cipher, scoring and neighbor settings come from the Hillclimb
+#	package variables, and the chances of crossover and mutation from
+#	GeneticPerm::probability.  Only the builtin neighbor and decipher
+#	procedures are supported.
+#
+# Arguments:
+#
+#	key		The key to start from.  The rest of the first
+#			generation is made of random shuffles of it.
+#	generations	The number of generations to breed.
+#	poolSize	The number of keys in each generation.
+#	args		Extra options for Hillclimb::genetic.
+#
+# Result:
+#	A list of the best key found, its value, and the statistics from
+#	Hillclimb::genetic.
+
+proc GeneticPerm::search {key generations poolSize args} {
+    variable probability
+
+    set options [Hillclimb::nativeOptions]
+    if {[llength $options] == 0} {
+	error "The native genetic search only works with the builtin neighbor and decipher procedures"
+    }
+
+    return [eval [list Hillclimb::genetic $Hillclimb::cipherObject $key] \
+	    $options \
+	    [list -generations $generations \
+	    -population $poolSize \
+	    -crossover $probability(crossover) \
+	    -mutate $probability(mutate)] $args]
+}
@@ -240,6 +240,147 @@ proc Hillclimb::registerMaxKey {key pt value limitvalue depth count} {
     puts "$depth ($count):\t$value ($limitvalue)\t$key $pt"
 }
 
+# Hillclimb::canScoreDelta
+#
+#	Check whether neighboring keys should be scored with the "delta"
+#	subcommand of the scoring command.  Delta scoring only rescores
+#	the parts of the plaintext that changed, but the old score has to
+#	be passed back through the string interface each time.  That only
+#	pays off when scoring the whole plaintext is expensive, as it is
+#	for the word tree based n-gram types.  Custom scoring procedures
+#	don't support the delta subcommand at all.
+#
+# Arguments:
+#
+#	scoreCmd	The scoring command.
+#
+# Result:
+#	1 if the delta subcommand should be used, 0 otherwise.
+
+proc Hillclimb::canScoreDelta {scoreCmd} {
+    if {$scoreCmd == "score"} {
+	set scoreCmd [score default]
+    }
+
+    if {![llength [info commands $scoreCmd]] || ![score isinternal $scoreCmd]} {
+	return 0
+    }
+
+    return [expr {[lsearch {ngramlog ngramcount} [$scoreCmd type]] != -1}]
+}
+
+# Hillclimb::canScoreList
+#
+#	Check whether a list of plaintexts can be scored with a single call
+#	to the "valuelist" subcommand of the scoring command.
+#
+# Arguments:
+#
+#	scoreCmd	The scoring command.
+#
+# Result:
+#	1 if the valuelist subcommand is available, 0 otherwise.
+
+proc Hillclimb::canScoreList {scoreCmd} {
+    if {$scoreCmd == "score"} {
+	return 1
+    }
+
+    return [expr {[llength [info commands $scoreCmd]] \
+	    && [score isinternal $scoreCmd]}]
+}
+
+# Hillclimb::scoreNeighbors
+#
+#	Score the plaintexts for a set of neighboring keys.  Delta scoring
+#	is used relative to the plaintext of the current key when it pays
+#	off, otherwise the whole list is scored in one call when the
+#	scoring command supports it.
+#
+# Arguments:
+#
+#	pts		The list of plaintexts to score.
+#	refPt		The plaintext for the current key.
+#	refValue	The score of refPt.
+#
+# Result:
+#	The list of scores, in the same order as pts.
+
+proc Hillclimb::scoreNeighbors {pts refPt refValue} {
+    variable scoreObj
+
+    set values {}
+    if {[canScoreDelta $scoreObj]} {
+	foreach pt $pts {
+	    if {[string length $pt] == [string length $refPt]} {
+		lappend values [$scoreObj delta $refPt $pt $refValue]
+	    } else {
+		lappend values [$scoreObj value $pt]
+	    }
+	}
+    } elseif {[canScoreList $scoreObj]} {
+	set values [$scoreObj valuelist $pts]
+    } else {
+	foreach pt $pts {
+	    lappend values [$scoreObj value $pt]
+	}
+    }
+
+    return $values
+}
+
+# Hillclimb::nativeOptions
+#
+#	Get the options for the native hill climber, Hillclimb::climb,
+#	that match the current settings.  Hillclimb::climb only knows
+#	about the builtin neighbor and decipher procedures.
+#
+# Arguments:
+#
+#	None.
+#
+# Result:
+#	A list of options for Hillclimb::climb, or an empty list if the
+#	current neighbor or decipher procedure isn't a builtin one.
+
+proc Hillclimb::nativeOptions {} {
+    variable neighborProc
+    variable decipherProc
+    variable scoreObj
+    variable fixedKeyPositions
+    variable stepInterval
+    variable stepCommand
+    variable bestFitCommand
+
+    array set neighborType {
+	swapGenericKey		generic
+	generateSwapNeighborKeys generic
+	swapKeysquareKey	keysquare
+	swapAristocratKey	aristocrat
+	swapTwosquareKey	twosquare
+    }
+    array set keyForm {
+	decipherSimple		simple
+	decipherAristocrat	pair
+	decipherGromark		gromark
+    }
+
+    regsub {^(::)?(Hillclimb::)?} $neighborProc {} neighborName
+    regsub {^(::)?(Hillclimb::)?} $decipherProc {} decipherName
+    if {![info exists neighborType($neighborName)] \
+	    || ![info exists keyForm($decipherName)]} {
+	return {}
+    }
+
+    return [list -neighbors $neighborType($neighborName) \
+	    -keyform $keyForm($decipherName) \
+	    -score $scoreObj \
+	    -fixed $fixedKeyPositions \
+	    -stepinterval $stepInterval \
+	    -stepcommand $stepCommand \
+	    -bestfitcommand $bestFitCommand]
+}
+
 # Hillclimb::recstart
 #
 #	This routine starts the recursive hill climb.
@@ -267,6 +408,14 @@ proc Hillclimb::recstart {key keyvalue depth} {
     variable scoreObj
     variable fixedKeyPositions
 
+    set options [nativeOptions]
+    if {[llength $options]} {
+	return [eval [list climb $cipherObject $key] $options \
+		[list -recursive 1 -value $keyvalue -depth $depth \
+		-registercommand $registerProc \
+		-abortvariable [namespace current]::mutationRequested]]
+    }
+
     set maxValue $keyvalue
     set localMaxValue $maxValue
     #puts -->[info level 0]\t$localMaxValue
@@ -277,10 +426,16 @@ proc Hillclimb::recstart {key keyvalue depth} {
 	return [list $key $keyvalue]
     }
 
-    foreach neighborKey [$neighborProc $key $fixedKeyPositions] {
+    set neighborKeys [$neighborProc $key $fixedKeyPositions]
+    set pts {}
+    foreach neighborKey $neighborKeys {
+	lappend pts [$decipherProc $cipherObject $neighborKey]
+    }
+    set values [scoreNeighbors $pts [$decipherProc $cipherObject $key] \
+	    $keyvalue]
+
+    foreach neighborKey $neighborKeys value $values {
 	incr curIteration
-	set pt [$decipherProc $cipherObject $neighborKey]
-	set value [$scoreObj value $pt]
 	if {$value > $localMaxValue} {
 
 	    foreach  {returnkey value} [Hillclimb::recstart $neighborKey \
@@ -342,7 +497,13 @@ proc Hillclimb::start {key} {
 
 #    puts "Starting hill climb with [$scoreObj type] scoring function"
 
-    set maxValue [$scoreObj value [$decipherProc $cipherObject $key]]
+    set options [nativeOptions]
+    if {[llength $options]} {
+	return [eval [list climb $cipherObject $key] $options]
+    }
+
+    set maxPt [$decipherProc $cipherObject $key]
+    set maxValue [$scoreObj value $maxPt]
     set maxKey $key
     set maximaFound 0
     set curIteration 0
@@ -354,16 +515,24 @@ proc Hillclimb::start {key} {
     while {! $maximaFound} {
 	set maximaFound 1
 	set curKey $maxKey
+	set curPt $maxPt
+	set curValue $maxValue
+
+	set neighborKeys [Hillclimb::randomizeList [$neighborProc $curKey $fixedKeyPositions]]
+	set pts {}
+	foreach neighborKey $neighborKeys {
+	    lappend pts [$decipherProc $cipherObject $neighborKey]
+	}
 
-	foreach neighborKey [Hillclimb::randomizeList [$neighborProc $curKey $fixedKeyPositions]] {
+	foreach neighborKey $neighborKeys pt $pts \
+		value [scoreNeighbors $pts $curPt $curValue] {
 	    incr curIteration
 
-	    set value [$scoreObj value \
-		    [$decipherProc $cipherObject $neighborKey]]
 	    if {$value > $maxValue} {
 		set maximaFound 0
 		set maxValue $value
 		set maxKey $neighborKey
+		set maxPt $pt
 
 		if {$bestFitCommand != ""} {
 		    $bestFitCommand $neighborKey $curIteration $value
@@ -42,9 +42,16 @@ namespace eval Scoredata "set dataDir [file dirname [info script]]"
 #	Note that lines with a value of 0 aren't necessary as the
 #	score commands default all values to 0.
 #
+#	The file may also be a binary table written by saveData.  These
+#	are loaded with "score load" and are much faster to load.  When
+#	no filename is given, a binary table with the same name as the
+#	default data file, but with a .bin extension, is used in
+#	preference to the text file.
+#
 # Arguments:
 #
 #	command		The score command that will load the data.
+#	language	(optional) The language of the preexisting file.
 #	filename	(optional) The name of the file from which the
 #			data will be loaded.  If not specified, then
 #			a preexisting file will be used, based on the
@@ -67,8 +74,9 @@ proc Scoredata::loadData {command {language {}} {filename {}}} {
 
     if {$filename == ""} {
 	set type [$command type]
-	if {[string first ngram $type] == 0} {
-	    set type [$command elemsize][string range $type 1 end]
+	# The densengram types share the data files of the ngram types.
+	if {[regexp {^(dense)?ngram(.*)$} $type -> dense suffix]} {
+	    set type [$command elemsize]gram$suffix
 	}
 
         if {$language == ""} {
@@ -76,6 +84,16 @@ proc Scoredata::loadData {command {language {}} {filename {}}} {
         } else {
             set filename [file join $dataDir ${type}Data_${language}.tcl]
         }
+
+	set binaryFile [file rootname $filename].bin
+	if {[file readable $binaryFile]} {
+	    set filename $binaryFile
+	}
+    }
+
+    if {[isBinaryFile $filename]} {
+	score load $command $filename
+	return {}
     }
 
     set s $command
@@ -84,6 +102,28 @@ proc Scoredata::loadData {command {language {}} {filename {}}} {
     return {}
 }
 
+# Scoredata::isBinaryFile
+#
+#	Check whether a file holds a binary scoring table.
+#
+# Arguments:
+#
+#	filename	The name of the file to check.
+#
+# Result:
+#	1 if the file is a binary scoring table, 0 otherwise.
+
+proc Scoredata::isBinaryFile {filename} {
+    if {[catch {open $filename r} fileid]} {
+	return 0
+    }
+    fconfigure $fileid -translation binary
+    set magic [read $fileid 8]
+    close $fileid
+
+    return [string equal $magic "CTSCORE\n"]
+}
+
 # Scoredata::saveData
 #
 #	Save a scoring table to a file for later use.  Elements in the
@@ -95,11 +135,30 @@ proc Scoredata::loadData {command {language {}} {filename {}}} {
 #	command		The score command that will load the data.
 #	filename	The name of the file to which the data will be
 #	                saved.
+#	format		(optional) Either "text" to save the table as a
+#			list of "$s add" commands, or "binary" to save it
+#			in the format used by "score save".  Defaults to
+#			"text".
 #
 # Result:
 #	None.
 
-proc Scoredata::saveData {command filename} {
+proc Scoredata::saveData {command filename {format text}} {
+    switch -- $format {
+	text {
+	}
+	binary {
+	    if {$filename == "-"} {
+		error "Binary scoring tables can't be written to stdout."
+	    }
+	    score save $command $filename
+	    return {}
+	}
+	default {
+	    error "Unknown format '$format'.  Must be one of text or binary."
+	}
+    }
+
     if {$filename == "-"} {
 	set fileid stdout
     } else {
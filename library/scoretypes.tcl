@@ -32,6 +32,50 @@ namespace eval Scoretypes {
     variable tetragramlogCmd {}
 
     variable comboweight 0.5
+
+    # Native combo scoring objects for each of the combo procedures,
+    # created the first time that each one is used.
+    variable comboCmd
+    variable comboCmdWeight
+    array set comboCmd {}
+    array set comboCmdWeight {}
+}
+
+# Scoretypes::comboCommand
+#
+#	Return a combo scoring object that adds a table score to a
+#       wordtree score multiplied by the combo weight.  The object is
+#       created once per name, and created again if the combo weight
+#       has changed since.
+#
+# Arguments:
+#
+#	name		The name of the combo procedure.
+#	tableCmd	The table scoring object.
+#
+# Result:
+#	The name of the combo scoring object.
+
+proc Scoretypes::comboCommand {name tableCmd} {
+    variable wordtreeCmd
+    variable comboweight
+    variable comboCmd
+    variable comboCmdWeight
+
+    if {[info exists comboCmd($name)]
+            && $comboCmdWeight($name) != $comboweight} {
+        rename $comboCmd($name) {}
+        unset comboCmd($name)
+    }
+
+    if {![info exists comboCmd($name)]} {
+        set comboCmd($name) [score create combo]
+        $comboCmd($name) add $tableCmd
+        $comboCmd($name) add $wordtreeCmd $comboweight
+        set comboCmdWeight($name) $comboweight
+    }
+
+    return $comboCmd($name)
 }
 
 # Scoretypes::tricomboscore
@@ -69,10 +113,7 @@ proc Scoretypes::tricomboscore {command args} {
         elemvalue {
         }
         value {
-            set plaintext $args
-            set value [expr [$trigramlogCmd value $plaintext] + [$wordtreeCmd value $plaintext]*$comboweight]
-
-            return $value
+            return [[comboCommand tricomboscore $trigramlogCmd] value $args]
         }
         elemsize {
         }
@@ -120,10 +161,7 @@ proc Scoretypes::dicomboscore {command args} {
         elemvalue {
         }
         value {
-            set plaintext $args
-            set value [expr [$digramlogCmd value $plaintext] + [$wordtreeCmd value $plaintext]*$comboweight]
-
-            return $value
+            return [[comboCommand dicomboscore $digramlogCmd] value $args]
         }
         elemsize {
         }
@@ -160,7 +198,7 @@ proc Scoretypes::tetracomboscore {command args} {
         ::Scoredata::loadData $wordtreeCmd
     }
     if {$tetragramlogCmd == ""} {
-        set tetragramlogCmd [score create ngramlog]
+        set tetragramlogCmd [score create densengramlog]
         $tetragramlogCmd elemsize 4
         ::Scoredata::loadData $tetragramlogCmd
         set comboweight 500
@@ -173,10 +211,7 @@ proc Scoretypes::tetracomboscore {command args} {
         elemvalue {
         }
         value {
-            set plaintext $args
-            set value [expr [$tetragramlogCmd value $plaintext] + [$wordtreeCmd value $plaintext]*$comboweight]
-
-            return $value
+            return [[comboCommand tetracomboscore $tetragramlogCmd] value $args]
         }
         elemsize {
         }
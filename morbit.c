@@ -66,6 +66,7 @@ typedef struct MorbitItem {
 
     char maxSolKey[10];
     double maxSolVal;
+    double scoreBound;	/* See DefaultScoreBound() */
     long solValidCount;
     char *solPt;
 } MorbitItem;
@@ -458,6 +459,7 @@ SolveMorbit(Tcl_Interp *interp, CipherItem *itemPtr, char *maxkey)
     }
 
     morPtr->maxSolVal = 0.0;
+    DefaultScoreBound(&morPtr->scoreBound);
     itemPtr->curIteration = 0;
     morPtr->solValidCount = 0;
     for(i=0; i < 9; i++) {
@@ -539,7 +541,9 @@ MorbitSolveValue(Tcl_Interp *interp, ClientData clientData, int *key, int length
     if (mt && MorseValid(mt)) {
 	morPtr->solValidCount++;
 	if (MorseStringToString(mt, morPtr->solPt) != NULL) {
-	    if (DefaultScoreValue(interp, morPtr->solPt, &val) != TCL_OK) {
+	    if (DefaultScoreBoundedValue(interp, morPtr->solPt,
+			morPtr->maxSolVal, morPtr->scoreBound, &val)
+		    != TCL_OK) {
 		return TCL_ERROR;
 	    }
 	    if (val > morPtr->maxSolVal) {
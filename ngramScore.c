@@ -37,6 +37,15 @@ double  NgramStringValue _ANSI_ARGS_((const char *, double **));
 double  NgramSingleValue _ANSI_ARGS_((unsigned char, unsigned char, double **));
 static void NormalizeTreeNodeLog _ANSI_ARGS_((TreeNode *));
 static int DumpNgramScore _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static int SaveNgramScore _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static int LoadNgramScore _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static double NgramDelta _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *, const char *, double, const int *, int));
+static double NgramWindowValue _ANSI_ARGS_((ScoreItem *, const char *, int));
+static double NgramGramValue _ANSI_ARGS_((ScoreItem *, const char *, int, int));
+static double NgramMaxValue _ANSI_ARGS_((ScoreItem *));
+static double NgramBlockValue _ANSI_ARGS_((ScoreItem *, const char *, int, int));
+static unsigned short int NgramTreeMax _ANSI_ARGS_((TreeNode *));
+static int FillNgramTable _ANSI_ARGS_((TreeNode *, unsigned short int *, int, int, int));
 
 typedef struct NgramItem {
     ScoreItem header;
@@ -55,6 +64,12 @@ ScoreType NgramLogType = {
     DeleteNgramScore,
     DumpNgramScore,
     ScoreMethodCmd,
+    SaveNgramScore,
+    LoadNgramScore,
+    NgramDelta,
+    NgramGramValue,
+    NgramMaxValue,
+    NgramBlockValue,
     (ScoreType *)NULL
 };
 
@@ -69,6 +84,12 @@ ScoreType NgramCountType = {
     DeleteNgramScore,
     DumpNgramScore,
     ScoreMethodCmd,
+    SaveNgramScore,
+    LoadNgramScore,
+    NgramDelta,
+    NgramGramValue,
+    NgramMaxValue,
+    NgramBlockValue,
     (ScoreType *)NULL
 };
 
@@ -130,17 +151,17 @@ NgramValue(Tcl_Interp *interp, ScoreItem *itemPtr, const char *string) {
     NgramItem *ngPtr = (NgramItem *)itemPtr;
     int wordLen;
     unsigned short int value = 0;
-    double totalVal = 0;
+    int totalVal = 0;
     int i;
 
     wordLen = strlen(string);
     for (i=0; i <= wordLen-itemPtr->elemSize; i++) {
 	if (treeMatchString(ngPtr->rootNode, string+i, &value)) {
-	    totalVal += (double) value;
+	    totalVal += value;
 	}
     }
 
-    return totalVal;
+    return (double) totalVal;
 }
 
 static double
@@ -195,3 +216,193 @@ DumpNgramScore(Tcl_Interp *interp, ScoreItem *itemPtr, const char *script) {
     Tcl_ResetResult(interp);
     return DumpTreeNode(interp, ngPtr->rootNode, &command, &element, 0);
 }
+
+/*
+ * Copy the measures from the word tree into a flat base-26 table.
+ * Returns 0 if the tree holds an element that can't be stored in the
+ * table.
+ */
+
+static int
+FillNgramTable(TreeNode *node, unsigned short int *table, int elemSize, int depth, int index) {
+    int count;
+
+    for (count=0; node->next && node->next[count]; count++) {
+	TreeNode *child = node->next[count];
+
+	if (child->val == '\0') {
+	    if (node->measure > 0) {
+		if (depth != elemSize) {
+		    return 0;
+		}
+		table[index] = node->measure;
+	    }
+	} else {
+	    if (child->val < 'a' || child->val > 'z' || depth >= elemSize) {
+		return 0;
+	    }
+	    if (! FillNgramTable(child, table, elemSize, depth+1,
+			index*26 + (child->val - 'a'))) {
+		return 0;
+	    }
+	}
+    }
+
+    return 1;
+}
+
+static int
+SaveNgramScore(Tcl_Interp *interp, ScoreItem *itemPtr, const char *filename) {
+    NgramItem *ngPtr = (NgramItem *)itemPtr;
+    unsigned short int *table;
+    int tableSize = 1;
+    int result;
+    int i;
+
+    if (itemPtr->elemSize < 1 || itemPtr->elemSize > SCORE_TABLE_MAX_NGRAM) {
+	Tcl_SetResult(interp, "Element size is too large for a binary score table.", TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    for (i=0; i < itemPtr->elemSize; i++) {
+	tableSize *= 26;
+    }
+    table = (unsigned short int *)ckalloc(sizeof(unsigned short int) * tableSize);
+    memset(table, 0, sizeof(unsigned short int) * tableSize);
+
+    if (! FillNgramTable(ngPtr->rootNode, table, itemPtr->elemSize, 0, 0)) {
+	ckfree((char *)table);
+	Tcl_SetResult(interp, "Only n-grams of the letters a-z can be saved in a binary score table.", TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    result = ScoreTableWrite(interp, filename, itemPtr, SCORE_TABLE_ALPHA,
+	    table, sizeof(unsigned short int), tableSize);
+
+    ckfree((char *)table);
+
+    return result;
+}
+
+/*
+ * The binary format is shared with the densengram types.  The word tree
+ * can't use the table in place, but building it directly from the table
+ * avoids evaluating a Tcl command for every element.
+ */
+
+static int
+LoadNgramScore(Tcl_Interp *interp, ScoreItem *itemPtr, const char *filename) {
+    NgramItem *ngPtr = (NgramItem *)itemPtr;
+    ScoreTableMap map;
+    const unsigned short int *table;
+    char element[SCORE_TABLE_MAX_NGRAM+1];
+    int elemSize;
+    int tableSize = 1;
+    int entries;
+    int i, j, index;
+
+    table = (const unsigned short int *)ScoreTableOpen(interp, filename,
+	    itemPtr, SCORE_TABLE_ALPHA, sizeof(unsigned short int), &map,
+	    &entries);
+    if (table == NULL) {
+	return TCL_ERROR;
+    }
+
+    elemSize = ((ScoreTableHeader *)map.base)->elemSize;
+    for (i=0; i < elemSize; i++) {
+	tableSize *= 26;
+    }
+    if (elemSize < 1 || elemSize > SCORE_TABLE_MAX_NGRAM
+	    || entries != tableSize) {
+	ScoreTableClose(&map);
+	Tcl_AppendResult(interp, "\"", filename,
+		"\" does not hold a valid n-gram table", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    deleteWordTree(ngPtr->rootNode);
+    ngPtr->rootNode = createWordTreeRoot();
+    itemPtr->elemSize = elemSize;
+
+    element[elemSize] = '\0';
+    for (i=0; i < entries; i++) {
+	if (table[i] > 0) {
+	    for (j=elemSize-1, index=i; j >= 0; j--, index /= 26) {
+		element[j] = 'a' + index%26;
+	    }
+	    addWordToTree(ngPtr->rootNode, element, table[i]);
+	}
+    }
+
+    ScoreTableClose(&map);
+
+    Tcl_ResetResult(interp);
+    return TCL_OK;
+}
+
+static double
+NgramWindowValue(ScoreItem *itemPtr, const char *string, int start) {
+    NgramItem *ngPtr = (NgramItem *)itemPtr;
+    unsigned short int value = 0;
+
+    if (treeMatchString(ngPtr->rootNode, string+start, &value)) {
+	return (double) value;
+    }
+
+    return 0.0;
+}
+
+static double
+NgramGramValue(ScoreItem *itemPtr, const char *string, int start, int index) {
+    return NgramWindowValue(itemPtr, string, start);
+}
+
+static double
+NgramMaxValue(ScoreItem *itemPtr) {
+    return (double) NgramTreeMax(((NgramItem *)itemPtr)->rootNode);
+}
+
+static double
+NgramBlockValue(ScoreItem *itemPtr, const char *string, int start, int count) {
+    double totalVal = 0.0;
+    int i;
+
+    for (i=start; i < start+count; i++) {
+	totalVal += NgramWindowValue(itemPtr, string, i);
+    }
+
+    return totalVal;
+}
+
+/*
+ * The largest measure of any node in the tree.  Only the nodes at the
+ * ends of n-grams are ever scored, so this is an upper bound on the
+ * value of any window.
+ */
+
+static unsigned short int
+NgramTreeMax(TreeNode *node) {
+    unsigned short int max;
+    int i;
+
+    if (node == NULL) {
+	return 0;
+    }
+
+    max = node->measure;
+    for (i=0; node->next && node->next[i]; i++) {
+	unsigned short int childMax = NgramTreeMax(node->next[i]);
+
+	if (childMax > max) {
+	    max = childMax;
+	}
+    }
+
+    return max;
+}
+
+static double
+NgramDelta(Tcl_Interp *interp, ScoreItem *itemPtr, const char *oldString, const char *newString, double oldValue, const int *positions, int count) {
+    return ScoreWindowDelta(itemPtr, NgramWindowValue, itemPtr->elemSize,
+	    oldString, newString, oldValue, positions, count);
+}
@@ -65,6 +65,10 @@ int NicodemusCheckValue		_ANSI_ARGS_((Tcl_Interp *, ClientData,
 static int EncodeNicodemus	_ANSI_ARGS_((Tcl_Interp *, CipherItem *,
 				const char *, const char *));
 static char *NicodemusTransform	_ANSI_ARGS_((CipherItem *, const char *, int));
+static int NicodemusBoundValue	_ANSI_ARGS_((Tcl_Interp *, ClientData, int *,
+				int, int, double *));
+static char NicodemusGetPt	_ANSI_ARGS_((int, char, char));
+static int NicodemusSolveAdjacency _ANSI_ARGS_((Tcl_Interp *, CipherItem *));
 
 typedef struct NicodemusItem {
     CipherItem header;
@@ -105,6 +109,14 @@ typedef struct NicodemusItem {
     char *maxKey;
     int  *maxOrder;
     char *fixedKey;
+
+    int prune;		/* Solve with a branch and bound search. */
+    double scoreBound;	/* See DefaultScoreBound() */
+    int windowCount;	/* Scoring windows in the plaintext, or 0 if
+			 * the score can't be bounded. */
+    PermBoundStats pruneStats;
+    int adjacency;	/* Solve from a column adjacency matrix, and
+			 * score this many of the best orders in full. */
 } NicodemusItem;
 
 CipherType NicodemusType = {
@@ -146,6 +158,11 @@ CreateNicodemus(Tcl_Interp *interp, CipherItem *itemPtr, int argc, const char **
     nicPtr->colLength = (int *)NULL;
     nicPtr->startPos = (int *)NULL;
     nicPtr->pt = (char *)NULL;
+    nicPtr->prune = 0;
+    nicPtr->scoreBound = 0.0;
+    nicPtr->windowCount = 0;
+    memset(&nicPtr->pruneStats, 0, sizeof(PermBoundStats));
+    nicPtr->adjacency = 0;
 
     sprintf(temp_ptr, "cipher%d", cipherid);
     Tcl_DStringInit(&dsPtr);
@@ -182,6 +199,14 @@ DeleteNicodemus(ClientData clientData)
 	ckfree(nicPtr->fixedKey);
     }
 
+    if (nicPtr->maxKey) {
+	ckfree(nicPtr->maxKey);
+    }
+
+    if (nicPtr->maxOrder) {
+	ckfree((char *)(nicPtr->maxOrder));
+    }
+
     if (nicPtr->order) {
 	ckfree((char *)(nicPtr->order));
     }
@@ -510,12 +535,87 @@ RestoreNicodemus(Tcl_Interp *interp, CipherItem *itemPtr, const char *key, const
     return TCL_OK;
 }
 
+/*
+ * Get a nicodemus cipher ready to search for the column order of
+ * fromData, using the key letters that were fitted to its columns.
+ */
+
+static int
+NicodemusStartSolve(Tcl_Interp *interp, ClientData fromData, ClientData toData, PermBest *bestPtr)
+{
+    NicodemusItem *fromPtr = (NicodemusItem *)fromData;
+    NicodemusItem *nicPtr = (NicodemusItem *)toData;
+    CipherItem *itemPtr = (CipherItem *)toData;
+    double value;
+
+    if (nicPtr != fromPtr) {
+	memcpy(nicPtr->fixedKey, fromPtr->fixedKey,
+		sizeof(char)*itemPtr->period);
+    }
+
+    if (nicPtr->maxKey) {
+	ckfree(nicPtr->maxKey);
+    }
+    if (nicPtr->maxOrder) {
+	ckfree((char *)(nicPtr->maxOrder));
+    }
+    nicPtr->maxKey = (char *)ckalloc(sizeof(char)*itemPtr->period);
+    nicPtr->maxOrder = (int *)ckalloc(sizeof(int)*itemPtr->period);
+    nicPtr->maxVal = 0.0;
+
+    if (!DefaultScoreBound(&nicPtr->scoreBound)
+	    || !DefaultScoreWindowSum(itemPtr->ciphertext, itemPtr->length,
+		&value, &nicPtr->windowCount)) {
+	nicPtr->windowCount = 0;
+    }
+
+    itemPtr->curIteration = 0;
+
+    PermBestInit(bestPtr, &nicPtr->maxVal, &itemPtr->curIteration);
+    PermBestAdd(bestPtr, nicPtr->maxKey, sizeof(char)*itemPtr->period);
+    PermBestAdd(bestPtr, nicPtr->maxOrder, sizeof(int)*itemPtr->period);
+
+    return TCL_OK;
+}
+
 static int
 SolveNicodemus(Tcl_Interp *interp, CipherItem *itemPtr, char *maxkey)
 {
     NicodemusItem *nicPtr = (NicodemusItem *)itemPtr;
     int i;
     int	result;
+    PermCheckpoint checkpoint;
+    PermBest best;
+
+    if (nicPtr->adjacency && itemPtr->threads > 1) {
+	Tcl_SetResult(interp, "The adjacency solve can't be used with -threads",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (nicPtr->adjacency
+	    && (itemPtr->checkpointFile || itemPtr->resumeFile)) {
+	Tcl_SetResult(interp, "Checkpoints can't be used with -adjacency",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (nicPtr->prune && itemPtr->threads > 1) {
+	Tcl_SetResult(interp, "Pruning can't be used with -threads",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (nicPtr->prune && (itemPtr->checkpointFile || itemPtr->resumeFile)) {
+	Tcl_SetResult(interp, "Checkpoints can't be used with -prune",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (itemPtr->rangeCount && (nicPtr->prune || nicPtr->adjacency)) {
+	Tcl_SetResult(interp, "Ranges can't be used with -prune or -adjacency",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (CipherCheckRange(interp, itemPtr) != TCL_OK) {
+	return TCL_ERROR;
+    }
 
     /*
      * Fit each column to find the best match against a standard english
@@ -530,19 +630,38 @@ SolveNicodemus(Tcl_Interp *interp, CipherItem *itemPtr, char *maxkey)
      * Now solve as an incomplete columnar.
      */
 
-    if (nicPtr->maxKey) {
-	ckfree(nicPtr->maxKey);
-    }
-    if (nicPtr->maxOrder) {
-	ckfree((char *)(nicPtr->maxOrder));
+    NicodemusStartSolve(interp, (ClientData)itemPtr, (ClientData)itemPtr,
+	    &best);
+    memset(&nicPtr->pruneStats, 0, sizeof(PermBoundStats));
+
+    if (nicPtr->adjacency) {
+	result = NicodemusSolveAdjacency(interp, itemPtr);
+    } else if (nicPtr->prune) {
+	result = _internalDoPermBoundCmd((ClientData)itemPtr, interp,
+		itemPtr->period, NicodemusCheckValue, NicodemusBoundValue,
+		&nicPtr->maxVal, &nicPtr->pruneStats);
+    } else if (itemPtr->rangeCount) {
+	result = _internalDoPermRangeCmd((ClientData)itemPtr, interp,
+		itemPtr->period, NicodemusCheckValue, itemPtr->rangeStart,
+		itemPtr->rangeCount);
+    } else if (itemPtr->threads > 1) {
+	result = _internalDoPermThreadCmd((ClientData)itemPtr, interp,
+		itemPtr->period, NicodemusCheckValue, itemPtr->threads,
+		NicodemusStartSolve, &best);
+    } else {
+	PermCheckpointInit(&checkpoint, itemPtr->checkpointFile,
+		itemPtr->resumeFile, itemPtr->checkpointInterval,
+		itemPtr->ciphertext, &itemPtr->curIteration);
+	PermCheckpointAdd(&checkpoint, nicPtr->maxKey,
+		sizeof(char)*itemPtr->period);
+	PermCheckpointAdd(&checkpoint, nicPtr->maxOrder,
+		sizeof(int)*itemPtr->period);
+	PermCheckpointAdd(&checkpoint, &nicPtr->maxVal,
+		sizeof(nicPtr->maxVal));
+
+	result = _internalDoPermCheckpointCmd((ClientData)itemPtr, interp,
+		itemPtr->period, NicodemusCheckValue, &checkpoint);
     }
-    nicPtr->maxKey = (char *)ckalloc(sizeof(char)*itemPtr->period);
-    nicPtr->maxOrder = (int *)ckalloc(sizeof(int)*itemPtr->period);
-    nicPtr->maxVal = 0.0;
-
-    itemPtr->curIteration = 0;
-
-    result = _internalDoPermCmd((ClientData)itemPtr, interp, itemPtr->period, NicodemusCheckValue);
 
     if (result == TCL_OK) {
 	for(i=0; i < itemPtr->period; i++) {
@@ -563,6 +682,154 @@ SolveNicodemus(Tcl_Interp *interp, CipherItem *itemPtr, char *maxkey)
     return result;
 }
 
+/*
+ * Decode one letter from a column with the given key letter.
+ */
+
+static char
+NicodemusGetPt(int encodingType, char key, char ct)
+{
+    char pt;
+
+    switch (encodingType) {
+	case VIG_TYPE:
+	    pt = VigenereGetPt(key, ct);
+	    break;
+	case VAR_TYPE:
+	    pt = VariantGetPt(key, ct);
+	    break;
+	case BEA_TYPE:
+	    pt = BeaufortGetPt(key, ct);
+	    break;
+	case PRT_TYPE:
+	    pt = PortaGetPt(key, ct);
+	    break;
+	default:
+	    abort();
+    }
+
+    return pt ? pt : ' ';
+}
+
+/*
+ * Solve for the column order by scoring the digrams of every pair of
+ * decoded columns side by side once, over the complete blocks of 5 rows.
+ * The orders whose adjacent pairs score best are found from those
+ * scores, and only those orders have their plaintext scored in full.
+ */
+
+static int
+NicodemusSolveAdjacency(Tcl_Interp *interp, CipherItem *itemPtr)
+{
+    NicodemusItem *nicPtr = (NicodemusItem *)itemPtr;
+    int period = itemPtr->period;
+    int blocksize = period * 5;
+    int rows = (itemPtr->length / blocksize) * 5;
+    int size = nicPtr->adjacency;
+    Tcl_WideUInt orderCount = 1;
+    char *columns;
+    double *matrix, *values;
+    int *orders;
+    int a, b, i, row, found;
+    int result = TCL_OK;
+
+    if (rows == 0) {
+	Tcl_SetResult(interp,
+		"The adjacency solve needs at least one complete block",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    for (i=2; i <= period && orderCount < (Tcl_WideUInt)size; i++) {
+	orderCount *= i;
+    }
+    if (orderCount < (Tcl_WideUInt)size) {
+	size = (int)orderCount;
+    }
+
+    if (PermAdjacencyAlloc(interp, size, period, &orders, &values)
+	    != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    columns = (char *)ckalloc(sizeof(char) * period * (rows + 1));
+    matrix = (double *)ckalloc(sizeof(double) * period * period);
+    for (a=0; a < period; a++) {
+	for (row=0; row < rows; row++) {
+	    columns[a*(rows+1) + row] = NicodemusGetPt(nicPtr->encodingType,
+		    nicPtr->fixedKey[a],
+		    itemPtr->ciphertext[(row/5)*blocksize + a*5 + row%5]);
+	}
+	columns[a*(rows+1) + rows] = '\0';
+    }
+    for (a=0; a < period; a++) {
+	for (b=0; b < period; b++) {
+	    matrix[a*period + b] = (a == b) ? 0.0
+		: get_digram_values(columns + a*(rows+1),
+			columns + b*(rows+1), itemPtr->language);
+	}
+    }
+
+    found = PermAdjacencyOrders(matrix, period, size, orders, values,
+	    &nicPtr->pruneStats);
+
+    for (a=0; a < found && result == TCL_OK; a++) {
+	result = NicodemusCheckValue(interp, (ClientData)itemPtr,
+		orders + a*period, period);
+    }
+
+    ckfree(columns);
+    ckfree((char *)matrix);
+    ckfree((char *)orders);
+    ckfree((char *)values);
+
+    return result;
+}
+
+/*
+ * Bound the score of every column order that puts the columns in perm at
+ * the first length positions of the plaintext.  Only the complete blocks
+ * of 5 rows are placed, and only the windows whose letters all come from
+ * those columns are scored.  Every other window is assumed to score as
+ * well as any window can.
+ */
+
+static int
+NicodemusBoundValue(Tcl_Interp *interp, ClientData clientData, int *perm, int length, int n, double *boundPtr)
+{
+    NicodemusItem *nicPtr = (NicodemusItem *)clientData;
+    CipherItem *itemPtr = (CipherItem *)clientData;
+    int period = itemPtr->period;
+    int blocksize = period * 5;
+    int rows = (itemPtr->length / blocksize) * 5;
+    int i, row, count, windows = 0;
+    double value, total = 0.0;
+
+    if (nicPtr->windowCount <= 0 || rows == 0) {
+	return TCL_CONTINUE;
+    }
+
+    for (i=0; i < length; i++) {
+	char key = nicPtr->fixedKey[perm[i]];
+
+	for (row=0; row < rows; row++) {
+	    nicPtr->pt[row*period + i] = NicodemusGetPt(nicPtr->encodingType,
+		    key, itemPtr->ciphertext[(row/5)*blocksize + perm[i]*5
+			+ row%5]);
+	}
+    }
+
+    for (row=0; row < rows; row++) {
+	DefaultScoreWindowSum(nicPtr->pt + row*period, length, &value, &count);
+	total += value;
+	windows += count;
+    }
+
+    *boundPtr = total + (nicPtr->windowCount - windows) * nicPtr->scoreBound;
+
+    return TCL_OK;
+}
+
 int
 NicodemusCheckValue(Tcl_Interp *interp, ClientData clientData, int *key, int keylen)
 {
@@ -1041,6 +1308,26 @@ NicodemusCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **a
 		Tcl_SetResult(interp, "", TCL_STATIC);
 	    }
 	    return TCL_OK;
+	} else if (strncmp(argv[1], "-checkpoint", 11) == 0 ||
+		   strncmp(argv[1], "-resume", 7) == 0) {
+	    return CipherGetCheckpoint(interp, itemPtr, argv[1]);
+	} else if (strcmp(argv[1], "-threads") == 0) {
+	    sprintf(temp_str, "%d", itemPtr->threads);
+	    Tcl_SetResult(interp, temp_str, TCL_VOLATILE);
+	    return TCL_OK;
+	} else if (strcmp(argv[1], "-range") == 0) {
+	    return CipherGetRange(interp, itemPtr);
+	} else if (strcmp(argv[1], "-prune") == 0) {
+	    sprintf(temp_str, "%d", nicPtr->prune);
+	    Tcl_SetResult(interp, temp_str, TCL_VOLATILE);
+	    return TCL_OK;
+	} else if (strcmp(argv[1], "-prunestats") == 0) {
+	    PermBoundStatsResult(interp, &nicPtr->pruneStats);
+	    return TCL_OK;
+	} else if (strcmp(argv[1], "-adjacency") == 0) {
+	    sprintf(temp_str, "%d", nicPtr->adjacency);
+	    Tcl_SetResult(interp, temp_str, TCL_VOLATILE);
+	    return TCL_OK;
 	} else if (strncmp(argv[1], "-language", 8) == 0) {
 	    Tcl_SetResult(interp, cipherGetLanguage(itemPtr->language),
 		    TCL_VOLATILE);
@@ -1089,6 +1376,33 @@ NicodemusCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **a
 		    return TCL_ERROR;
 		}
 		Tcl_SetObjResult(interp, Tcl_NewStringObj(argv[1], -1));
+	    } else if (strncmp(*argv, "-checkpoint", 11) == 0 ||
+		strncmp(*argv, "-resume", 7) == 0) {
+		if (CipherSetCheckpoint(interp, itemPtr, argv[0], argv[1])
+			!= TCL_OK) {
+		    return TCL_ERROR;
+		}
+	    } else if (strcmp(*argv, "-threads") == 0) {
+		if (sscanf(argv[1], "%d", &i) != 1 || i < 1) {
+		    Tcl_SetResult(interp, "Threads must be at least 1",
+			    TCL_STATIC);
+		    return TCL_ERROR;
+		}
+		itemPtr->threads = i;
+	    } else if (strcmp(*argv, "-range") == 0) {
+		if (CipherSetRange(interp, itemPtr, argv[1]) != TCL_OK) {
+		    return TCL_ERROR;
+		}
+	    } else if (strcmp(*argv, "-prune") == 0) {
+		if (Tcl_GetBoolean(interp, argv[1], &nicPtr->prune)
+			!= TCL_OK) {
+		    return TCL_ERROR;
+		}
+	    } else if (strcmp(*argv, "-adjacency") == 0) {
+		if (PermGetAdjacency(interp, argv[1], &nicPtr->adjacency)
+			!= TCL_OK) {
+		    return TCL_ERROR;
+		}
 	    } else if (strncmp(*argv, "-language", 8) == 0) {
 		itemPtr->language = cipherSelectLanguage(argv[1]);
 		Tcl_SetResult(interp, cipherGetLanguage(itemPtr->language),
@@ -132,6 +132,10 @@ DeleteNitrans(ClientData clientData)
 	ckfree(nitransPtr->key);
     }
 
+    if (nitransPtr->maxKey != NULL) {
+	ckfree(nitransPtr->maxKey);
+    }
+
     DeleteCipher(clientData);
 }
 
@@ -515,12 +519,45 @@ NitransCheckSolutionValue(Tcl_Interp *interp, ClientData clientData, int *key, i
     return TCL_OK;
 }
 
+/*
+ * Get a nitrans cipher ready to search for the key of fromData.  The
+ * search permutes the columns of the current key.
+ */
+
+static int
+NitransStartSolve(Tcl_Interp *interp, ClientData fromData, ClientData toData, PermBest *bestPtr)
+{
+    NitransItem *fromPtr = (NitransItem *)fromData;
+    NitransItem *nitransPtr = (NitransItem *)toData;
+    CipherItem *itemPtr = (CipherItem *)toData;
+
+    if (nitransPtr != fromPtr) {
+	memcpy(nitransPtr->key, fromPtr->key, sizeof(char)*itemPtr->period);
+    }
+
+    itemPtr->curIteration = 0;
+    nitransPtr->maxVal = 0;
+    if (nitransPtr->maxKey) {
+	ckfree((char *)nitransPtr->maxKey);
+    }
+
+    nitransPtr->maxKey = (char *)ckalloc(sizeof(char)*itemPtr->period);
+    nitransPtr->readDir = VERTICAL;
+
+    PermBestInit(bestPtr, &nitransPtr->maxVal, &itemPtr->curIteration);
+    PermBestAdd(bestPtr, nitransPtr->maxKey, sizeof(char)*itemPtr->period);
+
+    return TCL_OK;
+}
+
 static int
 SolveNitrans(Tcl_Interp *interp, CipherItem *itemPtr, char *maxkey)
 {
     NitransItem *nitransPtr = (NitransItem *)itemPtr;
     int i, result;
     char *result_key = (char *)NULL;
+    PermCheckpoint checkpoint;
+    PermBest best;
 
     if (itemPtr->ciphertext == (char *)NULL) {
 	Tcl_SetResult(interp,
@@ -529,18 +566,35 @@ SolveNitrans(Tcl_Interp *interp, CipherItem *itemPtr, char *maxkey)
 	return TCL_ERROR;
     }
 
-    itemPtr->curIteration = 0;
-    nitransPtr->maxVal = 0;
-    if (nitransPtr->maxKey) {
-	ckfree((char *)nitransPtr->maxKey);
+    if (CipherCheckRange(interp, itemPtr) != TCL_OK) {
+	return TCL_ERROR;
     }
 
-    nitransPtr->maxKey = (char *)ckalloc(sizeof(char)*itemPtr->period);
+    NitransStartSolve(interp, (ClientData)itemPtr, (ClientData)itemPtr,
+	    &best);
     result_key = (char *)ckalloc(sizeof(char)*itemPtr->period + 1);
 
-    nitransPtr->readDir = VERTICAL;
-    result = _internalDoPermCmd((ClientData)itemPtr,
-	    interp, itemPtr->period, NitransCheckSolutionValue);
+    if (itemPtr->rangeCount) {
+	result = _internalDoPermRangeCmd((ClientData)itemPtr, interp,
+		itemPtr->period, NitransCheckSolutionValue,
+		itemPtr->rangeStart, itemPtr->rangeCount);
+    } else if (itemPtr->threads > 1) {
+	result = _internalDoPermThreadCmd((ClientData)itemPtr, interp,
+		itemPtr->period, NitransCheckSolutionValue,
+		itemPtr->threads, NitransStartSolve, &best);
+    } else {
+	PermCheckpointInit(&checkpoint, itemPtr->checkpointFile,
+		itemPtr->resumeFile, itemPtr->checkpointInterval,
+		itemPtr->ciphertext, &itemPtr->curIteration);
+	PermCheckpointAdd(&checkpoint, nitransPtr->maxKey,
+		sizeof(char)*itemPtr->period);
+	PermCheckpointAdd(&checkpoint, &nitransPtr->maxVal,
+		sizeof(nitransPtr->maxVal));
+
+	result = _internalDoPermCheckpointCmd((ClientData)itemPtr,
+		interp, itemPtr->period, NitransCheckSolutionValue,
+		&checkpoint);
+    }
 
     /*
      * Now apply the best key
@@ -554,11 +608,13 @@ SolveNitrans(Tcl_Interp *interp, CipherItem *itemPtr, char *maxkey)
         result_key[i] = '\0';
 
         Tcl_SetResult(interp, result_key, TCL_DYNAMIC);
+    } else {
+	ckfree(result_key);
     }
 
     return result;
 }
-
+
 int
 NitransCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **argv)
 {
@@ -669,6 +725,15 @@ NitransCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **arg
 		Tcl_SetResult(interp, "", TCL_STATIC);
 	    }
 	    return TCL_OK;
+	} else if (strncmp(argv[1], "-checkpoint", 11) == 0 ||
+		   strncmp(argv[1], "-resume", 7) == 0) {
+	    return CipherGetCheckpoint(interp, itemPtr, argv[1]);
+	} else if (strcmp(argv[1], "-threads") == 0) {
+	    sprintf(temp_str, "%d", itemPtr->threads);
+	    Tcl_SetResult(interp, temp_str, TCL_VOLATILE);
+	    return TCL_OK;
+	} else if (strcmp(argv[1], "-range") == 0) {
+	    return CipherGetRange(interp, itemPtr);
 	} else if (strncmp(argv[1], "-language", 8) == 0) {
 	    Tcl_SetResult(interp, cipherGetLanguage(itemPtr->language),
 		    TCL_VOLATILE);
@@ -722,6 +787,23 @@ NitransCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **arg
 		    Tcl_AppendResult(interp, "Invalid direction.  Must be one of vertical or horizontal", (char *)NULL);
 		    return TCL_ERROR;
 		}
+	    } else if (strncmp(*argv, "-checkpoint", 11) == 0 ||
+		strncmp(*argv, "-resume", 7) == 0) {
+		if (CipherSetCheckpoint(interp, itemPtr, argv[0], argv[1])
+			!= TCL_OK) {
+		    return TCL_ERROR;
+		}
+	    } else if (strcmp(*argv, "-threads") == 0) {
+		if (sscanf(argv[1], "%d", &i) != 1 || i < 1) {
+		    Tcl_SetResult(interp, "Threads must be at least 1",
+			    TCL_STATIC);
+		    return TCL_ERROR;
+		}
+		itemPtr->threads = i;
+	    } else if (strcmp(*argv, "-range") == 0) {
+		if (CipherSetRange(interp, itemPtr, argv[1]) != TCL_OK) {
+		    return TCL_ERROR;
+		}
 	    } else if (strncmp(*argv, "-language", 8) == 0) {
 		itemPtr->language = cipherSelectLanguage(argv[1]);
 		Tcl_SetResult(interp, cipherGetLanguage(itemPtr->language),
@@ -23,40 +23,123 @@
 
 #include <perm.h>
 #include <string.h>
+#include <limits.h>
+#include <checkpoint.h>
 
 #include <cipherDebug.h>
 
+/*
+ * How many permutations to test between looking at the clock to see if
+ * a checkpoint is due.
+ */
+
+#define PERM_CHECK_INTERVAL	4096
+
+/*
+ * The most permutations that the permute command hands to a script in
+ * one batch.
+ */
+
+#define PERM_BATCH_MAX		65536
+
+/*
+ * The command prefix that the permute command calls with each batch of
+ * permutations.  The prefix is split into words once, and the words and
+ * the list of permutations are handed to Tcl_EvalObjv, so no string is
+ * built for a permutation.  The elements of the list are shared integer
+ * objects, one for each number from 0 to n-1.
+ */
+
+typedef struct PermScript {
+    int objc;		/* The words of the prefix, plus the list. */
+    Tcl_Obj **objv;
+    Tcl_Obj **numbers;	/* numbers[i] holds the integer i. */
+    Tcl_Obj **batch;	/* The elements of the permutations so far. */
+    int length;		/* The length of each permutation. */
+    int batchSize;	/* The most permutations to pass in one call. */
+    int count;		/* The number of permutations in batch. */
+} PermScript;
+
 typedef struct PermInfo {
     int length;
     int *dir;
     int *p;
     int *pi;
-    char *cmd_prefix;
+    int *c;		/* The move being tried at each level. */
+    PermScript *script;	/* Only used by the permute command. */
     int (*testFunc)(Tcl_Interp *, ClientData, int *, int);
+
+    /*
+     * Checkpointing.
+     */
+
+    PermCheckpoint *cpPtr;
+    int resuming;	/* Set until the saved permutation is reached. */
+    unsigned long tested;
+    Tcl_Time lastCheckpoint;
+
+    /*
+     * When searching one shard of a partitioned search, p permutes the
+     * elements in tail, and the full permutation that is tested is
+     * built in perm after the fixed prefix.
+     */
+
+    int *perm;
+    int *tail;
+    int prefixLength;
 } PermInfo;
 
+static int PermWriteCheckpoint	_ANSI_ARGS_((Tcl_Interp *, PermInfo *, int));
+static int PermReadCheckpoint	_ANSI_ARGS_((Tcl_Interp *, PermInfo *, int *));
+
 int
 _internalDoPerm(Tcl_Interp *interp, ClientData clientData, int n, PermInfo *pInfo)
 {
     int i, result;
 
     if (n >= pInfo->length) {
-	return pInfo->testFunc(interp, clientData, pInfo->p, pInfo->length);
-    } else {
-	result = _internalDoPerm(interp, clientData, n+1, pInfo);
-	if (result != TCL_OK) {
-	    return result;
+	/*
+	 * When resuming, the first permutation we reach is the one that
+	 * was tested just before the checkpoint was written.
+	 */
+
+	if (pInfo->resuming) {
+	    pInfo->resuming = 0;
+	    return TCL_OK;
+	}
+
+	if (pInfo->perm) {
+	    for (i=0; i < pInfo->length; i++) {
+		pInfo->perm[pInfo->prefixLength + i] = pInfo->tail[pInfo->p[i]];
+	    }
+	    result = pInfo->testFunc(interp, clientData, pInfo->perm,
+		    pInfo->prefixLength + pInfo->length);
+	} else {
+	    result = pInfo->testFunc(interp, clientData, pInfo->p,
+		    pInfo->length);
 	}
-	for (i=0; i<n; ++i) {
-	    int z;
-	    /*
-	     * Move(n, dir[n]);
-	     */
-	    z = pInfo->p[pInfo->pi[n]+pInfo->dir[n]];
-	    pInfo->p[pInfo->pi[n]] = z;
-	    pInfo->p[pInfo->pi[n]+pInfo->dir[n]] = n;
-	    pInfo->pi[z] = pInfo->pi[n];
-	    pInfo->pi[n] = pInfo->pi[n] + pInfo->dir[n];
+
+	if (result == TCL_OK && pInfo->cpPtr
+		&& ++pInfo->tested % PERM_CHECK_INTERVAL == 0
+		&& CheckpointDue(&pInfo->lastCheckpoint,
+		    pInfo->cpPtr->interval)) {
+	    result = PermWriteCheckpoint(interp, pInfo, 0);
+	}
+	return result;
+    } else {
+	for (i = (pInfo->resuming ? pInfo->c[n] : 0); i <= n; ++i) {
+	    if (i > 0 && !pInfo->resuming) {
+		int z;
+		/*
+		 * Move(n, dir[n]);
+		 */
+		z = pInfo->p[pInfo->pi[n]+pInfo->dir[n]];
+		pInfo->p[pInfo->pi[n]] = z;
+		pInfo->p[pInfo->pi[n]+pInfo->dir[n]] = n;
+		pInfo->pi[z] = pInfo->pi[n];
+		pInfo->pi[n] = pInfo->pi[n] + pInfo->dir[n];
+	    }
+	    pInfo->c[n] = i;
 
 	    result = _internalDoPerm(interp, clientData, n+1, pInfo);
 	    if (result != TCL_OK) {
@@ -69,6 +152,193 @@ _internalDoPerm(Tcl_Interp *interp, ClientData clientData, int n, PermInfo *pInf
     return TCL_OK;
 }
 
+/*
+ * Set up a checkpoint description for a permutation search.  The
+ * fileName and resumeName may be NULL.
+ */
+
+void
+PermCheckpointInit(PermCheckpoint *cpPtr, const char *fileName, const char *resumeName, double interval, const char *text, unsigned long *iterationPtr)
+{
+    cpPtr->fileName = fileName;
+    cpPtr->resumeName = resumeName;
+    cpPtr->interval = interval;
+    cpPtr->text = text;
+    cpPtr->iterationPtr = iterationPtr;
+    cpPtr->regionCount = 0;
+}
+
+/*
+ * Add a block of solver state to be saved with each checkpoint.
+ */
+
+void
+PermCheckpointAdd(PermCheckpoint *cpPtr, void *data, int size)
+{
+    if (cpPtr->regionCount < PERM_CHECKPOINT_REGIONS) {
+	cpPtr->regions[cpPtr->regionCount].data = data;
+	cpPtr->regions[cpPtr->regionCount].size = size;
+	cpPtr->regionCount++;
+    }
+}
+
+/*
+ * Set up the description of where a solver keeps its best key.
+ */
+
+void
+PermBestInit(PermBest *bestPtr, double *valuePtr, unsigned long *iterationPtr)
+{
+    bestPtr->valuePtr = valuePtr;
+    bestPtr->iterationPtr = iterationPtr;
+    bestPtr->regionCount = 0;
+}
+
+/*
+ * Add a block of the best key.
+ */
+
+void
+PermBestAdd(PermBest *bestPtr, void *data, int size)
+{
+    if (bestPtr->regionCount < PERM_CHECKPOINT_REGIONS) {
+	bestPtr->regions[bestPtr->regionCount].data = data;
+	bestPtr->regions[bestPtr->regionCount].size = size;
+	bestPtr->regionCount++;
+    }
+}
+
+/*
+ * Save the position of the search and the solver's state.  The position
+ * is the Steinhaus-Johnson-Trotter state along with the move being
+ * tried at each level of the recursion.
+ */
+
+static int
+PermWriteCheckpoint(Tcl_Interp *interp, PermInfo *pInfo, int done)
+{
+    PermCheckpoint *cpPtr = pInfo->cpPtr;
+    Checkpoint checkpoint;
+    int size = sizeof(int) * pInfo->length;
+    int i, result;
+
+    if (cpPtr->fileName == (const char *)NULL) {
+	return TCL_OK;
+    }
+
+    CheckpointInit(&checkpoint, CHECKPOINT_PERM);
+    CheckpointPutInt(&checkpoint, pInfo->length);
+    CheckpointPutText(&checkpoint, cpPtr->text);
+    CheckpointPutInt(&checkpoint, cpPtr->regionCount);
+    for (i=0; i < cpPtr->regionCount; i++) {
+	CheckpointPutInt(&checkpoint, cpPtr->regions[i].size);
+	CheckpointPutBytes(&checkpoint, cpPtr->regions[i].data,
+		cpPtr->regions[i].size);
+    }
+    CheckpointPutInt(&checkpoint, done);
+    CheckpointPutInt(&checkpoint,
+	    (cpPtr->iterationPtr ? *cpPtr->iterationPtr : 0));
+    CheckpointPutBytes(&checkpoint, pInfo->c, size);
+    CheckpointPutBytes(&checkpoint, pInfo->p, size);
+    CheckpointPutBytes(&checkpoint, pInfo->pi, size);
+    CheckpointPutBytes(&checkpoint, pInfo->dir, size);
+
+    result = CheckpointWrite(interp, &checkpoint, cpPtr->fileName);
+    CheckpointFree(&checkpoint);
+
+    return result;
+}
+
+/*
+ * Restore the position of the search and the solver's state from a
+ * checkpoint.  *donePtr is set if the checkpointed search had already
+ * finished.
+ */
+
+static int
+PermReadCheckpoint(Tcl_Interp *interp, PermInfo *pInfo, int *donePtr)
+{
+    PermCheckpoint *cpPtr = pInfo->cpPtr;
+    Checkpoint checkpoint;
+    Tcl_WideInt value;
+    int n = pInfo->length;
+    int size = sizeof(int) * n;
+    int i;
+
+    if (CheckpointRead(interp, &checkpoint, cpPtr->resumeName,
+		CHECKPOINT_PERM) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    if (CheckpointGetInt(interp, &checkpoint, &value) != TCL_OK) {
+	goto error;
+    }
+    if (value != n) {
+	CheckpointMismatch(interp, &checkpoint);
+	goto error;
+    }
+    if (CheckpointCheckText(interp, &checkpoint, cpPtr->text) != TCL_OK) {
+	goto error;
+    }
+    if (CheckpointGetInt(interp, &checkpoint, &value) != TCL_OK) {
+	goto error;
+    }
+    if (value != cpPtr->regionCount) {
+	CheckpointMismatch(interp, &checkpoint);
+	goto error;
+    }
+    for (i=0; i < cpPtr->regionCount; i++) {
+	if (CheckpointGetInt(interp, &checkpoint, &value) != TCL_OK) {
+	    goto error;
+	}
+	if (value != cpPtr->regions[i].size) {
+	    CheckpointMismatch(interp, &checkpoint);
+	    goto error;
+	}
+	if (CheckpointGetBytes(interp, &checkpoint, cpPtr->regions[i].data,
+		    cpPtr->regions[i].size) != TCL_OK) {
+	    goto error;
+	}
+    }
+    if (CheckpointGetInt(interp, &checkpoint, &value) != TCL_OK) {
+	goto error;
+    }
+    *donePtr = (int)value;
+    if (CheckpointGetInt(interp, &checkpoint, &value) != TCL_OK) {
+	goto error;
+    }
+    if (cpPtr->iterationPtr) {
+	*cpPtr->iterationPtr = (unsigned long)value;
+    }
+    if (CheckpointGetBytes(interp, &checkpoint, pInfo->c, size) != TCL_OK
+	    || CheckpointGetBytes(interp, &checkpoint, pInfo->p, size) != TCL_OK
+	    || CheckpointGetBytes(interp, &checkpoint, pInfo->pi, size) != TCL_OK
+	    || CheckpointGetBytes(interp, &checkpoint, pInfo->dir, size) != TCL_OK) {
+	goto error;
+    }
+
+    /*
+     * Don't let a damaged checkpoint send us outside of the arrays.
+     */
+
+    for (i=0; i < n; i++) {
+	if (pInfo->c[i] < 0 || pInfo->c[i] > i
+		|| pInfo->p[i] < 0 || pInfo->p[i] >= n
+		|| pInfo->pi[i] < 0 || pInfo->pi[i] >= n
+		|| (pInfo->dir[i] != 1 && pInfo->dir[i] != -1)) {
+	    CheckpointMismatch(interp, &checkpoint);
+	    goto error;
+	}
+    }
+
+    CheckpointFree(&checkpoint);
+    return TCL_OK;
+
+error:
+    CheckpointFree(&checkpoint);
+    return TCL_ERROR;
+}
+
 /*
  * Call this to perform a search of all permutations of a list
  * of integers.  The given command is called whenever a new permutation
@@ -79,26 +349,151 @@ _internalDoPerm(Tcl_Interp *interp, ClientData clientData, int n, PermInfo *pInf
 
 int
 _internalDoPermCmd(ClientData clientData, Tcl_Interp *interp, int n, int (*testFunc)(Tcl_Interp *, ClientData, int *, int))
+{
+    return _internalDoPermCheckpointCmd(clientData, interp, n, testFunc,
+	    (PermCheckpoint *)NULL);
+}
+
+/*
+ * The same as _internalDoPermCmd, but the search periodically saves its
+ * position to a checkpoint file, and can be resumed from one.  cpPtr may
+ * be NULL if no checkpointing is wanted.
+ */
+
+int
+_internalDoPermCheckpointCmd(ClientData clientData, Tcl_Interp *interp, int n, int (*testFunc)(Tcl_Interp *, ClientData, int *, int), PermCheckpoint *cpPtr)
 {
     PermInfo pInfo;
     int i, result;
+    int done = 0;
 
     if (n <= 1) {
 	Tcl_SetResult(interp, "Length of permuted array must be > 1\n", TCL_STATIC);
 	return TCL_ERROR;
     }
 
+    if (cpPtr && !cpPtr->fileName && !cpPtr->resumeName) {
+	cpPtr = (PermCheckpoint *)NULL;
+    }
+
     pInfo.length = n;
     pInfo.dir = (int *)ckalloc(sizeof(int) * (n + 1));
     pInfo.p = (int *)ckalloc(sizeof(int) * (n + 1));
     pInfo.pi = (int *)ckalloc(sizeof(int) * (n + 1));
-    pInfo.cmd_prefix = (char *)NULL;
+    pInfo.c = (int *)ckalloc(sizeof(int) * (n + 1));
+    pInfo.script = (PermScript *)NULL;
     pInfo.testFunc = testFunc;
+    pInfo.cpPtr = cpPtr;
+    pInfo.resuming = 0;
+    pInfo.tested = 0;
+    pInfo.perm = (int *)NULL;
+    Tcl_GetTime(&pInfo.lastCheckpoint);
 
     for(i=0; i < n; i++) {
 	pInfo.dir[i] = -1;
 	pInfo.p[i] = i;
 	pInfo.pi[i] = i;
+	pInfo.c[i] = 0;
+    }
+
+    if (cpPtr && cpPtr->resumeName) {
+	result = PermReadCheckpoint(interp, &pInfo, &done);
+	pInfo.resuming = 1;
+    } else {
+	result = TCL_OK;
+    }
+
+    if (result == TCL_OK && !done) {
+	result = _internalDoPerm(interp, clientData, 0, &pInfo);
+    }
+
+    if (result == TCL_OK && cpPtr) {
+	result = PermWriteCheckpoint(interp, &pInfo, 1);
+    }
+
+    ckfree((char *)pInfo.dir);
+    ckfree((char *)pInfo.p);
+    ckfree((char *)pInfo.pi);
+    ckfree((char *)pInfo.c);
+
+    return result;
+}
+
+/*
+ * A partitioned search splits the permutations of n elements into
+ * shards that can be searched independently, by fixing the first one or
+ * two elements of the permutation.  The number of shards only depends
+ * on n.
+ */
+
+static int
+PermPrefixLength(int n)
+{
+    return (n > 3) ? 2 : 1;
+}
+
+int
+PermShardCount(int n)
+{
+    int i, count = 1;
+
+    for (i=0; i < PermPrefixLength(n); i++) {
+	count *= n - i;
+    }
+
+    return count;
+}
+
+/*
+ * Test every permutation of n elements that starts with the
+ * prefixLength elements of prefix.  The rest of the elements are
+ * permuted with the same Steinhaus-Johnson-Trotter walk as
+ * _internalDoPermCmd, so consecutive permutations only differ by a swap
+ * of two neighboring elements.
+ */
+
+static int
+PermSearchPrefix(ClientData clientData, Tcl_Interp *interp, int n, int (*testFunc)(Tcl_Interp *, ClientData, int *, int), const int *prefix, int prefixLength)
+{
+    PermInfo pInfo;
+    int i, j, result;
+
+    pInfo.length = n - prefixLength;
+    pInfo.dir = (int *)ckalloc(sizeof(int) * (n + 1));
+    pInfo.p = (int *)ckalloc(sizeof(int) * (n + 1));
+    pInfo.pi = (int *)ckalloc(sizeof(int) * (n + 1));
+    pInfo.c = (int *)ckalloc(sizeof(int) * (n + 1));
+    pInfo.perm = (int *)ckalloc(sizeof(int) * (n + 1));
+    pInfo.tail = (int *)ckalloc(sizeof(int) * (n + 1));
+    pInfo.prefixLength = prefixLength;
+    pInfo.script = (PermScript *)NULL;
+    pInfo.testFunc = testFunc;
+    pInfo.cpPtr = (PermCheckpoint *)NULL;
+    pInfo.resuming = 0;
+    pInfo.tested = 0;
+
+    /*
+     * Whatever isn't in the prefix, in order, is permuted.
+     */
+
+    for (i=0; i < n; i++) {
+	pInfo.tail[i] = 0;
+    }
+    for (i=0; i < prefixLength; i++) {
+	pInfo.perm[i] = prefix[i];
+	pInfo.tail[prefix[i]] = 1;
+    }
+    for (i=0, j=0; i < n; i++) {
+	if (!pInfo.tail[i]) {
+	    pInfo.tail[j++] = i;
+	}
+    }
+
+    for(i=0; i < pInfo.length; i++) {
+	pInfo.dir[i] = -1;
+	pInfo.p[i] = i;
+	pInfo.pi[i] = i;
+	pInfo.c[i] = 0;
     }
 
     result = _internalDoPerm(interp, clientData, 0, &pInfo);
@@ -106,33 +501,509 @@ _internalDoPermCmd(ClientData clientData, Tcl_Interp *interp, int n, int (*testF
     ckfree((char *)pInfo.dir);
     ckfree((char *)pInfo.p);
     ckfree((char *)pInfo.pi);
+    ckfree((char *)pInfo.c);
+    ckfree((char *)pInfo.perm);
+    ckfree((char *)pInfo.tail);
 
     return result;
 }
 
 /*
- * Function called by PermCmd.  This does all of the work.
+ * Test every permutation in one shard of a partitioned search.
  */
 
 int
-doPerm (Tcl_Interp *interp, int n, PermInfo *pInfo)
+_internalDoPermShardCmd(ClientData clientData, Tcl_Interp *interp, int n, int (*testFunc)(Tcl_Interp *, ClientData, int *, int), int shard)
+{
+    int prefixLength = PermPrefixLength(n);
+    int size = PermShardCount(n);
+    int prefix[2];
+    int *unused;
+    int i, j, result;
+
+    if (n <= 1) {
+	Tcl_SetResult(interp, "Length of permuted array must be > 1\n", TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (shard < 0 || shard >= size) {
+	Tcl_SetResult(interp, "Invalid shard", TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    /*
+     * The shard number picks the prefix one element at a time from the
+     * elements that haven't been used yet.
+     */
+
+    unused = (int *)ckalloc(sizeof(int) * n);
+    for (i=0; i < n; i++) {
+	unused[i] = i;
+    }
+    for (i=0; i < prefixLength; i++) {
+	size /= n - i;
+	j = shard / size;
+	shard %= size;
+
+	prefix[i] = unused[j];
+	memmove(unused + j, unused + j + 1, sizeof(int) * (n - i - j - 1));
+    }
+    ckfree((char *)unused);
+
+    result = PermSearchPrefix(clientData, interp, n, testFunc, prefix,
+	    prefixLength);
+
+    return result;
+}
+
+/*
+ * Lexicographic ranks of permutations.  The permutations of n elements
+ * are numbered from 0, for 0 1 ... n-1, to n! - 1, for n-1 ... 1 0.
+ * Ranks are only supported up to PERM_RANK_MAX elements, the most whose
+ * ranks all fit in a Tcl_WideUInt.
+ */
+
+Tcl_WideUInt
+PermFactorial(int n)
+{
+    Tcl_WideUInt result = 1;
+
+    while (n > 1) {
+	result *= n--;
+    }
+
+    return result;
+}
+
+Tcl_WideUInt
+PermRank(const int *perm, int n)
+{
+    Tcl_WideUInt rank = 0;
+    int i, j, smaller;
+
+    for (i=0; i < n; i++) {
+	for (j=i+1, smaller=0; j < n; j++) {
+	    if (perm[j] < perm[i]) {
+		smaller++;
+	    }
+	}
+	rank += smaller * PermFactorial(n - 1 - i);
+    }
+
+    return rank;
+}
+
+void
+PermUnrank(Tcl_WideUInt rank, int n, int *perm)
+{
+    Tcl_WideUInt size;
+    int i, j, k;
+
+    for (i=0; i < n; i++) {
+	perm[i] = i;
+    }
+
+    /*
+     * Pick each element from the ones that are left, which stay sorted.
+     */
+
+    for (i=0; i < n; i++) {
+	size = PermFactorial(n - 1 - i);
+	j = i + (int)(rank / size);
+	rank %= size;
+
+	k = perm[j];
+	memmove(perm + i + 1, perm + i, sizeof(int) * (j - i));
+	perm[i] = k;
+    }
+}
+
+/*
+ * Read a rank from a string.
+ */
+
+int
+PermGetRank(Tcl_Interp *interp, const char *string, Tcl_WideUInt *rankPtr)
+{
+    Tcl_Obj *objPtr = Tcl_NewStringObj(string, -1);
+    Tcl_WideInt value;
+    int result;
+
+    Tcl_IncrRefCount(objPtr);
+    result = Tcl_GetWideIntFromObj(interp, objPtr, &value);
+    Tcl_DecrRefCount(objPtr);
+
+    if (result != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (value < 0) {
+	Tcl_AppendResult(interp, "Bad rank \"", string,
+		"\".  Ranks can't be negative", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    *rankPtr = (Tcl_WideUInt)value;
+    return TCL_OK;
+}
+
+/*
+ * Test count permutations of n elements, in lexicographic order of rank
+ * starting from rank start, so that a search can be split into ranges
+ * that are searched separately.  The range is covered by the largest
+ * blocks of permutations that share a prefix, and each block is searched
+ * with a Steinhaus-Johnson-Trotter walk.  A range that is aligned to
+ * (n-k)! permutations is searched in blocks of that size.
+ */
+
+int
+_internalDoPermRangeCmd(ClientData clientData, Tcl_Interp *interp, int n, int (*testFunc)(Tcl_Interp *, ClientData, int *, int), Tcl_WideUInt start, Tcl_WideUInt count)
+{
+    Tcl_WideUInt total, end, size;
+    int *perm;
+    int k, result = TCL_OK;
+
+    if (n <= 1) {
+	Tcl_SetResult(interp, "Length of permuted array must be > 1\n", TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (n > PERM_RANK_MAX) {
+	Tcl_SetResult(interp, "Ranges only work for up to 20 elements",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    total = PermFactorial(n);
+    if (start >= total) {
+	Tcl_SetResult(interp, "The range starts past the last permutation",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    end = (count > total - start) ? total : start + count;
+    perm = (int *)ckalloc(sizeof(int) * n);
+
+    while (start < end && result == TCL_OK) {
+	for (k=0; k < n; k++) {
+	    size = PermFactorial(n - k);
+	    if (start % size == 0 && end - start >= size) {
+		break;
+	    }
+	}
+
+	PermUnrank(start, n, perm);
+	result = PermSearchPrefix(clientData, interp, n, testFunc, perm, k);
+	start += size;
+    }
+
+    ckfree((char *)perm);
+
+    return result;
+}
+
+/*
+ * A branch and bound search builds the permutations one element at a
+ * time, in lexicographic order, and asks boundProc for the best value
+ * that any permutation with the current prefix could have.  When that
+ * can't beat the best value found so far the rest of the prefix's
+ * permutations are skipped.  A prefix is only skipped when its bound is
+ * clearly below the best value, so rounding in the bound can't lose a
+ * key.
+ */
+
+#define PERM_BOUND_SLACK	1e-9
+
+typedef struct PermBoundInfo {
+    int length;
+    int *perm;
+    int *used;
+    Tcl_WideUInt *count;	/* count[i] is the number of permutations
+				 * of i elements. */
+    int (*testFunc)(Tcl_Interp *, ClientData, int *, int);
+    PermBoundProc *boundProc;
+    double *bestPtr;
+    PermBoundStats *statsPtr;
+} PermBoundInfo;
+
+static int
+PermBoundSearch(Tcl_Interp *interp, ClientData clientData, int depth, PermBoundInfo *bInfo)
 {
     int i, result;
 
-    if (n >= pInfo->length) {
-	char elem[8];
-	Tcl_DString dsPtr;
+    if (depth >= bInfo->length) {
+	bInfo->statsPtr->tested++;
+	return bInfo->testFunc(interp, clientData, bInfo->perm,
+		bInfo->length);
+    }
+
+    /*
+     * A prefix with only one permutation left is cheaper to test than to
+     * bound.
+     */
+
+    if (depth > 0 && depth < bInfo->length - 1) {
+	double bound, best, limit;
+
+	result = bInfo->boundProc(interp, clientData, bInfo->perm, depth,
+		bInfo->length, &bound);
+	if (result == TCL_ERROR) {
+	    return result;
+	}
+
+	if (result == TCL_OK) {
+	    bInfo->statsPtr->bounded++;
+
+	    best = *bInfo->bestPtr;
+	    limit = best - PERM_BOUND_SLACK * (best < 0.0 ? -best : best);
+	    if (bound < limit) {
+		bInfo->statsPtr->pruned++;
+		bInfo->statsPtr->skipped += bInfo->count[bInfo->length - depth];
+		return TCL_OK;
+	    }
+	}
+    }
 
-	Tcl_DStringInit(&dsPtr);
-	Tcl_DStringAppend(&dsPtr, pInfo->cmd_prefix, -1);
-	Tcl_DStringStartSublist(&dsPtr);
-	for(i=0; i < pInfo->length; i++) {
-	    sprintf(elem, "%d", pInfo->p[i]);
-	    Tcl_DStringAppendElement(&dsPtr, elem);
+    for (i=0; i < bInfo->length; i++) {
+	if (bInfo->used[i]) {
+	    continue;
 	}
-	Tcl_DStringEndSublist(&dsPtr);
 
-	return Tcl_Eval(interp, Tcl_DStringValue(&dsPtr));
+	bInfo->used[i] = 1;
+	bInfo->perm[depth] = i;
+	result = PermBoundSearch(interp, clientData, depth+1, bInfo);
+	bInfo->used[i] = 0;
+
+	if (result != TCL_OK) {
+	    return result;
+	}
+    }
+
+    return TCL_OK;
+}
+
+/*
+ * Test every permutation of n elements that boundProc can't rule out.
+ * bestPtr points at the best value that testFunc has found so far, and
+ * testFunc is expected to keep it up to date.  The counts of what was
+ * tested and skipped are added to *statsPtr.
+ */
+
+int
+_internalDoPermBoundCmd(ClientData clientData, Tcl_Interp *interp, int n, int (*testFunc)(Tcl_Interp *, ClientData, int *, int), PermBoundProc *boundProc, double *bestPtr, PermBoundStats *statsPtr)
+{
+    PermBoundInfo bInfo;
+    int i, result;
+
+    if (n <= 1) {
+	Tcl_SetResult(interp, "Length of permuted array must be > 1\n", TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    bInfo.length = n;
+    bInfo.perm = (int *)ckalloc(sizeof(int) * (n + 1));
+    bInfo.used = (int *)ckalloc(sizeof(int) * (n + 1));
+    bInfo.count = (Tcl_WideUInt *)ckalloc(sizeof(Tcl_WideUInt) * (n + 1));
+    bInfo.testFunc = testFunc;
+    bInfo.boundProc = boundProc;
+    bInfo.bestPtr = bestPtr;
+    bInfo.statsPtr = statsPtr;
+
+    bInfo.count[0] = 1;
+    for (i=0; i < n; i++) {
+	bInfo.perm[i] = 0;
+	bInfo.used[i] = 0;
+	bInfo.count[i+1] = bInfo.count[i] * (i+1);
+    }
+
+    result = PermBoundSearch(interp, clientData, 0, &bInfo);
+
+    ckfree((char *)bInfo.perm);
+    ckfree((char *)bInfo.used);
+    ckfree((char *)bInfo.count);
+
+    return result;
+}
+
+/*
+ * The fraction of the permutations that a branch and bound search
+ * skipped.
+ */
+
+double
+PermBoundRatio(PermBoundStats *statsPtr)
+{
+    Tcl_WideUInt total = statsPtr->tested + statsPtr->skipped;
+
+    if (total == 0) {
+	return 0.0;
+    }
+
+    return (double)statsPtr->skipped / (double)total;
+}
+
+/*
+ * Leave the counts from a branch and bound search in the interpreter's
+ * result as a list of names and values.
+ */
+
+void
+PermBoundStatsResult(Tcl_Interp *interp, PermBoundStats *statsPtr)
+{
+    Tcl_Obj *resultObj = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+
+    Tcl_ListObjAppendElement(interp, resultObj,
+	    Tcl_NewStringObj("bounded", -1));
+    Tcl_ListObjAppendElement(interp, resultObj,
+	    Tcl_NewWideIntObj((Tcl_WideInt)statsPtr->bounded));
+    Tcl_ListObjAppendElement(interp, resultObj,
+	    Tcl_NewStringObj("pruned", -1));
+    Tcl_ListObjAppendElement(interp, resultObj,
+	    Tcl_NewWideIntObj((Tcl_WideInt)statsPtr->pruned));
+    Tcl_ListObjAppendElement(interp, resultObj,
+	    Tcl_NewStringObj("tested", -1));
+    Tcl_ListObjAppendElement(interp, resultObj,
+	    Tcl_NewWideIntObj((Tcl_WideInt)statsPtr->tested));
+    Tcl_ListObjAppendElement(interp, resultObj,
+	    Tcl_NewStringObj("skipped", -1));
+    Tcl_ListObjAppendElement(interp, resultObj,
+	    Tcl_NewWideIntObj((Tcl_WideInt)statsPtr->skipped));
+    Tcl_ListObjAppendElement(interp, resultObj,
+	    Tcl_NewStringObj("ratio", -1));
+    Tcl_ListObjAppendElement(interp, resultObj,
+	    Tcl_NewDoubleObj(PermBoundRatio(statsPtr)));
+    Tcl_SetObjResult(interp, resultObj);
+}
+
+/*
+ * Set up the command prefix cmd to be called with batches of batchSize
+ * permutations of length elements.  A batch is never bigger than
+ * PERM_BATCH_MAX or the number of permutations.
+ */
+
+static int
+PermScriptInit(Tcl_Interp *interp, PermScript *scriptPtr, const char *cmd, int length, int batchSize)
+{
+    Tcl_Obj *cmdObj, **words;
+    int i, count;
+
+    if (batchSize > PERM_BATCH_MAX) {
+	batchSize = PERM_BATCH_MAX;
+    }
+    if (length <= PERM_RANK_MAX
+	    && PermFactorial(length) < (Tcl_WideUInt)batchSize) {
+	batchSize = (int)PermFactorial(length);
+    }
+    if ((size_t)length >= UINT_MAX / sizeof(Tcl_Obj *) / batchSize) {
+	Tcl_SetResult(interp, "The permutations are too long for the batch",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    cmdObj = Tcl_NewStringObj(cmd, -1);
+    Tcl_IncrRefCount(cmdObj);
+    if (Tcl_ListObjGetElements(interp, cmdObj, &count, &words) != TCL_OK) {
+	Tcl_DecrRefCount(cmdObj);
+	return TCL_ERROR;
+    }
+
+    scriptPtr->objc = count + 1;
+    scriptPtr->objv = (Tcl_Obj **)ckalloc(sizeof(Tcl_Obj *) * (count + 1));
+    for (i=0; i < count; i++) {
+	scriptPtr->objv[i] = words[i];
+	Tcl_IncrRefCount(words[i]);
+    }
+    scriptPtr->objv[count] = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+    Tcl_IncrRefCount(scriptPtr->objv[count]);
+    Tcl_DecrRefCount(cmdObj);
+
+    scriptPtr->numbers = (Tcl_Obj **)ckalloc(sizeof(Tcl_Obj *) * (length + 1));
+    for (i=0; i < length; i++) {
+	scriptPtr->numbers[i] = Tcl_NewIntObj(i);
+	Tcl_IncrRefCount(scriptPtr->numbers[i]);
+    }
+    scriptPtr->batch = (Tcl_Obj **)ckalloc(sizeof(Tcl_Obj *)
+	    * ((size_t)length * batchSize + 1));
+    scriptPtr->length = length;
+    scriptPtr->batchSize = batchSize;
+    scriptPtr->count = 0;
+
+    return TCL_OK;
+}
+
+static void
+PermScriptFree(PermScript *scriptPtr)
+{
+    int i;
+
+    for (i=0; i < scriptPtr->objc; i++) {
+	Tcl_DecrRefCount(scriptPtr->objv[i]);
+    }
+    for (i=0; i < scriptPtr->length; i++) {
+	Tcl_DecrRefCount(scriptPtr->numbers[i]);
+    }
+    ckfree((char *)scriptPtr->objv);
+    ckfree((char *)scriptPtr->numbers);
+    ckfree((char *)scriptPtr->batch);
+}
+
+/*
+ * Call the command prefix with the permutations that have been saved up.
+ * The list object is reused for each call unless the script kept a
+ * reference to it.
+ */
+
+static int
+PermScriptFlush(Tcl_Interp *interp, PermScript *scriptPtr)
+{
+    Tcl_Obj **listPtrPtr = scriptPtr->objv + scriptPtr->objc - 1;
+
+    if (scriptPtr->count == 0) {
+	return TCL_OK;
+    }
+
+    if (Tcl_IsShared(*listPtrPtr)) {
+	Tcl_DecrRefCount(*listPtrPtr);
+	*listPtrPtr = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+	Tcl_IncrRefCount(*listPtrPtr);
+    }
+    Tcl_SetListObj(*listPtrPtr, scriptPtr->count * scriptPtr->length,
+	    scriptPtr->batch);
+    scriptPtr->count = 0;
+
+    return Tcl_EvalObjv(interp, scriptPtr->objc, scriptPtr->objv, 0);
+}
+
+/*
+ * Add a permutation to the batch, and call the command prefix once the
+ * batch is full.
+ */
+
+static int
+PermScriptAdd(Tcl_Interp *interp, PermScript *scriptPtr, const int *perm)
+{
+    Tcl_Obj **elemPtr = scriptPtr->batch
+	    + scriptPtr->count * scriptPtr->length;
+    int i;
+
+    for (i=0; i < scriptPtr->length; i++) {
+	elemPtr[i] = scriptPtr->numbers[perm[i]];
+    }
+
+    if (++scriptPtr->count < scriptPtr->batchSize) {
+	return TCL_OK;
+    }
+    return PermScriptFlush(interp, scriptPtr);
+}
+
+/*
+ * Function called by PermCmd.  This does all of the work.
+ */
+
+int
+doPerm (Tcl_Interp *interp, int n, PermInfo *pInfo)
+{
+    int i, result;
+
+    if (n >= pInfo->length) {
+	return PermScriptAdd(interp, pInfo->script, pInfo->p);
     } else {
 	result = doPerm(interp, n+1, pInfo);
 	if (result != TCL_OK) {
@@ -162,7 +1033,20 @@ doPerm (Tcl_Interp *interp, int n, PermInfo *pInfo)
 }
 
 /*
- * Usage:  permute n cmdPrefix
+ * The test function for permute -range.  clientData is the PermScript.
+ */
+
+static int
+PermEvalRange(Tcl_Interp *interp, ClientData clientData, int *perm, int n)
+{
+    return PermScriptAdd(interp, (PermScript *)clientData, perm);
+}
+
+/*
+ * Usage:  permute n cmdPrefix ?-batch count?
+ *	   permute -range start count n cmdPrefix ?-batch count?
+ *	   permute -rank list
+ *	   permute -unrank n rank
  */
 
 int
@@ -170,9 +1054,139 @@ PermCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **argv)
 {
     int n, i, result;
     PermInfo pInfo;
+    PermScript script;
+    Tcl_WideUInt start, count;
+    int batchSize = 1;
+
+    if (argc == 3 && strcmp(argv[1], "-rank") == 0) {
+	int listc;
+	const char **listv;
+	int *perm;
+
+	if (Tcl_SplitList(interp, argv[2], &listc, &listv) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (listc > PERM_RANK_MAX) {
+	    ckfree((char *)listv);
+	    Tcl_SetResult(interp, "Ranks only work for up to 20 elements",
+		    TCL_STATIC);
+	    return TCL_ERROR;
+	}
+
+	perm = (int *)ckalloc(sizeof(int) * (listc + 1));
+	for (i=0; i < listc; i++) {
+	    if (sscanf(listv[i], "%d", &perm[i]) != 1
+		    || perm[i] < 0 || perm[i] >= listc) {
+		Tcl_AppendResult(interp, "Not a permutation:  ", argv[2],
+			(char *)NULL);
+		ckfree((char *)perm);
+		ckfree((char *)listv);
+		return TCL_ERROR;
+	    }
+	}
+	for (i=0; i < listc; i++) {
+	    for (n=i+1; n < listc; n++) {
+		if (perm[i] == perm[n]) {
+		    Tcl_AppendResult(interp, "Not a permutation:  ", argv[2],
+			    (char *)NULL);
+		    ckfree((char *)perm);
+		    ckfree((char *)listv);
+		    return TCL_ERROR;
+		}
+	    }
+	}
+
+	Tcl_SetObjResult(interp,
+		Tcl_NewWideIntObj((Tcl_WideInt)PermRank(perm, listc)));
+
+	ckfree((char *)perm);
+	ckfree((char *)listv);
+	return TCL_OK;
+    }
+
+    if (argc == 4 && strcmp(argv[1], "-unrank") == 0) {
+	int perm[PERM_RANK_MAX];
+	Tcl_Obj *resultObj;
+
+	if (sscanf(argv[2], "%d", &n) != 1 || n < 1 || n > PERM_RANK_MAX) {
+	    Tcl_SetResult(interp, "n must be an integer from 1 to 20",
+		    TCL_STATIC);
+	    return TCL_ERROR;
+	}
+	if (PermGetRank(interp, argv[3], &start) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (start >= PermFactorial(n)) {
+	    Tcl_SetResult(interp, "The rank is past the last permutation",
+		    TCL_STATIC);
+	    return TCL_ERROR;
+	}
+
+	PermUnrank(start, n, perm);
+	resultObj = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+	for (i=0; i < n; i++) {
+	    Tcl_ListObjAppendElement(interp, resultObj, Tcl_NewIntObj(perm[i]));
+	}
+	Tcl_SetObjResult(interp, resultObj);
+	return TCL_OK;
+    }
+
+    /*
+     * The permutations can be handed to the command in batches, as one
+     * flat list.
+     */
+
+    if (argc > 4 && strcmp(argv[argc-2], "-batch") == 0) {
+	if (sscanf(argv[argc-1], "%d", &batchSize) != 1 || batchSize < 1) {
+	    Tcl_SetResult(interp, "The batch size must be a positive integer",
+		    TCL_STATIC);
+	    return TCL_ERROR;
+	}
+	argc -= 2;
+    }
+
+    if (argc == 6 && strcmp(argv[1], "-range") == 0) {
+	if (PermGetRank(interp, argv[2], &start) != TCL_OK
+		|| PermGetRank(interp, argv[3], &count) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (sscanf(argv[4], "%d", &n) != 1) {
+	    Tcl_SetResult(interp, "n must be an integer\n", TCL_STATIC);
+	    return TCL_ERROR;
+	}
+
+	if (n < 1) {
+	    Tcl_SetResult(interp, "Length of permuted array must be > 1\n",
+		    TCL_STATIC);
+	    return TCL_ERROR;
+	}
+	if (PermScriptInit(interp, &script, argv[5], n, batchSize) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+
+	result = _internalDoPermRangeCmd((ClientData)&script, interp, n,
+		PermEvalRange, start, count);
+	if (result == TCL_OK) {
+	    result = PermScriptFlush(interp, &script);
+	}
+	PermScriptFree(&script);
+
+	return result;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "-rank") == 0) {
+	Tcl_SetResult(interp, "Usage:  permute -rank list", TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (argc > 1 && strcmp(argv[1], "-unrank") == 0) {
+	Tcl_SetResult(interp, "Usage:  permute -unrank n rank", TCL_STATIC);
+	return TCL_ERROR;
+    }
 
     if (argc != 3) {
-	Tcl_SetResult(interp, "Usage:  permute n cmd", TCL_STATIC);
+	Tcl_SetResult(interp,
+		"Usage:  permute ?-range start count? n cmd ?-batch count?",
+		TCL_STATIC);
 	return TCL_ERROR;
     }
 
@@ -181,12 +1195,18 @@ PermCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **argv)
 	return TCL_ERROR;
     }
 
+    if (n < 0) {
+	n = 0;
+    }
+    if (PermScriptInit(interp, &script, argv[2], n, batchSize) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
     pInfo.length = n;
     pInfo.dir = (int *)ckalloc(sizeof(int) * (n + 1));
     pInfo.p = (int *)ckalloc(sizeof(int) * (n + 1));
     pInfo.pi = (int *)ckalloc(sizeof(int) * (n + 1));
-    pInfo.cmd_prefix = (char *)ckalloc(sizeof(char)*strlen(argv[2])+2);
-    strcpy(pInfo.cmd_prefix, argv[2]);
+    pInfo.script = &script;
 
     for(i=0; i < n; i++) {
 	pInfo.dir[i] = -1;
@@ -195,8 +1215,11 @@ PermCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **argv)
     }
 
     result = doPerm(interp, 0, &pInfo);
+    if (result == TCL_OK) {
+	result = PermScriptFlush(interp, &script);
+    }
 
-    ckfree((char *)pInfo.cmd_prefix);
+    PermScriptFree(&script);
     ckfree((char *)pInfo.dir);
     ckfree((char *)pInfo.p);
     ckfree((char *)pInfo.pi);
@@ -22,5 +22,113 @@
  */
 #include <tcl.h>
 
+/*
+ * The most blocks of solver state that a permutation search can save in
+ * its checkpoints.
+ */
+
+#define PERM_CHECKPOINT_REGIONS	4
+
+/*
+ * The most elements whose permutations can all be ranked.  21! doesn't
+ * fit in 64 bits.
+ */
+
+#define PERM_RANK_MAX	20
+
+/*
+ * The most column orders that an adjacency solve will keep.  Each one is
+ * scored in full, so asking for more than this wouldn't be any use.
+ */
+
+#define PERM_ADJACENCY_MAX	100000
+
+/*
+ * Describes how a permutation search should checkpoint itself.  The
+ * regions are the blocks of solver state (usually the best key and
+ * value found so far) that are saved along with the position of the
+ * search, and restored when it is resumed.
+ */
+
+typedef struct PermCheckpoint {
+    const char *fileName;	/* Write checkpoints here, or NULL. */
+    const char *resumeName;	/* Resume from this checkpoint, or NULL. */
+    double interval;		/* Seconds between checkpoints. */
+    const char *text;		/* The ciphertext being solved. */
+    unsigned long *iterationPtr;/* The solver's iteration count, or NULL. */
+    int regionCount;
+    struct {
+	void *data;
+	int size;
+    } regions[PERM_CHECKPOINT_REGIONS];
+} PermCheckpoint;
+
+/*
+ * Where a solver keeps the best key it has found, for the permutation
+ * searches that are spread over several threads.  Each thread searches
+ * with its own copy of the cipher, and the best key of every copy is
+ * gathered from these regions when the search is done.
+ */
+
+typedef struct PermBest {
+    double *valuePtr;		/* The value of the best key. */
+    unsigned long *iterationPtr;/* The solver's iteration count, or NULL. */
+    int regionCount;
+    struct {
+	void *data;
+	int size;
+    } regions[PERM_CHECKPOINT_REGIONS];
+} PermBest;
+
+/*
+ * Get the cipher toData ready to search for the key of the cipher
+ * fromData, and describe where it keeps its best key.  The two are the
+ * same cipher unless the search is spread over several threads.
+ */
+
+typedef int (PermStartProc) _ANSI_ARGS_((Tcl_Interp *, ClientData,
+	ClientData, PermBest *));
+
+/*
+ * Get an optimistic bound on the value of every permutation of n
+ * elements that starts with the first length elements of perm.  Returns
+ * TCL_OK and sets *boundPtr, TCL_CONTINUE if the prefix can't be bounded
+ * yet, or TCL_ERROR.
+ */
+
+typedef int (PermBoundProc) _ANSI_ARGS_((Tcl_Interp *, ClientData, int *,
+	int, int, double *));
+
+/*
+ * How much of the search a branch and bound permutation search was able
+ * to skip.
+ */
+
+typedef struct PermBoundStats {
+    Tcl_WideUInt bounded;	/* Prefixes that were bounded. */
+    Tcl_WideUInt pruned;	/* Prefixes whose permutations were skipped. */
+    Tcl_WideUInt tested;	/* Permutations that were tested. */
+    Tcl_WideUInt skipped;	/* Permutations that were skipped. */
+} PermBoundStats;
+
 int PermCmd(ClientData, Tcl_Interp *, int , const char **);
 int _internalDoPermCmd(ClientData, Tcl_Interp *, int, int (*testFunc)(Tcl_Interp *, ClientData, int *, int));
+int _internalDoPermCheckpointCmd(ClientData, Tcl_Interp *, int, int (*testFunc)(Tcl_Interp *, ClientData, int *, int), PermCheckpoint *);
+void PermCheckpointInit(PermCheckpoint *, const char *, const char *, double, const char *, unsigned long *);
+void PermCheckpointAdd(PermCheckpoint *, void *, int);
+void PermBestInit(PermBest *, double *, unsigned long *);
+void PermBestAdd(PermBest *, void *, int);
+int PermShardCount(int);
+int _internalDoPermShardCmd(ClientData, Tcl_Interp *, int, int (*testFunc)(Tcl_Interp *, ClientData, int *, int), int);
+int _internalDoPermThreadCmd(ClientData, Tcl_Interp *, int, int (*testFunc)(Tcl_Interp *, ClientData, int *, int), int, PermStartProc *, PermBest *);
+int _internalDoPermBoundCmd(ClientData, Tcl_Interp *, int, int (*testFunc)(Tcl_Interp *, ClientData, int *, int), PermBoundProc *, double *, PermBoundStats *);
+double PermBoundRatio(PermBoundStats *);
+void PermBoundStatsResult(Tcl_Interp *, PermBoundStats *);
+int PermAdjacencyOrders(const double *, int, int, int *, double *, PermBoundStats *);
+int PermAdjacencyAlloc(Tcl_Interp *, int, int, int **, double **);
+int PermGetAdjacency(Tcl_Interp *, const char *, int *);
+Tcl_WideUInt PermFactorial(int);
+Tcl_WideUInt PermRank(const int *, int);
+void PermUnrank(Tcl_WideUInt, int, int *);
+int PermGetRank(Tcl_Interp *, const char *, Tcl_WideUInt *);
+int _internalDoPermRangeCmd(ClientData, Tcl_Interp *, int, int (*testFunc)(Tcl_Interp *, ClientData, int *, int), Tcl_WideUInt, Tcl_WideUInt);
@@ -0,0 +1,299 @@
+/*
+ * permAdjacency.c --
+ *
+ *	This file finds the best orders of the columns of a transposition
+ *	from a matrix of column adjacency scores.  matrix[a*n + b] is the
+ *	score of putting column b directly to the right of column a, and
+ *	the score of an order is the sum of the scores of its adjacent
+ *	pairs.  Computing the matrix once is much cheaper than building and
+ *	scoring the plaintext of every order, so the search can look at
+ *	every order and only the best few need to be scored in full.
+ *
+ *	The search builds the orders one column at a time.  The columns
+ *	that could follow the last one are tried best first, so good orders
+ *	are found early, and a partial order is dropped as soon as it
+ *	couldn't beat the worst of the orders that are being kept.
+ *
+ * Copyright (c) 2008 Michael Thomas <wart@kobold.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <tcl.h>
+#include <string.h>
+#include <limits.h>
+#include "perm.h"
+
+#include <cipherDebug.h>
+
+/*
+ * A partial order is only dropped when its bound is clearly below the
+ * worst order being kept, so rounding in the bound can't lose an order.
+ */
+
+#define PERM_ADJACENCY_SLACK	1e-9
+
+typedef struct PermAdjacencyInfo {
+    const double *matrix;
+    int n;
+    int *order;
+    int *used;
+    int *choices;	/* n choices for each level of the search. */
+    Tcl_WideUInt *count;/* count[i] is the number of orders of i columns. */
+
+    int size;		/* The most orders to keep. */
+    int found;		/* The number of orders kept so far. */
+    int *orders;	/* The orders being kept, best first. */
+    double *values;
+    PermBoundStats *statsPtr;
+} PermAdjacencyInfo;
+
+/*
+ * Keep an order if it's one of the best seen so far.  An order that ties
+ * one that is already kept goes after it.
+ */
+
+static void
+PermAdjacencyKeep(PermAdjacencyInfo *aInfo, double value)
+{
+    int i = aInfo->found;
+
+    if (i == aInfo->size) {
+	if (value <= aInfo->values[i-1]) {
+	    return;
+	}
+	i--;
+    } else {
+	aInfo->found++;
+    }
+
+    for (; i > 0 && aInfo->values[i-1] < value; i--) {
+	aInfo->values[i] = aInfo->values[i-1];
+	memcpy(aInfo->orders + i*aInfo->n, aInfo->orders + (i-1)*aInfo->n,
+		sizeof(int) * aInfo->n);
+    }
+
+    aInfo->values[i] = value;
+    memcpy(aInfo->orders + i*aInfo->n, aInfo->order, sizeof(int) * aInfo->n);
+}
+
+/*
+ * The best score that column a can get from one of the unused columns
+ * following it.
+ */
+
+static double
+PermAdjacencyBest(PermAdjacencyInfo *aInfo, int a)
+{
+    const double *row = aInfo->matrix + a*aInfo->n;
+    double best = 0.0;
+    int b, found = 0;
+
+    for (b=0; b < aInfo->n; b++) {
+	if (aInfo->used[b] || b == a) {
+	    continue;
+	}
+	if (!found || row[b] > best) {
+	    best = row[b];
+	    found = 1;
+	}
+    }
+
+    return best;
+}
+
+/*
+ * The most that the columns that haven't been placed could add to the
+ * score of a partial order.  The last column placed and every unused
+ * column but one are followed by an unused column, so each adds at most
+ * its best score against them.  The unused column that ends up last adds
+ * nothing, so the smallest of their best scores is left out.
+ */
+
+static double
+PermAdjacencyBound(PermAdjacencyInfo *aInfo, int depth)
+{
+    double bound, best, smallest = 0.0;
+    int a, found = 0;
+
+    bound = PermAdjacencyBest(aInfo, aInfo->order[depth-1]);
+    for (a=0; a < aInfo->n; a++) {
+	if (aInfo->used[a]) {
+	    continue;
+	}
+
+	best = PermAdjacencyBest(aInfo, a);
+	bound += best;
+	if (!found || best < smallest) {
+	    smallest = best;
+	    found = 1;
+	}
+    }
+
+    return bound - smallest;
+}
+
+static void
+PermAdjacencySearch(PermAdjacencyInfo *aInfo, int depth, double value)
+{
+    int n = aInfo->n;
+    int *choices = aInfo->choices + depth*n;
+    const double *row = (const double *)NULL;
+    int i, j, count;
+
+    if (depth == n) {
+	aInfo->statsPtr->tested++;
+	PermAdjacencyKeep(aInfo, value);
+	return;
+    }
+
+    if (depth > 0 && depth < n - 1 && aInfo->found == aInfo->size) {
+	double bound = value + PermAdjacencyBound(aInfo, depth);
+	double worst = aInfo->values[aInfo->size-1];
+	double limit = worst
+	    - PERM_ADJACENCY_SLACK * (worst < 0.0 ? -worst : worst);
+
+	aInfo->statsPtr->bounded++;
+	if (bound < limit) {
+	    aInfo->statsPtr->pruned++;
+	    aInfo->statsPtr->skipped += aInfo->count[n - depth];
+	    return;
+	}
+    }
+
+    /*
+     * Try the unused columns that score best after the last column
+     * first.
+     */
+
+    if (depth > 0) {
+	row = aInfo->matrix + aInfo->order[depth-1]*n;
+    }
+
+    for (i=0, count=0; i < n; i++) {
+	if (aInfo->used[i]) {
+	    continue;
+	}
+
+	for (j=count; row && j > 0 && row[choices[j-1]] < row[i]; j--) {
+	    choices[j] = choices[j-1];
+	}
+	choices[j] = i;
+	count++;
+    }
+
+    for (i=0; i < count; i++) {
+	int next = choices[i];
+
+	aInfo->used[next] = 1;
+	aInfo->order[depth] = next;
+	PermAdjacencySearch(aInfo, depth+1,
+		value + (row ? row[next] : 0.0));
+	aInfo->used[next] = 0;
+    }
+}
+
+/*
+ * Parse the number of orders for an adjacency solve to keep.
+ */
+
+int
+PermGetAdjacency(Tcl_Interp *interp, const char *value, int *sizePtr)
+{
+    int size;
+
+    if (Tcl_GetInt(interp, value, &size) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (size < 0) {
+	Tcl_SetResult(interp, "The adjacency count can't be negative",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (size > PERM_ADJACENCY_MAX) {
+	Tcl_SetResult(interp,
+		"The adjacency count can't be more than 100000", TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    *sizePtr = size;
+    return TCL_OK;
+}
+
+/*
+ * Allocate the space for size orders of n columns and their scores.  The
+ * sizes are checked first, since ckalloc only takes an unsigned int.
+ */
+
+int
+PermAdjacencyAlloc(Tcl_Interp *interp, int size, int n, int **ordersPtr, double **valuesPtr)
+{
+    if (size < 1 || n < 1 || (size_t)size > UINT_MAX / sizeof(int) / n) {
+	Tcl_SetResult(interp, "The adjacency count is too large for the period",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    *ordersPtr = (int *)ckalloc(sizeof(int) * (size_t)size * n);
+    *valuesPtr = (double *)ckalloc(sizeof(double) * (size_t)size);
+    return TCL_OK;
+}
+
+/*
+ * Find the size best orders of n columns from the adjacency scores in
+ * matrix.  The orders are left in orders, n elements each, best first,
+ * and their scores in values.  Returns the number of orders found, which
+ * is size unless there are fewer than size orders.  The counts of what
+ * was looked at and skipped are added to *statsPtr.
+ */
+
+int
+PermAdjacencyOrders(const double *matrix, int n, int size, int *orders, double *values, PermBoundStats *statsPtr)
+{
+    PermAdjacencyInfo aInfo;
+    int i;
+
+    if (n < 1 || size < 1) {
+	return 0;
+    }
+
+    aInfo.matrix = matrix;
+    aInfo.n = n;
+    aInfo.order = (int *)ckalloc(sizeof(int) * n);
+    aInfo.used = (int *)ckalloc(sizeof(int) * n);
+    aInfo.choices = (int *)ckalloc(sizeof(int) * n * n);
+    aInfo.count = (Tcl_WideUInt *)ckalloc(sizeof(Tcl_WideUInt) * (n + 1));
+    aInfo.size = size;
+    aInfo.found = 0;
+    aInfo.orders = orders;
+    aInfo.values = values;
+    aInfo.statsPtr = statsPtr;
+
+    aInfo.count[0] = 1;
+    for (i=0; i < n; i++) {
+	aInfo.used[i] = 0;
+	aInfo.count[i+1] = aInfo.count[i] * (i+1);
+    }
+
+    PermAdjacencySearch(&aInfo, 0, 0.0);
+
+    ckfree((char *)aInfo.order);
+    ckfree((char *)aInfo.used);
+    ckfree((char *)aInfo.choices);
+    ckfree((char *)aInfo.count);
+
+    return aInfo.found;
+}
@@ -0,0 +1,527 @@
+/*
+ * permThread.c --
+ *
+ *	This file spreads a search of all of the permutations of a key over
+ *	several threads.  The permutations are split into shards that each
+ *	fix the first elements of the permutation (see
+ *	_internalDoPermShardCmd()), and the shards are handed out to the
+ *	worker threads one at a time, in order.
+ *
+ *	A Tcl interpreter can only be used by the thread that created it.
+ *	Every worker thread creates its own interpreter and its own copy of
+ *	the cipher, made from the ciphertext and settings of the original,
+ *	and runs the cipher's usual test function on it.  The scoring
+ *	tables are only read during a search, so the workers share them,
+ *	but they don't use the score cache.
+ *
+ *	The step and best fit commands of the workers' ciphers forward
+ *	their arguments to the thread that started the search as events,
+ *	and that thread runs the cipher's real commands from the event loop
+ *	until all of the workers are done.  Only improvements on the best
+ *	value so far are sent to the best fit command.
+ *
+ *	Each shard remembers the best key that it found, if it improved on
+ *	the best key its worker had found before.  Since every worker takes
+ *	shards in order, the first shard holding the best value always
+ *	records it, and that shard's key is the result.  So the result
+ *	doesn't depend on the number of threads.
+ *
+ * Copyright (c) 2008 Michael Thomas <wart@kobold.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <tcl.h>
+#include <string.h>
+#include "cipher.h"
+#include "score.h"
+#include "perm.h"
+
+extern ScoreItem *defaultScoreItem;
+
+#define PERM_EVENT_STEP		0
+#define PERM_EVENT_BESTFIT	1
+#define PERM_EVENT_DONE		2
+
+/*
+ * The names of the commands that stand in for the step and best fit
+ * commands in the workers' interpreters.
+ */
+
+#define PERM_STEP_CMD		"permForwardStep"
+#define PERM_BESTFIT_CMD	"permForwardBestFit"
+
+typedef struct PermShared {
+    Tcl_Interp *interp;		/* The interpreter that started the search. */
+    CipherItem *itemPtr;	/* The cipher being solved. */
+    int n;
+    int (*testFunc)(Tcl_Interp *, ClientData, int *, int);
+    PermStartProc *startProc;
+    PermBest *bestPtr;		/* Where the original keeps its best key. */
+    int keySize;		/* The size of all of the regions together. */
+    CipherClone clone;
+
+    /*
+     * The results of each shard.  keys holds keySize bytes for every
+     * shard.
+     */
+
+    int shards;
+    int *found;
+    double *values;
+    char *keys;
+
+    /*
+     * Everything below is protected by mutex, except for the fields
+     * that are only used by the thread that started the search.
+     */
+
+    Tcl_Mutex mutex;
+    int nextShard;
+    unsigned long iterations;
+    char *error;		/* The first error from a worker. */
+    volatile int abort;
+
+    Tcl_ThreadId mainThread;
+    int running;
+    double reportedBest;
+    Tcl_Obj *errorObj;		/* The error from a callback. */
+} PermShared;
+
+typedef struct PermWorker {
+    PermShared *sharedPtr;
+    PermBest best;		/* Where the worker's copy keeps its key. */
+} PermWorker;
+
+typedef struct PermEvent {
+    Tcl_Event header;
+    PermShared *sharedPtr;
+    int kind;
+    char *args;
+    double value;
+} PermEvent;
+
+/*
+ * Remember the first error of the search, and stop the other workers.
+ */
+
+static void
+PermWorkerError(PermShared *sharedPtr, const char *message)
+{
+    Tcl_MutexLock(&sharedPtr->mutex);
+    if (sharedPtr->error == NULL) {
+	sharedPtr->error = (char *)ckalloc(strlen(message) + 1);
+	strcpy(sharedPtr->error, message);
+    }
+    sharedPtr->abort = 1;
+    Tcl_MutexUnlock(&sharedPtr->mutex);
+}
+
+/*
+ * Run a step or best fit command for a worker thread.  This is called by
+ * the event loop of the thread that started the search.
+ */
+
+static int
+PermEventProc(Tcl_Event *evPtr, int flags)
+{
+    PermEvent *eventPtr = (PermEvent *)evPtr;
+    PermShared *sharedPtr = eventPtr->sharedPtr;
+    CipherItem *itemPtr = sharedPtr->itemPtr;
+    Tcl_Interp *interp = sharedPtr->interp;
+    Tcl_DString dsPtr;
+    const char *cmd;
+
+    if (eventPtr->kind == PERM_EVENT_DONE) {
+	sharedPtr->running--;
+	return 1;
+    }
+
+    if (eventPtr->kind == PERM_EVENT_BESTFIT) {
+	if (eventPtr->value <= sharedPtr->reportedBest) {
+	    ckfree(eventPtr->args);
+	    return 1;
+	}
+	sharedPtr->reportedBest = eventPtr->value;
+	cmd = itemPtr->bestFitCommand;
+    } else {
+	cmd = itemPtr->stepCommand;
+    }
+
+    if (sharedPtr->errorObj == NULL && cmd) {
+	Tcl_DStringInit(&dsPtr);
+	Tcl_DStringAppendElement(&dsPtr, cmd);
+	Tcl_DStringAppend(&dsPtr, " ", 1);
+	Tcl_DStringAppend(&dsPtr, eventPtr->args, -1);
+
+	if (Tcl_Eval(interp, Tcl_DStringValue(&dsPtr)) != TCL_OK) {
+	    sharedPtr->errorObj = Tcl_GetObjResult(interp);
+	    Tcl_IncrRefCount(sharedPtr->errorObj);
+	    sharedPtr->abort = 1;
+	}
+	Tcl_ResetResult(interp);
+	Tcl_DStringFree(&dsPtr);
+    }
+
+    ckfree(eventPtr->args);
+    return 1;
+}
+
+static void
+PermQueueEvent(PermShared *sharedPtr, int kind, const char *args, double value)
+{
+    PermEvent *eventPtr = (PermEvent *)ckalloc(sizeof(PermEvent));
+
+    eventPtr->header.proc = PermEventProc;
+    eventPtr->sharedPtr = sharedPtr;
+    eventPtr->kind = kind;
+    eventPtr->args = (char *)NULL;
+    if (args) {
+	eventPtr->args = (char *)ckalloc(strlen(args) + 1);
+	strcpy(eventPtr->args, args);
+    }
+    eventPtr->value = value;
+
+    Tcl_ThreadQueueEvent(sharedPtr->mainThread, (Tcl_Event *)eventPtr,
+	    TCL_QUEUE_TAIL);
+    Tcl_ThreadAlert(sharedPtr->mainThread);
+}
+
+/*
+ * The step and best fit commands of a worker's cipher.  The arguments
+ * are passed on to the cipher's real commands.
+ */
+
+static int
+PermForward(PermWorker *workerPtr, Tcl_Interp *interp, int kind, int objc, Tcl_Obj *CONST objv[])
+{
+    PermShared *sharedPtr = workerPtr->sharedPtr;
+    Tcl_Obj *argsObj;
+
+    if (sharedPtr->abort) {
+	Tcl_SetResult(interp, "The search was stopped", TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    argsObj = Tcl_NewListObj(objc - 1, objv + 1);
+    Tcl_IncrRefCount(argsObj);
+    PermQueueEvent(sharedPtr, kind, Tcl_GetString(argsObj),
+	    *workerPtr->best.valuePtr);
+    Tcl_DecrRefCount(argsObj);
+
+    return TCL_OK;
+}
+
+static int
+PermForwardStepCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
+{
+    return PermForward((PermWorker *)clientData, interp, PERM_EVENT_STEP,
+	    objc, objv);
+}
+
+static int
+PermForwardBestFitCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
+{
+    return PermForward((PermWorker *)clientData, interp, PERM_EVENT_BESTFIT,
+	    objc, objv);
+}
+
+/*
+ * Return the next shard to search, or -1 if there are none left.
+ */
+
+static int
+PermNextShard(PermShared *sharedPtr)
+{
+    int shard = -1;
+
+    Tcl_MutexLock(&sharedPtr->mutex);
+    if (! sharedPtr->abort && sharedPtr->nextShard < sharedPtr->shards) {
+	shard = sharedPtr->nextShard++;
+    }
+    Tcl_MutexUnlock(&sharedPtr->mutex);
+
+    return shard;
+}
+
+/*
+ * Set up a worker's copy of the cipher.  Returns NULL, after recording
+ * the error, if it can't be made.
+ */
+
+static CipherItem *
+PermWorkerCipher(PermWorker *workerPtr, Tcl_Interp *interp)
+{
+    PermShared *sharedPtr = workerPtr->sharedPtr;
+    CipherItem *mainPtr = sharedPtr->itemPtr;
+    CipherItem *itemPtr;
+    char cmdName[64];
+    int i, keySize = 0;
+
+    itemPtr = CipherCloneCreate(interp, &sharedPtr->clone, cmdName,
+	    sizeof(cmdName));
+    if (itemPtr == NULL) {
+	PermWorkerError(sharedPtr, Tcl_GetStringResult(interp));
+	return (CipherItem *)NULL;
+    }
+
+    itemPtr->stepInterval = mainPtr->stepInterval;
+    if (mainPtr->stepCommand) {
+	Tcl_CreateObjCommand(interp, PERM_STEP_CMD, PermForwardStepCmd,
+		(ClientData)workerPtr, (Tcl_CmdDeleteProc *)NULL);
+	CipherSetStepCmd(itemPtr, PERM_STEP_CMD);
+    }
+    if (mainPtr->bestFitCommand) {
+	Tcl_CreateObjCommand(interp, PERM_BESTFIT_CMD, PermForwardBestFitCmd,
+		(ClientData)workerPtr, (Tcl_CmdDeleteProc *)NULL);
+	CipherSetBestFitCmd(itemPtr, PERM_BESTFIT_CMD);
+    }
+
+    /*
+     * The original cipher isn't touched until the workers are done, so
+     * it's safe to read it here.
+     */
+
+    if ((sharedPtr->startProc)(interp, (ClientData)mainPtr,
+		(ClientData)itemPtr, &workerPtr->best) != TCL_OK) {
+	PermWorkerError(sharedPtr, Tcl_GetStringResult(interp));
+	return (CipherItem *)NULL;
+    }
+    for (i=0; i < workerPtr->best.regionCount; i++) {
+	keySize += workerPtr->best.regions[i].size;
+    }
+    if (keySize != sharedPtr->keySize) {
+	PermWorkerError(sharedPtr,
+		"The copy of the cipher doesn't match the original");
+	return (CipherItem *)NULL;
+    }
+
+    return itemPtr;
+}
+
+static Tcl_ThreadCreateType
+PermWorkerThread(ClientData clientData)
+{
+    PermShared *sharedPtr = (PermShared *)clientData;
+    PermWorker worker;
+    Tcl_Interp *interp = Tcl_CreateInterp();
+    CipherItem *itemPtr;
+    int i, shard;
+
+    worker.sharedPtr = sharedPtr;
+    ScoreThreadSkipCache(1);
+
+    itemPtr = PermWorkerCipher(&worker, interp);
+    while (itemPtr != NULL && (shard = PermNextShard(sharedPtr)) >= 0) {
+	double before = *worker.best.valuePtr;
+	char *key;
+
+	if (_internalDoPermShardCmd((ClientData)itemPtr, interp,
+		    sharedPtr->n, sharedPtr->testFunc, shard) != TCL_OK) {
+	    PermWorkerError(sharedPtr, Tcl_GetStringResult(interp));
+	    break;
+	}
+
+	if (*worker.best.valuePtr > before) {
+	    key = sharedPtr->keys + shard * sharedPtr->keySize;
+	    for (i=0; i < worker.best.regionCount; i++) {
+		memcpy(key, worker.best.regions[i].data,
+			worker.best.regions[i].size);
+		key += worker.best.regions[i].size;
+	    }
+	    sharedPtr->values[shard] = *worker.best.valuePtr;
+	    sharedPtr->found[shard] = 1;
+	}
+    }
+
+    if (itemPtr != NULL && worker.best.iterationPtr) {
+	Tcl_MutexLock(&sharedPtr->mutex);
+	sharedPtr->iterations += *worker.best.iterationPtr;
+	Tcl_MutexUnlock(&sharedPtr->mutex);
+    }
+
+    Tcl_DeleteInterp(interp);
+    ScoreThreadFinish();
+    PermQueueEvent(sharedPtr, PERM_EVENT_DONE, (char *)NULL, 0.0);
+
+    Tcl_ExitThread(TCL_OK);
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/*
+ * Check that a search can be spread over several threads.
+ */
+
+static int
+PermCheckThreads(Tcl_Interp *interp, CipherItem *itemPtr)
+{
+    if (Tcl_GetVar2Ex(interp, "tcl_platform", "threaded",
+		TCL_GLOBAL_ONLY) == NULL) {
+	Tcl_SetResult(interp, "-threads needs a threaded build of Tcl",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (defaultScoreItem == NULL) {
+	Tcl_SetResult(interp,
+		"Scoring commands written in Tcl can't be used with -threads",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (itemPtr->checkpointFile || itemPtr->resumeFile) {
+	Tcl_SetResult(interp, "Checkpoints can't be used with -threads",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+
+/*
+ * Search all permutations of n elements with up to threads threads.
+ * clientData is the cipher being solved, which must already have been
+ * set up with startProc, and bestPtr describes where it keeps its best
+ * key.  On return the best key of the whole search is in the cipher's
+ * best key regions, as if _internalDoPermCmd had been used.
+ */
+
+int
+_internalDoPermThreadCmd(ClientData clientData, Tcl_Interp *interp, int n, int (*testFunc)(Tcl_Interp *, ClientData, int *, int), int threads, PermStartProc *startProc, PermBest *bestPtr)
+{
+    CipherItem *itemPtr = (CipherItem *)clientData;
+    PermShared shared;
+    Tcl_ThreadId *threadIds;
+    int result = TCL_OK;
+    int best = -1;
+    int i;
+
+    if (n <= 1) {
+	Tcl_SetResult(interp, "Length of permuted array must be > 1\n", TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (PermCheckThreads(interp, itemPtr) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    memset(&shared, 0, sizeof(PermShared));
+    shared.interp = interp;
+    shared.itemPtr = itemPtr;
+    shared.n = n;
+    shared.testFunc = testFunc;
+    shared.startProc = startProc;
+    shared.bestPtr = bestPtr;
+    shared.reportedBest = *bestPtr->valuePtr;
+    for (i=0; i < bestPtr->regionCount; i++) {
+	shared.keySize += bestPtr->regions[i].size;
+    }
+
+    if (CipherCloneInit(interp, itemPtr, itemPtr->typePtr->type,
+		&shared.clone) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    shared.shards = PermShardCount(n);
+    shared.found = (int *)ckalloc(sizeof(int) * shared.shards);
+    shared.values = (double *)ckalloc(sizeof(double) * shared.shards);
+    shared.keys = (char *)ckalloc(shared.keySize * shared.shards + 1);
+    for (i=0; i < shared.shards; i++) {
+	shared.found[i] = 0;
+	shared.values[i] = 0.0;
+    }
+    if (threads > shared.shards) {
+	threads = shared.shards;
+    }
+
+    /*
+     * Run the forwarded callbacks until every worker is done.  Each
+     * worker sends its "done" event last, so all of its callbacks have
+     * been run by then.
+     */
+
+    shared.mainThread = Tcl_GetCurrentThread();
+    threadIds = (Tcl_ThreadId *)ckalloc(sizeof(Tcl_ThreadId) * threads);
+    for (i=0; i < threads; i++) {
+	if (Tcl_CreateThread(threadIds + shared.running, PermWorkerThread,
+		    (ClientData)&shared, TCL_THREAD_STACK_DEFAULT,
+		    TCL_THREAD_JOINABLE) == TCL_OK) {
+	    shared.running++;
+	}
+    }
+    threads = shared.running;
+
+    while (shared.running > 0) {
+	Tcl_DoOneEvent(TCL_ALL_EVENTS);
+    }
+    for (i=0; i < threads; i++) {
+	int status;
+
+	Tcl_JoinThread(threadIds[i], &status);
+    }
+    ckfree((char *)threadIds);
+
+    /*
+     * Report a failed callback first, then the first failure in a worker.
+     */
+
+    if (threads == 0) {
+	Tcl_SetResult(interp, "Could not start the worker threads",
+		TCL_STATIC);
+	result = TCL_ERROR;
+    } else if (shared.errorObj) {
+	Tcl_SetObjResult(interp, shared.errorObj);
+	result = TCL_ERROR;
+    } else if (shared.error) {
+	Tcl_SetResult(interp, shared.error, TCL_VOLATILE);
+	result = TCL_ERROR;
+    }
+
+    if (result == TCL_OK) {
+	double maxValue = *bestPtr->valuePtr;
+	char *key;
+
+	for (i=0; i < shared.shards; i++) {
+	    if (shared.found[i] && shared.values[i] > maxValue) {
+		maxValue = shared.values[i];
+		best = i;
+	    }
+	}
+	if (best >= 0) {
+	    key = shared.keys + best * shared.keySize;
+	    for (i=0; i < bestPtr->regionCount; i++) {
+		memcpy(bestPtr->regions[i].data, key,
+			bestPtr->regions[i].size);
+		key += bestPtr->regions[i].size;
+	    }
+	    *bestPtr->valuePtr = maxValue;
+	}
+	if (bestPtr->iterationPtr) {
+	    *bestPtr->iterationPtr += shared.iterations;
+	}
+    }
+
+    if (shared.errorObj) {
+	Tcl_DecrRefCount(shared.errorObj);
+    }
+    if (shared.error) {
+	ckfree(shared.error);
+    }
+    CipherCloneFree(&shared.clone);
+    Tcl_MutexFinalize(&shared.mutex);
+    ckfree((char *)shared.found);
+    ckfree((char *)shared.values);
+    ckfree(shared.keys);
+
+    return result;
+}
@@ -30,6 +30,7 @@
 #include <score.h>
 
 #include <cipherDebug.h>
+#include <cipherRandom.h>
 
 static int  CreatePollux	_ANSI_ARGS_((Tcl_Interp *interp,
 				CipherItem *, int, const char **));
@@ -658,7 +659,8 @@ EncodePollux (Tcl_Interp *interp, CipherItem *itemPtr, const char *pt, const cha
     n = strlen(ct);
     for (i=0; i<n; i++) {
 	mark = trans[(unsigned)ct[i]];
-	ct[i] = palette[mark][rand()%npalette[mark]] + '0';
+	ct[i] = palette[mark][RandomIndex(RandomThreadState(),
+		npalette[mark])] + '0';
     }
 
     /*
@@ -26,10 +26,86 @@
 #include <score.h>
 #include <scoreInt.h>
 #include <string.h>
+#include <limits.h>
+#include <math.h>
 
 #include <cipherDebug.h>
 
 static int IsInternalScore _ANSI_ARGS_((ScoreItem *));
+static int ScoreDeltaCmd _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *,
+	    int, const char **));
+static int ScoreListCmd _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *,
+	    int, Tcl_Obj *CONST[]));
+static int IsScoreListOption _ANSI_ARGS_((int, Tcl_Obj *CONST[]));
+static int ScoreInvokeStringCmd _ANSI_ARGS_((Tcl_CmdProc *, ClientData,
+	    Tcl_Interp *, int, Tcl_Obj *CONST[]));
+static double ScoreItemValue _ANSI_ARGS_((Tcl_Interp *, ScoreItem *,
+	    const char *));
+static Tcl_WideUInt ScoreCacheHash _ANSI_ARGS_((const char *));
+static void ScoreCacheInvalidate _ANSI_ARGS_((void));
+static int ScoreCacheSizeCmd _ANSI_ARGS_((Tcl_Interp *, const char *, int,
+	    const char **));
+static int ScoreCacheStatsCmd _ANSI_ARGS_((Tcl_Interp *, const char *, int,
+	    const char **));
+
+/*
+ * Position lists up to this size are sorted in place by ScoreWindowDelta().
+ * Longer lists are copied to the heap first.
+ */
+#define SCORE_DELTA_SORT_SIZE	64
+
+/*
+ * An optional cache of plaintext scores in front of the builtin scoring
+ * objects.  Entries are keyed by a 64 bit hash of the plaintext and the
+ * scoring object.  The table is open addressed, and a lookup only probes
+ * SCORE_CACHE_PROBES slots so that it stays cheap when the table is
+ * full.  Changing any scoring table bumps the generation, which
+ * invalidates every entry at once.  The cache is off until it's given a
+ * size with "score cachesize".
+ */
+
+typedef struct ScoreCacheEntry {
+    Tcl_WideUInt hash;
+    ScoreItem *itemPtr;
+    unsigned int generation;
+    double value;
+} ScoreCacheEntry;
+
+#define SCORE_CACHE_PROBES	4
+#define SCORE_CACHE_MAX_SIZE	(1<<24)
+
+static ScoreCacheEntry *scoreCache = (ScoreCacheEntry *)NULL;
+static unsigned int scoreCacheSize = 0;
+static unsigned int scoreCacheGeneration = 1;
+static Tcl_WideUInt scoreCacheHits = 0;
+static Tcl_WideUInt scoreCacheMisses = 0;
+
+/*
+ * The cache isn't thread safe, so the worker threads of a search turn
+ * it off for themselves with ScoreThreadSkipCache().  Each thread also
+ * counts its own bounded scoring calls, and a worker thread adds its
+ * counts to the shared totals with ScoreThreadFinish() when it is done.
+ */
+
+typedef struct ScoreThreadData {
+    int skipCache;
+    Tcl_WideUInt boundedCalls;
+    Tcl_WideUInt boundedAborts;
+} ScoreThreadData;
+
+static Tcl_ThreadDataKey scoreDataKey;
+
+/*
+ * Bounded scoring checks whether a plaintext can still beat the cutoff
+ * after every block of this many windows.
+ */
+
+#define SCORE_BOUND_BLOCK	16
+#define SCORE_BOUND_SLACK	1e-9
+
+static Tcl_WideUInt scoreBoundedCalls = 0;
+static Tcl_WideUInt scoreBoundedAborts = 0;
+TCL_DECLARE_MUTEX(scoreBoundedMutex)
 
 ScoreItem *initialScoreItem = (ScoreItem *)NULL;
 ScoreItem *defaultScoreItem = (ScoreItem *)NULL;
@@ -42,15 +118,37 @@ extern ScoreType TrigramLogType;
 extern ScoreType TrigramCountType;
 extern ScoreType NgramLogType;
 extern ScoreType NgramCountType;
+extern ScoreType DenseNgramLogType;
+extern ScoreType DenseNgramCountType;
 extern ScoreType WordtreeType;
+extern ScoreType ComboType;
 
 int scoreid = 0;
+int scoreFixedScale = 0;
+
+/*
+ * Turn a count of fixed point units into a table entry.  Counts too big
+ * for an int are clamped so that they can't wrap around.
+ */
+
+int
+ScoreFixedEntry(double fixed) {
+    if (fixed > (double)INT_MAX) {
+	return INT_MAX;
+    }
+    if (fixed < (double)-INT_MAX) {
+	return -INT_MAX;
+    }
+    return (int)fixed;
+}
 
 int
 InitScoreTypes(Tcl_Interp *interp)
 {
     int i, j;
 
+    ScoreKernelInit();
+
     if (typeList == NULL) {
 	typeList = &DigramLogType;
 	DigramLogType.nextPtr = &DigramCountType;
@@ -58,8 +156,11 @@ InitScoreTypes(Tcl_Interp *interp)
 	TrigramLogType.nextPtr = &TrigramCountType;
 	TrigramCountType.nextPtr = &NgramLogType;
 	NgramLogType.nextPtr = &NgramCountType;
-	NgramCountType.nextPtr = &WordtreeType;
-	WordtreeType.nextPtr = NULL;
+	NgramCountType.nextPtr = &DenseNgramLogType;
+	DenseNgramLogType.nextPtr = &DenseNgramCountType;
+	DenseNgramCountType.nextPtr = &WordtreeType;
+	WordtreeType.nextPtr = &ComboType;
+	ComboType.nextPtr = NULL;
     }
 
     /*
@@ -89,11 +190,11 @@ InitScoreTypes(Tcl_Interp *interp)
      * match the type that is the first in the type list.
      */
 
-    for(i =0 ; i < 256; i++) {
+    for(i =0 ; i < 26; i++) {
 	char temp_str[3];
-	for(j=0; j < 256; j++) {
-	    temp_str[0] = i;
-	    temp_str[1] = j;
+	for(j=0; j < 26; j++) {
+	    temp_str[0] = 'a' + i;
+	    temp_str[1] = 'a' + j;
 	    temp_str[2] = '\0';
 	    (typeList->addProc)(interp, initialScoreItem, temp_str, defaultScoreData[i][j]);
 	}
@@ -154,6 +255,7 @@ ScoreCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **argv)
 {
     ScoreType *typePtr, *matchPtr = NULL;
     ScoreItem *itemPtr;
+    Tcl_CmdInfo cmdInfo;
     char temp_str[128];
     const char *cmd = argv[0];
 
@@ -221,6 +323,71 @@ ScoreCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **argv)
 
 	Tcl_SetObjResult(interp, Tcl_NewDoubleObj(value));
 	return TCL_OK;
+    } else if (**argv == 'b' && (strcmp(*argv, "boundedvalue") == 0)) {
+	double cutoff;
+	double bound;
+	double value;
+
+	if (argc < 3 || argc > 4) {
+	    Tcl_AppendResult(interp, "usage:  ", cmd,
+		    " boundedvalue string cutoff ?bound?", (char *)NULL);
+	    return TCL_ERROR;
+	}
+
+	if (Tcl_GetDouble(interp, argv[2], &cutoff) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+
+	if (argc == 4) {
+	    if (Tcl_GetDouble(interp, argv[3], &bound) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else {
+	    DefaultScoreBound(&bound);
+	}
+
+	if (DefaultScoreBoundedValue(interp, argv[1], cutoff, bound, &value)
+		!= TCL_OK) {
+	    return TCL_ERROR;
+	}
+
+	Tcl_SetObjResult(interp, Tcl_NewDoubleObj(value));
+	return TCL_OK;
+    } else if (**argv == 'b' && (strcmp(*argv, "boundstats") == 0)) {
+	ScoreThreadData *dataPtr;
+	Tcl_WideUInt calls, aborts;
+	Tcl_Obj *resultObj;
+
+	if (argc != 1) {
+	    Tcl_AppendResult(interp,
+		    "Wrong number of args.  Should be:  ", cmd, " boundstats",
+		    (char *)NULL);
+	    return TCL_ERROR;
+	}
+
+	dataPtr = (ScoreThreadData *)Tcl_GetThreadData(&scoreDataKey,
+		sizeof(ScoreThreadData));
+	Tcl_MutexLock(&scoreBoundedMutex);
+	calls = scoreBoundedCalls + dataPtr->boundedCalls;
+	aborts = scoreBoundedAborts + dataPtr->boundedAborts;
+	Tcl_MutexUnlock(&scoreBoundedMutex);
+
+	resultObj = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+	Tcl_ListObjAppendElement(interp, resultObj,
+		Tcl_NewStringObj("calls", -1));
+	Tcl_ListObjAppendElement(interp, resultObj,
+		Tcl_NewWideIntObj((Tcl_WideInt)calls));
+	Tcl_ListObjAppendElement(interp, resultObj,
+		Tcl_NewStringObj("aborts", -1));
+	Tcl_ListObjAppendElement(interp, resultObj,
+		Tcl_NewWideIntObj((Tcl_WideInt)aborts));
+	Tcl_SetObjResult(interp, resultObj);
+
+	return TCL_OK;
+    } else if (**argv == 'c' && (strcmp(*argv, "cachesize") == 0)) {
+	return ScoreCacheSizeCmd(interp, cmd, argc, argv);
+    } else if (**argv == 'c' && (strcmp(*argv, "cachestats") == 0)) {
+	return ScoreCacheStatsCmd(interp, cmd, argc, argv);
     } else if (**argv == 'c' && (strncmp(*argv, "create", 1) == 0)) {
 	if (argc < 2) {
 	    Tcl_AppendResult(interp, "Usage:  ", cmd, " create type",
@@ -257,9 +424,22 @@ ScoreCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **argv)
 	    return TCL_ERROR;
 	}
 
+	/*
+	 * The scoring object's command was created as a string command.
+	 * Add an object procedure so that "valuelist" and "bestof" can
+	 * read their lists without converting them to strings first.
+	 */
+	if (Tcl_GetCommandInfo(interp, Tcl_GetStringResult(interp), &cmdInfo)) {
+	    cmdInfo.objProc = ScoreMethodObjCmd;
+	    cmdInfo.objClientData = (ClientData)itemPtr;
+	    Tcl_SetCommandInfo(interp, Tcl_GetStringResult(interp), &cmdInfo);
+	}
+
 	AddInternalScore(itemPtr);
 
 	return TCL_OK;
+    } else if (**argv == 'd' && (strcmp(*argv, "delta") == 0)) {
+	return ScoreDeltaCmd(interp, (ScoreItem *)NULL, cmd, argc, argv);
     } else if (**argv == 'd' && (strncmp(*argv, "default", 1) == 0)) {
 	Tcl_CmdInfo cmdInfo;
 	if (argc > 2) {
@@ -312,6 +492,47 @@ ScoreCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **argv)
 	}
 
 	Tcl_SetObjResult(interp, Tcl_NewIntObj(IsInternalScore(cmdInfo.clientData)));
+	return TCL_OK;
+    } else if ((**argv == 's' && (strncmp(*argv, "save", 4) == 0))
+	    || (**argv == 'l' && (strncmp(*argv, "load", 4) == 0))) {
+	int save = (**argv == 's');
+
+	if (argc != 3) {
+	    Tcl_AppendResult(interp,
+		    "Wrong number of args.  Should be:  ", cmd, " ", *argv,
+		    " command filename", (char *)NULL);
+	    return TCL_ERROR;
+	}
+
+	itemPtr = GetInternalScore(interp, argv[1]);
+	if (itemPtr == NULL) {
+	    return TCL_ERROR;
+	}
+
+	if ((save && itemPtr->typePtr->saveProc == NULL)
+		|| (!save && itemPtr->typePtr->loadProc == NULL)) {
+	    Tcl_AppendResult(interp, "Binary score tables are not supported for the ",
+		    itemPtr->typePtr->type, " type.", (char *)NULL);
+	    return TCL_ERROR;
+	}
+
+	if (save) {
+	    if (! itemPtr->initialized) {
+		Tcl_SetResult(interp, 
+			"Attempt to use uninitialized scoring object.", 
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+
+	    return (itemPtr->typePtr->saveProc)(interp, itemPtr, argv[2]);
+	}
+
+	ScoreCacheInvalidate();
+	if ((itemPtr->typePtr->loadProc)(interp, itemPtr, argv[2]) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	itemPtr->initialized = 1;
+
 	return TCL_OK;
     } else if (**argv == 't' && (strncmp(*argv, "types", 5) == 0)) {
 	if (argc > 1) {
@@ -336,6 +557,33 @@ ScoreCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char **argv)
 
         Tcl_SetResult(interp, defaultScoreItem->typePtr->type, TCL_VOLATILE);
 
+	return TCL_OK;
+    } else if (**argv == 'f' && (strncmp(*argv, "fixedpoint", 5) == 0)) {
+	int scale;
+
+	if (argc > 2) {
+	    Tcl_AppendResult(interp,
+		    "Wrong number of args.  Should be:  ", cmd,
+		    " fixedpoint ?scale?", (char *)NULL);
+	    return TCL_ERROR;
+	}
+
+	if (argc == 2) {
+	    if (Tcl_GetInt(interp, argv[1], &scale) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+
+	    if (scale < 0 || scale > SCORE_FIXED_MAX_SCALE) {
+		sprintf(temp_str, "%d", SCORE_FIXED_MAX_SCALE);
+		Tcl_AppendResult(interp, "Scale must be between 0 and ",
+			temp_str, (char *)NULL);
+		return TCL_ERROR;
+	    }
+
+	    scoreFixedScale = scale;
+	}
+
+	Tcl_SetObjResult(interp, Tcl_NewIntObj(scoreFixedScale));
 	return TCL_OK;
     } else {
 	Tcl_AppendResult(interp, "Usage:  ", cmd, " ?option? ?args?",
@@ -363,6 +611,11 @@ DeleteScore(ClientData clientData)
 	defaultScoreCommand = (Tcl_Obj *)NULL;
     }
 
+    /*
+     * The memory for this item could be reused by a new scoring object.
+     */
+    ScoreCacheInvalidate();
+
     ckfree((char *) clientData);
 }
 
@@ -384,6 +637,31 @@ IsInternalScore(ScoreItem *itemPtr)
     return 0;
 }
 
+/*
+ * Return the scoring object for a command that was created by "score
+ * create".  If there is no such command, or it's a custom scoring
+ * command, an error is left in the interpreter and NULL is returned.
+ */
+
+ScoreItem *
+GetInternalScore(Tcl_Interp *interp, const char *cmdName) {
+    Tcl_CmdInfo cmdInfo;
+
+    if (Tcl_GetCommandInfo(interp, cmdName, &cmdInfo) != 1) {
+	Tcl_AppendResult(interp, "Command '", cmdName, "' not found.",
+		(char *)NULL);
+	return (ScoreItem *)NULL;
+    }
+
+    if (! IsInternalScore(cmdInfo.clientData)) {
+	Tcl_AppendResult(interp, "Command '", cmdName,
+		"' is not a builtin scoring object.", (char *)NULL);
+	return (ScoreItem *)NULL;
+    }
+
+    return (ScoreItem *)(cmdInfo.clientData);
+}
+
 void
 AddInternalScore(ScoreItem *itemPtr) {
     ScoreItem **scoreList = (ScoreItem **)ckalloc(sizeof(ScoreItem *) * (scoreid + 2));
@@ -400,35 +678,246 @@ AddInternalScore(ScoreItem *itemPtr) {
     newScores = scoreList;
 }
 
-double
-DigramStringValue(const char *string, double **table) {
-    int length = strlen(string);
-    double value = 0.0;
+/*
+ * Hash a plaintext for the score cache.  The string is mixed in 8 bytes
+ * at a time so that hashing costs much less than scoring.
+ */
+
+static Tcl_WideUInt
+ScoreCacheHash(const char *string) {
+    const Tcl_WideUInt multiplier = (Tcl_WideUInt)0x9e3779b97f4a7c15ULL;
+    size_t length = strlen(string);
+    Tcl_WideUInt hash = (Tcl_WideUInt)0xcbf29ce484222325ULL ^ length;
+    Tcl_WideUInt chunk;
+    size_t i;
+
+    for (i=0; i+8 <= length; i += 8) {
+	memcpy(&chunk, string+i, 8);
+	hash = (hash ^ chunk) * multiplier;
+	hash ^= hash >> 29;
+    }
+
+    chunk = 0;
+    memcpy(&chunk, string+i, length-i);
+    hash = (hash ^ chunk) * multiplier;
+    hash ^= hash >> 32;
+    hash *= multiplier;
+    hash ^= hash >> 29;
+
+    return hash;
+}
+
+/*
+ * Score a string with a builtin scoring object, going through the score
+ * cache if it's enabled.
+ */
+
+static double
+ScoreItemValue(Tcl_Interp *interp, ScoreItem *itemPtr, const char *string) {
+    ScoreCacheEntry *entryPtr;
+    ScoreCacheEntry *victimPtr = (ScoreCacheEntry *)NULL;
+    Tcl_WideUInt hash;
+    unsigned int mask = scoreCacheSize - 1;
+    unsigned int slot;
+    double value;
     int i;
 
-    for (i=1; i < length; i++) {
-	value += DigramSingleValue(string[i-1], string[i], table);
+    if (scoreCache == NULL || ((ScoreThreadData *)Tcl_GetThreadData(
+		&scoreDataKey, sizeof(ScoreThreadData)))->skipCache) {
+	return (itemPtr->typePtr->valueProc)(interp, itemPtr, string);
+    }
+
+    hash = ScoreCacheHash(string);
+
+    slot = (unsigned int)(hash ^ (hash >> 32)) & mask;
+    for (i=0; i < SCORE_CACHE_PROBES; i++) {
+	entryPtr = scoreCache + ((slot + i) & mask);
+
+	if (entryPtr->generation != scoreCacheGeneration) {
+	    if (victimPtr == NULL) {
+		victimPtr = entryPtr;
+	    }
+	} else if (entryPtr->hash == hash && entryPtr->itemPtr == itemPtr) {
+	    scoreCacheHits++;
+	    return entryPtr->value;
+	}
+    }
+
+    /*
+     * If every probed slot is in use then evict one of them, picked
+     * with the high bits of the hash.
+     */
+
+    if (victimPtr == NULL) {
+	victimPtr = scoreCache
+	    + ((slot + (unsigned int)(hash >> 32) % SCORE_CACHE_PROBES) & mask);
     }
-    
+
+    scoreCacheMisses++;
+    value = (itemPtr->typePtr->valueProc)(interp, itemPtr, string);
+
+    victimPtr->hash = hash;
+    victimPtr->itemPtr = itemPtr;
+    victimPtr->generation = scoreCacheGeneration;
+    victimPtr->value = value;
+
     return value;
 }
-
+
 /*
- * This has been replaced by a macro.  See score.h for details.
+ * Turn the score cache off, or back on, for the calling thread.
  */
+
+void
+ScoreThreadSkipCache(int skip) {
+    ScoreThreadData *dataPtr = (ScoreThreadData *)Tcl_GetThreadData(
+	    &scoreDataKey, sizeof(ScoreThreadData));
+
+    dataPtr->skipCache = skip;
+}
+
 /*
-double
-DigramSingleValue(unsigned char val1, unsigned char val2, double **table) {
-    return table[val1][val2];
+ * Add the bounded scoring counts of the calling thread to the totals
+ * that every thread sees.
+ */
+
+void
+ScoreThreadFinish() {
+    ScoreThreadData *dataPtr = (ScoreThreadData *)Tcl_GetThreadData(
+	    &scoreDataKey, sizeof(ScoreThreadData));
+
+    Tcl_MutexLock(&scoreBoundedMutex);
+    scoreBoundedCalls += dataPtr->boundedCalls;
+    scoreBoundedAborts += dataPtr->boundedAborts;
+    Tcl_MutexUnlock(&scoreBoundedMutex);
+
+    dataPtr->boundedCalls = 0;
+    dataPtr->boundedAborts = 0;
 }
-*/
-
+
+static void
+ScoreCacheInvalidate() {
+    scoreCacheGeneration++;
+
+    /*
+     * Entries from the generation that has wrapped around would look
+     * valid again.
+     */
+
+    if (scoreCacheGeneration == 0) {
+	if (scoreCache) {
+	    memset(scoreCache, 0, sizeof(ScoreCacheEntry) * scoreCacheSize);
+	}
+	scoreCacheGeneration = 1;
+    }
+}
+
+/*
+ *	score cachesize ?entries?
+ *
+ * Set the number of entries in the score cache, rounded up to a power of
+ * two.  A size of 0 turns the cache off.  Changing the size empties the
+ * cache and resets the statistics.  Returns the current size.
+ */
+
+static int
+ScoreCacheSizeCmd(Tcl_Interp *interp, const char *cmd, int argc, const char **argv) {
+    char temp_str[TCL_INTEGER_SPACE];
+    int size;
+    unsigned int newSize;
+
+    if (argc > 2) {
+	Tcl_AppendResult(interp,
+		"Wrong number of args.  Should be:  ", cmd,
+		" cachesize ?entries?", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    if (argc == 2) {
+	if (Tcl_GetInt(interp, argv[1], &size) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+
+	if (size < 0 || size > SCORE_CACHE_MAX_SIZE) {
+	    sprintf(temp_str, "%d", SCORE_CACHE_MAX_SIZE);
+	    Tcl_AppendResult(interp, "Cache size must be between 0 and ",
+		    temp_str, (char *)NULL);
+	    return TCL_ERROR;
+	}
+
+	for (newSize=(size ? SCORE_CACHE_PROBES : 0); newSize < size;
+		newSize <<= 1) {
+	}
+
+	if (scoreCache) {
+	    ckfree((char *)scoreCache);
+	    scoreCache = (ScoreCacheEntry *)NULL;
+	}
+	scoreCacheSize = newSize;
+	if (newSize) {
+	    scoreCache = (ScoreCacheEntry *)ckalloc(sizeof(ScoreCacheEntry)
+		    * newSize);
+	    memset(scoreCache, 0, sizeof(ScoreCacheEntry) * newSize);
+	}
+	scoreCacheGeneration = 1;
+	scoreCacheHits = 0;
+	scoreCacheMisses = 0;
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewIntObj((int)scoreCacheSize));
+    return TCL_OK;
+}
+
+/*
+ *	score cachestats
+ *
+ * Returns a list of the cache size, the number of valid entries, and the
+ * number of hits and misses since the size was last set.
+ */
+
+static int
+ScoreCacheStatsCmd(Tcl_Interp *interp, const char *cmd, int argc, const char **argv) {
+    Tcl_Obj *resultObj;
+    int used = 0;
+    int i;
+
+    if (argc != 1) {
+	Tcl_AppendResult(interp,
+		"Wrong number of args.  Should be:  ", cmd, " cachestats",
+		(char *)NULL);
+	return TCL_ERROR;
+    }
+
+    for (i=0; i < scoreCacheSize; i++) {
+	if (scoreCache[i].generation == scoreCacheGeneration) {
+	    used++;
+	}
+    }
+
+    resultObj = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+    Tcl_ListObjAppendElement(interp, resultObj, Tcl_NewStringObj("size", -1));
+    Tcl_ListObjAppendElement(interp, resultObj,
+	    Tcl_NewIntObj((int)scoreCacheSize));
+    Tcl_ListObjAppendElement(interp, resultObj, Tcl_NewStringObj("used", -1));
+    Tcl_ListObjAppendElement(interp, resultObj, Tcl_NewIntObj(used));
+    Tcl_ListObjAppendElement(interp, resultObj, Tcl_NewStringObj("hits", -1));
+    Tcl_ListObjAppendElement(interp, resultObj,
+	    Tcl_NewWideIntObj((Tcl_WideInt)scoreCacheHits));
+    Tcl_ListObjAppendElement(interp, resultObj,
+	    Tcl_NewStringObj("misses", -1));
+    Tcl_ListObjAppendElement(interp, resultObj,
+	    Tcl_NewWideIntObj((Tcl_WideInt)scoreCacheMisses));
+    Tcl_SetObjResult(interp, resultObj);
+
+    return TCL_OK;
+}
+
 int
 DefaultScoreValue(Tcl_Interp *interp, const char *string, double *value) {
     *value = 0.0;
 
     if (defaultScoreItem != NULL) {
-	*value = (defaultScoreItem->typePtr->valueProc)(interp, defaultScoreItem, string);
+	*value = ScoreItemValue(interp, defaultScoreItem, string);
 	Tcl_SetObjResult(interp, Tcl_NewDoubleObj(*value));
     } else if (interp == NULL) {
 	return TCL_ERROR;
@@ -505,6 +994,513 @@ DefaultScoreElementValue(Tcl_Interp *interp, const char *element, double *value)
     return TCL_OK;
 }
 
+/*
+ * Score newString given that it differs from oldString, which has a score
+ * of oldValue, only at the listed positions.  Both strings must have the
+ * same length.  If the default score type can't rescore part of a string,
+ * or the default is a Tcl command, then newString is scored in full.
+ * Unlike DefaultScoreValue() the interpreter result is left alone when
+ * the delta can be used.
+ */
+
+int
+DefaultScoreDeltaValue(Tcl_Interp *interp, const char *oldString, const char *newString, double oldValue, const int *positions, int count, double *value) {
+    if (defaultScoreItem != NULL && defaultScoreItem->typePtr->deltaProc) {
+	*value = (defaultScoreItem->typePtr->deltaProc)(interp,
+		defaultScoreItem, oldString, newString, oldValue, positions,
+		count);
+	return TCL_OK;
+    }
+
+    return DefaultScoreValue(interp, newString, value);
+}
+
+/*
+ * The same as DefaultScoreValue() and DefaultScoreDeltaValue() for a
+ * builtin scoring object.  If itemPtr is NULL then the default scoring
+ * table is used.
+ */
+
+int
+ScoreObjectValue(Tcl_Interp *interp, ScoreItem *itemPtr, const char *string, double *value) {
+    if (itemPtr == NULL) {
+	return DefaultScoreValue(interp, string, value);
+    }
+
+    *value = ScoreItemValue(interp, itemPtr, string);
+    return TCL_OK;
+}
+
+int
+ScoreObjectDeltaValue(Tcl_Interp *interp, ScoreItem *itemPtr, const char *oldString, const char *newString, double oldValue, const int *positions, int count, double *value) {
+    if (itemPtr == NULL) {
+	return DefaultScoreDeltaValue(interp, oldString, newString, oldValue,
+		positions, count, value);
+    }
+
+    if (itemPtr->typePtr->deltaProc) {
+	*value = (itemPtr->typePtr->deltaProc)(interp, itemPtr, oldString,
+		newString, oldValue, positions, count);
+    } else {
+	*value = ScoreItemValue(interp, itemPtr, newString);
+    }
+
+    return TCL_OK;
+}
+
+/*
+ * Get an upper bound on the value that any one window of a plaintext can
+ * add to its score with the default scoring table, for use with
+ * DefaultScoreBoundedValue().  Returns 0 if the default table doesn't
+ * support bounded scoring, in which case DefaultScoreBoundedValue()
+ * always scores the full plaintext.
+ */
+
+int
+DefaultScoreBound(double *bound) {
+    *bound = 0.0;
+
+    if (defaultScoreItem == NULL || defaultScoreItem->typePtr->maxProc == NULL
+	    || defaultScoreItem->elemSize < 1) {
+	return 0;
+    }
+
+    *bound = (defaultScoreItem->typePtr->maxProc)(defaultScoreItem);
+    return 1;
+}
+
+/*
+ * Score a plaintext that only matters if its score is greater than
+ * cutoff.  The windows of the plaintext are scored SCORE_BOUND_BLOCK at a
+ * time, and scoring stops as soon as the windows that are left couldn't
+ * raise the score above the cutoff even if each of them added bound.
+ * In that case *value is an upper bound on the score that is no greater
+ * than the cutoff.  Otherwise *value is the sum of the blocks, which is
+ * the sum of the windows that the value proc computes.  For types that
+ * keep doubles or fixed point values the two sums are added up in a
+ * different order and can differ by rounding, but never by more than a
+ * few units in the last place.  bound should come from
+ * DefaultScoreBound().
+ */
+
+int
+DefaultScoreBoundedValue(Tcl_Interp *interp, const char *string, double cutoff, double bound, double *value) {
+    ScoreItem *itemPtr = defaultScoreItem;
+    ScoreThreadData *dataPtr;
+    double partial = 0.0;
+    double limit;
+    int windows;
+    int start, count;
+
+    if (itemPtr == NULL || itemPtr->typePtr->blockProc == NULL
+	    || itemPtr->elemSize < 1) {
+	return DefaultScoreValue(interp, string, value);
+    }
+
+    dataPtr = (ScoreThreadData *)Tcl_GetThreadData(&scoreDataKey,
+	    sizeof(ScoreThreadData));
+    dataPtr->boundedCalls++;
+
+    /*
+     * Leave a little room for rounding so that a plaintext is never
+     * dropped when its full score would be above the cutoff.
+     */
+
+    limit = cutoff - SCORE_BOUND_SLACK * (cutoff < 0.0 ? -cutoff : cutoff);
+    windows = strlen(string) - itemPtr->elemSize + 1;
+
+    for (start=0; start < windows; start += count) {
+	double best;
+
+	count = windows - start;
+	if (count > SCORE_BOUND_BLOCK) {
+	    count = SCORE_BOUND_BLOCK;
+	}
+
+	partial += (itemPtr->typePtr->blockProc)(itemPtr, string, start,
+		count);
+	best = partial + (windows - start - count) * bound;
+	if (best < limit) {
+	    dataPtr->boundedAborts++;
+	    *value = best;
+	    return TCL_OK;
+	}
+    }
+
+    *value = partial;
+    if (interp != NULL) {
+	Tcl_SetObjResult(interp, Tcl_NewDoubleObj(partial));
+    }
+    return TCL_OK;
+}
+
+/*
+ * Add up the values of the windows that lie entirely within the first
+ * length characters of a string, with the default scoring table.  Sets
+ * *countPtr to the number of windows.  Returns 0 if the default table
+ * can't score windows on their own, for bounding the score of a
+ * plaintext that is only partly known.
+ */
+
+int
+DefaultScoreWindowSum(const char *string, int length, double *value, int *countPtr) {
+    ScoreItem *itemPtr = defaultScoreItem;
+    int count;
+
+    *value = 0.0;
+    *countPtr = 0;
+
+    if (itemPtr == NULL || itemPtr->typePtr->blockProc == NULL
+	    || itemPtr->elemSize < 1) {
+	return 0;
+    }
+
+    count = length - itemPtr->elemSize + 1;
+    if (count > 0) {
+	*value = (itemPtr->typePtr->blockProc)(itemPtr, string, 0, count);
+	*countPtr = count;
+    }
+
+    return 1;
+}
+
+/*
+ * A generic delta proc for types that score a string by summing the value
+ * of every windowSize long substring.  windowProc returns the value of the
+ * window starting at an offset in the string.  Only windows that overlap
+ * one of the positions are rescored, and each of them only once no matter
+ * how many of the positions it overlaps.
+ */
+
+double
+ScoreWindowDelta(ScoreItem *itemPtr, ScoreWindowProc *windowProc, int windowSize, const char *oldString, const char *newString, double oldValue, const int *positions, int count) {
+    int sortBuffer[SCORE_DELTA_SORT_SIZE];
+    int *sorted = sortBuffer;
+    double delta = 0.0;
+    int next = 0;
+    int i, j;
+
+    if (count <= 0) {
+	return oldValue;
+    }
+
+    if (count > SCORE_DELTA_SORT_SIZE) {
+	sorted = (int *)ckalloc(sizeof(int) * count);
+    }
+
+    /*
+     * The lists are usually short, so an insertion sort will do.
+     */
+
+    for (i=0; i < count; i++) {
+	int p = positions[i];
+
+	for (j=i; j > 0 && sorted[j-1] > p; j--) {
+	    sorted[j] = sorted[j-1];
+	}
+	sorted[j] = p;
+    }
+
+    for (i=0; i < count; i++) {
+	int p = sorted[i];
+	int avail, first, last, start;
+
+	if (p < 0) {
+	    continue;
+	}
+
+	/*
+	 * The windows that contain position p start anywhere from
+	 * p-windowSize+1 to p, but can't run past the end of the string.
+	 * Skip any that were handled for an earlier position.
+	 */
+
+	for (avail=0; avail < windowSize-1 && newString[p+1+avail]; avail++) {
+	}
+
+	first = p - windowSize + 1;
+	if (first < next) {
+	    first = next;
+	}
+	if (first < 0) {
+	    first = 0;
+	}
+	last = p + avail - windowSize + 1;
+
+	for (start=first; start <= last; start++) {
+	    delta += windowProc(itemPtr, newString, start)
+		- windowProc(itemPtr, oldString, start);
+	}
+
+	if (last+1 > next) {
+	    next = last+1;
+	}
+    }
+
+    if (sorted != sortBuffer) {
+	ckfree((char *)sorted);
+    }
+
+    return oldValue + delta;
+}
+
+/*
+ * Implements the "delta" subcommand for both the score command and the
+ * scoring objects.  itemPtr is NULL when the default score should be used.
+ *
+ *	delta oldString newString oldValue ?positions?
+ *
+ * If the positions aren't given then every position at which the strings
+ * differ is used.
+ */
+
+static int
+ScoreDeltaCmd(Tcl_Interp *interp, ScoreItem *itemPtr, const char *cmd, int argc, const char **argv) {
+    int positionBuffer[SCORE_DELTA_SORT_SIZE];
+    int *positions = positionBuffer;
+    int length = 0;
+    int count = 0;
+    double oldValue;
+    double value;
+    int result = TCL_OK;
+    int i;
+
+    if (argc < 4 || argc > 5) {
+	Tcl_AppendResult(interp, "usage:  ", cmd,
+		" delta oldstring newstring oldvalue ?positions?",
+		(char *)NULL);
+	return TCL_ERROR;
+    }
+
+    if (itemPtr && ! itemPtr->initialized) {
+	Tcl_SetResult(interp, 
+		"Attempt to use uninitialized scoring object.", 
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    length = strlen(argv[1]);
+    if (strlen(argv[2]) != length) {
+	Tcl_SetResult(interp, "The old and new strings must be the same length.", TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    if (Tcl_GetDouble(interp, argv[3], &oldValue) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    if (argc == 5) {
+	const char **positionList;
+
+	if (Tcl_SplitList(interp, argv[4], &count, &positionList) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (count > SCORE_DELTA_SORT_SIZE) {
+	    positions = (int *)ckalloc(sizeof(int) * count);
+	}
+	for (i=0; i < count && result == TCL_OK; i++) {
+	    result = Tcl_GetInt(interp, positionList[i], positions+i);
+	    if (result == TCL_OK && (positions[i] < 0 || positions[i] >= length)) {
+		Tcl_AppendResult(interp, "Position ", positionList[i],
+			" is outside of the string.", (char *)NULL);
+		result = TCL_ERROR;
+	    }
+	}
+	ckfree((char *)positionList);
+    } else {
+	for (i=0; i < length; i++) {
+	    if (argv[1][i] != argv[2][i]) {
+		if (count == SCORE_DELTA_SORT_SIZE && positions == positionBuffer) {
+		    positions = (int *)ckalloc(sizeof(int) * length);
+		    memcpy(positions, positionBuffer, sizeof(int) * count);
+		}
+		positions[count++] = i;
+	    }
+	}
+    }
+
+    if (result == TCL_OK) {
+	if (itemPtr == NULL) {
+	    result = DefaultScoreDeltaValue(interp, argv[1], argv[2], oldValue,
+		    positions, count, &value);
+	} else if (itemPtr->typePtr->deltaProc) {
+	    value = (itemPtr->typePtr->deltaProc)(interp, itemPtr, argv[1],
+		    argv[2], oldValue, positions, count);
+	} else {
+	    value = (itemPtr->typePtr->valueProc)(interp, itemPtr, argv[2]);
+	}
+    }
+
+    if (positions != positionBuffer) {
+	ckfree((char *)positions);
+    }
+
+    if (result == TCL_OK) {
+	Tcl_SetObjResult(interp, Tcl_NewDoubleObj(value));
+    }
+
+    return result;
+}
+
+/*
+ * Score every string in a list with a single command.  The "valuelist"
+ * form returns the list of scores, the "bestof" form returns the index
+ * and score of the highest scoring string.  If itemPtr is NULL then the
+ * default scoring table is used.
+ */
+
+static int
+ScoreListCmd(Tcl_Interp *interp, ScoreItem *itemPtr, const char *cmd, int objc, Tcl_Obj *CONST objv[]) {
+    const char *option = Tcl_GetString(objv[0]);
+    int bestOnly = (*option == 'b');
+    Tcl_Obj **stringObjs;
+    Tcl_Obj *resultObj = (Tcl_Obj *)NULL;
+    double value = 0.0;
+    double bestValue = 0.0;
+    int bestIndex = -1;
+    int count;
+    int i;
+
+    if (objc != 2) {
+	Tcl_AppendResult(interp, "usage:  ", cmd, " ", option, " stringlist",
+		(char *)NULL);
+	return TCL_ERROR;
+    }
+
+    if (itemPtr == NULL) {
+	itemPtr = defaultScoreItem;
+    } else if (! itemPtr->initialized) {
+	Tcl_SetResult(interp, 
+		"Attempt to use uninitialized scoring object.", 
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    if (Tcl_ListObjGetElements(interp, objv[1], &count, &stringObjs)
+	    != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    /*
+     * Hold on to the list in case a custom scoring command modifies
+     * the variable that it came from.
+     */
+    Tcl_IncrRefCount(objv[1]);
+    if (! bestOnly) {
+	resultObj = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+    }
+
+    for (i=0; i < count; i++) {
+	if (itemPtr) {
+	    value = ScoreItemValue(interp, itemPtr,
+		    Tcl_GetString(stringObjs[i]));
+	} else if (DefaultScoreValue(interp, Tcl_GetString(stringObjs[i]),
+		    &value) != TCL_OK) {
+	    if (resultObj) {
+		Tcl_DecrRefCount(resultObj);
+	    }
+	    Tcl_DecrRefCount(objv[1]);
+	    return TCL_ERROR;
+	}
+
+	if (bestOnly) {
+	    if (bestIndex < 0 || value > bestValue) {
+		bestIndex = i;
+		bestValue = value;
+	    }
+	} else {
+	    Tcl_ListObjAppendElement((Tcl_Interp *)NULL, resultObj,
+		    Tcl_NewDoubleObj(value));
+	}
+    }
+    Tcl_DecrRefCount(objv[1]);
+
+    if (bestOnly) {
+	Tcl_ResetResult(interp);
+	if (bestIndex >= 0) {
+	    Tcl_Obj *pair[2];
+
+	    pair[0] = Tcl_NewIntObj(bestIndex);
+	    pair[1] = Tcl_NewDoubleObj(bestValue);
+	    Tcl_SetObjResult(interp, Tcl_NewListObj(2, pair));
+	}
+    } else {
+	Tcl_SetObjResult(interp, resultObj);
+    }
+
+    return TCL_OK;
+}
+
+static int
+IsScoreListOption(int objc, Tcl_Obj *CONST objv[]) {
+    const char *option;
+
+    if (objc < 2) {
+	return 0;
+    }
+
+    option = Tcl_GetString(objv[1]);
+    return ((*option == 'v' && strcmp(option, "valuelist") == 0)
+	    || (*option == 'b' && strcmp(option, "bestof") == 0));
+}
+
+/*
+ * Pass an object command invocation on to a string based command
+ * procedure.
+ */
+
+static int
+ScoreInvokeStringCmd(Tcl_CmdProc *proc, ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]) {
+    const char *argvBuffer[20];
+    const char **argv = argvBuffer;
+    int result;
+    int i;
+
+    if (objc >= sizeof(argvBuffer)/sizeof(argvBuffer[0])) {
+	argv = (const char **)ckalloc(sizeof(char *) * (objc + 1));
+    }
+
+    for (i=0; i < objc; i++) {
+	argv[i] = Tcl_GetString(objv[i]);
+    }
+    argv[objc] = (const char *)NULL;
+
+    result = (*proc)(clientData, interp, objc, argv);
+
+    if (argv != argvBuffer) {
+	ckfree((char *)argv);
+    }
+
+    return result;
+}
+
+/*
+ * The object based entry points for the score command and the scoring
+ * objects.  The list scoring options are handled here, everything else
+ * goes through the string based command procedures.
+ */
+
+int
+ScoreObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]) {
+    if (IsScoreListOption(objc, objv)) {
+	return ScoreListCmd(interp, (ScoreItem *)NULL,
+		Tcl_GetString(objv[0]), objc-1, objv+1);
+    }
+
+    return ScoreInvokeStringCmd(ScoreCmd, clientData, interp, objc, objv);
+}
+
+int
+ScoreMethodObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]) {
+    if (IsScoreListOption(objc, objv)) {
+	return ScoreListCmd(interp, (ScoreItem *)clientData,
+		Tcl_GetString(objv[0]), objc-1, objv+1);
+    }
+
+    return ScoreInvokeStringCmd(ScoreMethodCmd, clientData, interp, objc,
+	    objv);
+}
+
 int
 NullScoreNormalizer(Tcl_Interp *interp, ScoreItem *itemPtr) {
     Tcl_ResetResult(interp);
@@ -588,7 +1584,7 @@ ScoreMethodCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char *
 	    return TCL_ERROR;
         }
 
-	value = (itemPtr->typePtr->valueProc(interp, itemPtr, argv[1]));
+	value = ScoreItemValue(interp, itemPtr, argv[1]);
 
 	if (argc == 3) {
 	    if (Tcl_GetDouble(interp, argv[2], &weight) != TCL_OK) {
@@ -666,9 +1662,11 @@ ScoreMethodCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char *
          * is enough to consider it initialized.
          */
         itemPtr->initialized = 1;
+	ScoreCacheInvalidate();
 
 	return (itemPtr->typePtr->addProc(interp, itemPtr, argv[1], value));
     } else if (**argv == 'n' && (strncmp(*argv, "normalize", 9) == 0)) {
+	ScoreCacheInvalidate();
 	return (itemPtr->typePtr->normalProc(interp, itemPtr));
     } else if (**argv == 'e' && (strncmp(*argv, "elemsize", 8) == 0)) {
 	if (argc > 2) {
@@ -704,6 +1702,8 @@ ScoreMethodCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char *
 	}
 
 	return TCL_OK;
+    } else if (**argv == 'd' && (strncmp(*argv, "delta", 5) == 0)) {
+	return ScoreDeltaCmd(interp, itemPtr, cmd, argc, argv);
     } else if (**argv == 'd' && (strncmp(*argv, "dump", 4) == 0)) {
 	if (argc != 2) {
 	    Tcl_AppendResult(interp, "usage:  ", cmd, " dump script",
@@ -728,6 +1728,13 @@ ScoreMethodCmd(ClientData clientData, Tcl_Interp *interp, int argc, const char *
 			" elemvalue element ?weight?", (char *)NULL);
 	Tcl_AppendResult(interp, "\n                 ", cmd,
 			" add element ?value?", (char *)NULL);
+	Tcl_AppendResult(interp, "\n                 ", cmd,
+			" delta oldstring newstring oldvalue ?positions?",
+			(char *)NULL);
+	Tcl_AppendResult(interp, "\n                 ", cmd,
+			" valuelist stringlist", (char *)NULL);
+	Tcl_AppendResult(interp, "\n                 ", cmd,
+			" bestof stringlist", (char *)NULL);
 
 	return TCL_ERROR;
     }
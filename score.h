@@ -33,28 +33,70 @@
  */
 extern int scoreid;
 
+/*
+ * Fixed point scoring.  When scoreFixedScale is nonzero the digram and
+ * trigram scoring objects that are created store every value as a 32 bit
+ * integer count of 1/scoreFixedScale units, and score strings by adding
+ * up integers.  The n-gram and wordtree types always store integers.
+ * Scores are only converted to doubles when they are returned, so two
+ * plaintexts with the same elements always get exactly the same score.
+ * ScoreDoubleToFixed() rounds a value to table units, table entries that
+ * don't fit in 32 bits are clamped by ScoreFixedEntry(), and strings are
+ * added up in 64 bits.
+ */
+extern int scoreFixedScale;
+#define SCORE_FIXED_MAX_SCALE	1000000
+#define ScoreDoubleToFixed(value, scale) \
+	(floor((value) * (double)(scale) + 0.5))
+
 typedef struct {
     int elemSize;
     unsigned short int initialized;
     struct ScoreType *typePtr;
 } ScoreItem;
 
-#define DigramSingleValue(a, b, c) ( c[(unsigned char)a][(unsigned char)b] )
-
 int ScoreMethodCmd	_ANSI_ARGS_((ClientData, Tcl_Interp *, int, const char **));
+int ScoreMethodObjCmd	_ANSI_ARGS_((ClientData, Tcl_Interp *, int, Tcl_Obj *CONST[]));
 
 void	AddInternalScore _ANSI_ARGS_((ScoreItem *));
+ScoreItem *GetInternalScore _ANSI_ARGS_((Tcl_Interp *, const char *));
 void	DeleteScoreCommand _ANSI_ARGS_((ClientData));
 int	InitScoreTypes _ANSI_ARGS_((Tcl_Interp *));
 int	NullScoreNormalizer _ANSI_ARGS_((Tcl_Interp *, ScoreItem *));
 int	DumpScoreTable _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, char *));
 int	ScoreCmd _ANSI_ARGS_((ClientData, Tcl_Interp *, int, const char **));
+int	ScoreObjCmd _ANSI_ARGS_((ClientData, Tcl_Interp *, int, Tcl_Obj *CONST[]));
 void	DeleteScore _ANSI_ARGS_((ClientData));
 int     DumpTreeNode _ANSI_ARGS_((Tcl_Interp *, TreeNode *, Tcl_DString *, Tcl_DString *, int));
-double	DigramStringValue _ANSI_ARGS_((const char *, double **));
-double	DigramSingleValue _ANSI_ARGS_((unsigned char, unsigned char, double **));
+double	ScoreDigramSum _ANSI_ARGS_((const double *, const unsigned char *, int, const char *, int));
+Tcl_WideInt	ScoreDigramFixedSum _ANSI_ARGS_((const int *, const unsigned char *, int, const char *, int));
+double	ScoreTrigramSum _ANSI_ARGS_((const double *, const char *, int));
+Tcl_WideInt	ScoreTrigramFixedSum _ANSI_ARGS_((const int *, const char *, int));
+int	ScoreFixedEntry _ANSI_ARGS_((double));
+void	ScoreKernelInit _ANSI_ARGS_((void));
+int	ScoreTrigramIndex _ANSI_ARGS_((const char *));
+
+/*
+ * Trigram tables hold 27*27*27 values.  Each character is mapped to
+ * 0-25 for the letters a-z and 26 for anything else.  Entries for
+ * trigrams with a 26 in them are always zero.
+ */
+#define SCORE_TRIGRAM_TABLE_SIZE (27*27*27)
 int  DefaultScoreValue _ANSI_ARGS_((Tcl_Interp *, const char *, double *));
 int  DefaultScoreElementValue _ANSI_ARGS_((Tcl_Interp *, const char *, double *));
+int  DefaultScoreDeltaValue _ANSI_ARGS_((Tcl_Interp *, const char *,
+		const char *, double, const int *, int, double *));
+int  DefaultScoreBound _ANSI_ARGS_((double *));
+int  DefaultScoreBoundedValue _ANSI_ARGS_((Tcl_Interp *, const char *,
+		double, double, double *));
+int  DefaultScoreWindowSum _ANSI_ARGS_((const char *, int, double *,
+		int *));
+int  ScoreObjectValue _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *,
+		double *));
+int  ScoreObjectDeltaValue _ANSI_ARGS_((Tcl_Interp *, ScoreItem *,
+		const char *, const char *, double, const int *, int, double *));
+void ScoreThreadSkipCache _ANSI_ARGS_((int));
+void ScoreThreadFinish _ANSI_ARGS_((void));
 
 typedef int	ScoreCommandProc _ANSI_ARGS_((ClientData, Tcl_Interp *,
 		int, const char **));
@@ -71,6 +113,21 @@ typedef int	ScoreNormalizeProc	_ANSI_ARGS_((Tcl_Interp *,
 		ScoreItem *));
 typedef int	ScoreDumpProc	_ANSI_ARGS_((Tcl_Interp *, ScoreItem *,
 		const char *));
+typedef int	ScoreSaveProc	_ANSI_ARGS_((Tcl_Interp *, ScoreItem *,
+		const char *));
+typedef int	ScoreLoadProc	_ANSI_ARGS_((Tcl_Interp *, ScoreItem *,
+		const char *));
+typedef double	ScoreDeltaProc	_ANSI_ARGS_((Tcl_Interp *, ScoreItem *,
+		const char *, const char *, double, const int *, int));
+typedef double	ScoreWindowProc	_ANSI_ARGS_((ScoreItem *, const char *, int));
+typedef double	ScoreGramProc	_ANSI_ARGS_((ScoreItem *, const char *, int,
+		int));
+typedef double	ScoreMaxProc	_ANSI_ARGS_((ScoreItem *));
+typedef double	ScoreBlockProc	_ANSI_ARGS_((ScoreItem *, const char *, int,
+		int));
+
+double	ScoreWindowDelta _ANSI_ARGS_((ScoreItem *, ScoreWindowProc *, int,
+		const char *, const char *, double, const int *, int));
 
 typedef struct ScoreType {
     char *type;				/* Name of scoring type */
@@ -83,8 +140,90 @@ typedef struct ScoreType {
     ScoreDeleteProc *deleteProc;
     ScoreDumpProc *dumpProc;
     ScoreCommandProc *cmdProc;
+    ScoreSaveProc *saveProc;		/* Write the table in the binary
+					 * format.  NULL if not supported. */
+    ScoreLoadProc *loadProc;		/* Replace the table with one read
+					 * from the binary format. */
+    ScoreDeltaProc *deltaProc;		/* Rescore a string that differs
+					 * from a previously scored string
+					 * at a few positions.  NULL if the
+					 * whole string must be rescored. */
+    ScoreGramProc *gramProc;		/* Return the value of the
+					 * elemSize long window starting at
+					 * an offset in a string.  The last
+					 * argument is the base-26 index of
+					 * the window's letters, or -1 if
+					 * the window has a character
+					 * outside of a-z or is longer than
+					 * SCORE_TABLE_MAX_NGRAM.  Lets the
+					 * combo type score all of its
+					 * components in one pass.  NULL if
+					 * the type can't score windows. */
+    ScoreMaxProc *maxProc;		/* Return an upper bound on the
+					 * value of any one elemSize long
+					 * window.  NULL if the type doesn't
+					 * support bounded scoring. */
+    ScoreBlockProc *blockProc;		/* Return the sum of the values of
+					 * count windows starting at an
+					 * offset in a string. */
     struct ScoreType *nextPtr;
 } ScoreType;
 
+/*
+ * Binary score tables.  A table is stored as a fixed size header followed
+ * by a flat array of entries in native byte order.  The header records
+ * how the array is indexed so that a table can only be loaded back into
+ * a type with the same layout.
+ */
+
+#define SCORE_TABLE_MAGIC	"CTSCORE\n"
+#define SCORE_TABLE_VERSION	1
+#define SCORE_TABLE_BYTEORDER	0x01020304
+
+/*
+ * Entries indexed by the base-256 value of the element's bytes.
+ */
+#define SCORE_TABLE_BYTE	1
+/*
+ * Entries indexed by the base-26 value of the element's letters (a-z).
+ */
+#define SCORE_TABLE_ALPHA	2
+
+/*
+ * The largest n-gram that can be stored in a flat base-26 table.
+ */
+#define SCORE_TABLE_MAX_NGRAM	5
+
+typedef struct ScoreTableHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int byteOrder;
+    unsigned int layout;
+    int elemSize;
+    unsigned int entrySize;
+    unsigned int dataOffset;
+    unsigned int entries;
+    unsigned int reserved;
+    char type[24];			/* Type of the table that was saved */
+} ScoreTableHeader;
+
+/*
+ * A table that has been opened with ScoreTableOpen().  The data is
+ * memory-mapped where the platform supports it and read into memory
+ * otherwise.  Either way it must be treated as read-only.
+ */
+
+typedef struct ScoreTableMap {
+    void *base;
+    size_t length;
+    int mapped;
+} ScoreTableMap;
+
+int	ScoreTableWrite _ANSI_ARGS_((Tcl_Interp *, const char *, ScoreItem *,
+		int, const void *, int, int));
+const void *ScoreTableOpen _ANSI_ARGS_((Tcl_Interp *, const char *,
+		ScoreItem *, int, int, ScoreTableMap *, int *));
+void	ScoreTableClose _ANSI_ARGS_((ScoreTableMap *));
+
 
 #endif /* _SCORE_H_INCLUDED */
@@ -0,0 +1,387 @@
+/*
+ * scoreKernel.c --
+ *
+ *	This file implements the inner loops of the digram and trigram
+ *	scoring types.  Both types keep their values in flat tables and
+ *	sum the table entries for every digram or trigram in a string.
+ *
+ *	The sums are split into four interleaved partial sums that are
+ *	combined at the end, which lets the processor overlap the
+ *	lookups instead of waiting on one long chain of additions.  The
+ *	result can differ from a strict left to right sum only by
+ *	rounding, which is well below 1e-12 of the total for any
+ *	plaintext.
+ *
+ *	On x86 processors that support AVX2 there is also a trigram
+ *	kernel that does the lookups four at a time with gather
+ *	instructions.  It adds the values in exactly the same order as
+ *	the scalar kernel, so both return identical results.  Gathers are
+ *	fast on some processors and very slow on others (microcode updates
+ *	for the "gather data sampling" vulnerability made them several
+ *	times slower than plain loads), so setting the CIPHER_SCORE_KERNEL
+ *	environment variable to "scalar" turns the AVX2 kernel off.  The
+ *	kernel is chosen once, by ScoreKernelInit(), when the scoring
+ *	types are set up.  The digram table is small enough to stay in the
+ *	L1 cache, where plain loads are always faster than a gather.
+ *
+ *	Fixed point tables (see scoreFixedScale in score.h) have their own
+ *	kernels that add up integers.  Integer sums don't depend on the
+ *	order of the additions.
+ *
+ * Copyright (c) 2018 Michael Thomas <wart@kobold.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <tcl.h>
+#include <score.h>
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+	&& !defined(NO_SIMD_SCORING)
+#define SCORE_KERNEL_AVX2
+#include <immintrin.h>
+#endif
+
+typedef double ScoreKernelProc _ANSI_ARGS_((const double *,
+	    const unsigned char *, int));
+
+static double TrigramKernelScalar _ANSI_ARGS_((const double *,
+	    const unsigned char *, int));
+static ScoreKernelProc *ScoreKernelSelect _ANSI_ARGS_((ScoreKernelProc *,
+	    ScoreKernelProc *));
+
+static ScoreKernelProc *trigramKernel = (ScoreKernelProc *)NULL;
+
+/*
+ * Maps a character to its trigram table index.  The letters a-z map to
+ * 0-25, everything else maps to 26.
+ */
+
+#define L(c)	((c) - 'a')
+#define X	26
+#define X16	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X
+
+static const unsigned char trigramIndex[256] = {
+    X16, X16, X16, X16, X16, X16,
+    X, L('a'), L('b'), L('c'), L('d'), L('e'), L('f'), L('g'),
+    L('h'), L('i'), L('j'), L('k'), L('l'), L('m'), L('n'), L('o'),
+    L('p'), L('q'), L('r'), L('s'), L('t'), L('u'), L('v'), L('w'),
+    L('x'), L('y'), L('z'), X, X, X, X, X,
+    X16, X16, X16, X16, X16, X16, X16, X16
+};
+
+#undef L
+#undef X
+#undef X16
+
+#define TRIGRAM_INDEX(c)	(trigramIndex[(unsigned char)(c)])
+
+/*
+ * Sum of the trigram table entries for every three adjacent characters.
+ * Every trigram that contains a character other than a-z has an index
+ * with a 26 in it, and those table entries are always zero.
+ */
+
+static double
+TrigramKernelScalar(const double *table, const unsigned char *string, int length) {
+    double sum0 = 0.0, sum1 = 0.0, sum2 = 0.0, sum3 = 0.0;
+    double value;
+    unsigned c0, c1, c2, c3, c4, c5;
+    int i;
+
+    if (length < 3) {
+	return 0.0;
+    }
+
+    c0 = TRIGRAM_INDEX(string[0]);
+    c1 = TRIGRAM_INDEX(string[1]);
+    for (i=0; i + 6 <= length; i += 4) {
+	c2 = TRIGRAM_INDEX(string[i+2]);
+	c3 = TRIGRAM_INDEX(string[i+3]);
+	c4 = TRIGRAM_INDEX(string[i+4]);
+	c5 = TRIGRAM_INDEX(string[i+5]);
+
+	sum0 += table[(c0*27 + c1)*27 + c2];
+	sum1 += table[(c1*27 + c2)*27 + c3];
+	sum2 += table[(c2*27 + c3)*27 + c4];
+	sum3 += table[(c3*27 + c4)*27 + c5];
+
+	c0 = c4;
+	c1 = c5;
+    }
+
+    value = (sum0 + sum1) + (sum2 + sum3);
+    for (; i + 3 <= length; i++) {
+	c2 = TRIGRAM_INDEX(string[i+2]);
+	value += table[(c0*27 + c1)*27 + c2];
+	c0 = c1;
+	c1 = c2;
+    }
+
+    return value;
+}
+
+#ifdef SCORE_KERNEL_AVX2
+
+static double TrigramKernelAVX2 _ANSI_ARGS_((const double *,
+	    const unsigned char *, int));
+
+/*
+ * Load four consecutive characters, zero extended into 32 bit lanes.
+ */
+
+__attribute__((target("avx2")))
+static inline __m128i
+LoadChars(const unsigned char *string) {
+    int chars;
+
+    memcpy(&chars, string, sizeof(int));
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(chars));
+}
+
+/*
+ * The vector version of TRIGRAM_INDEX().
+ */
+
+__attribute__((target("avx2")))
+static inline __m128i
+LoadTrigramIndices(const unsigned char *string) {
+    __m128i c = _mm_sub_epi32(LoadChars(string), _mm_set1_epi32('a'));
+    __m128i letter = _mm_and_si128(
+	    _mm_cmpgt_epi32(c, _mm_set1_epi32(-1)),
+	    _mm_cmpgt_epi32(_mm_set1_epi32(26), c));
+
+    return _mm_blendv_epi8(_mm_set1_epi32(26), c, letter);
+}
+
+__attribute__((target("avx2")))
+static double
+TrigramKernelAVX2(const double *table, const unsigned char *string, int length) {
+    __m256d sum = _mm256_setzero_pd();
+    __m128i base = _mm_set1_epi32(27);
+    double lanes[4];
+    double value;
+    int i;
+
+    for (i=0; i + 6 <= length; i += 4) {
+	__m128i c0 = LoadTrigramIndices(string + i);
+	__m128i c1 = LoadTrigramIndices(string + i + 1);
+	__m128i c2 = LoadTrigramIndices(string + i + 2);
+	__m128i index = _mm_add_epi32(_mm_mullo_epi32(
+		_mm_add_epi32(_mm_mullo_epi32(c0, base), c1), base), c2);
+
+	sum = _mm256_add_pd(sum, _mm256_i32gather_pd(table, index, 8));
+    }
+
+    _mm256_storeu_pd(lanes, sum);
+    value = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i + 3 <= length; i++) {
+	value += table[(TRIGRAM_INDEX(string[i])*27
+		+ TRIGRAM_INDEX(string[i+1]))*27 + TRIGRAM_INDEX(string[i+2])];
+    }
+
+    return value;
+}
+
+#else
+
+#define TrigramKernelAVX2	TrigramKernelScalar
+
+#endif /* SCORE_KERNEL_AVX2 */
+
+/*
+ * Choose between the scalar and vector versions of a kernel.  The vector
+ * version is used if the processor supports it, unless the
+ * CIPHER_SCORE_KERNEL environment variable is set to "scalar".
+ */
+
+static ScoreKernelProc *
+ScoreKernelSelect(ScoreKernelProc *scalarProc, ScoreKernelProc *vectorProc) {
+#ifdef SCORE_KERNEL_AVX2
+    const char *forced = getenv("CIPHER_SCORE_KERNEL");
+
+    __builtin_cpu_init();
+    if (! __builtin_cpu_supports("avx2")
+	    || (forced != NULL && strcmp(forced, "scalar") == 0)) {
+	return scalarProc;
+    }
+    return vectorProc;
+#else
+    return scalarProc;
+#endif
+}
+
+/*
+ * Pick the kernels.  This is called by InitScoreTypes(), so it runs in
+ * the first interpreter that loads the package, before any worker
+ * threads can score anything.  The mutex keeps the interpreters of later
+ * threads from racing to set the kernels again.
+ */
+
+TCL_DECLARE_MUTEX(scoreKernelMutex)
+
+void
+ScoreKernelInit() {
+    Tcl_MutexLock(&scoreKernelMutex);
+    if (trigramKernel == NULL) {
+	trigramKernel = ScoreKernelSelect(TrigramKernelScalar,
+		TrigramKernelAVX2);
+    }
+    Tcl_MutexUnlock(&scoreKernelMutex);
+}
+
+/*
+ * Sum of the digram table entries for every pair of adjacent characters.
+ * Each character is mapped to its row with the index table, and rows are
+ * 1<<shift entries apart.
+ */
+
+double
+ScoreDigramSum(const double *table, const unsigned char *index, int shift, const char *string, int length) {
+    const unsigned char *s = (const unsigned char *)string;
+    double sum0 = 0.0, sum1 = 0.0, sum2 = 0.0, sum3 = 0.0;
+    double value;
+    unsigned c0, c1, c2, c3, c4;
+    int i;
+
+    if (length < 2) {
+	return 0.0;
+    }
+
+    c0 = index[s[0]];
+    for (i=0; i + 4 < length; i += 4) {
+	c1 = index[s[i+1]];
+	c2 = index[s[i+2]];
+	c3 = index[s[i+3]];
+	c4 = index[s[i+4]];
+
+	sum0 += table[(c0 << shift) | c1];
+	sum1 += table[(c1 << shift) | c2];
+	sum2 += table[(c2 << shift) | c3];
+	sum3 += table[(c3 << shift) | c4];
+
+	c0 = c4;
+    }
+
+    value = (sum0 + sum1) + (sum2 + sum3);
+    for (; i + 1 < length; i++) {
+	c1 = index[s[i+1]];
+	value += table[(c0 << shift) | c1];
+	c0 = c1;
+    }
+
+    return value;
+}
+
+/*
+ * The same as ScoreDigramSum() for fixed point tables.
+ */
+
+Tcl_WideInt
+ScoreDigramFixedSum(const int *table, const unsigned char *index, int shift, const char *string, int length) {
+    const unsigned char *s = (const unsigned char *)string;
+    Tcl_WideInt sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    unsigned c0, c1, c2, c3, c4;
+    int i;
+
+    if (length < 2) {
+	return 0;
+    }
+
+    c0 = index[s[0]];
+    for (i=0; i + 4 < length; i += 4) {
+	c1 = index[s[i+1]];
+	c2 = index[s[i+2]];
+	c3 = index[s[i+3]];
+	c4 = index[s[i+4]];
+
+	sum0 += table[(c0 << shift) | c1];
+	sum1 += table[(c1 << shift) | c2];
+	sum2 += table[(c2 << shift) | c3];
+	sum3 += table[(c3 << shift) | c4];
+
+	c0 = c4;
+    }
+
+    for (; i + 1 < length; i++) {
+	c1 = index[s[i+1]];
+	sum0 += table[(c0 << shift) | c1];
+	c0 = c1;
+    }
+
+    return sum0 + sum1 + sum2 + sum3;
+}
+
+double
+ScoreTrigramSum(const double *table, const char *string, int length) {
+    return (*trigramKernel)(table, (const unsigned char *)string, length);
+}
+
+/*
+ * The same as ScoreTrigramSum() for fixed point tables.  Integer gathers
+ * are no faster than the double ones, so there is only a scalar version.
+ */
+
+Tcl_WideInt
+ScoreTrigramFixedSum(const int *table, const char *string, int length) {
+    const unsigned char *s = (const unsigned char *)string;
+    Tcl_WideInt sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    unsigned c0, c1, c2, c3, c4, c5;
+    int i;
+
+    if (length < 3) {
+	return 0;
+    }
+
+    c0 = TRIGRAM_INDEX(s[0]);
+    c1 = TRIGRAM_INDEX(s[1]);
+    for (i=0; i + 6 <= length; i += 4) {
+	c2 = TRIGRAM_INDEX(s[i+2]);
+	c3 = TRIGRAM_INDEX(s[i+3]);
+	c4 = TRIGRAM_INDEX(s[i+4]);
+	c5 = TRIGRAM_INDEX(s[i+5]);
+
+	sum0 += table[(c0*27 + c1)*27 + c2];
+	sum1 += table[(c1*27 + c2)*27 + c3];
+	sum2 += table[(c2*27 + c3)*27 + c4];
+	sum3 += table[(c3*27 + c4)*27 + c5];
+
+	c0 = c4;
+	c1 = c5;
+    }
+
+    for (; i + 3 <= length; i++) {
+	c2 = TRIGRAM_INDEX(s[i+2]);
+	sum0 += table[(c0*27 + c1)*27 + c2];
+	c0 = c1;
+	c1 = c2;
+    }
+
+    return sum0 + sum1 + sum2 + sum3;
+}
+
+/*
+ * The position of a trigram in a trigram table.
+ */
+
+int
+ScoreTrigramIndex(const char *trigram) {
+    return (TRIGRAM_INDEX((unsigned char)trigram[0])*27
+	    + TRIGRAM_INDEX((unsigned char)trigram[1]))*27
+	    + TRIGRAM_INDEX((unsigned char)trigram[2]);
+}
@@ -0,0 +1,271 @@
+/*
+ * scoreTable.c --
+ *
+ *	This file implements reading and writing of binary score tables.
+ *	Loading a table from the text format sources one Tcl command for
+ *	every element, which is slow for the large n-gram tables.  The
+ *	binary format is a flat array that can be mapped directly into
+ *	memory, and is shared between processes through the page cache.
+ *
+ * Copyright (c) 2018 Michael Thomas <wart@kobold.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <tcl.h>
+#include <score.h>
+#include <string.h>
+
+#ifdef HAVE_MMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static int ScoreTableCheckHeader _ANSI_ARGS_((Tcl_Interp *, const char *,
+	    ScoreItem *, int, int, ScoreTableMap *));
+
+int
+ScoreTableWrite(Tcl_Interp *interp, const char *filename, ScoreItem *itemPtr, int layout, const void *data, int entrySize, int entries) {
+    ScoreTableHeader header;
+    Tcl_Channel chan;
+
+    memset(&header, 0, sizeof(ScoreTableHeader));
+    memcpy(header.magic, SCORE_TABLE_MAGIC, sizeof(header.magic));
+    header.version = SCORE_TABLE_VERSION;
+    header.byteOrder = SCORE_TABLE_BYTEORDER;
+    header.layout = layout;
+    header.elemSize = itemPtr->elemSize;
+    header.entrySize = entrySize;
+    header.dataOffset = sizeof(ScoreTableHeader);
+    header.entries = entries;
+    strncpy(header.type, itemPtr->typePtr->type, sizeof(header.type)-1);
+
+    chan = Tcl_OpenFileChannel(interp, filename, "w", 0644);
+    if (chan == (Tcl_Channel)NULL) {
+	return TCL_ERROR;
+    }
+
+    if (Tcl_SetChannelOption(interp, chan, "-translation", "binary")
+	    != TCL_OK) {
+	Tcl_Close((Tcl_Interp *)NULL, chan);
+	return TCL_ERROR;
+    }
+
+    if (Tcl_Write(chan, (const char *)&header, sizeof(ScoreTableHeader)) < 0
+	    || Tcl_Write(chan, (const char *)data, entrySize * entries) < 0) {
+	Tcl_AppendResult(interp, "error writing \"", filename, "\": ",
+		Tcl_PosixError(interp), (char *)NULL);
+	Tcl_Close((Tcl_Interp *)NULL, chan);
+	return TCL_ERROR;
+    }
+
+    if (Tcl_Close(interp, chan) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    Tcl_ResetResult(interp);
+    return TCL_OK;
+}
+
+/*
+ * Open a binary score table and verify that it can be loaded into
+ * itemPtr.  On success the mapping is stored in mapPtr, the number of
+ * entries in entriesPtr, and a pointer to the first entry is returned.
+ * The header can be found at mapPtr->base.  On failure an error is left
+ * in the interpreter and NULL is returned.
+ */
+
+const void *
+ScoreTableOpen(Tcl_Interp *interp, const char *filename, ScoreItem *itemPtr, int layout, int entrySize, ScoreTableMap *mapPtr, int *entriesPtr) {
+#ifdef HAVE_MMAP
+    Tcl_DString native;
+    const char *path;
+    struct stat statBuf;
+    void *base;
+    int fd;
+
+    mapPtr->base = NULL;
+    mapPtr->length = 0;
+    mapPtr->mapped = 0;
+
+    path = Tcl_TranslateFileName(interp, filename, &native);
+    if (path == NULL) {
+	return NULL;
+    }
+
+    fd = open(path, O_RDONLY);
+    Tcl_DStringFree(&native);
+    if (fd < 0) {
+	Tcl_AppendResult(interp, "couldn't open \"", filename, "\": ",
+		Tcl_PosixError(interp), (char *)NULL);
+	return NULL;
+    }
+
+    if (fstat(fd, &statBuf) != 0) {
+	Tcl_AppendResult(interp, "couldn't read \"", filename, "\": ",
+		Tcl_PosixError(interp), (char *)NULL);
+	close(fd);
+	return NULL;
+    }
+
+    if (statBuf.st_size < sizeof(ScoreTableHeader)) {
+	close(fd);
+	Tcl_AppendResult(interp, "\"", filename,
+		"\" is not a binary score table", (char *)NULL);
+	return NULL;
+    }
+
+    base = mmap(NULL, (size_t)statBuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+	Tcl_AppendResult(interp, "couldn't map \"", filename, "\": ",
+		Tcl_PosixError(interp), (char *)NULL);
+	return NULL;
+    }
+
+    mapPtr->base = base;
+    mapPtr->length = (size_t)statBuf.st_size;
+    mapPtr->mapped = 1;
+#else
+    Tcl_Channel chan;
+    Tcl_WideInt length;
+
+    mapPtr->base = NULL;
+    mapPtr->length = 0;
+    mapPtr->mapped = 0;
+
+    chan = Tcl_OpenFileChannel(interp, filename, "r", 0);
+    if (chan == (Tcl_Channel)NULL) {
+	return NULL;
+    }
+
+    if (Tcl_SetChannelOption(interp, chan, "-translation", "binary")
+	    != TCL_OK) {
+	Tcl_Close((Tcl_Interp *)NULL, chan);
+	return NULL;
+    }
+
+    length = Tcl_Seek(chan, 0, SEEK_END);
+    if (length < (Tcl_WideInt)sizeof(ScoreTableHeader)) {
+	Tcl_Close((Tcl_Interp *)NULL, chan);
+	Tcl_AppendResult(interp, "\"", filename,
+		"\" is not a binary score table", (char *)NULL);
+	return NULL;
+    }
+    Tcl_Seek(chan, 0, SEEK_SET);
+
+    mapPtr->base = (void *)ckalloc((unsigned)length);
+    mapPtr->length = (size_t)length;
+    if (Tcl_Read(chan, (char *)mapPtr->base, (int)length) != length) {
+	Tcl_AppendResult(interp, "error reading \"", filename, "\": ",
+		Tcl_PosixError(interp), (char *)NULL);
+	Tcl_Close((Tcl_Interp *)NULL, chan);
+	ScoreTableClose(mapPtr);
+	return NULL;
+    }
+    Tcl_Close((Tcl_Interp *)NULL, chan);
+#endif
+
+    if (ScoreTableCheckHeader(interp, filename, itemPtr, layout, entrySize,
+		mapPtr) != TCL_OK) {
+	ScoreTableClose(mapPtr);
+	return NULL;
+    }
+
+    *entriesPtr = ((ScoreTableHeader *)mapPtr->base)->entries;
+    return (const char *)mapPtr->base
+	+ ((ScoreTableHeader *)mapPtr->base)->dataOffset;
+}
+
+void
+ScoreTableClose(ScoreTableMap *mapPtr) {
+    if (mapPtr->base == NULL) {
+	return;
+    }
+
+#ifdef HAVE_MMAP
+    if (mapPtr->mapped) {
+	munmap(mapPtr->base, mapPtr->length);
+    } else {
+	ckfree((char *)mapPtr->base);
+    }
+#else
+    ckfree((char *)mapPtr->base);
+#endif
+
+    mapPtr->base = NULL;
+    mapPtr->length = 0;
+    mapPtr->mapped = 0;
+}
+
+static int
+ScoreTableCheckHeader(Tcl_Interp *interp, const char *filename, ScoreItem *itemPtr, int layout, int entrySize, ScoreTableMap *mapPtr) {
+    const ScoreTableHeader *headerPtr = (const ScoreTableHeader *)mapPtr->base;
+    char temp_str[TCL_DOUBLE_SPACE];
+    char type[sizeof(headerPtr->type)+1];
+
+    if (memcmp(headerPtr->magic, SCORE_TABLE_MAGIC, sizeof(headerPtr->magic))
+	    != 0) {
+	Tcl_AppendResult(interp, "\"", filename,
+		"\" is not a binary score table", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    if (headerPtr->byteOrder != SCORE_TABLE_BYTEORDER) {
+	Tcl_AppendResult(interp, "\"", filename,
+		"\" was written on a machine with a different byte order",
+		(char *)NULL);
+	return TCL_ERROR;
+    }
+
+    if (headerPtr->version != SCORE_TABLE_VERSION) {
+	sprintf(temp_str, "%u", headerPtr->version);
+	Tcl_AppendResult(interp, "\"", filename,
+		"\" uses unsupported score table version ", temp_str,
+		(char *)NULL);
+	return TCL_ERROR;
+    }
+
+    memcpy(type, headerPtr->type, sizeof(headerPtr->type));
+    type[sizeof(headerPtr->type)] = '\0';
+    if (headerPtr->layout != layout || headerPtr->entrySize != entrySize) {
+	Tcl_AppendResult(interp, "\"", filename, "\" holds a ", type,
+		" table which can't be loaded into a ",
+		itemPtr->typePtr->type, " scoring object", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    if (itemPtr->elemSize >= 0 && headerPtr->elemSize != itemPtr->elemSize) {
+	sprintf(temp_str, "%d != %d", headerPtr->elemSize, itemPtr->elemSize);
+	Tcl_AppendResult(interp, "Element size incorrect.  ", temp_str,
+		(char *)NULL);
+	return TCL_ERROR;
+    }
+
+    if (headerPtr->dataOffset < sizeof(ScoreTableHeader)
+	    || headerPtr->dataOffset > mapPtr->length
+	    || (mapPtr->length - headerPtr->dataOffset) / headerPtr->entrySize
+		< headerPtr->entries) {
+	Tcl_AppendResult(interp, "\"", filename, "\" is truncated",
+		(char *)NULL);
+	return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
@@ -64,6 +64,7 @@ typedef struct SwagmanItem {
 
     char **maxSolKey;
     double maxSolVal;
+    double scoreBound;	/* See DefaultScoreBound() */
 } SwagmanItem;
 
 /*
@@ -455,6 +456,7 @@ SolveSwagman(Tcl_Interp *interp, CipherItem *itemPtr, char *maxkey)
 
     itemPtr->curIteration=0;
     swagPtr->maxSolVal=0.0;
+    DefaultScoreBound(&swagPtr->scoreBound);
     swagPtr->maxSolKey=(char **)ckalloc(sizeof(char *) * itemPtr->period);
     for(i=0; i < itemPtr->period; i++) {
 	swagPtr->maxSolKey[i] = (char *)ckalloc(sizeof(char) * itemPtr->period);
@@ -574,8 +576,8 @@ SwagmanSolveValue(Tcl_Interp *interp, ClientData clientData, int *key, int lengt
 	}
 
 	if (pt) {
-	    if (DefaultScoreValue(interp, pt, &val)
-                    != TCL_OK) {
+	    if (DefaultScoreBoundedValue(interp, pt, swagPtr->maxSolVal,
+			swagPtr->scoreBound, &val) != TCL_OK) {
 		return TCL_ERROR;
 	    }
 
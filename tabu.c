@@ -0,0 +1,528 @@
+/*
+ * tabu.c --
+ *
+ *	This file implements a tabu search on top of the native hill
+ *	climber's key and scoring routines.  Every step scores all of the
+ *	current key's neighbors and moves to the best one, even when it
+ *	is worse than the current key.  Two memories keep the search from
+ *	walking back into the keys it has just left:
+ *
+ *	moves		A move that was made can't be made again for the
+ *			next -tenure steps, unless it would give a key
+ *			better than any seen so far.
+ *	history		A hash of each of the last -history keys is kept
+ *			in a fixed size set.  Neighbors whose hash is in
+ *			the set aren't scored at all.
+ *
+ * Copyright (c) 2008 Michael Thomas <wart@kobold.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <tcl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "hillclimb.h"
+
+/*
+ * The hashes of the most recently visited keys.  The hashes are kept in
+ * an open addressed table with room for at least twice as many entries
+ * as the history holds, and in a ring that gives the order they were
+ * added in so the oldest can be dropped.  A hash of 0 marks an empty
+ * slot in the table.
+ */
+
+typedef Tcl_WideUInt TabuHash;
+
+typedef struct TabuHistory {
+    TabuHash *table;
+    int mask;
+    TabuHash *ring;
+    int size;
+    int count;
+    int next;
+} TabuHistory;
+
+typedef struct TabuState {
+    HillclimbState climb;
+    long iterations;
+    long tenure;
+    int historySize;
+
+    long steps;
+    long evaluations;
+    long considered;
+    long revisits;
+    long tabu;
+    long aspirations;
+    HillclimbTrace trace;
+} TabuState;
+
+/*
+ * 64 bit FNV-1a hash of both parts of a key.
+ */
+
+static TabuHash
+TabuHashKey(const char *key, int keySize)
+{
+    TabuHash hash = ((TabuHash)0xcbf29ce4 << 32) | 0x84222325;
+    int i;
+
+    for (i=0; i < keySize; i++) {
+	hash ^= (unsigned char)key[i];
+	hash *= ((TabuHash)0x100 << 32) | 0x1b3;
+    }
+
+    return hash ? hash : 1;
+}
+
+static void
+TabuHistoryInit(TabuHistory *histPtr, int size)
+{
+    int tableSize = 16;
+
+    while (tableSize < size * 2) {
+	tableSize *= 2;
+    }
+    histPtr->table = (TabuHash *)ckalloc(sizeof(TabuHash) * tableSize);
+    memset(histPtr->table, 0, sizeof(TabuHash) * tableSize);
+    histPtr->mask = tableSize - 1;
+    histPtr->ring = (TabuHash *)ckalloc(sizeof(TabuHash) * size);
+    histPtr->size = size;
+    histPtr->count = 0;
+    histPtr->next = 0;
+}
+
+static void
+TabuHistoryFree(TabuHistory *histPtr)
+{
+    ckfree((char *)histPtr->table);
+    ckfree((char *)histPtr->ring);
+}
+
+/*
+ * Return the slot that holds hash, or the empty slot where it would go.
+ */
+
+static int
+TabuHistorySlot(TabuHistory *histPtr, TabuHash hash)
+{
+    int slot = (int)(hash & histPtr->mask);
+
+    while (histPtr->table[slot] && histPtr->table[slot] != hash) {
+	slot = (slot + 1) & histPtr->mask;
+    }
+
+    return slot;
+}
+
+static int
+TabuHistoryContains(TabuHistory *histPtr, TabuHash hash)
+{
+    return histPtr->table[TabuHistorySlot(histPtr, hash)] == hash;
+}
+
+/*
+ * Remove the hash in slot, moving later entries of its run back so that
+ * no probe stops early at the hole.
+ */
+
+static void
+TabuHistoryRemove(TabuHistory *histPtr, int slot)
+{
+    int next = slot;
+
+    histPtr->table[slot] = 0;
+    for (;;) {
+	int home;
+
+	next = (next + 1) & histPtr->mask;
+	if (histPtr->table[next] == 0) {
+	    break;
+	}
+	home = (int)(histPtr->table[next] & histPtr->mask);
+
+	/*
+	 * The entry can move back into the hole unless its home slot
+	 * lies cyclically after the hole and at or before the entry.
+	 */
+
+	if (((next - home) & histPtr->mask)
+		>= ((next - slot) & histPtr->mask)) {
+	    histPtr->table[slot] = histPtr->table[next];
+	    histPtr->table[next] = 0;
+	    slot = next;
+	}
+    }
+}
+
+/*
+ * Add a hash, dropping the oldest one when the history is full.
+ */
+
+static void
+TabuHistoryAdd(TabuHistory *histPtr, TabuHash hash)
+{
+    int slot = TabuHistorySlot(histPtr, hash);
+
+    if (histPtr->table[slot] == hash) {
+	return;
+    }
+    if (histPtr->count == histPtr->size) {
+	TabuHistoryRemove(histPtr,
+		TabuHistorySlot(histPtr, histPtr->ring[histPtr->next]));
+	histPtr->count--;
+	slot = TabuHistorySlot(histPtr, hash);
+    }
+    histPtr->table[slot] = hash;
+    histPtr->ring[histPtr->next] = hash;
+    histPtr->next = (histPtr->next + 1) % histPtr->size;
+    histPtr->count++;
+}
+
+/*
+ * Run the tabu search from key.  On return maxKey holds the best key
+ * seen.
+ */
+
+static int
+TabuRun(HillclimbState *climbPtr, char *key, char *maxKey, double *maxValuePtr)
+{
+    TabuState *statePtr = (TabuState *)climbPtr;
+    HillclimbNeighbors *nbPtr = &climbPtr->moves;
+    TabuHistory history;
+    HillclimbMove move;
+    char *curPt = (char *)NULL;
+    int curPtSpace = 0;
+    long *tabuUntil;
+    double curValue, value, maxValue;
+    long iteration, index;
+    int result;
+
+    result = HillclimbDecipher(climbPtr, key);
+    if (result == TCL_OK) {
+	result = HillclimbScore(climbPtr, (char *)NULL, 0.0, &curValue);
+    }
+    if (result != TCL_OK) {
+	return TCL_ERROR;
+    }
+    statePtr->evaluations++;
+    HillclimbCopyPt(&curPt, &curPtSpace, climbPtr->pt);
+
+    TabuHistoryInit(&history, statePtr->historySize);
+    TabuHistoryAdd(&history, TabuHashKey(key, climbPtr->keySize));
+    tabuUntil = (long *)ckalloc(sizeof(long) * nbPtr->count);
+    memset(tabuUntil, 0, sizeof(long) * nbPtr->count);
+
+    maxValue = curValue;
+    memcpy(maxKey, key, climbPtr->keySize);
+    result = HillclimbBestFit(climbPtr, key, 0, maxValue);
+
+    for (iteration=1; iteration <= statePtr->iterations && result == TCL_OK;
+	    iteration++) {
+	long bestIndex = -1;
+	double bestValue = 0.0;
+	int bestAspires = 0;
+
+	for (index=0; index < nbPtr->count; index++) {
+	    int isTabu = tabuUntil[index] >= iteration;
+
+	    HillclimbNeighborsMove(nbPtr, index, &move);
+	    HillclimbApplyMove(nbPtr, key, &move);
+	    statePtr->considered++;
+
+	    /*
+	     * A key in the history can't beat the best key, since the
+	     * best key is never worse than any key visited, so it isn't
+	     * worth scoring.
+	     */
+
+	    if (TabuHistoryContains(&history,
+			TabuHashKey(key, climbPtr->keySize))) {
+		statePtr->revisits++;
+		HillclimbUndoMove(nbPtr, key, &move);
+		continue;
+	    }
+
+	    result = HillclimbDecipher(climbPtr, key);
+	    if (result == TCL_OK) {
+		result = HillclimbScore(climbPtr, curPt, curValue, &value);
+	    }
+	    HillclimbUndoMove(nbPtr, key, &move);
+	    if (result != TCL_OK) {
+		break;
+	    }
+	    statePtr->evaluations++;
+
+	    if (isTabu && value <= maxValue) {
+		statePtr->tabu++;
+		continue;
+	    }
+	    if (bestIndex < 0 || value > bestValue) {
+		bestIndex = index;
+		bestValue = value;
+		bestAspires = isTabu;
+	    }
+	}
+	if (result != TCL_OK) {
+	    break;
+	}
+
+	/*
+	 * Every neighbor is tabu or already visited, so the search is
+	 * stuck.
+	 */
+
+	if (bestIndex < 0) {
+	    break;
+	}
+	if (bestAspires) {
+	    statePtr->aspirations++;
+	}
+
+	HillclimbNeighborsMove(nbPtr, bestIndex, &move);
+	HillclimbApplyMove(nbPtr, key, &move);
+	result = HillclimbDecipher(climbPtr, key);
+	if (result != TCL_OK) {
+	    break;
+	}
+	HillclimbCopyPt(&curPt, &curPtSpace, climbPtr->pt);
+	curValue = bestValue;
+	tabuUntil[bestIndex] = iteration + statePtr->tenure;
+	TabuHistoryAdd(&history, TabuHashKey(key, climbPtr->keySize));
+	statePtr->steps++;
+
+	if (curValue > maxValue) {
+	    maxValue = curValue;
+	    memcpy(maxKey, key, climbPtr->keySize);
+	    HillclimbTraceAdd(&statePtr->trace, iteration, curValue);
+
+	    result = HillclimbBestFit(climbPtr, key, iteration, curValue);
+	}
+
+	if (result == TCL_OK) {
+	    result = HillclimbStep(climbPtr, key, iteration);
+	}
+    }
+
+    if (result == TCL_OK) {
+	result = HillclimbDecipher(climbPtr, maxKey);
+    }
+
+    TabuHistoryFree(&history);
+    ckfree((char *)tabuUntil);
+    if (curPt) {
+	ckfree(curPt);
+    }
+
+    *maxValuePtr = maxValue;
+    return result;
+}
+
+/*
+ * Hillclimb::tabu cipher key ?options?
+ *
+ *	Search for the best key with a tabu search.  Returns a list of the
+ *	best key found, its score, and a list of statistics about the
+ *	run.  The cipher is left with the best key restored.  See
+ *	doc/Hillclimb/package.tml for the options.
+ */
+
+int
+HillclimbTabuObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
+{
+    TabuState state;
+    TabuState *bestPtr = &state;
+    Tcl_Obj *resultObjs[3];
+    Tcl_Obj *statObjs[30];
+    Tcl_Time start, end;
+    char *restarts = (char *)NULL;
+    char *key = (char *)NULL;
+    char *maxKey;
+    double maxValue = 0.0;
+    double seconds;
+    long steps, evaluations, considered, revisits, tabu, aspirations;
+    int result = TCL_OK;
+    int best = 0;
+    int i;
+
+    if (objc < 3 || objc % 2 == 0) {
+	Tcl_AppendResult(interp, "Usage:  ", Tcl_GetString(objv[0]),
+		" cipher key ?option value ...?", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    memset(&state, 0, sizeof(TabuState));
+    if (HillclimbInitState(interp, objv[1], &state.climb) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    state.iterations = 1000;
+    state.tenure = 10;
+    state.historySize = 1024;
+
+    for (i=3; i < objc; i += 2) {
+	const char *option = Tcl_GetString(objv[i]);
+
+	result = HillclimbStateOption(&state.climb, option, objv[i+1]);
+	if (result == TCL_ERROR) {
+	    return TCL_ERROR;
+	} else if (result == TCL_OK) {
+	    continue;
+	}
+	result = TCL_OK;
+
+	if (strcmp(option, "-iterations") == 0) {
+	    if (Tcl_GetLongFromObj(interp, objv[i+1], &state.iterations)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.iterations < 1) {
+		Tcl_SetResult(interp, "Iterations must be at least 1",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-tenure") == 0) {
+	    if (Tcl_GetLongFromObj(interp, objv[i+1], &state.tenure)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.tenure < 0) {
+		Tcl_SetResult(interp, "The tenure can't be negative",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-history") == 0) {
+	    if (Tcl_GetIntFromObj(interp, objv[i+1], &state.historySize)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.historySize < 1 || state.historySize > (1 << 24)) {
+		Tcl_SetResult(interp,
+			"The history must hold from 1 to 16777216 keys",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else {
+	    Tcl_AppendResult(interp, "Unknown option ", option, (char *)NULL);
+	    return TCL_ERROR;
+	}
+    }
+
+    if (HillclimbPrepare(&state.climb, objv[2], &key) != TCL_OK) {
+	HillclimbFreeState(&state.climb);
+	return TCL_ERROR;
+    }
+    if (state.climb.moves.count == 0) {
+	Tcl_SetResult(interp, "The key has no positions that can be swapped",
+		TCL_STATIC);
+	ckfree(key);
+	HillclimbFreeState(&state.climb);
+	return TCL_ERROR;
+    }
+    maxKey = (char *)ckalloc(state.climb.keySize);
+
+    Tcl_GetTime(&start);
+    if (state.climb.restarts > 1 || state.climb.threads > 1) {
+	result = HillclimbRunRestarts(&state.climb, sizeof(TabuState),
+		TabuRun, key, maxKey, &maxValue, &restarts, &best);
+    } else {
+	result = TabuRun(&state.climb, key, maxKey, &maxValue);
+    }
+    Tcl_GetTime(&end);
+
+    /*
+     * The counts are totals over all of the restarts.  The trace comes
+     * from the restart that found the best key.
+     */
+
+    steps = state.steps;
+    evaluations = state.evaluations;
+    considered = state.considered;
+    revisits = state.revisits;
+    tabu = state.tabu;
+    aspirations = state.aspirations;
+    if (restarts) {
+	for (i=0; i < state.climb.restarts; i++) {
+	    TabuState *runPtr = (TabuState *)(restarts
+		    + i * sizeof(TabuState));
+
+	    steps += runPtr->steps;
+	    evaluations += runPtr->evaluations;
+	    considered += runPtr->considered;
+	    revisits += runPtr->revisits;
+	    tabu += runPtr->tabu;
+	    aspirations += runPtr->aspirations;
+	}
+	bestPtr = (TabuState *)(restarts + best * sizeof(TabuState));
+    }
+
+    if (result == TCL_OK) {
+	seconds = (end.sec - start.sec) + (end.usec - start.usec) / 1e6;
+
+	statObjs[0] = Tcl_NewStringObj("evaluations", -1);
+	statObjs[1] = Tcl_NewLongObj(evaluations);
+	statObjs[2] = Tcl_NewStringObj("seconds", -1);
+	statObjs[3] = Tcl_NewDoubleObj(seconds);
+	statObjs[4] = Tcl_NewStringObj("rate", -1);
+	statObjs[5] = Tcl_NewDoubleObj(seconds > 0.0
+		? evaluations / seconds : 0.0);
+	statObjs[6] = Tcl_NewStringObj("steps", -1);
+	statObjs[7] = Tcl_NewLongObj(steps);
+	statObjs[8] = Tcl_NewStringObj("revisits", -1);
+	statObjs[9] = Tcl_NewLongObj(revisits);
+	statObjs[10] = Tcl_NewStringObj("revisitrate", -1);
+	statObjs[11] = Tcl_NewDoubleObj(considered > 0
+		? (double)revisits / considered : 0.0);
+	statObjs[12] = Tcl_NewStringObj("tabu", -1);
+	statObjs[13] = Tcl_NewLongObj(tabu);
+	statObjs[14] = Tcl_NewStringObj("aspirations", -1);
+	statObjs[15] = Tcl_NewLongObj(aspirations);
+	statObjs[16] = Tcl_NewStringObj("seed", -1);
+	statObjs[17] = Tcl_NewLongObj(state.climb.seed);
+	statObjs[18] = Tcl_NewStringObj("iterations", -1);
+	statObjs[19] = Tcl_NewLongObj(state.iterations);
+	statObjs[20] = Tcl_NewStringObj("tenure", -1);
+	statObjs[21] = Tcl_NewLongObj(state.tenure);
+	statObjs[22] = Tcl_NewStringObj("history", -1);
+	statObjs[23] = Tcl_NewIntObj(state.historySize);
+	statObjs[24] = Tcl_NewStringObj("restarts", -1);
+	statObjs[25] = Tcl_NewLongObj(state.climb.restarts);
+	statObjs[26] = Tcl_NewStringObj("threads", -1);
+	statObjs[27] = Tcl_NewIntObj(state.climb.threads);
+	statObjs[28] = Tcl_NewStringObj("trace", -1);
+	statObjs[29] = HillclimbTraceObj(&bestPtr->trace);
+
+	resultObjs[0] = HillclimbKeyObj(&state.climb, maxKey);
+	resultObjs[1] = Tcl_NewDoubleObj(maxValue);
+	resultObjs[2] = Tcl_NewListObj(30, statObjs);
+	Tcl_SetObjResult(interp, Tcl_NewListObj(3, resultObjs));
+    }
+
+    if (restarts) {
+	for (i=0; i < state.climb.restarts; i++) {
+	    HillclimbTraceFree(&((TabuState *)(restarts
+		    + i * sizeof(TabuState)))->trace);
+	}
+	HillclimbFreeRestarts(&state.climb, sizeof(TabuState), restarts);
+    }
+    HillclimbTraceFree(&state.trace);
+    ckfree(key);
+    ckfree(maxKey);
+    HillclimbFreeState(&state.climb);
+
+    return result;
+}
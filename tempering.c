@@ -0,0 +1,572 @@
+/*
+ * tempering.c --
+ *
+ *	This file implements parallel tempering, also called replica
+ *	exchange, on top of the native hill climber's key and scoring
+ *	routines.  Several chains make random moves at once, each at its own
+ *	fixed temperature, and keep them with the same Metropolis rule as
+ *	the annealing search.  The temperatures form a geometric ladder
+ *	from the coldest to the hottest.  After every -exchange steps the
+ *	chains at neighboring temperatures try to trade keys: a colder chain
+ *	always takes a better key from a hotter one, and takes a worse key
+ *	with probability exp((v2 - v1) * (1/T1 - 1/T2)).  Hot chains wander
+ *	far from a local optimum and pass what they find down to the cold
+ *	chains, which polish it.  Even and odd pairs of chains take turns
+ *	at trading.
+ *
+ *	The chains of one round are run as tasks in a pool of threads.
+ *	Each chain has its own random number generator, seeded from the
+ *	search's seed, and the trades are made by the calling thread, so
+ *	the result doesn't depend on the number of threads.
+ *
+ * Copyright (c) 2008 Michael Thomas <wart@kobold.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <tcl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "hillclimb.h"
+
+/*
+ * The fraction of worse keys that the hottest chain accepts at an
+ * estimated temperature.
+ */
+
+#define TEMPERING_HOT_ACCEPTANCE	0.5
+
+/*
+ * The ratio of the hottest to the coldest temperature when the coldest
+ * isn't given.  Chains only trade often enough when the ladder is
+ * narrow, so this is much smaller than the range of an annealing
+ * schedule.
+ */
+
+#define TEMPERING_RANGE		20.0
+
+typedef struct TemperingChain {
+    RandomState rand;
+    double temperature;
+
+    /*
+     * The chain's current key, its plaintext and value.  These move
+     * between chains when they trade.
+     */
+
+    char *key;
+    char *pt;
+    int ptSpace;
+    double value;
+
+    /*
+     * The best key this chain has seen.
+     */
+
+    char *maxKey;
+    double maxValue;
+
+    long evaluations;
+    long accepted;
+} TemperingChain;
+
+typedef struct TemperingState {
+    HillclimbState climb;
+    int replicas;
+    long iterations;
+    long exchange;
+    double hottest;
+    double coldest;
+
+    TemperingChain *chains;	/* From the coldest to the hottest. */
+    long steps;			/* The number of steps in this round. */
+
+    /*
+     * The trades tried and made between chain i and chain i+1.
+     */
+
+    long *tries;
+    long *trades;
+
+    long evaluations;
+} TemperingState;
+
+/*
+ * Run one chain for a round.  This is called by the pool with the search
+ * state of the thread that runs it.
+ */
+
+static int
+TemperingRunChain(HillclimbState *climbPtr, int index, ClientData clientData)
+{
+    TemperingState *statePtr = (TemperingState *)clientData;
+    TemperingChain *chainPtr = statePtr->chains + index;
+    HillclimbMove move;
+    double value;
+    long step;
+    int result = TCL_OK;
+
+    climbPtr->rand = chainPtr->rand;
+    for (step=0; step < statePtr->steps; step++) {
+	HillclimbRandomMove(climbPtr, &move);
+	HillclimbApplyMove(&climbPtr->moves, chainPtr->key, &move);
+	result = HillclimbDecipher(climbPtr, chainPtr->key);
+	if (result == TCL_OK) {
+	    result = HillclimbScore(climbPtr, chainPtr->pt, chainPtr->value,
+		    &value);
+	}
+	if (result != TCL_OK) {
+	    break;
+	}
+	chainPtr->evaluations++;
+
+	if (value >= chainPtr->value || HillclimbRandom(climbPtr)
+		< exp((value - chainPtr->value) / chainPtr->temperature)) {
+	    chainPtr->value = value;
+	    HillclimbCopyPt(&chainPtr->pt, &chainPtr->ptSpace, climbPtr->pt);
+	    chainPtr->accepted++;
+
+	    if (value > chainPtr->maxValue) {
+		chainPtr->maxValue = value;
+		memcpy(chainPtr->maxKey, chainPtr->key, climbPtr->keySize);
+	    }
+	} else {
+	    HillclimbUndoMove(&climbPtr->moves, chainPtr->key, &move);
+	}
+    }
+    chainPtr->rand = climbPtr->rand;
+
+    return result;
+}
+
+/*
+ * Try to trade keys between chain i and chain i+1.
+ */
+
+static void
+TemperingTrade(TemperingState *statePtr, int i)
+{
+    TemperingChain *coldPtr = statePtr->chains + i;
+    TemperingChain *hotPtr = statePtr->chains + i + 1;
+    double delta;
+    char *key, *pt;
+    int ptSpace;
+    double value;
+
+    statePtr->tries[i]++;
+    delta = (hotPtr->value - coldPtr->value)
+	    * (1.0 / coldPtr->temperature - 1.0 / hotPtr->temperature);
+    if (delta < 0.0 && HillclimbRandom(&statePtr->climb) >= exp(delta)) {
+	return;
+    }
+    statePtr->trades[i]++;
+
+    key = coldPtr->key;
+    coldPtr->key = hotPtr->key;
+    hotPtr->key = key;
+    pt = coldPtr->pt;
+    coldPtr->pt = hotPtr->pt;
+    hotPtr->pt = pt;
+    ptSpace = coldPtr->ptSpace;
+    coldPtr->ptSpace = hotPtr->ptSpace;
+    hotPtr->ptSpace = ptSpace;
+    value = coldPtr->value;
+    coldPtr->value = hotPtr->value;
+    hotPtr->value = value;
+}
+
+/*
+ * Run every round from key.  On return maxKey holds the best key seen
+ * by any chain.  The trace gets a pair of the step and value for every
+ * improvement of the best key.
+ */
+
+static int
+TemperingRun(TemperingState *statePtr, HillclimbPool *poolPtr, char *key, char *maxKey, double *maxValuePtr, Tcl_Obj *traceObj)
+{
+    HillclimbState *climbPtr = &statePtr->climb;
+    Tcl_Interp *interp = climbPtr->interp;
+    int keySize = climbPtr->keySize;
+    double value, maxValue;
+    double ratio = 1.0;
+    long done, round, interval;
+    int result, improved, i;
+
+    result = HillclimbDecipher(climbPtr, key);
+    if (result == TCL_OK) {
+	result = HillclimbScore(climbPtr, (char *)NULL, 0.0, &value);
+    }
+    if (result != TCL_OK) {
+	return TCL_ERROR;
+    }
+    statePtr->evaluations++;
+
+    if (statePtr->hottest <= 0.0) {
+	char *pt = (char *)NULL;
+	int ptSpace = 0;
+
+	HillclimbCopyPt(&pt, &ptSpace, climbPtr->pt);
+	result = HillclimbEstimateTemperature(climbPtr, key, pt, value,
+		TEMPERING_HOT_ACCEPTANCE, &statePtr->evaluations,
+		&statePtr->hottest);
+	ckfree(pt);
+	if (result != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	result = HillclimbDecipher(climbPtr, key);
+	if (result != TCL_OK) {
+	    return TCL_ERROR;
+	}
+    }
+    if (statePtr->coldest <= 0.0) {
+	statePtr->coldest = statePtr->hottest / TEMPERING_RANGE;
+    } else if (statePtr->coldest > statePtr->hottest) {
+	statePtr->hottest = statePtr->coldest;
+    }
+    if (statePtr->replicas > 1) {
+	ratio = pow(statePtr->hottest / statePtr->coldest,
+		1.0 / (statePtr->replicas - 1));
+    }
+
+    /*
+     * Every chain starts from key.  The chains' generators are seeded
+     * from the search's generator, which also decides the trades.
+     */
+
+    for (i=0; i < statePtr->replicas; i++) {
+	TemperingChain *chainPtr = statePtr->chains + i;
+
+	RandomSeed(&chainPtr->rand, RandomNext(&climbPtr->rand));
+	chainPtr->temperature = statePtr->coldest * pow(ratio, i);
+	chainPtr->key = (char *)ckalloc(keySize);
+	chainPtr->maxKey = (char *)ckalloc(keySize);
+	memcpy(chainPtr->key, key, keySize);
+	memcpy(chainPtr->maxKey, key, keySize);
+	HillclimbCopyPt(&chainPtr->pt, &chainPtr->ptSpace, climbPtr->pt);
+	chainPtr->value = chainPtr->maxValue = value;
+    }
+
+    maxValue = value;
+    memcpy(maxKey, key, keySize);
+    result = HillclimbBestFit(climbPtr, maxKey, 0, maxValue);
+
+    interval = climbPtr->stepInterval;
+    for (done=0, round=0; done < statePtr->iterations && result == TCL_OK;
+	    round++) {
+	long last = done;
+
+	statePtr->steps = statePtr->exchange;
+	if (statePtr->steps > statePtr->iterations - done) {
+	    statePtr->steps = statePtr->iterations - done;
+	}
+	result = HillclimbPoolRun(poolPtr, statePtr->replicas,
+		TemperingRunChain, (ClientData)statePtr);
+	if (result != TCL_OK) {
+	    break;
+	}
+	done += statePtr->steps;
+
+	for (i=(int)(round % 2); i + 1 < statePtr->replicas; i += 2) {
+	    TemperingTrade(statePtr, i);
+	}
+
+	improved = 0;
+	for (i=0; i < statePtr->replicas; i++) {
+	    TemperingChain *chainPtr = statePtr->chains + i;
+
+	    if (chainPtr->maxValue > maxValue) {
+		Tcl_Obj *pairObjs[2];
+
+		maxValue = chainPtr->maxValue;
+		memcpy(maxKey, chainPtr->maxKey, keySize);
+		pairObjs[0] = Tcl_NewLongObj(done);
+		pairObjs[1] = Tcl_NewDoubleObj(maxValue);
+		Tcl_ListObjAppendElement(interp, traceObj,
+			Tcl_NewListObj(2, pairObjs));
+		improved = 1;
+	    }
+	}
+	if (improved) {
+	    result = HillclimbBestFit(climbPtr, maxKey, done, maxValue);
+	}
+
+	/*
+	 * The step command gets the coldest chain's key once for every
+	 * -stepinterval steps, at the end of the round that passes it.
+	 */
+
+	if (result == TCL_OK && interval > 0 && done / interval
+		!= last / interval) {
+	    result = HillclimbStep(climbPtr, statePtr->chains[0].key,
+		    (done / interval) * interval);
+	}
+    }
+
+    if (result == TCL_OK) {
+	result = HillclimbDecipher(climbPtr, maxKey);
+    }
+
+    *maxValuePtr = maxValue;
+    return result;
+}
+
+static void
+TemperingFreeState(TemperingState *statePtr)
+{
+    int i;
+
+    if (statePtr->chains) {
+	for (i=0; i < statePtr->replicas; i++) {
+	    TemperingChain *chainPtr = statePtr->chains + i;
+
+	    if (chainPtr->key) {
+		ckfree(chainPtr->key);
+		ckfree(chainPtr->maxKey);
+	    }
+	    if (chainPtr->pt) {
+		ckfree(chainPtr->pt);
+	    }
+	}
+	ckfree((char *)statePtr->chains);
+	ckfree((char *)statePtr->tries);
+	ckfree((char *)statePtr->trades);
+    }
+    HillclimbFreeState(&statePtr->climb);
+}
+
+/*
+ * Hillclimb::tempering cipher key ?options?
+ *
+ *	Search for the best key with parallel tempering.  Returns a list
+ *	of the best key found, its score, and a list of statistics about
+ *	the run.  The cipher is left with the best key restored.  See
+ *	doc/Hillclimb/package.tml for the options.
+ */
+
+int
+HillclimbTemperingObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
+{
+    TemperingState state;
+    HillclimbPool *poolPtr;
+    Tcl_Obj *resultObjs[3];
+    Tcl_Obj *statObjs[24];
+    Tcl_Obj *traceObj, *temperaturesObj, *acceptanceObj, *tradesObj;
+    Tcl_Time start, end;
+    char *key = (char *)NULL;
+    char *maxKey;
+    double maxValue = 0.0;
+    double seconds;
+    long evaluations;
+    int result = TCL_OK;
+    int i;
+
+    if (objc < 3 || objc % 2 == 0) {
+	Tcl_AppendResult(interp, "Usage:  ", Tcl_GetString(objv[0]),
+		" cipher key ?option value ...?", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    memset(&state, 0, sizeof(TemperingState));
+    if (HillclimbInitState(interp, objv[1], &state.climb) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    state.replicas = 8;
+    state.iterations = 100000;
+    state.exchange = 100;
+
+    for (i=3; i < objc; i += 2) {
+	const char *option = Tcl_GetString(objv[i]);
+
+	result = HillclimbStateOption(&state.climb, option, objv[i+1]);
+	if (result == TCL_ERROR) {
+	    return TCL_ERROR;
+	} else if (result == TCL_OK) {
+	    continue;
+	}
+	result = TCL_OK;
+
+	if (strcmp(option, "-replicas") == 0) {
+	    if (Tcl_GetIntFromObj(interp, objv[i+1], &state.replicas)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.replicas < 1) {
+		Tcl_SetResult(interp, "Replicas must be at least 1",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-iterations") == 0) {
+	    if (Tcl_GetLongFromObj(interp, objv[i+1], &state.iterations)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.iterations < 1) {
+		Tcl_SetResult(interp, "Iterations must be at least 1",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-exchange") == 0) {
+	    if (Tcl_GetLongFromObj(interp, objv[i+1], &state.exchange)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.exchange < 1) {
+		Tcl_SetResult(interp, "Exchange interval must be at least 1",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-temperature") == 0) {
+	    if (Tcl_GetDoubleFromObj(interp, objv[i+1], &state.hottest)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.hottest <= 0.0) {
+		Tcl_SetResult(interp, "Temperatures must be greater than 0",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else if (strcmp(option, "-final") == 0) {
+	    if (Tcl_GetDoubleFromObj(interp, objv[i+1], &state.coldest)
+		    != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (state.coldest <= 0.0) {
+		Tcl_SetResult(interp, "Temperatures must be greater than 0",
+			TCL_STATIC);
+		return TCL_ERROR;
+	    }
+	} else {
+	    Tcl_AppendResult(interp, "Unknown option ", option, (char *)NULL);
+	    return TCL_ERROR;
+	}
+    }
+
+    if (state.climb.restarts > 1) {
+	Tcl_SetResult(interp, "Parallel tempering can't use -restarts",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+    if (state.hottest > 0.0 && state.coldest > state.hottest) {
+	Tcl_SetResult(interp,
+		"The final temperature can't be above the starting temperature",
+		TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    if (HillclimbPrepare(&state.climb, objv[2], &key) != TCL_OK) {
+	TemperingFreeState(&state);
+	return TCL_ERROR;
+    }
+    if (state.climb.moves.count == 0) {
+	Tcl_SetResult(interp, "The key has no positions that can be swapped",
+		TCL_STATIC);
+	ckfree(key);
+	TemperingFreeState(&state);
+	return TCL_ERROR;
+    }
+    if (HillclimbPoolCreate(&state.climb, state.climb.threads, &poolPtr)
+	    != TCL_OK) {
+	ckfree(key);
+	TemperingFreeState(&state);
+	return TCL_ERROR;
+    }
+
+    state.chains = (TemperingChain *)ckalloc(sizeof(TemperingChain)
+	    * state.replicas);
+    memset(state.chains, 0, sizeof(TemperingChain) * state.replicas);
+    state.tries = (long *)ckalloc(sizeof(long) * state.replicas);
+    state.trades = (long *)ckalloc(sizeof(long) * state.replicas);
+    memset(state.tries, 0, sizeof(long) * state.replicas);
+    memset(state.trades, 0, sizeof(long) * state.replicas);
+    maxKey = (char *)ckalloc(state.climb.keySize);
+
+    traceObj = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+    Tcl_IncrRefCount(traceObj);
+
+    Tcl_GetTime(&start);
+    result = TemperingRun(&state, poolPtr, key, maxKey, &maxValue, traceObj);
+    Tcl_GetTime(&end);
+    HillclimbPoolDelete(poolPtr);
+
+    if (result == TCL_OK) {
+	seconds = (end.sec - start.sec) + (end.usec - start.usec) / 1e6;
+
+	evaluations = state.evaluations;
+	temperaturesObj = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+	acceptanceObj = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+	tradesObj = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+	for (i=0; i < state.replicas; i++) {
+	    TemperingChain *chainPtr = state.chains + i;
+
+	    evaluations += chainPtr->evaluations;
+	    Tcl_ListObjAppendElement(interp, temperaturesObj,
+		    Tcl_NewDoubleObj(chainPtr->temperature));
+	    Tcl_ListObjAppendElement(interp, acceptanceObj,
+		    Tcl_NewDoubleObj(chainPtr->evaluations
+			? (double)chainPtr->accepted / chainPtr->evaluations
+			: 0.0));
+	    if (i + 1 < state.replicas) {
+		Tcl_Obj *tradeObjs[3];
+
+		tradeObjs[0] = Tcl_NewDoubleObj(chainPtr->temperature);
+		tradeObjs[1] = Tcl_NewDoubleObj(chainPtr[1].temperature);
+		tradeObjs[2] = Tcl_NewDoubleObj(state.tries[i]
+			? (double)state.trades[i] / state.tries[i] : 0.0);
+		Tcl_ListObjAppendElement(interp, tradesObj,
+			Tcl_NewListObj(3, tradeObjs));
+	    }
+	}
+
+	statObjs[0] = Tcl_NewStringObj("evaluations", -1);
+	statObjs[1] = Tcl_NewLongObj(evaluations);
+	statObjs[2] = Tcl_NewStringObj("seconds", -1);
+	statObjs[3] = Tcl_NewDoubleObj(seconds);
+	statObjs[4] = Tcl_NewStringObj("rate", -1);
+	statObjs[5] = Tcl_NewDoubleObj(seconds > 0.0
+		? evaluations / seconds : 0.0);
+	statObjs[6] = Tcl_NewStringObj("seed", -1);
+	statObjs[7] = Tcl_NewLongObj(state.climb.seed);
+	statObjs[8] = Tcl_NewStringObj("iterations", -1);
+	statObjs[9] = Tcl_NewLongObj(state.iterations);
+	statObjs[10] = Tcl_NewStringObj("replicas", -1);
+	statObjs[11] = Tcl_NewIntObj(state.replicas);
+	statObjs[12] = Tcl_NewStringObj("threads", -1);
+	statObjs[13] = Tcl_NewIntObj(state.climb.threads);
+	statObjs[14] = Tcl_NewStringObj("temperatures", -1);
+	statObjs[15] = temperaturesObj;
+	statObjs[16] = Tcl_NewStringObj("acceptance", -1);
+	statObjs[17] = acceptanceObj;
+	statObjs[18] = Tcl_NewStringObj("exchanges", -1);
+	statObjs[19] = tradesObj;
+	statObjs[20] = Tcl_NewStringObj("exchange", -1);
+	statObjs[21] = Tcl_NewLongObj(state.exchange);
+	statObjs[22] = Tcl_NewStringObj("trace", -1);
+	statObjs[23] = traceObj;
+
+	resultObjs[0] = HillclimbKeyObj(&state.climb, maxKey);
+	resultObjs[1] = Tcl_NewDoubleObj(maxValue);
+	resultObjs[2] = Tcl_NewListObj(24, statObjs);
+	Tcl_SetObjResult(interp, Tcl_NewListObj(3, resultObjs));
+    }
+
+    Tcl_DecrRefCount(traceObj);
+    ckfree(key);
+    ckfree(maxKey);
+    TemperingFreeState(&state);
+
+    return result;
+}
@@ -26,9 +26,6 @@
 #include <math.h>
 #include <string.h>
 
-double TrigramStringValue _ANSI_ARGS_((const char *, double ***));
-double TrigramSingleValue _ANSI_ARGS_((unsigned char, unsigned char, unsigned char, double ***));
-
 static int CreateTrigram _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, int, const char **));
 static int AddTrigram _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *, double));
 static void DeleteTrigram _ANSI_ARGS_((ClientData));
@@ -36,13 +33,30 @@ static int NormalizeTrigramLog _ANSI_ARGS_((Tcl_Interp *, ScoreItem *));
 static double TrigramValue _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
 static double TrigramElementValue _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
 static int DumpTrigram _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static int SaveTrigram _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static int LoadTrigram _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *));
+static double TrigramDelta _ANSI_ARGS_((Tcl_Interp *, ScoreItem *, const char *, const char *, double, const int *, int));
+static double TrigramWindowValue _ANSI_ARGS_((ScoreItem *, const char *, int));
+static double TrigramGramValue _ANSI_ARGS_((ScoreItem *, const char *, int, int));
+static double TrigramMaxValue _ANSI_ARGS_((ScoreItem *));
+static double TrigramBlockValue _ANSI_ARGS_((ScoreItem *, const char *, int, int));
 
 typedef struct TrigramItem {
     ScoreItem header;
 
-    double ***value;
+    /*
+     * See SCORE_TRIGRAM_TABLE_SIZE in score.h for the layout.  Fixed
+     * point objects have a nonzero scale and keep their values in
+     * fixedValue instead of value.  See scoreFixedScale in score.h.
+     */
+    int scale;
+    double *value;
+    int *fixedValue;
 } TrigramItem;
 
+static double TrigramEntry _ANSI_ARGS_((TrigramItem *, int));
+static void SetTrigramEntry _ANSI_ARGS_((TrigramItem *, int, double));
+
 ScoreType TrigramLogType = {
     "trigramlog",
     sizeof(TrigramItem),
@@ -54,6 +68,12 @@ ScoreType TrigramLogType = {
     DeleteTrigram,
     DumpTrigram,
     ScoreMethodCmd,
+    SaveTrigram,
+    LoadTrigram,
+    TrigramDelta,
+    TrigramGramValue,
+    TrigramMaxValue,
+    TrigramBlockValue,
     (ScoreType *)NULL
 };
 
@@ -68,6 +88,12 @@ ScoreType TrigramCountType = {
     DeleteTrigram,
     DumpTrigram,
     ScoreMethodCmd,
+    SaveTrigram,
+    LoadTrigram,
+    TrigramDelta,
+    TrigramGramValue,
+    TrigramMaxValue,
+    TrigramBlockValue,
     (ScoreType *)NULL
 };
 
@@ -76,17 +102,19 @@ CreateTrigram(Tcl_Interp *interp, ScoreItem *itemPtr, int argc, const char **arg
     TrigramItem *tlPtr = (TrigramItem *)itemPtr;
     char temp_ptr[TCL_DOUBLE_SPACE];
     Tcl_DString dsPtr;
-    int i, j, k;
+    int i;
 
     tlPtr->header.elemSize = 3;
-    tlPtr->value = (double ***)ckalloc(sizeof(double **) * 26);
-    for (i=0; i < 26; i++) {
-	tlPtr->value[i] = (double **)ckalloc(sizeof(double *) * 26);
-	for (j=0; j < 26; j++) {
-	    tlPtr->value[i][j] = (double *)ckalloc(sizeof(double) * 26);
-	    for (k=0; k < 26; k++) {
-		tlPtr->value[i][j][k] = 0.0;
-	    }
+    tlPtr->scale = scoreFixedScale;
+    tlPtr->value = (double *)NULL;
+    tlPtr->fixedValue = (int *)NULL;
+    if (tlPtr->scale) {
+	tlPtr->fixedValue = (int *)ckalloc(sizeof(int) * SCORE_TRIGRAM_TABLE_SIZE);
+	memset(tlPtr->fixedValue, 0, sizeof(int) * SCORE_TRIGRAM_TABLE_SIZE);
+    } else {
+	tlPtr->value = (double *)ckalloc(sizeof(double) * SCORE_TRIGRAM_TABLE_SIZE);
+	for (i=0; i < SCORE_TRIGRAM_TABLE_SIZE; i++) {
+	    tlPtr->value[i] = 0.0;
 	}
     }
     sprintf(temp_ptr, "score%d", scoreid);
@@ -116,20 +144,15 @@ CreateTrigram(Tcl_Interp *interp, ScoreItem *itemPtr, int argc, const char **arg
 void
 DeleteTrigram(ClientData clientData) {
     TrigramItem *tlPtr = (TrigramItem *)clientData;
-    int i, j;
 
     if (tlPtr->value != NULL) {
-	for(i=0; i < 26; i++) {
-	    if (tlPtr->value[i] != NULL) {
-		for (j=0; j < 26; j++) {
-		    ckfree((char *)tlPtr->value[i][j]);
-		}
-	    }
-	    ckfree((char *)tlPtr->value[i]);
-	}
 	ckfree((char *)tlPtr->value);
     }
-    tlPtr->value = (double ***)NULL;
+    tlPtr->value = (double *)NULL;
+    if (tlPtr->fixedValue != NULL) {
+	ckfree((char *)tlPtr->fixedValue);
+    }
+    tlPtr->fixedValue = (int *)NULL;
 
     DeleteScore(clientData);
 }
@@ -146,7 +169,15 @@ AddTrigram(Tcl_Interp *interp, ScoreItem *itemPtr, const char *element, double v
 	return TCL_ERROR;
     }
 
-    tlPtr->value[element[0]-'a'][element[1]-'a'][element[2]-'a'] += value;
+    if (tlPtr->scale) {
+	int index = ScoreTrigramIndex(element);
+
+	tlPtr->fixedValue[index] = ScoreFixedEntry(
+		(double)tlPtr->fixedValue[index]
+		+ ScoreDoubleToFixed(value, tlPtr->scale));
+    } else {
+	tlPtr->value[ScoreTrigramIndex(element)] += value;
+    }
 
     Tcl_SetObjResult(interp, Tcl_NewStringObj(element, -1));
     return TCL_OK;
@@ -156,56 +187,30 @@ static double
 TrigramValue(Tcl_Interp *interp, ScoreItem *itemPtr, const char *string) {
     TrigramItem *tlPtr = (TrigramItem *)itemPtr;
 
-    return TrigramStringValue(string, (double ***)tlPtr->value);
+    if (tlPtr->scale) {
+	return (double)ScoreTrigramFixedSum(tlPtr->fixedValue, string,
+		strlen(string)) / tlPtr->scale;
+    }
+
+    return ScoreTrigramSum(tlPtr->value, string, strlen(string));
 }
 
 static double
 TrigramElementValue(Tcl_Interp *interp, ScoreItem *itemPtr, const char *string) {
     TrigramItem *tlPtr = (TrigramItem *)itemPtr;
 
-    return TrigramSingleValue((unsigned char)string[0], (unsigned char)string[1], (unsigned char)string[2], tlPtr->value);
-}
-
-double
-TrigramStringValue(const char *string, double ***table) {
-    int length = strlen(string);
-    double value = 0.0;
-    int i;
-
-    for (i=2; i < length; i++) {
-	if ((string[i-2] >= 'a' && string[i-2] <= 'z')
-		&& (string[i-1] >= 'a' && string[i-1] <= 'z')
-		&& (string[i] >= 'a' && string[i] <= 'z')) {
-	    value += TrigramSingleValue(string[i-2], string[i-1], string[i], table);
-	}
-    }
-    
-    return value;
-}
-
-/*
- * TODO:  Replace this with a macro
- */
-double
-TrigramSingleValue(unsigned char val1, unsigned char val2, unsigned char val3, double ***table) {
-    return table[val1-'a'][val2-'a'][val3-'a'];
+    return TrigramEntry(tlPtr, ScoreTrigramIndex(string));
 }
 
 static int
 NormalizeTrigramLog(Tcl_Interp *interp, ScoreItem *itemPtr) {
     TrigramItem *tlPtr = (TrigramItem *)itemPtr;
-    int i, j, k;
+    int i;
 
-    for(i=0; i < 26; i++) {
-	for (j=0; j < 26; j++) {
-	    for (k=0; k < 26; k++) {
-		if (tlPtr->value[i][j][k] > 0.0) {
-		    tlPtr->value[i][j][k] = log(tlPtr->value[i][j][k]);
-		} else {
-		    tlPtr->value[i][j][k] = 0.0;
-		}
-	    }
-	}
+    for(i=0; i < SCORE_TRIGRAM_TABLE_SIZE; i++) {
+	double value = TrigramEntry(tlPtr, i);
+
+	SetTrigramEntry(tlPtr, i, (value > 0.0) ? log(value) : 0.0);
     }
 
     Tcl_ResetResult(interp);
@@ -230,15 +235,19 @@ DumpTrigram(Tcl_Interp *interp, ScoreItem *itemPtr, const char *script) {
     for (i='a'; i <= 'z'; i++) {
 	for (j='a'; j <= 'z'; j++) {
 	    for (k='a'; k <= 'z'; k++) {
-		if (TrigramSingleValue(i, j, k, tlPtr->value) > 0.0) {
-		    element[0] = i;
-		    element[1] = j;
-		    element[2] = k;
+		double value;
+
+		element[0] = i;
+		element[1] = j;
+		element[2] = k;
+		value = TrigramEntry(tlPtr, ScoreTrigramIndex(element));
+
+		if (value > 0.0) {
 
 		    Tcl_DStringSetLength(&dsPtr, length);
 		    Tcl_DStringStartSublist(&dsPtr);
 		    Tcl_DStringAppendElement(&dsPtr, element);
-		    Tcl_SetDoubleObj(valueObj, TrigramSingleValue(i, j, k, tlPtr->value));
+		    Tcl_SetDoubleObj(valueObj, value);
 		    Tcl_DStringAppendElement(&dsPtr, Tcl_GetString(valueObj));
 		    Tcl_DStringEndSublist(&dsPtr);
 
@@ -254,3 +263,162 @@ DumpTrigram(Tcl_Interp *interp, ScoreItem *itemPtr, const char *script) {
 
     return TCL_OK;
 }
+
+static int
+SaveTrigram(Tcl_Interp *interp, ScoreItem *itemPtr, const char *filename) {
+    TrigramItem *tlPtr = (TrigramItem *)itemPtr;
+    double *table = (double *)ckalloc(sizeof(double) * 26 * 26 * 26);
+    int result;
+    int i, j, k;
+
+    /*
+     * Binary score tables only hold the entries for the letters a-z.
+     */
+
+    for (i=0; i < 26; i++) {
+	for (j=0; j < 26; j++) {
+	    for (k=0; k < 26; k++) {
+		table[(i*26 + j)*26 + k]
+			= TrigramEntry(tlPtr, (i*27 + j)*27 + k);
+	    }
+	}
+    }
+
+    result = ScoreTableWrite(interp, filename, itemPtr, SCORE_TABLE_ALPHA,
+	    table, sizeof(double), 26 * 26 * 26);
+
+    ckfree((char *)table);
+
+    return result;
+}
+
+static int
+LoadTrigram(Tcl_Interp *interp, ScoreItem *itemPtr, const char *filename) {
+    TrigramItem *tlPtr = (TrigramItem *)itemPtr;
+    ScoreTableMap map;
+    const double *table;
+    int entries;
+    int i, j, k;
+
+    table = (const double *)ScoreTableOpen(interp, filename, itemPtr,
+	    SCORE_TABLE_ALPHA, sizeof(double), &map, &entries);
+    if (table == NULL) {
+	return TCL_ERROR;
+    }
+
+    if (entries != 26 * 26 * 26) {
+	ScoreTableClose(&map);
+	Tcl_AppendResult(interp, "\"", filename,
+		"\" does not hold a valid trigram table", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    for (i=0; i < 26; i++) {
+	for (j=0; j < 26; j++) {
+	    for (k=0; k < 26; k++) {
+		SetTrigramEntry(tlPtr, (i*27 + j)*27 + k,
+			table[(i*26 + j)*26 + k]);
+	    }
+	}
+    }
+
+    ScoreTableClose(&map);
+
+    Tcl_ResetResult(interp);
+    return TCL_OK;
+}
+
+static double
+TrigramWindowValue(ScoreItem *itemPtr, const char *string, int start) {
+    TrigramItem *tlPtr = (TrigramItem *)itemPtr;
+
+    /*
+     * Windows with characters other than a-z index entries that are
+     * always zero.  See SCORE_TRIGRAM_TABLE_SIZE.  Fixed point windows
+     * are returned in table units so that TrigramDelta() only adds up
+     * integers.
+     */
+
+    if (tlPtr->scale) {
+	return (double)tlPtr->fixedValue[ScoreTrigramIndex(string+start)];
+    }
+
+    return tlPtr->value[ScoreTrigramIndex(string+start)];
+}
+
+static double
+TrigramGramValue(ScoreItem *itemPtr, const char *string, int start, int index) {
+    TrigramItem *tlPtr = (TrigramItem *)itemPtr;
+
+    if (index < 0) {
+	return 0.0;
+    }
+
+    /*
+     * Convert the base-26 index to the base-27 table index.
+     */
+
+    return TrigramEntry(tlPtr, index + (index / 676)*53 + (index / 26) % 26);
+}
+
+static double
+TrigramMaxValue(ScoreItem *itemPtr) {
+    TrigramItem *tlPtr = (TrigramItem *)itemPtr;
+    double max = 0.0;
+    int i;
+
+    for (i=0; i < SCORE_TRIGRAM_TABLE_SIZE; i++) {
+	double value = TrigramEntry(tlPtr, i);
+
+	if (value > max) {
+	    max = value;
+	}
+    }
+
+    return max;
+}
+
+static double
+TrigramBlockValue(ScoreItem *itemPtr, const char *string, int start, int count) {
+    TrigramItem *tlPtr = (TrigramItem *)itemPtr;
+
+    if (tlPtr->scale) {
+	return (double)ScoreTrigramFixedSum(tlPtr->fixedValue, string+start,
+		count+2) / tlPtr->scale;
+    }
+
+    return ScoreTrigramSum(tlPtr->value, string+start, count+2);
+}
+
+static double
+TrigramDelta(Tcl_Interp *interp, ScoreItem *itemPtr, const char *oldString, const char *newString, double oldValue, const int *positions, int count) {
+    TrigramItem *tlPtr = (TrigramItem *)itemPtr;
+
+    if (tlPtr->scale) {
+	return ScoreWindowDelta(itemPtr, TrigramWindowValue, 3, oldString,
+		newString, ScoreDoubleToFixed(oldValue, tlPtr->scale),
+		positions, count) / tlPtr->scale;
+    }
+
+    return ScoreWindowDelta(itemPtr, TrigramWindowValue, 3, oldString,
+	    newString, oldValue, positions, count);
+}
+
+static double
+TrigramEntry(TrigramItem *tlPtr, int index) {
+    if (tlPtr->scale) {
+	return (double)tlPtr->fixedValue[index] / tlPtr->scale;
+    }
+
+    return tlPtr->value[index];
+}
+
+static void
+SetTrigramEntry(TrigramItem *tlPtr, int index, double value) {
+    if (tlPtr->scale) {
+	tlPtr->fixedValue[index] = ScoreFixedEntry(
+		ScoreDoubleToFixed(value, tlPtr->scale));
+    } else {
+	tlPtr->value[index] = value;
+    }
+}
@@ -54,6 +54,12 @@ ScoreType WordtreeType = {
     DeleteWordtreeScore,
     DumpWordtreeScore,
     ScoreMethodCmd,
+    (ScoreSaveProc *)NULL,
+    (ScoreLoadProc *)NULL,
+    (ScoreDeltaProc *)NULL,
+    (ScoreGramProc *)NULL,
+    (ScoreMaxProc *)NULL,
+    (ScoreBlockProc *)NULL,
     (ScoreType *)NULL
 };
 
@@ -116,7 +122,7 @@ WordtreeValue(Tcl_Interp *interp, ScoreItem *itemPtr, const char *string) {
     int wordLen;
     int wVal;
     int startPos = 0;
-    double totalVal = 0.0;
+    int totalVal = 0;
     unsigned short int value = 0;
 
     wordLen = strlen(string);
@@ -130,7 +136,7 @@ WordtreeValue(Tcl_Interp *interp, ScoreItem *itemPtr, const char *string) {
 	}
     }
 
-    return totalVal;
+    return (double) totalVal;
 }
 
 static double